@@ -145,5 +145,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "StreamReader.h"
 #include "qnan.h"
 
+/* Loops over more elements than this are distributed over the threads with OpenMP if
+ * the library is compiled with OpenMP support (/openmp), smaller loops stay serial.
+ */
+#define AI_PARALLEL_MIN_ELEMENTS 10000
+#ifdef _OPENMP
+#	include <omp.h>
+#endif
+
 
 #endif // !! ASSIMP_PCH_INCLUDED
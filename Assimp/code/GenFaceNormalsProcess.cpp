@@ -115,7 +115,10 @@ bool GenFaceNormalsProcess::GenMeshFaceNormals (aiMesh* pMesh)
 	const float qnan = get_qnan();
 
 	// iterate through all faces and compute per-face normals but store them per-vertex. 
-	for( unsigned int a = 0; a < pMesh->mNumFaces; a++)	{
+	// The vertices are not shared between faces (verbose format), so the faces are independent.
+	const int numFaces = (int)pMesh->mNumFaces;
+#pragma omp parallel for if(numFaces > AI_PARALLEL_MIN_ELEMENTS)
+	for( int a = 0; a < numFaces; a++)	{
 		const aiFace& face = pMesh->mFaces[a];
 		if (face.mNumIndices < 3)	{
 			// either a point or a line -> no well-defined normal vector
@@ -126,7 +126,9 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 	pMesh->mNormals = new aiVector3D[pMesh->mNumVertices];
 
 	// Compute per-face normals but store them per-vertex
-	for( unsigned int a = 0; a < pMesh->mNumFaces; a++)
+	const int numFaces = (int)pMesh->mNumFaces;
+#pragma omp parallel for if(numFaces > AI_PARALLEL_MIN_ELEMENTS)
+	for( int a = 0; a < numFaces; a++)
 	{
 		const aiFace& face = pMesh->mFaces[a];
 		if (face.mNumIndices < 3)
@@ -166,33 +168,31 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 		vertexFinder = &_vertexFinder;
 		posEpsilon = ComputePositionEpsilon(pMesh);
 	}
-	std::vector<unsigned int> verticesFound;
 	aiVector3D* pcNew = new aiVector3D[pMesh->mNumVertices];
+	const int numVertices = (int)pMesh->mNumVertices;
 
 	if (configMaxAngle >= AI_DEG_TO_RAD( 175.f ))	{
 		// There is no angle limit. Thus all vertices with positions close
-		// to each other will receive the same vertex normal. This allows us
-		// to optimize the whole algorithm a little bit ...
-		std::vector<bool> abHad(pMesh->mNumVertices,false);
-		for (unsigned int i = 0; i < pMesh->mNumVertices;++i)	{
-			if (abHad[i])continue;
-
-			// Get all vertices that share this one ...
-			vertexFinder->FindPositions( pMesh->mVertices[i], posEpsilon, verticesFound);
-
-			aiVector3D pcNor; 
-			for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
-				const aiVector3D& v = pMesh->mNormals[verticesFound[a]];
-				if (is_not_qnan(v.x))pcNor += v;
-			}
-			pcNor.Normalize();
-
-			// Write the smoothed normal back to all affected normals
-			for (unsigned int a = 0; a < verticesFound.size(); ++a)
-			{
-				register unsigned int vidx = verticesFound[a];
-				pcNew[vidx] = pcNor;
-				abHad[vidx] = true;
+		// to each other will receive the same vertex normal. The serial version
+		// wrote the normal of a group to all of its vertices at once, this is not
+		// possible with the vertices distributed over the threads. Every vertex
+		// looks up its own group instead, for (nearly) identical positions this
+		// gives the same result.
+#pragma omp parallel if(numVertices > AI_PARALLEL_MIN_ELEMENTS)
+		{
+			std::vector<unsigned int> verticesFound;
+
+#pragma omp for
+			for (int i = 0; i < numVertices;++i)	{
+				// Get all vertices that share this one ...
+				vertexFinder->FindPositions( pMesh->mVertices[i], posEpsilon, verticesFound);
+
+				aiVector3D pcNor; 
+				for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
+					const aiVector3D& v = pMesh->mNormals[verticesFound[a]];
+					if (is_not_qnan(v.x))pcNor += v;
+				}
+				pcNew[i] = pcNor.Normalize();
 			}
 		}
 	}
@@ -200,24 +200,30 @@ bool GenVertexNormalsProcess::GenMeshVertexNormals (aiMesh* pMesh, unsigned int
 	// the effect, this one is the most straightforward one.
 	else	{
 		const float fLimit = ::cos(configMaxAngle); 
-		for (unsigned int i = 0; i < pMesh->mNumVertices;++i)	{
-			// Get all vertices that share this one ...
-			vertexFinder->FindPositions( pMesh->mVertices[i] , posEpsilon, verticesFound);
-
-			aiVector3D pcNor; 
-			for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
-				const aiVector3D& v = pMesh->mNormals[verticesFound[a]];
-
-				// check whether the angle between the two normals is not too large
-				// HACK: if v.x is qnan the dot product will become qnan, too
-				//   therefore the comparison against fLimit should be false
-				//   in every case. 
-				if (v * pMesh->mNormals[i] < fLimit)
-					continue;
-
-				pcNor += v;
+#pragma omp parallel if(numVertices > AI_PARALLEL_MIN_ELEMENTS)
+		{
+			std::vector<unsigned int> verticesFound;
+
+#pragma omp for
+			for (int i = 0; i < numVertices;++i)	{
+				// Get all vertices that share this one ...
+				vertexFinder->FindPositions( pMesh->mVertices[i] , posEpsilon, verticesFound);
+
+				aiVector3D pcNor; 
+				for (unsigned int a = 0; a < verticesFound.size(); ++a)	{
+					const aiVector3D& v = pMesh->mNormals[verticesFound[a]];
+
+					// check whether the angle between the two normals is not too large
+					// HACK: if v.x is qnan the dot product will become qnan, too
+					//   therefore the comparison against fLimit should be false
+					//   in every case. 
+					if (v * pMesh->mNormals[i] < fLimit)
+						continue;
+
+					pcNor += v;
+				}
+				pcNew[i] = pcNor.Normalize();
 			}
-			pcNew[i] = pcNor.Normalize();
 		}
 	}
 
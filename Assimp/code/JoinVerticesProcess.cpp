@@ -52,9 +52,142 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TinyFormatter.h"
 
 using namespace Assimp;
+
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Hash grid over the vertex positions of a mesh. The cells are twice as large as the position
+// epsilon, so the positions within the epsilon of a query point lie in at most 2x2x2 cells.
+// Without welding, only equal positions are returned, like SpatialSort::FindIdenticalPositions.
+// Equal positions always share a cell, so then only one cell is searched.
+// Unlike SpatialSort, the lookup cost does not grow with the number of vertices that have the
+// same distance to the sort plane, which are many on meshes with split UV seams.
+class VertexHashGrid
+{
+public:
+	// -------------------------------------------------------------------
+	/** Hashes the positions into the grid, the position array must stay valid.
+	 *  The epsilon sets the cell size, positions are only welded within it if weld is set. */
+	void Fill( const aiVector3D* positions, unsigned int numPositions, float epsilon, bool weld);
+
+	// -------------------------------------------------------------------
+	/** Returns the vertices with an index below maxIndex whose position is equal to the
+	 *  given position, or within the epsilon if welding, in ascending order. */
+	void FindPositions( const aiVector3D& position, unsigned int maxIndex, std::vector<unsigned int>& results) const;
+
+private:
+	int GetCell( float value, float minValue) const {
+		return (int)floor( (value - minValue) * mInvCellSize);
+	}
+
+	unsigned int GetBucket( int x, int y, int z) const {
+		return ((unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u) & mBucketMask;
+	}
+
+	const aiVector3D* mPositions;
+	aiVector3D mMin;
+	float mEpsilon;
+	bool mWeld;
+	float mInvCellSize;
+	unsigned int mBucketMask;
+
+	// vertex indices sorted by bucket, mEntries[mBucketOffsets[b]] to mEntries[mBucketOffsets[b+1]]
+	// are the vertices of bucket b in ascending order
+	std::vector<unsigned int> mBucketOffsets;
+	std::vector<unsigned int> mEntries;
+};
+
+// ------------------------------------------------------------------------------------------------
+void VertexHashGrid::Fill( const aiVector3D* positions, unsigned int numPositions, float epsilon, bool weld)
+{
+	mPositions = positions;
+	mEpsilon = epsilon;
+	mWeld = weld;
+
+	aiVector3D maxVec;
+	ArrayBounds( positions, numPositions, mMin, maxVec);
+
+	// an epsilon of 0 means that all positions are equal, any cell size does then
+	mInvCellSize = epsilon > 0.f ? 0.5f / epsilon : 1.f;
+
+	unsigned int numBuckets = 1;
+	while (numBuckets < numPositions) {
+		numBuckets <<= 1;
+	}
+	mBucketMask = numBuckets - 1;
+
+	// hashing is the expensive part, the bucket of each vertex is independent of the others
+	std::vector<unsigned int> buckets( numPositions);
+#pragma omp parallel for if(numPositions > AI_PARALLEL_MIN_ELEMENTS)
+	for( int a = 0; a < (int)numPositions; a++) {
+		const aiVector3D& p = positions[a];
+		buckets[a] = GetBucket( GetCell( p.x, mMin.x), GetCell( p.y, mMin.y), GetCell( p.z, mMin.z));
+	}
+
+	// counting sort by bucket, stable so that the vertices of a bucket stay in ascending order
+	mBucketOffsets.assign( numBuckets + 1, 0);
+	for( unsigned int a = 0; a < numPositions; a++) {
+		++mBucketOffsets[buckets[a] + 1];
+	}
+	for( unsigned int b = 0; b < numBuckets; b++) {
+		mBucketOffsets[b + 1] += mBucketOffsets[b];
+	}
+
+	std::vector<unsigned int> fill( mBucketOffsets.begin(), mBucketOffsets.end() - 1);
+	mEntries.resize( numPositions);
+	for( unsigned int a = 0; a < numPositions; a++) {
+		mEntries[fill[buckets[a]]++] = a;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+void VertexHashGrid::FindPositions( const aiVector3D& position, unsigned int maxIndex, std::vector<unsigned int>& results) const
+{
+	results.clear();
+
+	const float radius = mWeld ? mEpsilon : 0.f;
+	const int x0 = GetCell( position.x - radius, mMin.x), x1 = GetCell( position.x + radius, mMin.x);
+	const int y0 = GetCell( position.y - radius, mMin.y), y1 = GetCell( position.y + radius, mMin.y);
+	const int z0 = GetCell( position.z - radius, mMin.z), z1 = GetCell( position.z + radius, mMin.z);
+	const float radiusSqr = radius * radius;
+
+	// different cells may share a bucket, which must be searched only once
+	unsigned int visited[8];
+	unsigned int numVisited = 0;
+
+	for( int z = z0; z <= z1; z++) {
+		for( int y = y0; y <= y1; y++) {
+			for( int x = x0; x <= x1; x++) {
+				const unsigned int bucket = GetBucket( x, y, z);
+				if (std::find( visited, visited + numVisited, bucket) != visited + numVisited) {
+					continue;
+				}
+				visited[numVisited++] = bucket;
+
+				for( unsigned int e = mBucketOffsets[bucket]; e < mBucketOffsets[bucket + 1]; e++) {
+					const unsigned int index = mEntries[e];
+					if (index >= maxIndex) {
+						break;
+					}
+					if ((mPositions[index] - position).SquareLength() <= radiusSqr) {
+						results.push_back( index);
+					}
+				}
+			}
+		}
+	}
+
+	// the earliest unique vertex wins, as with a linear search
+	std::sort( results.begin(), results.end());
+}
+
+} // end of anonymous namespace
+
 // ------------------------------------------------------------------------------------------------
 // Constructor to be privately used by Importer
 JoinVerticesProcess::JoinVerticesProcess()
+: configUseHashGrid (false)
+, configWeldPositions (false)
 {
 	// nothing to do here
 }
@@ -72,6 +205,14 @@ bool JoinVerticesProcess::IsActive( unsigned int pFlags) const
 {
 	return (pFlags & aiProcess_JoinIdenticalVertices) != 0;
 }
+
+// ------------------------------------------------------------------------------------------------
+// Setup import configuration
+void JoinVerticesProcess::SetupProperties(const Importer* pImp)
+{
+	configUseHashGrid = (0 != pImp->GetPropertyInteger(AI_CONFIG_PP_JV_HASH_GRID,0));
+	configWeldPositions = (0 != pImp->GetPropertyInteger(AI_CONFIG_PP_JV_WELD_POSITIONS,0));
+}
 // ------------------------------------------------------------------------------------------------
 // Executes the post processing step on the given imported data.
 void JoinVerticesProcess::Execute( aiScene* pScene)
@@ -138,25 +279,26 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 	// A little helper to find locally close vertices faster.
 	// Try to reuse the lookup table from the last step.
 	const static float epsilon = 1e-5f;
-	float posEpsilonSqr;
 	SpatialSort* vertexFinder = NULL;
 	SpatialSort _vertexFinder;
+	VertexHashGrid vertexGrid;
 
 	typedef std::pair<SpatialSort,float> SpatPair;
-	if (shared)	{
+	if (configUseHashGrid) {
+		vertexGrid.Fill(pMesh->mVertices, pMesh->mNumVertices, ComputePositionEpsilon(pMesh), configWeldPositions);
+	}
+	else if (shared)	{
 		std::vector<SpatPair >* avf;
 		shared->GetProperty(AI_SPP_SPATIAL_SORT,avf);
 		if (avf)	{
 			SpatPair& blubb = (*avf)[meshIndex];
 			vertexFinder  = &blubb.first;
-			posEpsilonSqr = blubb.second;
 		}
 	}
-	if (!vertexFinder)	{
+	if (!configUseHashGrid && !vertexFinder)	{
 		// bad, need to compute it.
 		_vertexFinder.Fill(pMesh->mVertices, pMesh->mNumVertices, sizeof( aiVector3D));
 		vertexFinder = &_vertexFinder; 
-		posEpsilonSqr = ComputePositionEpsilon(pMesh);
 	}
 
 	// Squared because we check against squared length of the vector difference
@@ -183,7 +325,12 @@ int JoinVerticesProcess::ProcessMesh( aiMesh* pMesh, unsigned int meshIndex)
 		Vertex v(pMesh,a);
 
 		// collect all vertices that are close enough to the given position
-		vertexFinder->FindIdenticalPositions( v.position, verticesFound);
+		if (configUseHashGrid) {
+			vertexGrid.FindPositions( v.position, a, verticesFound);
+		}
+		else {
+			vertexFinder->FindIdenticalPositions( v.position, verticesFound);
+		}
 		unsigned int matchIndex = 0xffffffff;
 
 		// check all unique vertices close to the position if this vertex is already present among them
@@ -89,6 +89,13 @@ public:
 	*/
 	void Execute( aiScene* pScene);
 
+	// -------------------------------------------------------------------
+	/** Called prior to ExecuteOnScene().
+	* The function is a request to the process to update its configuration
+	* basing on the Importer's configuration property list.
+	*/
+	void SetupProperties(const Importer* pImp);
+
 protected:
 	// -------------------------------------------------------------------
 	/** Unites identical vertices in the given mesh.
@@ -98,6 +105,11 @@ protected:
 	int ProcessMesh( aiMesh* pMesh, unsigned int meshIndex);
 
 private:
+	/** Configuration option: find coincident vertices with a hash grid */
+	bool configUseHashGrid;
+
+	/** Configuration option: weld positions within the position epsilon, hash grid only */
+	bool configWeldPositions;
 };
 
 } // end of namespace Assimp
@@ -90,6 +90,30 @@ void SpatialSort::Fill( const aiVector3D* pPositions, unsigned int pNumPositions
 // ------------------------------------------------------------------------------------------------
 void SpatialSort :: Finalize()
 {
+#ifdef _OPENMP
+	// sort one chunk per thread, then merge pairs of neighboring chunks until one is left
+	const int numChunks = omp_get_max_threads();
+	if (numChunks > 1 && mPositions.size() > AI_PARALLEL_MIN_ELEMENTS) {
+		std::vector<size_t> bounds(numChunks+1);
+		for (int i = 0; i <= numChunks; ++i) {
+			bounds[i] = mPositions.size() * i / numChunks;
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < numChunks; ++i) {
+			std::sort( mPositions.begin() + bounds[i], mPositions.begin() + bounds[i+1]);
+		}
+
+		for (int width = 1; width < numChunks; width *= 2) {
+#pragma omp parallel for
+			for (int i = 0; i < numChunks - width; i += 2*width) {
+				std::inplace_merge( mPositions.begin() + bounds[i], mPositions.begin() + bounds[i+width], 
+					mPositions.begin() + bounds[std::min(i+2*width,numChunks)]);
+			}
+		}
+		return;
+	}
+#endif
 	std::sort( mPositions.begin(), mPositions.end());
 }
 
@@ -101,14 +125,18 @@ void SpatialSort::Append( const aiVector3D* pPositions, unsigned int pNumPositio
 	// store references to all given positions along with their distance to the reference plane
 	const size_t initial = mPositions.size();
 	mPositions.reserve(initial + (pFinalize?pNumPositions:pNumPositions*2));
-	for( unsigned int a = 0; a < pNumPositions; a++)
+	mPositions.resize(initial + pNumPositions);
+
+	const int numPositions = (int)pNumPositions;
+#pragma omp parallel for if(numPositions > AI_PARALLEL_MIN_ELEMENTS)
+	for( int a = 0; a < numPositions; a++)
 	{
 		const char* tempPointer = reinterpret_cast<const char*> (pPositions);
 		const aiVector3D* vec   = reinterpret_cast<const aiVector3D*> (tempPointer + a * pElementOffset);
 
 		// store position by index and distance
 		float distance = *vec * mPlaneNormal;
-		mPositions.push_back( Entry( a+initial, *vec, distance));
+		mPositions[initial + a] = Entry( a+initial, *vec, distance);
 	}
 
 	if (pFinalize) {
@@ -154,10 +154,13 @@ bool TriangulateProcess::TriangulateMesh( aiMesh* pMesh)
 	pMesh->mPrimitiveTypes |= aiPrimitiveType_TRIANGLE;
 	pMesh->mPrimitiveTypes &= ~aiPrimitiveType_POLYGON;
 
-	// Find out how many output faces we'll get
+	// Find out how many output faces we'll get. Every face knows where its triangles
+	// start, so that the faces can be triangulated in parallel.
 	unsigned int numOut = 0, max_out = 0;
+	std::vector<unsigned int> faceOut(pMesh->mNumFaces);
 	for( unsigned int a = 0; a < pMesh->mNumFaces; a++)	{
 		aiFace& face = pMesh->mFaces[a];
+		faceOut[a] = numOut;
 		if( face.mNumIndices <= 3)
 			numOut++;
 
@@ -175,8 +178,7 @@ bool TriangulateProcess::TriangulateMesh( aiMesh* pMesh)
 		nor_out = pMesh->mNormals = new aiVector3D[pMesh->mNumVertices];
 	}
 
-	aiFace* out = new aiFace[numOut], *curOut = out;
-	std::vector<aiVector3D> temp_verts(max_out+2); /* temporary storage for vertices */
+	aiFace* out = new aiFace[numOut];
 
 	// Apply vertex colors to represent the face winding?
 #ifdef AI_BUILD_TRIANGULATE_COLOR_FACE_WINDING
@@ -188,10 +190,18 @@ bool TriangulateProcess::TriangulateMesh( aiMesh* pMesh)
 	aiColor4D* clr = pMesh->mColors[0];
 #endif
 
+	const int numFaces = (int)pMesh->mNumFaces;
+	int numFailed = 0;
+#pragma omp parallel if(numFaces > AI_PARALLEL_MIN_ELEMENTS) reduction(+:numFailed)
+	{
+	std::vector<aiVector3D> temp_verts(max_out+2); /* temporary storage for vertices */
+
 	// use boost::scoped_array to avoid slow std::vector<bool> specialiations
 	boost::scoped_array<bool> done(new bool[max_out]); 
-	for( unsigned int a = 0; a < pMesh->mNumFaces; a++)	{
+#pragma omp for schedule(dynamic,1024)
+	for( int a = 0; a < numFaces; a++)	{
 		aiFace& face = pMesh->mFaces[a];
+		aiFace* curOut = out + faceOut[a];
 
 		unsigned int* idx = face.mIndices;
 		int num = (int)face.mNumIndices, ear = 0, tmp, prev = num-1, next = 0, max = num;
@@ -336,7 +346,8 @@ bool TriangulateProcess::TriangulateMesh( aiMesh* pMesh)
 
 					// Instead we're continuting with the standard trifanning algorithm which we'd
 					// use if we had only convex polygons. That's life.
-					DefaultLogger::get()->error("Failed to triangulate polygon (no ear found). Probably not a simple polygon?");
+					// (the logger is not thread-safe, the error is reported after the loop)
+					++numFailed;
 
 					curOut -= (max-num); /* undo all previous work */
 					for (tmp = 0; tmp < max-2; ++tmp) {
@@ -388,13 +399,20 @@ bool TriangulateProcess::TriangulateMesh( aiMesh* pMesh)
 		}
 		face.mIndices = NULL; /* prevent unintended deletion of our awesome results. would be a pity */
 	}
+	}
+
+	if (numFailed) {
+		DefaultLogger::get()->error("Failed to triangulate " + boost::lexical_cast<std::string>(numFailed) +
+			" polygon(s) (no ear found). Probably not a simple polygon?");
+	}
 
 	// kill the old faces
 	delete [] pMesh->mFaces;
 
-	// ... and store the new ones
+	// ... and store the new ones. Every polygon with n vertices gives n-2 triangles,
+	// also if the ear cutting failed and it was trifanned.
 	pMesh->mFaces    = out;
-	pMesh->mNumFaces = (unsigned int)(curOut-out); /* not necessarily equal to numOut */
+	pMesh->mNumFaces = numOut;
 	return true;
 }
 
@@ -389,6 +389,34 @@ enum aiComponent
 #define AI_CONFIG_PP_SBP_REMOVE				\
 	"PP_SBP_REMOVE"
 
+// ---------------------------------------------------------------------------
+/** @brief Configures the #aiProcess_JoinIdenticalVertices step to find
+ *  coincident vertices with a hash grid instead of a SpatialSort.
+ *
+ *  The grid hashes the positions into cells of twice the position epsilon
+ *  (1e-4 of the bounding box diagonal of the mesh). Like the SpatialSort,
+ *  it only joins vertices with equal positions unless
+ *  #AI_CONFIG_PP_JV_WELD_POSITIONS is set. Use this for large meshes with
+ *  many coincident vertices, e.g. OBJ exports with split UV seams, where the
+ *  SpatialSort degenerates to long linear searches.
+ *  Property type: bool. Default value: false.
+ */
+#define AI_CONFIG_PP_JV_HASH_GRID			\
+	"PP_JV_HASH_GRID"
+
+// ---------------------------------------------------------------------------
+/** @brief Configures the #aiProcess_JoinIdenticalVertices step to also join
+ *  vertices whose positions are closer than the position epsilon.
+ *
+ *  This welds positions that differ by rounding errors, e.g. the vertices
+ *  of adjacent faces that were transformed separately, but it also joins
+ *  distinct vertices of features smaller than the epsilon. Only used with
+ *  #AI_CONFIG_PP_JV_HASH_GRID.
+ *  Property type: bool. Default value: false.
+ */
+#define AI_CONFIG_PP_JV_WELD_POSITIONS			\
+	"PP_JV_WELD_POSITIONS"
+
 // ---------------------------------------------------------------------------
 /** @brief Input parameter to the #aiProcess_FindInvalidData step:
  *  Specifies the floating-point accuracy for animation values. The step
@@ -0,0 +1,752 @@
+//--------------------------------------------------------------------------------------
+// Batch driver
+//
+// Runs the jobs of a manifest through the CPU implementation of the pipeline, no graphics
+// device is needed. A job morphs the first surface (iso value 0) into the second one
+// (iso value 1) and writes the diffused volume, the iso surface masks and a preview.
+//
+// Usage: Batch [options] manifest
+//   --concurrency n         number of jobs that run at the same time (default: 1)
+//   --threads n             total number of threads, 0 is one thread per core (default: 0)
+//   --media dir             media directory (default: Media\)
+//   --size n                width and height of the previews in pixels (default: 256)
+//   --restart               runs all jobs again, ignores the journal of finished jobs
+//
+// The manifest has one section per job, the keys before the first section are the
+// defaults of all jobs:
+//
+//   resolution = 64                voxels along the largest extent of the volume, the voxels are cubes
+//   box = oriented                 fits an oriented box around the surfaces, the volume is written
+//                                  in the frame of the box (default: axis aligned)
+//   steps = 8
+//   solver = gauss-seidel          jacobi (default) or in place red-black gauss-seidel
+//   relaxation = 1.5               over-relaxation of the gauss-seidel sweeps (default: 1)
+//   domain = between               only diffuses voxels that are inside of exactly one surface,
+//                                  the others keep their voronoi color (default: all)
+//   diffuse = iso                  diffuses only the iso values instead of the colors (default: color)
+//   colordownsample = 2            diffuses the colors of the iso mode at a lower resolution
+//                                  (default: 0, the colors of the voronoi diagram are kept)
+//   decimate = 0.5                 decimates the meshes with an error of at most this many voxels
+//                                  (default: 0, the meshes are not decimated)
+//
+//   [teapot]
+//   surface1 = sphere              mesh name or path relative to the media directory
+//   surface2 = teapot
+//   scale1 = 0.25                  size of the surface (default: 0.25 and 0.5)
+//   rotate1 = 0 45 0               rotation around x, y and z in degrees
+//   translate1 = 0 0 0.1           translation after the scaling and rotation
+//   color1 = 0 1 0                 color of the surface (default: green and blue)
+//   iso = 0.25 0.5 0.75            iso values of the masks
+//   volume = out\teapot.vol        diffused colors, RGBA floats
+//   mask = out\teapot_mask         masks are written to <mask>_<iso>.vol, one byte per voxel
+//   thumbnail = out\teapot.png     preview like the Thumbnail tool
+//
+// Finished jobs are appended to <manifest>.done, a second run skips them. The outputs of
+// a job are written to temporary files which are renamed when the job is done, so an
+// interrupted job leaves no partial outputs behind and runs again on resume. A failed job
+// deletes its temporary files.
+// The exit code is 1 if at least one job failed.
+//--------------------------------------------------------------------------------------
+#include "Globals.h"
+#include "CPUPipeline.h"
+#include "ThreadPool.h"
+#include "CPUDiffusion.h"
+#include "CPUVolumeRenderer.h"
+#include "WindingNumber.h"
+#include "MeshDecimation.h"
+#include <vector>
+#include <set>
+#include <map>
+#include <fstream>
+#include <iomanip>
+
+#define BATCH_DEFAULT_RESOLUTION 64
+#define BATCH_DEFAULT_SIZE 256
+#define BATCH_DEFAULT_STEPS 8
+
+#define BATCH_VOLUME_MAGIC 0x4c564456	// "VDVL"
+#define BATCH_VOLUME_VERSION 2
+
+//file header of a volume or mask, followed by the voxels with x running fastest
+struct BATCHVOLUMEHEADER
+{
+	unsigned int nMagic;
+	unsigned int nVersion;
+	unsigned int nWidth;
+	unsigned int nHeight;
+	unsigned int nDepth;
+	unsigned int nNumChannels;
+	unsigned int nBytesPerChannel;
+	float pBBMin[3];
+	float pBBMax[3];
+	float pRotation[9];			//rows of the rotation from the frame of the volume into world space
+};
+
+struct BATCH_SURFACE
+{
+	std::string strMesh;
+	float fScale;
+	D3DXVECTOR3 vRotation;
+	D3DXVECTOR3 vTranslation;
+	D3DXCOLOR cColor;
+};
+
+struct BATCH_JOB
+{
+	std::string strName;
+	BATCH_SURFACE pSurfaces[2];
+	int iResolution;
+	bool bOrientedBoundingBox;
+	int iNumSteps;
+	bool bGaussSeidel;
+	float fRelaxation;
+	bool bRestrictDomain;
+	bool bScalar;
+	int iColorDownsample;
+	float fDecimationError;
+	std::vector<float> vIsoValues;
+	std::string strVolume;
+	std::string strMask;
+	std::string strThumbnail;
+};
+
+struct BATCH_SETTINGS
+{
+	std::string					strManifest;
+	std::vector<BATCH_JOB>		vJobs;
+	int							iConcurrency;
+	unsigned int				nThreads;
+	int							iImageSize;
+	std::string					strMediaDirectory;
+	bool						bRestart;
+};
+
+//shared by the job threads
+struct BATCH_STATE
+{
+	const BATCH_SETTINGS*		pSettings;
+	std::vector<int>			vPendingJobs;
+	volatile LONG				nNextJob;
+	volatile LONG				nNumFailed;
+	std::ofstream				journal;
+	CRITICAL_SECTION			csJournal;
+	CRITICAL_SECTION			csMeshCache;
+	CRITICAL_SECTION			csOutput;
+};
+
+
+/****************************************************************************
+ ****************************************************************************/
+static std::string Trim(const std::string& str)
+{
+	size_t nBegin = str.find_first_not_of(" \t\r");
+	if(nBegin == std::string::npos)
+		return "";
+	size_t nEnd = str.find_last_not_of(" \t\r");
+	return str.substr(nBegin, nEnd - nBegin + 1);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ParseVector(const std::string& strValue, int iNumComponents, float* pComponents)
+{
+	std::stringstream ss(strValue);
+	for(int i = 0; i < iNumComponents; i++)
+	{
+		if(!(ss >> pComponents[i]))
+			return false;
+	}
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static void SetDefaults(BATCH_JOB* pJob)
+{
+	for(int i = 0; i < 2; i++)
+	{
+		pJob->pSurfaces[i].vRotation = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+		pJob->pSurfaces[i].vTranslation = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	}
+
+	//sizes and colors of the benchmark
+	pJob->pSurfaces[0].strMesh = "sphere";
+	pJob->pSurfaces[0].fScale = 0.25f;
+	pJob->pSurfaces[0].cColor = D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f);
+	pJob->pSurfaces[1].fScale = 0.5f;
+	pJob->pSurfaces[1].cColor = D3DXCOLOR(0.0f, 0.5f, 1.0f, 1.0f);
+
+	pJob->iResolution = BATCH_DEFAULT_RESOLUTION;
+	pJob->bOrientedBoundingBox = false;
+	pJob->iNumSteps = BATCH_DEFAULT_STEPS;
+	pJob->bGaussSeidel = false;
+	pJob->fRelaxation = 1.0f;
+	pJob->bRestrictDomain = false;
+	pJob->bScalar = false;
+	pJob->iColorDownsample = 0;
+	pJob->fDecimationError = 0.0f;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool SetJobValue(BATCH_JOB* pJob, const std::string& strKey, const std::string& strValue)
+{
+	//keys of the surfaces end with the number of the surface
+	char cLast = strKey.empty() ? 0 : strKey[strKey.size() - 1];
+	if(cLast == '1' || cLast == '2')
+	{
+		BATCH_SURFACE& surface = pJob->pSurfaces[cLast - '1'];
+		std::string strSurfaceKey = strKey.substr(0, strKey.size() - 1);
+		float pColor[3];
+
+		if(strSurfaceKey == "surface")
+			surface.strMesh = strValue;
+		else if(strSurfaceKey == "scale")
+			return ParseVector(strValue, 1, &surface.fScale);
+		else if(strSurfaceKey == "rotate")
+			return ParseVector(strValue, 3, (float*)&surface.vRotation);
+		else if(strSurfaceKey == "translate")
+			return ParseVector(strValue, 3, (float*)&surface.vTranslation);
+		else if(strSurfaceKey == "color" && ParseVector(strValue, 3, pColor))
+			surface.cColor = D3DXCOLOR(pColor[0], pColor[1], pColor[2], 1.0f);
+		else
+			return false;
+		return true;
+	}
+
+	if(strKey == "resolution")
+		pJob->iResolution = atoi(strValue.c_str());
+	else if(strKey == "box")
+	{
+		if(strValue != "aligned" && strValue != "oriented")
+			return false;
+		pJob->bOrientedBoundingBox = strValue == "oriented";
+	}
+	else if(strKey == "steps")
+		pJob->iNumSteps = atoi(strValue.c_str());
+	else if(strKey == "solver")
+	{
+		if(strValue != "jacobi" && strValue != "gauss-seidel")
+			return false;
+		pJob->bGaussSeidel = strValue == "gauss-seidel";
+	}
+	else if(strKey == "relaxation")
+		return ParseVector(strValue, 1, &pJob->fRelaxation);
+	else if(strKey == "domain")
+	{
+		if(strValue != "all" && strValue != "between")
+			return false;
+		pJob->bRestrictDomain = strValue == "between";
+	}
+	else if(strKey == "diffuse")
+	{
+		if(strValue != "color" && strValue != "iso")
+			return false;
+		pJob->bScalar = strValue == "iso";
+	}
+	else if(strKey == "colordownsample")
+		pJob->iColorDownsample = atoi(strValue.c_str());
+	else if(strKey == "decimate")
+		return ParseVector(strValue, 1, &pJob->fDecimationError);
+	else if(strKey == "iso")
+	{
+		pJob->vIsoValues.clear();
+		std::stringstream ss(strValue);
+		float fIsoValue;
+		while(ss >> fIsoValue)
+			pJob->vIsoValues.push_back(fIsoValue);
+	}
+	else if(strKey == "volume")
+		pJob->strVolume = strValue;
+	else if(strKey == "mask")
+		pJob->strMask = strValue;
+	else if(strKey == "thumbnail")
+		pJob->strThumbnail = strValue;
+	else
+		return false;
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool IsValidJob(const BATCH_JOB& job)
+{
+	if(job.pSurfaces[1].strMesh.empty())
+	{
+		std::cerr << "Job " << job.strName << " has no surface2" << std::endl;
+		return false;
+	}
+	if(job.strVolume.empty() && job.strThumbnail.empty() && (job.strMask.empty() || job.vIsoValues.empty()))
+	{
+		std::cerr << "Job " << job.strName << " has no outputs" << std::endl;
+		return false;
+	}
+	if(job.iResolution < 2 || job.iNumSteps < 1 || job.fRelaxation <= 0.0f || job.fRelaxation >= 2.0f || job.fDecimationError < 0.0f)
+	{
+		std::cerr << "Job " << job.strName << " has an invalid resolution, number of steps, relaxation or decimation error" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ReadManifest(const std::string& strFileName, std::vector<BATCH_JOB>& vJobs)
+{
+	std::ifstream file(strFileName.c_str());
+	if(!file)
+		return false;
+
+	BATCH_JOB defaults;
+	SetDefaults(&defaults);
+
+	//the current job is the defaults until the first section
+	BATCH_JOB* pJob = &defaults;
+	std::set<std::string> jobNames;
+	bool bValid = true;
+
+	std::string strLine;
+	for(int iLine = 1; std::getline(file, strLine); iLine++)
+	{
+		strLine = Trim(strLine);
+		if(strLine.empty() || strLine[0] == '#' || strLine[0] == ';')
+			continue;
+
+		if(strLine[0] == '[')
+		{
+			BATCH_JOB job = defaults;
+			job.strName = Trim(strLine.substr(1, strLine.find(']') - 1));
+			if(job.strName.empty() || !jobNames.insert(job.strName).second)
+			{
+				std::cerr << strFileName << "(" << iLine << "): missing or duplicate job name" << std::endl;
+				bValid = false;
+			}
+			vJobs.push_back(job);
+			pJob = &vJobs.back();
+			continue;
+		}
+
+		size_t nEquals = strLine.find('=');
+		std::string strKey = Trim(strLine.substr(0, nEquals));
+		std::string strValue = nEquals == std::string::npos ? "" : Trim(strLine.substr(nEquals + 1));
+		if(nEquals == std::string::npos || !SetJobValue(pJob, strKey, strValue))
+		{
+			std::cerr << strFileName << "(" << iLine << "): invalid line " << strLine << std::endl;
+			bValid = false;
+		}
+	}
+
+	for(unsigned int i = 0; i < vJobs.size(); i++)
+		bValid = IsValidJob(vJobs[i]) && bValid;
+
+	return bValid;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ParseArguments(int argc, wchar_t* argv[], BATCH_SETTINGS* pSettings)
+{
+	pSettings->iConcurrency = 1;
+	pSettings->nThreads = 0;
+	pSettings->iImageSize = BATCH_DEFAULT_SIZE;
+	pSettings->strMediaDirectory = "Media\\";
+	pSettings->bRestart = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string strOption = ConvertWideCharToChar(argv[i]);
+
+		//options without a value
+		if(strOption == "--restart")
+		{
+			pSettings->bRestart = true;
+			continue;
+		}
+		else if(strOption.compare(0, 2, "--") != 0)
+		{
+			pSettings->strManifest = strOption;
+			continue;
+		}
+
+		if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value of " << strOption << std::endl;
+			return false;
+		}
+		std::string strValue = ConvertWideCharToChar(argv[++i]);
+
+		if(strOption == "--concurrency")
+			pSettings->iConcurrency = atoi(strValue.c_str());
+		else if(strOption == "--threads")
+			pSettings->nThreads = (unsigned int)atoi(strValue.c_str());
+		else if(strOption == "--size")
+			pSettings->iImageSize = atoi(strValue.c_str());
+		else if(strOption == "--media")
+		{
+			pSettings->strMediaDirectory = strValue;
+			if(!strValue.empty() && strValue[strValue.size() - 1] != '\\' && strValue[strValue.size() - 1] != '/')
+				pSettings->strMediaDirectory += "\\";
+		}
+		else
+		{
+			std::cerr << "Unknown option " << strOption << std::endl;
+			return false;
+		}
+	}
+
+	if(pSettings->strManifest.empty())
+	{
+		std::cerr << "No manifest given" << std::endl;
+		return false;
+	}
+
+	if(!ReadManifest(pSettings->strManifest, pSettings->vJobs))
+	{
+		std::cerr << "Could not read the manifest " << pSettings->strManifest << std::endl;
+		return false;
+	}
+
+	return pSettings->iConcurrency > 0 && pSettings->iImageSize > 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static HRESULT LoadSurface(BATCH_STATE* pState, const BATCH_SURFACE& surface, float fIsoValue, MESHDATA* pMeshData, CPU_SURFACE* pSurface)
+{
+	HRESULT hr(S_OK);
+
+	D3DXMATRIX mRotation, mTranslation;
+	D3DXMatrixRotationYawPitchRoll(&mRotation, D3DXToRadian(surface.vRotation.y), D3DXToRadian(surface.vRotation.x), D3DXToRadian(surface.vRotation.z));
+	D3DXMatrixTranslation(&mTranslation, surface.vTranslation.x, surface.vTranslation.y, surface.vTranslation.z);
+
+	//the mesh cache is not thread safe, it also writes the cache files
+	EnterCriticalSection(&pState->csMeshCache);
+	hr = CPUPipeline::LoadSurface(CPUPipeline::GetMeshPath(pState->pSettings->strMediaDirectory, surface.strMesh), surface.cColor, surface.fScale,
+								  mRotation * mTranslation, fIsoValue, pMeshData, pSurface);
+	LeaveCriticalSection(&pState->csMeshCache);
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static void ComputeDomainMask(const std::vector<CPU_SURFACE>& vSurfaces, const CPUVolume& volume, std::vector<unsigned char>& vMask)
+{
+	int iWidth = volume.GetWidth();
+	int iHeight = volume.GetHeight();
+	D3DXVECTOR3 vVoxelSize = volume.GetBBMax() - volume.GetBBMin();
+	vVoxelSize.x /= iWidth;
+	vVoxelSize.y /= iHeight;
+	vVoxelSize.z /= volume.GetDepth();
+
+	//the winding numbers are computed in object space
+	std::vector<WindingNumber> vWindingNumbers(vSurfaces.size());
+	std::vector<D3DXMATRIX> vWorldToObject(vSurfaces.size());
+	for(unsigned int i = 0; i < vSurfaces.size(); i++)
+	{
+		const MESHDATA* pMesh = vSurfaces[i].pMesh;
+		vWindingNumbers[i].Build(&pMesh->vVertices[0], (unsigned int)pMesh->vVertices.size(), &pMesh->vTriangleIndices[0], (unsigned int)pMesh->vTriangleIndices.size());
+		D3DXMatrixInverse(&vWorldToObject[i], NULL, &vSurfaces[i].mModel);
+	}
+
+	vMask.resize(volume.GetNumVoxels());
+	ThreadPool::GetInstance()->ParallelFor(0, volume.GetDepth(), 1, [&](int iBegin, int iEnd)
+	{
+		for(int z = iBegin; z < iEnd; z++)
+		{
+			for(int y = 0; y < iHeight; y++)
+			{
+				for(int x = 0; x < iWidth; x++)
+				{
+					D3DXVECTOR3 vPosition(volume.GetBBMin().x + (x + 0.5f) * vVoxelSize.x,
+										  volume.GetBBMin().y + (y + 0.5f) * vVoxelSize.y,
+										  volume.GetBBMin().z + (z + 0.5f) * vVoxelSize.z);
+
+					//the morph happens between the surfaces, inside of one and outside of the other
+					int iNumInside = 0;
+					for(unsigned int i = 0; i < vSurfaces.size(); i++)
+					{
+						D3DXVECTOR3 vObjectPosition;
+						D3DXVec3TransformCoord(&vObjectPosition, &vPosition, &vWorldToObject[i]);
+						iNumInside += vWindingNumbers[i].IsInside(vObjectPosition) ? 1 : 0;
+					}
+
+					vMask[volume.GetIndex(x, y, z)] = iNumInside == 1 ? 1 : 0;
+				}
+			}
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static HRESULT WriteVolumeFile(const std::string& strFileName, const CPUVolume& volume, const OrientedBoundingBox& bbVolume,
+							   const void* pVoxels, unsigned int nNumChannels, unsigned int nBytesPerChannel)
+{
+	BATCHVOLUMEHEADER header;
+	header.nMagic = BATCH_VOLUME_MAGIC;
+	header.nVersion = BATCH_VOLUME_VERSION;
+	header.nWidth = volume.GetWidth();
+	header.nHeight = volume.GetHeight();
+	header.nDepth = volume.GetDepth();
+	header.nNumChannels = nNumChannels;
+	header.nBytesPerChannel = nBytesPerChannel;
+	memcpy(header.pBBMin, (const float*)volume.GetBBMin(), sizeof(header.pBBMin));
+	memcpy(header.pBBMax, (const float*)volume.GetBBMax(), sizeof(header.pBBMax));
+	for(int i = 0; i < 3; i++)
+	{
+		for(int j = 0; j < 3; j++)
+			header.pRotation[3 * i + j] = bbVolume.GetLocalToWorld()(i, j);
+	}
+
+	std::ofstream file(strFileName.c_str(), std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)pVoxels, (std::streamsize)volume.GetNumVoxels() * nNumChannels * nBytesPerChannel);
+	file.close();
+
+	return file ? S_OK : E_FAIL;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static std::string GetMaskFileName(const std::string& strMask, float fIsoValue)
+{
+	std::stringstream ss;
+	ss << strMask << "_" << std::fixed << std::setprecision(3) << fIsoValue << ".vol";
+	return ss.str();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static HRESULT WriteOutputs(const BATCH_JOB& job, CPUVolume* pVolume, CPUDiffusion* pDiffusion, const OrientedBoundingBox& bbVolume,
+							CPUVolumeRenderer* pRenderer, std::vector<std::string>& vOutputs)
+{
+	HRESULT hr(S_OK);
+
+	//an output is added before its temporary file is written, so that a partial file is deleted as well
+	if(!job.strVolume.empty())
+	{
+		vOutputs.push_back(job.strVolume);
+		V_RETURN(WriteVolumeFile(job.strVolume + ".tmp", *pVolume, bbVolume, pVolume->GetColors(), 4, sizeof(float)));
+	}
+
+	if(!job.strMask.empty())
+	{
+		std::vector<unsigned char> vMask;
+		for(unsigned int i = 0; i < job.vIsoValues.size(); i++)
+		{
+			pDiffusion->ExtractIsoSurface(pVolume, job.vIsoValues[i], vMask);
+			vOutputs.push_back(GetMaskFileName(job.strMask, job.vIsoValues[i]));
+			V_RETURN(WriteVolumeFile(vOutputs.back() + ".tmp", *pVolume, bbVolume, &vMask[0], 1, 1));
+		}
+	}
+	pDiffusion->Release();
+
+	if(!job.strThumbnail.empty())
+	{
+		float fFovY = D3DX_PI / 4;
+		D3DXVECTOR3 vEye, vAt, vUp;
+		CPUPipeline::GetPreviewCamera(*pVolume, bbVolume, fFovY, &vEye, &vAt, &vUp);
+		pRenderer->SetCamera(vEye, vAt, vUp, fFovY);
+
+		vOutputs.push_back(job.strThumbnail);
+		V_RETURN(pRenderer->Render(pVolume));
+		V_RETURN(pRenderer->SavePNG(job.strThumbnail + ".tmp"));
+	}
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static HRESULT RunJob(BATCH_STATE* pState, const BATCH_JOB& job, CPUVolumeRenderer* pRenderer)
+{
+	HRESULT hr(S_OK);
+
+	MESHDATA pMeshData[2];
+	std::vector<CPU_SURFACE> vSurfaces(2);
+	V_RETURN(LoadSurface(pState, job.pSurfaces[0], 0.0f, &pMeshData[0], &vSurfaces[0]));
+	V_RETURN(LoadSurface(pState, job.pSurfaces[1], 1.0f, &pMeshData[1], &vSurfaces[1]));
+
+	OrientedBoundingBox bbVolume;
+	CPUPipeline::FitBoundingBox(vSurfaces, job.bOrientedBoundingBox, &bbVolume);
+
+	CPUVolume volume;
+	V_RETURN(CPUPipeline::AllocateVolume(bbVolume, job.iResolution, &volume));
+
+	//the error bound is given in voxels, the meshes are decimated in model space. The vertices move
+	//by less than the padding of the bounding box, so it is not fitted again.
+	if(job.fDecimationError > 0.0f)
+	{
+		float fVoxelSize = (volume.GetBBMax().x - volume.GetBBMin().x) / volume.GetWidth();
+		for(int i = 0; i < 2; i++)
+		{
+			D3DXVECTOR3 vAxis(vSurfaces[i].mModel._11, vSurfaces[i].mModel._12, vSurfaces[i].mModel._13);
+			MeshDecimation decimation;
+			V_RETURN(decimation.Decimate(&pMeshData[i], job.fDecimationError * fVoxelSize / D3DXVec3Length(&vAxis)));
+		}
+	}
+
+	CPUVoronoi voronoi;
+	V_RETURN(voronoi.Compute(vSurfaces, &volume));
+	voronoi.Release();
+
+	std::vector<unsigned char> vDomainMask;
+	if(job.bRestrictDomain)
+		ComputeDomainMask(vSurfaces, volume, vDomainMask);
+
+	CPUDiffusion diffusion;
+	diffusion.SetGaussSeidel(job.bGaussSeidel, job.fRelaxation);
+	diffusion.SetScalarMode(job.bScalar, job.iColorDownsample);
+	diffusion.SetDomainMask(vDomainMask.empty() ? NULL : &vDomainMask[0]);
+	V_RETURN(diffusion.Diffuse(&volume, job.iNumSteps));
+
+	//the outputs are written to temporary files first, renamed when all of them are done
+	std::vector<std::string> vOutputs;
+	hr = WriteOutputs(job, &volume, &diffusion, bbVolume, pRenderer, vOutputs);
+
+	for(unsigned int i = 0; SUCCEEDED(hr) && i < vOutputs.size(); i++)
+	{
+		if(!MoveFileExA((vOutputs[i] + ".tmp").c_str(), vOutputs[i].c_str(), MOVEFILE_REPLACE_EXISTING))
+			hr = E_FAIL;
+	}
+
+	//a failed job leaves no temporary files behind, the renamed outputs are replaced when it runs again
+	if(FAILED(hr))
+	{
+		for(unsigned int i = 0; i < vOutputs.size(); i++)
+			DeleteFileA((vOutputs[i] + ".tmp").c_str());
+	}
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static DWORD WINAPI JobThreadProc(LPVOID pParameter)
+{
+	BATCH_STATE* pState = (BATCH_STATE*)pParameter;
+	const BATCH_SETTINGS& settings = *pState->pSettings;
+
+	//every job thread has its own image
+	CPUVolumeRenderer renderer;
+	if(FAILED(renderer.SetImageSize(settings.iImageSize, settings.iImageSize)))
+	{
+		EnterCriticalSection(&pState->csOutput);
+		std::cerr << "Could not allocate the image" << std::endl;
+		LeaveCriticalSection(&pState->csOutput);
+		return 1;
+	}
+
+	for(;;)
+	{
+		LONG nJob = InterlockedIncrement(&pState->nNextJob) - 1;
+		if(nJob >= (LONG)pState->vPendingJobs.size())
+			break;
+
+		const BATCH_JOB& job = settings.vJobs[pState->vPendingJobs[nJob]];
+		DWORD dwStart = GetTickCount();
+		HRESULT hr = RunJob(pState, job, &renderer);
+
+		if(SUCCEEDED(hr))
+		{
+			//the journal is flushed after every job, so that a resume skips it
+			EnterCriticalSection(&pState->csJournal);
+			pState->journal << job.strName << std::endl;
+			LeaveCriticalSection(&pState->csJournal);
+		}
+		else
+			InterlockedIncrement(&pState->nNumFailed);
+
+		EnterCriticalSection(&pState->csOutput);
+		if(SUCCEEDED(hr))
+			std::cout << job.strName << " (" << GetTickCount() - dwStart << " ms)" << std::endl;
+		else
+			std::cerr << "Failed: " << job.strName << std::endl;
+		LeaveCriticalSection(&pState->csOutput);
+	}
+
+	renderer.Release();
+
+	return 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int wmain(int argc, wchar_t* argv[])
+{
+	BATCH_SETTINGS settings;
+	if(!ParseArguments(argc, argv, &settings))
+		return 2;
+
+	//jobs of the journal are finished
+	std::string strJournal = settings.strManifest + ".done";
+	std::set<std::string> finishedJobs;
+	if(!settings.bRestart)
+	{
+		std::ifstream journal(strJournal.c_str());
+		std::string strLine;
+		while(std::getline(journal, strLine))
+			finishedJobs.insert(Trim(strLine));
+	}
+
+	BATCH_STATE state;
+	state.pSettings = &settings;
+	state.nNextJob = 0;
+	state.nNumFailed = 0;
+	for(unsigned int i = 0; i < settings.vJobs.size(); i++)
+	{
+		if(finishedJobs.count(settings.vJobs[i].strName) == 0)
+			state.vPendingJobs.push_back(i);
+	}
+
+	if(state.vPendingJobs.size() < settings.vJobs.size())
+		std::cout << "Skipping " << settings.vJobs.size() - state.vPendingJobs.size() << " finished jobs" << std::endl;
+
+	state.journal.open(strJournal.c_str(), settings.bRestart ? std::ios::trunc : std::ios::app);
+	if(!state.journal)
+	{
+		std::cerr << "Could not open the journal " << strJournal << std::endl;
+		return 2;
+	}
+
+	//one job at a time gets the thread pool, the others run on their own thread,
+	//so the pool gets the threads that are not used by the other jobs
+	int iConcurrency = min(settings.iConcurrency, max(1, (int)state.vPendingJobs.size()));
+	unsigned int nThreads = settings.nThreads > 0 ? settings.nThreads : ThreadPool::GetNumProcessors();
+	ThreadPool::GetInstance()->SetNumThreads(max(1u, nThreads - min(nThreads, (unsigned int)iConcurrency - 1)));
+
+	InitializeCriticalSection(&state.csJournal);
+	InitializeCriticalSection(&state.csMeshCache);
+	InitializeCriticalSection(&state.csOutput);
+
+	std::vector<HANDLE> vThreads;
+	for(int i = 1; i < iConcurrency; i++)
+	{
+		HANDLE hThread = CreateThread(NULL, 0, JobThreadProc, &state, 0, NULL);
+		if(hThread != NULL)
+			vThreads.push_back(hThread);
+	}
+
+	//the main thread runs jobs as well
+	JobThreadProc(&state);
+
+	for(unsigned int i = 0; i < vThreads.size(); i++)
+	{
+		WaitForSingleObject(vThreads[i], INFINITE);
+		CloseHandle(vThreads[i]);
+	}
+
+	DeleteCriticalSection(&state.csJournal);
+	DeleteCriticalSection(&state.csMeshCache);
+	DeleteCriticalSection(&state.csOutput);
+
+	int iNumFailed = (int)state.nNumFailed;
+	std::cout << state.vPendingJobs.size() - iNumFailed << " of " << state.vPendingJobs.size() << " jobs finished" << std::endl;
+
+	ThreadPool::DeleteInstance();
+	MeshCache::DeleteInstance();
+
+	return iNumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,517 @@
+//--------------------------------------------------------------------------------------
+// Benchmark of the morph pipeline
+//
+// Runs the bundled meshes through the CPU implementation of the pipeline
+// (voronoi -> diffusion -> iso surface) for several resolutions and thread counts.
+// Every mesh is morphed with the sphere, like the default scene of the viewer.
+// The results can be written to a baseline file and compared against it.
+//
+// Usage: Benchmark [options]
+//   --meshes a,b,...        meshes of the media directory (default: all bundled meshes)
+//   --resolutions 64,128    voxels along the largest extent of the volume (default: 64,128,256,512)
+//   --threads 1,4           thread counts, 0 is one thread per core (default: 1,0)
+//   --steps n               diffusion steps (default: 8)
+//   --repeat n              runs per case, the fastest run is reported (default: 1)
+//   --media dir             media directory (default: Media\)
+//   --baseline file         compares the results with the baseline file
+//   --write-baseline file   writes the results as new baseline file
+//   --tolerance t           relative tolerance of the comparison (default: 0.1)
+//
+// The exit code is 1 if a case is slower than the baseline by more than the tolerance.
+//--------------------------------------------------------------------------------------
+#include "Globals.h"
+#include "CPUPipeline.h"
+#include "ThreadPool.h"
+#include "CPUDiffusion.h"
+#include <psapi.h>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#define BENCHMARK_DEFAULT_STEPS 8
+#define BENCHMARK_DEFAULT_TOLERANCE 0.1
+#define BENCHMARK_ISO_VALUE 0.5f
+
+enum BENCHMARK_STAGE
+{
+	STAGE_VORONOI,
+	STAGE_DIFFUSION,
+	STAGE_ISOSURFACE,
+	NUM_STAGES
+};
+
+static const char* g_pStageNames[NUM_STAGES] = { "voronoi", "diffusion", "iso" };
+
+struct BENCHMARK_SETTINGS
+{
+	std::vector<std::string>	vMeshes;
+	std::vector<int>			vResolutions;
+	std::vector<unsigned int>	vThreads;
+	int							iNumSteps;
+	int							iNumRepetitions;
+	std::string					strMediaDirectory;
+	std::string					strBaselineFile;
+	std::string					strWriteBaselineFile;
+	double						fTolerance;
+};
+
+struct BENCHMARK_RESULT
+{
+	std::string			strMesh;
+	int					iResolution;
+	unsigned int		nThreads;
+	int					iNumSteps;
+	double				pStageTime[NUM_STAGES];		//ms
+	unsigned int		nNumVoxels;
+	unsigned int		nInsideVoxels;
+	unsigned __int64	nEngineMemory;				//bytes
+	unsigned __int64	nPeakWorkingSet;			//bytes
+	bool				bOutOfMemory;
+};
+
+
+/****************************************************************************
+ ****************************************************************************/
+static double GetTime()
+{
+	static LARGE_INTEGER s_frequency = { 0 };
+	if(s_frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&s_frequency);
+
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	return double(time.QuadPart) * 1000.0 / double(s_frequency.QuadPart);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static unsigned __int64 GetPeakWorkingSet()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static std::vector<std::string> SplitList(const std::string& strList)
+{
+	std::vector<std::string> vItems;
+	std::stringstream ss(strList);
+	std::string strItem;
+	while(std::getline(ss, strItem, ','))
+	{
+		if(!strItem.empty())
+			vItems.push_back(strItem);
+	}
+	return vItems;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ParseArguments(int argc, wchar_t* argv[], BENCHMARK_SETTINGS* pSettings)
+{
+	pSettings->iNumSteps = BENCHMARK_DEFAULT_STEPS;
+	pSettings->iNumRepetitions = 1;
+	pSettings->strMediaDirectory = "Media\\";
+	pSettings->fTolerance = BENCHMARK_DEFAULT_TOLERANCE;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string strOption = ConvertWideCharToChar(argv[i]);
+		if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value of " << strOption << std::endl;
+			return false;
+		}
+		std::string strValue = ConvertWideCharToChar(argv[++i]);
+
+		if(strOption == "--meshes")
+			pSettings->vMeshes = SplitList(strValue);
+		else if(strOption == "--resolutions")
+		{
+			std::vector<std::string> vItems = SplitList(strValue);
+			for(unsigned int j = 0; j < vItems.size(); j++)
+				pSettings->vResolutions.push_back(atoi(vItems[j].c_str()));
+		}
+		else if(strOption == "--threads")
+		{
+			std::vector<std::string> vItems = SplitList(strValue);
+			for(unsigned int j = 0; j < vItems.size(); j++)
+				pSettings->vThreads.push_back((unsigned int)atoi(vItems[j].c_str()));
+		}
+		else if(strOption == "--steps")
+			pSettings->iNumSteps = atoi(strValue.c_str());
+		else if(strOption == "--repeat")
+			pSettings->iNumRepetitions = max(1, atoi(strValue.c_str()));
+		else if(strOption == "--media")
+		{
+			pSettings->strMediaDirectory = strValue;
+			if(!strValue.empty() && strValue[strValue.size() - 1] != '\\' && strValue[strValue.size() - 1] != '/')
+				pSettings->strMediaDirectory += "\\";
+		}
+		else if(strOption == "--baseline")
+			pSettings->strBaselineFile = strValue;
+		else if(strOption == "--write-baseline")
+			pSettings->strWriteBaselineFile = strValue;
+		else if(strOption == "--tolerance")
+			pSettings->fTolerance = atof(strValue.c_str());
+		else
+		{
+			std::cerr << "Unknown option " << strOption << std::endl;
+			return false;
+		}
+	}
+
+	if(pSettings->vMeshes.empty())
+	{
+		for(int i = 0; i < CPUPipeline::GetNumNamedMeshes(); i++)
+			pSettings->vMeshes.push_back(CPUPipeline::GetNamedMesh(i));
+	}
+
+	if(pSettings->vResolutions.empty())
+	{
+		pSettings->vResolutions.push_back(64);
+		pSettings->vResolutions.push_back(128);
+		pSettings->vResolutions.push_back(256);
+		pSettings->vResolutions.push_back(512);
+	}
+
+	if(pSettings->vThreads.empty())
+	{
+		pSettings->vThreads.push_back(1);
+		pSettings->vThreads.push_back(0);
+	}
+
+	//ascending resolutions, the peak working set of the process only grows
+	std::sort(pSettings->vResolutions.begin(), pSettings->vResolutions.end());
+
+	return pSettings->iNumSteps > 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static void RunCase(const std::vector<CPU_SURFACE>& vSurfaces, const OrientedBoundingBox& bbVolume,
+					int iNumSteps, BENCHMARK_RESULT* pResult)
+{
+	for(int i = 0; i < NUM_STAGES; i++)
+		pResult->pStageTime[i] = 0.0;
+	pResult->nNumVoxels = 0;
+	pResult->nInsideVoxels = 0;
+	pResult->nEngineMemory = 0;
+	pResult->bOutOfMemory = false;
+
+	CPUVolume volume;
+	CPUVoronoi voronoi;
+	CPUDiffusion diffusion;
+	std::vector<unsigned char> vMask;
+
+	if(FAILED(CPUPipeline::AllocateVolume(bbVolume, pResult->iResolution, &volume)))
+	{
+		pResult->bOutOfMemory = true;
+		return;
+	}
+	pResult->nNumVoxels = volume.GetWidth() * volume.GetHeight() * volume.GetDepth();
+
+	double fStart = GetTime();
+	if(FAILED(voronoi.Compute(vSurfaces, &volume)))
+	{
+		pResult->bOutOfMemory = true;
+		return;
+	}
+	pResult->pStageTime[STAGE_VORONOI] = GetTime() - fStart;
+	pResult->nEngineMemory = volume.GetMemorySize() + voronoi.GetMemorySize();
+
+	//the voronoi buffers are not needed anymore, like in the viewer
+	voronoi.Release();
+
+	fStart = GetTime();
+	if(FAILED(diffusion.Diffuse(&volume, iNumSteps)))
+	{
+		pResult->bOutOfMemory = true;
+		return;
+	}
+	pResult->pStageTime[STAGE_DIFFUSION] = GetTime() - fStart;
+	pResult->nEngineMemory = max(pResult->nEngineMemory, volume.GetMemorySize() + diffusion.GetMemorySize());
+
+	diffusion.Release();
+
+	fStart = GetTime();
+	pResult->nInsideVoxels = diffusion.ExtractIsoSurface(&volume, BENCHMARK_ISO_VALUE, vMask);
+	pResult->pStageTime[STAGE_ISOSURFACE] = GetTime() - fStart;
+
+	pResult->nPeakWorkingSet = GetPeakWorkingSet();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static std::string GetCaseKey(const BENCHMARK_RESULT& result)
+{
+	std::stringstream ss;
+	ss << result.strMesh << "," << result.iResolution << "," << result.nThreads << "," << result.iNumSteps;
+	return ss.str();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool WriteBaseline(const std::string& strFileName, const std::vector<BENCHMARK_RESULT>& vResults)
+{
+	std::ofstream file(strFileName.c_str());
+	if(!file)
+		return false;
+
+	file << "# morph pipeline benchmark, " << ThreadPool::GetNumProcessors() << " processors" << std::endl;
+	file << "mesh,resolution,threads,steps,voronoi_ms,diffusion_ms,iso_ms,inside_voxels,peak_working_set" << std::endl;
+	file << std::fixed << std::setprecision(3);
+
+	for(unsigned int i = 0; i < vResults.size(); i++)
+	{
+		const BENCHMARK_RESULT& result = vResults[i];
+		if(result.bOutOfMemory)
+			continue;
+
+		file << GetCaseKey(result);
+		for(int j = 0; j < NUM_STAGES; j++)
+			file << "," << result.pStageTime[j];
+		file << "," << result.nInsideVoxels << "," << result.nPeakWorkingSet << std::endl;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ReadBaseline(const std::string& strFileName, std::map<std::string, BENCHMARK_RESULT>& mBaseline)
+{
+	std::ifstream file(strFileName.c_str());
+	if(!file)
+		return false;
+
+	std::string strLine;
+	while(std::getline(file, strLine))
+	{
+		if(strLine.empty() || strLine[0] == '#' || strLine.compare(0, 5, "mesh,") == 0)
+			continue;
+
+		std::vector<std::string> vItems = SplitList(strLine);
+		if(vItems.size() < 8)
+			continue;
+
+		BENCHMARK_RESULT result;
+		result.strMesh = vItems[0];
+		result.iResolution = atoi(vItems[1].c_str());
+		result.nThreads = (unsigned int)atoi(vItems[2].c_str());
+		result.iNumSteps = atoi(vItems[3].c_str());
+		for(int j = 0; j < NUM_STAGES; j++)
+			result.pStageTime[j] = atof(vItems[4 + j].c_str());
+		result.nInsideVoxels = (unsigned int)strtoul(vItems[7].c_str(), NULL, 10);
+		result.nPeakWorkingSet = vItems.size() > 8 ? _strtoui64(vItems[8].c_str(), NULL, 10) : 0;
+		result.nNumVoxels = 0;
+		result.nEngineMemory = 0;
+		result.bOutOfMemory = false;
+
+		mBaseline[GetCaseKey(result)] = result;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static int CompareWithBaseline(const std::vector<BENCHMARK_RESULT>& vResults, const std::map<std::string, BENCHMARK_RESULT>& mBaseline, double fTolerance)
+{
+	int iNumRegressions = 0;
+
+	std::cout << std::endl << "Comparison with the baseline (tolerance " << fTolerance * 100.0 << " %)" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+
+	for(unsigned int i = 0; i < vResults.size(); i++)
+	{
+		const BENCHMARK_RESULT& result = vResults[i];
+		if(result.bOutOfMemory)
+			continue;
+
+		std::map<std::string, BENCHMARK_RESULT>::const_iterator it = mBaseline.find(GetCaseKey(result));
+		if(it == mBaseline.end())
+		{
+			std::cout << "  " << GetCaseKey(result) << ": not in the baseline" << std::endl;
+			continue;
+		}
+
+		for(int j = 0; j < NUM_STAGES; j++)
+		{
+			double fBaseline = it->second.pStageTime[j];
+			if(fBaseline <= 0.0)
+				continue;
+
+			double fRatio = result.pStageTime[j] / fBaseline;
+			const char* szVerdict = "";
+			if(fRatio > 1.0 + fTolerance)
+			{
+				szVerdict = "  REGRESSION";
+				iNumRegressions++;
+			}
+			else if(fRatio < 1.0 - fTolerance)
+				szVerdict = "  faster";
+
+			std::cout << "  " << std::setw(28) << std::left << GetCaseKey(result) << std::right << std::setw(10) << g_pStageNames[j]
+					  << std::setw(12) << fBaseline << " ms" << std::setw(12) << result.pStageTime[j] << " ms"
+					  << std::setw(8) << fRatio << "x" << szVerdict << std::endl;
+		}
+
+		//optimizations that must not change the result can be checked with the number of inside voxels
+		if(result.nInsideVoxels != it->second.nInsideVoxels)
+		{
+			std::cout << "  " << GetCaseKey(result) << ": result changed, " << it->second.nInsideVoxels
+					  << " -> " << result.nInsideVoxels << " inside voxels" << std::endl;
+		}
+	}
+
+	std::cout << iNumRegressions << " regression(s)" << std::endl;
+	return iNumRegressions;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int wmain(int argc, wchar_t* argv[])
+{
+	BENCHMARK_SETTINGS settings;
+	if(!ParseArguments(argc, argv, &settings))
+		return 2;
+
+	std::vector<BENCHMARK_RESULT> vResults;
+
+	D3DXMATRIX mIdentity;
+	D3DXMatrixIdentity(&mIdentity);
+
+	MESHDATA sphereData;
+	CPU_SURFACE sphereSurface;
+	std::string strSpherePath = CPUPipeline::GetMeshPath(settings.strMediaDirectory, "sphere");
+	if(FAILED(CPUPipeline::LoadSurface(strSpherePath, D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f), 0.25f, mIdentity, 0.0f, &sphereData, &sphereSurface)))
+	{
+		std::cerr << "Could not load " << strSpherePath << std::endl;
+		return 2;
+	}
+
+	//the sphere is morphed into each mesh, which is twice its size
+	std::vector<std::string> vMeshNames;
+	std::vector<MESHDATA> vMeshData(settings.vMeshes.size());
+	std::vector<std::vector<CPU_SURFACE> > vCases;
+	std::vector<OrientedBoundingBox> vBoundingBoxes;
+
+	for(unsigned int iMesh = 0; iMesh < settings.vMeshes.size(); iMesh++)
+	{
+		std::vector<CPU_SURFACE> vSurfaces(2);
+		vSurfaces[0] = sphereSurface;
+		std::string strMeshPath = CPUPipeline::GetMeshPath(settings.strMediaDirectory, settings.vMeshes[iMesh]);
+		if(FAILED(CPUPipeline::LoadSurface(strMeshPath, D3DXCOLOR(0.0f, 0.5f, 1.0f, 1.0f), 0.5f, mIdentity, 1.0f, &vMeshData[iMesh], &vSurfaces[1])))
+		{
+			std::cerr << "Could not load " << strMeshPath << std::endl;
+			continue;
+		}
+
+		//axis aligned like the default of the viewer
+		OrientedBoundingBox bbVolume;
+		CPUPipeline::FitBoundingBox(vSurfaces, false, &bbVolume);
+
+		vMeshNames.push_back(settings.vMeshes[iMesh]);
+		vCases.push_back(vSurfaces);
+		vBoundingBoxes.push_back(bbVolume);
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "mesh          res  threads   voronoi ms  diffusion ms     iso ms  diffusion Mvoxel/s  total Mvoxel/s  engine MB  peak MB" << std::endl;
+
+	//the resolutions are the outer loop, so the peak working set grows with the current resolution
+	for(unsigned int iRes = 0; iRes < settings.vResolutions.size(); iRes++)
+	{
+		for(unsigned int iCase = 0; iCase < vCases.size(); iCase++)
+		{
+			for(unsigned int iThreads = 0; iThreads < settings.vThreads.size(); iThreads++)
+			{
+				ThreadPool::GetInstance()->SetNumThreads(settings.vThreads[iThreads]);
+
+				BENCHMARK_RESULT result;
+				result.strMesh = vMeshNames[iCase];
+				result.iResolution = settings.vResolutions[iRes];
+				result.nThreads = ThreadPool::GetInstance()->GetNumThreads();
+				result.iNumSteps = settings.iNumSteps;
+
+				//the fastest of the repetitions is the least disturbed one
+				for(int iRun = 0; iRun < settings.iNumRepetitions; iRun++)
+				{
+					BENCHMARK_RESULT run = result;
+					RunCase(vCases[iCase], vBoundingBoxes[iCase], settings.iNumSteps, &run);
+
+					if(iRun == 0 || run.bOutOfMemory)
+						result = run;
+					else
+					{
+						for(int j = 0; j < NUM_STAGES; j++)
+							result.pStageTime[j] = min(result.pStageTime[j], run.pStageTime[j]);
+						result.nPeakWorkingSet = run.nPeakWorkingSet;
+					}
+
+					if(result.bOutOfMemory)
+						break;
+				}
+
+				std::cout << std::setw(10) << std::left << result.strMesh << std::right << std::setw(7) << result.iResolution << std::setw(9) << result.nThreads;
+				if(result.bOutOfMemory)
+				{
+					std::cout << "   out of memory" << std::endl;
+				}
+				else
+				{
+					double fVoxels = double(result.nNumVoxels);
+					double fDiffusion = result.pStageTime[STAGE_DIFFUSION];
+					double fTotal = result.pStageTime[STAGE_VORONOI] + fDiffusion + result.pStageTime[STAGE_ISOSURFACE];
+
+					//throughput in million voxel updates per second
+					std::cout << std::setw(13) << result.pStageTime[STAGE_VORONOI]
+							  << std::setw(14) << fDiffusion
+							  << std::setw(11) << result.pStageTime[STAGE_ISOSURFACE]
+							  << std::setw(20) << (fDiffusion > 0.0 ? fVoxels * result.iNumSteps / (fDiffusion * 1000.0) : 0.0)
+							  << std::setw(16) << (fTotal > 0.0 ? fVoxels / (fTotal * 1000.0) : 0.0)
+							  << std::setw(11) << double(result.nEngineMemory) / (1024.0 * 1024.0)
+							  << std::setw(9) << double(result.nPeakWorkingSet) / (1024.0 * 1024.0) << std::endl;
+				}
+
+				vResults.push_back(result);
+			}
+		}
+	}
+
+	int iExitCode = 0;
+
+	if(!settings.strBaselineFile.empty())
+	{
+		std::map<std::string, BENCHMARK_RESULT> mBaseline;
+		if(!ReadBaseline(settings.strBaselineFile, mBaseline))
+		{
+			std::cerr << "Could not read the baseline " << settings.strBaselineFile << std::endl;
+			iExitCode = 2;
+		}
+		else if(CompareWithBaseline(vResults, mBaseline, settings.fTolerance) > 0)
+			iExitCode = 1;
+	}
+
+	if(!settings.strWriteBaselineFile.empty())
+	{
+		if(WriteBaseline(settings.strWriteBaselineFile, vResults))
+			std::cout << "Baseline written to " << settings.strWriteBaselineFile << std::endl;
+		else
+		{
+			std::cerr << "Could not write the baseline " << settings.strWriteBaselineFile << std::endl;
+			iExitCode = 2;
+		}
+	}
+
+	ThreadPool::DeleteInstance();
+	MeshCache::DeleteInstance();
+
+	return iExitCode;
+}
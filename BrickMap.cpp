@@ -0,0 +1,178 @@
+#include "BrickMap.h"
+#include <float.h>
+
+
+/****************************************************************************
+ ****************************************************************************/
+BrickMap::BrickMap()
+{
+	m_iWidth = 0;
+	m_iHeight = 0;
+	m_iDepth = 0;
+
+	m_iBrickSize = 4;
+	m_iDilation = 1;
+
+	m_iBricksX = 0;
+	m_iBricksY = 0;
+	m_iBricksZ = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void BrickMap::Clear()
+{
+	m_vActive.clear();
+	m_vLayerRects.clear();
+	m_iBricksX = m_iBricksY = m_iBricksZ = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void BrickMap::Build(const std::vector<float>& vValues, int iWidth, int iHeight, int iDepth, const std::vector<float>& vIsoValues)
+{
+	Clear();
+
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_iDepth = iDepth;
+
+	m_iBricksX = (iWidth + m_iBrickSize - 1) / m_iBrickSize;
+	m_iBricksY = (iHeight + m_iBrickSize - 1) / m_iBrickSize;
+	m_iBricksZ = (iDepth + m_iBrickSize - 1) / m_iBrickSize;
+
+	std::vector<bool> vStraddling(m_iBricksX * m_iBricksY * m_iBricksZ, false);
+
+	for(int bz = 0; bz < m_iBricksZ; bz++)
+	{
+		for(int by = 0; by < m_iBricksY; by++)
+		{
+			for(int bx = 0; bx < m_iBricksX; bx++)
+			{
+				//value range of the brick including a border of one voxel, the fine level interpolates across it
+				float fMin = FLT_MAX;
+				float fMax = -FLT_MAX;
+
+				int iStartZ = max(0, bz * m_iBrickSize - 1), iEndZ = min(iDepth, (bz + 1) * m_iBrickSize + 1);
+				int iStartY = max(0, by * m_iBrickSize - 1), iEndY = min(iHeight, (by + 1) * m_iBrickSize + 1);
+				int iStartX = max(0, bx * m_iBrickSize - 1), iEndX = min(iWidth, (bx + 1) * m_iBrickSize + 1);
+
+				for(int z = iStartZ; z < iEndZ; z++)
+				{
+					for(int y = iStartY; y < iEndY; y++)
+					{
+						const float* pRow = &vValues[(z * iHeight + y) * iWidth];
+						for(int x = iStartX; x < iEndX; x++)
+						{
+							if(pRow[x] < fMin)
+								fMin = pRow[x];
+							if(pRow[x] > fMax)
+								fMax = pRow[x];
+						}
+					}
+				}
+
+				for(unsigned int i = 0; i < vIsoValues.size(); i++)
+				{
+					if(fMin <= vIsoValues[i] && vIsoValues[i] <= fMax)
+					{
+						vStraddling[(bz * m_iBricksY + by) * m_iBricksX + bx] = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	//dilate the straddling bricks so that the refined shell has a margin
+	m_vActive.assign(vStraddling.size(), false);
+	for(int bz = 0; bz < m_iBricksZ; bz++)
+	{
+		for(int by = 0; by < m_iBricksY; by++)
+		{
+			for(int bx = 0; bx < m_iBricksX; bx++)
+			{
+				if(!vStraddling[(bz * m_iBricksY + by) * m_iBricksX + bx])
+					continue;
+
+				for(int z = max(0, bz - m_iDilation); z <= min(m_iBricksZ - 1, bz + m_iDilation); z++)
+					for(int y = max(0, by - m_iDilation); y <= min(m_iBricksY - 1, by + m_iDilation); y++)
+						for(int x = max(0, bx - m_iDilation); x <= min(m_iBricksX - 1, bx + m_iDilation); x++)
+							m_vActive[(z * m_iBricksY + y) * m_iBricksX + x] = true;
+			}
+		}
+	}
+
+	//bounding rectangle of every brick layer
+	m_vLayerRects.resize(m_iBricksZ);
+	for(int bz = 0; bz < m_iBricksZ; bz++)
+	{
+		BRICKRECT& rect = m_vLayerRects[bz];
+		rect.bEmpty = true;
+		rect.iMinX = m_iBricksX;
+		rect.iMinY = m_iBricksY;
+		rect.iMaxX = -1;
+		rect.iMaxY = -1;
+
+		for(int by = 0; by < m_iBricksY; by++)
+		{
+			for(int bx = 0; bx < m_iBricksX; bx++)
+			{
+				if(!ItlIsActive(bx, by, bz))
+					continue;
+
+				rect.bEmpty = false;
+				rect.iMinX = min(rect.iMinX, bx);
+				rect.iMinY = min(rect.iMinY, by);
+				rect.iMaxX = max(rect.iMaxX, bx);
+				rect.iMaxY = max(rect.iMaxY, by);
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool BrickMap::GetSliceRect(int iSlice, int iWidth, int iHeight, int iDepth, D3D11_RECT* pRect) const
+{
+	if(IsEmpty())
+		return false;
+
+	//brick layer of the slice center
+	int iCoarseZ = int((iSlice + 0.5f) * m_iDepth / iDepth);
+	int iLayer = min(m_iBricksZ - 1, iCoarseZ / m_iBrickSize);
+
+	const BRICKRECT& rect = m_vLayerRects[iLayer];
+	if(rect.bEmpty)
+		return false;
+
+	//convert the brick rectangle to the fine resolution, rounding outwards
+	int iCoarseLeft = rect.iMinX * m_iBrickSize;
+	int iCoarseTop = rect.iMinY * m_iBrickSize;
+	int iCoarseRight = min(m_iWidth, (rect.iMaxX + 1) * m_iBrickSize);
+	int iCoarseBottom = min(m_iHeight, (rect.iMaxY + 1) * m_iBrickSize);
+
+	pRect->left = (iCoarseLeft * iWidth) / m_iWidth;
+	pRect->top = (iCoarseTop * iHeight) / m_iHeight;
+	pRect->right = min(iWidth, (iCoarseRight * iWidth + m_iWidth - 1) / m_iWidth);
+	pRect->bottom = min(iHeight, (iCoarseBottom * iHeight + m_iHeight - 1) / m_iHeight);
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+float BrickMap::GetActiveFraction() const
+{
+	if(IsEmpty())
+		return 0.0f;
+
+	unsigned int nActive = 0;
+	for(unsigned int i = 0; i < m_vActive.size(); i++)
+	{
+		if(m_vActive[i])
+			nActive++;
+	}
+
+	return float(nActive) / float(m_vActive.size());
+}
@@ -0,0 +1,80 @@
+#ifndef _BRICKMAP_H_
+#define _BRICKMAP_H_
+
+#include "Globals.h"
+#include <vector>
+
+/*
+ *  Marks the bricks of a coarse volume whose value range straddles one of the target iso values.
+ *	Only these bricks have to be solved again at a finer resolution, the rest of the fine volume
+ *	is taken from the upsampled coarse solution.
+ */
+class BrickMap
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	BrickMap();
+
+	/*
+	 *  Builds the map from the values of the coarse volume (x, y, z order)
+	 */
+	void Build(const std::vector<float>& vValues, int iWidth, int iHeight, int iDepth, const std::vector<float>& vIsoValues);
+
+	/*
+	 *  Removes all bricks
+	 */
+	void Clear();
+
+	/*
+	 *  Returns the rectangle of the active bricks in a slice of a fine volume with the given size.
+	 *	Returns false if the slice does not intersect an active brick.
+	 */
+	bool GetSliceRect(int iSlice, int iWidth, int iHeight, int iDepth, D3D11_RECT* pRect) const;
+
+	/*
+	 *  Fraction of the active bricks
+	 */
+	float GetActiveFraction() const;
+
+	/*
+	 *  Edge length of a brick in coarse voxels (default 4) and number of bricks that are added
+	 *	around every straddling brick (default 1)
+	 */
+	void SetBrickSize(int iBrickSize) { m_iBrickSize = max(1, iBrickSize); }
+	void SetDilation(int iDilation) { m_iDilation = max(0, iDilation); }
+
+	bool IsEmpty() const { return m_vActive.empty(); }
+
+protected:
+	struct BRICKRECT
+	{
+		int iMinX;
+		int iMinY;
+		int iMaxX;
+		int iMaxY;
+		bool bEmpty;
+	};
+
+	bool ItlIsActive(int x, int y, int z) const { return m_vActive[(z * m_iBricksY + y) * m_iBricksX + x]; }
+
+	//size of the coarse volume
+	int m_iWidth;
+	int m_iHeight;
+	int m_iDepth;
+
+	int m_iBrickSize;
+	int m_iDilation;
+
+	int m_iBricksX;
+	int m_iBricksY;
+	int m_iBricksZ;
+
+	std::vector<bool> m_vActive;
+
+	//bounding rectangle of the active bricks of every brick layer
+	std::vector<BRICKRECT> m_vLayerRects;
+};
+
+#endif
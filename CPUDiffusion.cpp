@@ -0,0 +1,527 @@
+#include "CPUDiffusion.h"
+#include "ThreadPool.h"
+#include <new>
+#include <float.h>
+
+/*
+ *  Sweeps of the step kernels
+ */
+struct JacobiSweep
+{
+	//point sampling at the offset position rounds the kernel to the nearest voxel
+	static bool GetOffset(float fKernel, int& iOffset)
+	{
+		iOffset = (int)(fKernel + 0.5f);
+		return true;
+	}
+
+	//samples outside of the volume are clamped to the border
+	static int ClampLow(int i, int iOffset, int iSize) { return max(0, i - iOffset); }
+	static int ClampHigh(int i, int iOffset, int iSize) { return min(iSize - 1, i + iOffset); }
+
+	template<typename T>
+	static void Update(T& vDest, const T& vCenter, const T& vMean, float fRelaxation) { vDest = vMean; }
+};
+
+struct RedBlackSweep
+{
+	//odd offsets, so that all samples have the other color. Voxels with the offset 0 only sample
+	//themselves and keep their value.
+	static bool GetOffset(float fKernel, int& iOffset)
+	{
+		if(fKernel < 0.5f)
+			return false;
+		iOffset = 2 * (int)(0.5f * fKernel) + 1;
+		return true;
+	}
+
+	//clamping to the border is moved back by one voxel where it would hit the own color
+	static int ClampLow(int i, int iOffset, int iSize)
+	{
+		return i - iOffset >= 0 ? i - iOffset : (i & 1) ? 0 : min(1, iSize - 1);
+	}
+	static int ClampHigh(int i, int iOffset, int iSize)
+	{
+		return i + iOffset < iSize ? i + iOffset : ((iSize - 1 - i) & 1) ? iSize - 1 : max(0, iSize - 2);
+	}
+
+	template<typename T>
+	static void Update(T& vDest, const T& vCenter, const T& vMean, float fRelaxation) { vDest = vCenter + fRelaxation * (vMean - vCenter); }
+};
+
+const CPUDiffusion::STEPKERNEL CPUDiffusion::s_pStepKernels[NUM_STEPFORMATS][2] =
+{
+	{ &CPUDiffusion::ItlStepKernel<D3DXVECTOR4, JacobiSweep>, &CPUDiffusion::ItlStepKernel<D3DXVECTOR4, RedBlackSweep> },
+	{ &CPUDiffusion::ItlStepKernel<float, JacobiSweep>, &CPUDiffusion::ItlStepKernel<float, RedBlackSweep> },
+};
+
+/****************************************************************************
+ ****************************************************************************/
+CPUDiffusion::CPUDiffusion()
+{
+	m_bGaussSeidel = false;
+	m_fRelaxation = 1.0f;
+	m_pDomainMask = NULL;
+	m_bScalar = false;
+	m_iColorDownsample = 0;
+	m_nNumActiveVoxels = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::SetScalarMode(bool bScalar, int iColorDownsample)
+{
+	m_bScalar = bScalar;
+	m_iColorDownsample = max(0, iColorDownsample);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::SetGaussSeidel(bool bGaussSeidel, float fRelaxation)
+{
+	m_bGaussSeidel = bGaussSeidel;
+	m_fRelaxation = fRelaxation;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::Release()
+{
+	std::vector<D3DXVECTOR4>().swap(m_vColors);
+	for(int i = 0; i < 2; i++)
+	{
+		std::vector<float>().swap(m_vIsoValues[i]);
+		std::vector<unsigned int>().swap(m_vActiveVoxels[i]);
+		std::vector<unsigned int>().swap(m_vBrickOffsets[i]);
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned __int64 CPUDiffusion::GetMemorySize() const
+{
+	unsigned __int64 nSize = (unsigned __int64)m_vColors.capacity() * sizeof(D3DXVECTOR4);
+	for(int i = 0; i < 2; i++)
+	{
+		nSize += (unsigned __int64)m_vIsoValues[i].capacity() * sizeof(float);
+		nSize += (unsigned __int64)(m_vActiveVoxels[i].capacity() + m_vBrickOffsets[i].capacity()) * sizeof(unsigned int);
+	}
+	return nSize;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUDiffusion::Diffuse(CPUVolume* pVolume, int iNumSteps)
+{
+	if(pVolume->GetNumVoxels() == 0)
+		return E_INVALIDARG;
+
+	if(m_bScalar)
+		return ItlDiffuseScalar(pVolume, iNumSteps);
+
+	try
+	{
+		ItlBuildActiveVoxels(pVolume);
+
+		//the jacobi steps write the active voxels only, the others have to be in both buffers
+		if(!m_bGaussSeidel)
+			m_vColors.assign(pVolume->GetColors(), pVolume->GetColors() + pVolume->GetNumVoxels());
+		else
+			std::vector<D3DXVECTOR4>().swap(m_vColors);
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	for(int iStep = 0; iStep < iNumSteps; iStep++)
+	{
+		//the sample offsets shrink linearly with every step, like in Diffusion::RenderDiffusion
+		float fPolySize = 1.0f - float(iStep) / float(iNumSteps);
+
+		if(m_bGaussSeidel)
+		{
+			ItlStep(pVolume, STEPFORMAT_RGBA32F, pVolume->GetColors(), pVolume->GetColors(), 0, fPolySize);
+			ItlStep(pVolume, STEPFORMAT_RGBA32F, pVolume->GetColors(), pVolume->GetColors(), 1, fPolySize);
+		}
+		else
+		{
+			ItlStep(pVolume, STEPFORMAT_RGBA32F, pVolume->GetColors(), &m_vColors[0], -1, fPolySize);
+			pVolume->SwapColors(m_vColors);
+		}
+	}
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUDiffusion::ItlDiffuseScalar(CPUVolume* pVolume, int iNumSteps)
+{
+	HRESULT hr(S_OK);
+
+	unsigned int nNumVoxels = pVolume->GetNumVoxels();
+	D3DXVECTOR4* pColors = pVolume->GetColors();
+
+	try
+	{
+		ItlBuildActiveVoxels(pVolume);
+		std::vector<D3DXVECTOR4>().swap(m_vColors);
+
+		m_vIsoValues[0].resize(nNumVoxels);
+		for(unsigned int i = 0; i < nNumVoxels; i++)
+			m_vIsoValues[0][i] = pColors[i].w;
+
+		if(!m_bGaussSeidel)
+			m_vIsoValues[1] = m_vIsoValues[0];
+		else
+			std::vector<float>().swap(m_vIsoValues[1]);
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	for(int iStep = 0; iStep < iNumSteps; iStep++)
+	{
+		float fPolySize = 1.0f - float(iStep) / float(iNumSteps);
+
+		if(m_bGaussSeidel)
+		{
+			ItlStep(pVolume, STEPFORMAT_R32F, &m_vIsoValues[0][0], &m_vIsoValues[0][0], 0, fPolySize);
+			ItlStep(pVolume, STEPFORMAT_R32F, &m_vIsoValues[0][0], &m_vIsoValues[0][0], 1, fPolySize);
+		}
+		else
+		{
+			ItlStep(pVolume, STEPFORMAT_R32F, &m_vIsoValues[0][0], &m_vIsoValues[1][0], -1, fPolySize);
+			m_vIsoValues[0].swap(m_vIsoValues[1]);
+		}
+	}
+
+	const float* pIsoValues = &m_vIsoValues[0][0];
+	for(unsigned int i = 0; i < nNumVoxels; i++)
+		pColors[i].w = pIsoValues[i];
+
+	if(m_iColorDownsample > 0)
+		V_RETURN(ItlDiffuseDownsampledColors(pVolume, iNumSteps));
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUDiffusion::ItlDiffuseDownsampledColors(CPUVolume* pVolume, int iNumSteps)
+{
+	HRESULT hr(S_OK);
+
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iDepth = pVolume->GetDepth();
+	int n = m_iColorDownsample;
+
+	CPUVolume lowVolume;
+	lowVolume.SetBoundingBox(pVolume->GetBBMin(), pVolume->GetBBMax());
+	V_RETURN(lowVolume.Allocate((iWidth + n - 1) / n, (iHeight + n - 1) / n, (iDepth + n - 1) / n));
+
+	int iLowWidth = lowVolume.GetWidth();
+	int iLowHeight = lowVolume.GetHeight();
+	int iLowDepth = lowVolume.GetDepth();
+	const D3DXVECTOR4* pColors = pVolume->GetColors();
+	const float* pDistances = pVolume->GetDistances();
+	D3DXVECTOR4* pLowColors = lowVolume.GetColors();
+	float* pLowDistances = lowVolume.GetDistances();
+
+	//box filter of the colors, the distance to the closest surface in low resolution voxels
+	ThreadPool::GetInstance()->ParallelFor(0, iLowDepth, 1, [&](int iBegin, int iEnd)
+	{
+		for(int z = iBegin; z < iEnd; z++)
+		{
+			for(int y = 0; y < iLowHeight; y++)
+			{
+				for(int x = 0; x < iLowWidth; x++)
+				{
+					D3DXVECTOR4 vSum(0.0f, 0.0f, 0.0f, 0.0f);
+					float fMinDistance = FLT_MAX;
+					int iNumSamples = 0;
+
+					for(int sz = z * n; sz < min(iDepth, (z + 1) * n); sz++)
+					{
+						for(int sy = y * n; sy < min(iHeight, (y + 1) * n); sy++)
+						{
+							for(int sx = x * n; sx < min(iWidth, (x + 1) * n); sx++)
+							{
+								unsigned int nIndex = pVolume->GetIndex(sx, sy, sz);
+								vSum += pColors[nIndex];
+								fMinDistance = min(fMinDistance, pDistances[nIndex]);
+								iNumSamples++;
+							}
+						}
+					}
+
+					unsigned int nLowIndex = lowVolume.GetIndex(x, y, z);
+					pLowColors[nLowIndex] = vSum / float(iNumSamples);
+					pLowDistances[nLowIndex] = fMinDistance / float(n);
+				}
+			}
+		}
+	});
+
+	CPUDiffusion colorDiffusion;
+	colorDiffusion.SetGaussSeidel(m_bGaussSeidel, m_fRelaxation);
+	V_RETURN(colorDiffusion.Diffuse(&lowVolume, iNumSteps));
+	colorDiffusion.Release();
+
+	//trilinear interpolation at the active voxels, the pinned voxels keep their voronoi color
+	D3DXVECTOR4* pDestColors = pVolume->GetColors();
+	ItlForEachActiveVoxel(-1, [&](const unsigned int* pBegin, const unsigned int* pEnd)
+	{
+		for(const unsigned int* pVoxel = pBegin; pVoxel < pEnd; pVoxel++)
+		{
+			unsigned int nIndex = *pVoxel;
+			int x = nIndex % iWidth;
+			int y = (nIndex / iWidth) % iHeight;
+			int z = nIndex / (iWidth * iHeight);
+
+			//the centers of the low resolution voxels are at n * (i + 0.5) - 0.5
+			float fX = max(0.0f, (x + 0.5f) / n - 0.5f);
+			float fY = max(0.0f, (y + 0.5f) / n - 0.5f);
+			float fZ = max(0.0f, (z + 0.5f) / n - 0.5f);
+			int x0 = min(iLowWidth - 1, (int)fX), x1 = min(iLowWidth - 1, x0 + 1);
+			int y0 = min(iLowHeight - 1, (int)fY), y1 = min(iLowHeight - 1, y0 + 1);
+			int z0 = min(iLowDepth - 1, (int)fZ), z1 = min(iLowDepth - 1, z0 + 1);
+			float fx = fX - x0, fy = fY - y0, fz = fZ - z0;
+
+			D3DXVECTOR4 c00 = pLowColors[lowVolume.GetIndex(x0, y0, z0)] * (1.0f - fx) + pLowColors[lowVolume.GetIndex(x1, y0, z0)] * fx;
+			D3DXVECTOR4 c10 = pLowColors[lowVolume.GetIndex(x0, y1, z0)] * (1.0f - fx) + pLowColors[lowVolume.GetIndex(x1, y1, z0)] * fx;
+			D3DXVECTOR4 c01 = pLowColors[lowVolume.GetIndex(x0, y0, z1)] * (1.0f - fx) + pLowColors[lowVolume.GetIndex(x1, y0, z1)] * fx;
+			D3DXVECTOR4 c11 = pLowColors[lowVolume.GetIndex(x0, y1, z1)] * (1.0f - fx) + pLowColors[lowVolume.GetIndex(x1, y1, z1)] * fx;
+			D3DXVECTOR4 vColor = (c00 * (1.0f - fy) + c10 * fy) * (1.0f - fz) + (c01 * (1.0f - fy) + c11 * fy) * fz;
+
+			//the iso value is the one of the scalar diffusion
+			pDestColors[nIndex] = D3DXVECTOR4(vColor.x, vColor.y, vColor.z, pDestColors[nIndex].w);
+		}
+	});
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::ItlBuildActiveVoxels(const CPUVolume* pVolume)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iBricksX = (iWidth + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+	int iBricksY = (iHeight + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+	int iBricksZ = (pVolume->GetDepth() + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+	const float* pDistances = pVolume->GetDistances();
+	const unsigned char* pDomainMask = m_pDomainMask;
+
+	//the offset of a voxel is largest in the first step, a voxel with the offset 0 only samples itself
+	//in all steps. These are the voxels on the surfaces, they keep the color of the voronoi diagram.
+	auto IsActive = [&](unsigned int nIndex) -> bool
+	{
+		return (pDomainMask == NULL || pDomainMask[nIndex] != 0) && 0.92387f * pDistances[nIndex] - 0.5f >= 0.5f;
+	};
+
+	//the first pass counts the voxels of every brick, the second one stores them
+	for(int iColor = 0; iColor < 2; iColor++)
+		m_vBrickOffsets[iColor].assign(iBricksX * iBricksY * iBricksZ + 1, 0);
+
+	for(int iPass = 0; iPass < 2; iPass++)
+	{
+		ItlForEachBrick(pVolume, [&](int iMinX, int iMinY, int iMinZ, int iMaxX, int iMaxY, int iMaxZ)
+		{
+			int iBrick = ((iMinZ / CPU_DIFFUSION_BRICK_SIZE) * iBricksY + iMinY / CPU_DIFFUSION_BRICK_SIZE) * iBricksX + iMinX / CPU_DIFFUSION_BRICK_SIZE;
+
+			for(int iColor = 0; iColor < 2; iColor++)
+			{
+				unsigned int nCount = 0;
+				unsigned int* pActive = iPass == 0 ? NULL : &m_vActiveVoxels[iColor][0] + m_vBrickOffsets[iColor][iBrick];
+
+				for(int z = iMinZ; z < iMaxZ; z++)
+				{
+					for(int y = iMinY; y < iMaxY; y++)
+					{
+						unsigned int nRow = (z * iHeight + y) * iWidth;
+						for(int x = iMinX + ((iMinX + y + z + iColor) & 1); x < iMaxX; x += 2)
+						{
+							if(!IsActive(nRow + x))
+								continue;
+							if(pActive != NULL)
+								pActive[nCount] = nRow + x;
+							nCount++;
+						}
+					}
+				}
+
+				if(iPass == 0)
+					m_vBrickOffsets[iColor][iBrick + 1] = nCount;
+			}
+		});
+
+		if(iPass == 0)
+		{
+			for(int iColor = 0; iColor < 2; iColor++)
+			{
+				std::vector<unsigned int>& vOffsets = m_vBrickOffsets[iColor];
+				for(unsigned int i = 1; i < vOffsets.size(); i++)
+					vOffsets[i] += vOffsets[i - 1];
+				m_vActiveVoxels[iColor].resize(max(1u, vOffsets.back()));
+			}
+		}
+	}
+
+	m_nNumActiveVoxels = m_vBrickOffsets[0].back() + m_vBrickOffsets[1].back();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::ItlForEachActiveVoxel(int iColor, const std::function<void(const unsigned int*, const unsigned int*)>& fnVoxels)
+{
+	int iNumBricks = (int)m_vBrickOffsets[0].size() - 1;
+
+	//every chunk gets the active voxels of its bricks, iColor -1 returns both colors
+	ThreadPool::GetInstance()->ParallelFor(0, iNumBricks, 1, [&](int iBegin, int iEnd)
+	{
+		for(int iCurrentColor = 0; iCurrentColor < 2; iCurrentColor++)
+		{
+			if(iColor >= 0 && iColor != iCurrentColor)
+				continue;
+
+			const unsigned int* pActive = &m_vActiveVoxels[iCurrentColor][0];
+			const std::vector<unsigned int>& vOffsets = m_vBrickOffsets[iCurrentColor];
+			if(vOffsets[iBegin] < vOffsets[iEnd])
+				fnVoxels(pActive + vOffsets[iBegin], pActive + vOffsets[iEnd]);
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::ItlStep(const CPUVolume* pVolume, STEPFORMAT format, const void* pSource, void* pDest, int iColor, float fPolySize)
+{
+	STEPPARAMS params;
+	params.iWidth = pVolume->GetWidth();
+	params.iHeight = pVolume->GetHeight();
+	params.iDepth = pVolume->GetDepth();
+	params.pDistances = pVolume->GetDistances();
+	params.pSource = pSource;
+	params.pDest = pDest;
+	params.fPolySize = fPolySize;
+	params.fRelaxation = m_fRelaxation;
+
+	//the format and the sweep are resolved here, not per voxel
+	STEPKERNEL pKernel = s_pStepKernels[format][m_bGaussSeidel ? 1 : 0];
+
+	ItlForEachActiveVoxel(iColor, [&](const unsigned int* pBegin, const unsigned int* pEnd)
+	{
+		pKernel(params, pBegin, pEnd);
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+template<typename T, typename Sweep>
+void CPUDiffusion::ItlStepKernel(const STEPPARAMS& params, const unsigned int* pBegin, const unsigned int* pEnd)
+{
+	int iWidth = params.iWidth;
+	int iHeight = params.iHeight;
+	int iDepth = params.iDepth;
+	const float* pDistances = params.pDistances;
+	const T* pSource = (const T*)params.pSource;
+	T* pDest = (T*)params.pDest;
+	float fPolySize = params.fPolySize;
+	float fRelaxation = params.fRelaxation;
+
+	for(const unsigned int* pVoxel = pBegin; pVoxel < pEnd; pVoxel++)
+	{
+		unsigned int nIndex = *pVoxel;
+		int x = nIndex % iWidth;
+		int y = (nIndex / iWidth) % iHeight;
+		int z = nIndex / (iWidth * iHeight);
+		unsigned int nRow = nIndex - x;
+
+		//the distances are in voxels, so the kernel is the same along all axes
+		float fKernel = max(0.0f, 0.92387f * pDistances[nIndex] * fPolySize - 0.5f);
+		int iOffset;
+		if(!Sweep::GetOffset(fKernel, iOffset))
+			continue;
+
+		int x0 = Sweep::ClampLow(x, iOffset, iWidth), x1 = Sweep::ClampHigh(x, iOffset, iWidth);
+		int y0 = Sweep::ClampLow(y, iOffset, iHeight), y1 = Sweep::ClampHigh(y, iOffset, iHeight);
+		int z0 = Sweep::ClampLow(z, iOffset, iDepth), z1 = Sweep::ClampHigh(z, iOffset, iDepth);
+
+		T vSum = pSource[nRow + x0] + pSource[nRow + x1];
+		vSum += pSource[(z * iHeight + y0) * iWidth + x] + pSource[(z * iHeight + y1) * iWidth + x];
+		vSum += pSource[(z0 * iHeight + y) * iWidth + x] + pSource[(z1 * iHeight + y) * iWidth + x];
+
+		Sweep::Update(pDest[nIndex], pSource[nIndex], vSum / 6.0f, fRelaxation);
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned int CPUDiffusion::ExtractIsoSurface(const CPUVolume* pVolume, float fIsoValue, std::vector<unsigned char>& vMask)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	const D3DXVECTOR4* pColors = pVolume->GetColors();
+
+	vMask.resize(pVolume->GetNumVoxels());
+	unsigned char* pMask = vMask.empty() ? NULL : &vMask[0];
+
+	volatile LONG nInside = 0;
+	ItlForEachBrick(pVolume, [&](int iMinX, int iMinY, int iMinZ, int iMaxX, int iMaxY, int iMaxZ)
+	{
+		LONG nBrickInside = 0;
+		for(int z = iMinZ; z < iMaxZ; z++)
+		{
+			for(int y = iMinY; y < iMaxY; y++)
+			{
+				unsigned int nRow = (z * iHeight + y) * iWidth;
+				for(unsigned int nIndex = nRow + iMinX; nIndex < nRow + iMaxX; nIndex++)
+				{
+					//same test as IsoSurfacePS, linear sampling at the voxel centers returns the voxel
+					unsigned char cInside = pColors[nIndex].w >= fIsoValue ? 1 : 0;
+					pMask[nIndex] = cInside;
+					nBrickInside += cInside;
+				}
+			}
+		}
+		InterlockedExchangeAdd(&nInside, nBrickInside);
+	});
+
+	return (unsigned int)nInside;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUDiffusion::ItlForEachBrick(const CPUVolume* pVolume, const std::function<void(int, int, int, int, int, int)>& fnBrick)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iDepth = pVolume->GetDepth();
+
+	int iBricksX = (iWidth + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+	int iBricksY = (iHeight + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+	int iBricksZ = (iDepth + CPU_DIFFUSION_BRICK_SIZE - 1) / CPU_DIFFUSION_BRICK_SIZE;
+
+	//one loop over all bricks of the volume, the bricks of one thread are close to each other
+	ThreadPool::GetInstance()->ParallelFor(0, iBricksX * iBricksY * iBricksZ, 1, [&](int iBegin, int iEnd)
+	{
+		for(int iBrick = iBegin; iBrick < iEnd; iBrick++)
+		{
+			int x = (iBrick % iBricksX) * CPU_DIFFUSION_BRICK_SIZE;
+			int y = ((iBrick / iBricksX) % iBricksY) * CPU_DIFFUSION_BRICK_SIZE;
+			int z = (iBrick / (iBricksX * iBricksY)) * CPU_DIFFUSION_BRICK_SIZE;
+
+			fnBrick(x, y, z, 
+					min(iWidth, x + CPU_DIFFUSION_BRICK_SIZE), 
+					min(iHeight, y + CPU_DIFFUSION_BRICK_SIZE), 
+					min(iDepth, z + CPU_DIFFUSION_BRICK_SIZE));
+		}
+	});
+}
@@ -0,0 +1,170 @@
+#ifndef _CPUDIFFUSION_H_
+#define _CPUDIFFUSION_H_
+
+#include "Globals.h"
+#include "CPUVolume.h"
+#include <vector>
+#include <functional>
+
+//edge length of the bricks the steps are distributed over the threads in
+#define CPU_DIFFUSION_BRICK_SIZE 16
+
+/*
+ *  CPU implementation of the diffusion and iso surface stages.
+ *	A diffusion step averages six samples along the axes, their offset shrinks with the
+ *	distance to the closest surface and with the step index like in DiffusionPS.
+ *
+ *	The steps are jacobi steps by default, they need a second color buffer. Red-black Gauss-Seidel
+ *	sweeps update the colors in place instead: the voxels are split into a checkerboard and every
+ *	half sweep only reads the other color. For this the sample offsets are rounded to odd numbers.
+ *
+ *	The steps only run over a compacted list of active voxels. Voxels on the surfaces sample only
+ *	themselves and are pinned to their voronoi color, voxels outside of the domain mask are skipped.
+ *
+ *	In the scalar mode only the iso values (alpha) are diffused in a single channel buffer, a quarter
+ *	of the memory traffic of the colors. The colors can be diffused afterwards on a downsampled
+ *	volume and interpolated, or keep the colors of the voronoi diagram.
+ */
+class CPUDiffusion
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	CPUDiffusion();
+
+	/*
+	 *  Diffuses the colors of the volume in place, the distances are not changed
+	 */
+	HRESULT Diffuse(CPUVolume* pVolume, int iNumSteps);
+
+	/*
+	 *  Enables the in place red-black Gauss-Seidel sweeps. fRelaxation > 1 over-relaxes the
+	 *	update (SOR), values of 2 and above do not converge.
+	 */
+	void SetGaussSeidel(bool bGaussSeidel, float fRelaxation = 1.0f);
+	bool IsGaussSeidel() const { return m_bGaussSeidel; }
+
+	/*
+	 *  Restricts the diffusion to the voxels with a non zero mask value, the other voxels keep the
+	 *	color of the voronoi diagram. The mask has one byte per voxel, NULL diffuses all voxels.
+	 */
+	void SetDomainMask(const unsigned char* pDomainMask) { m_pDomainMask = pDomainMask; }
+
+	/*
+	 *  Enables the scalar mode. With iColorDownsample > 0 the colors are diffused on a volume with
+	 *	1/iColorDownsample of the resolution, with 0 the voxels keep the colors of the voronoi diagram.
+	 */
+	void SetScalarMode(bool bScalar, int iColorDownsample = 0);
+	bool IsScalarMode() const { return m_bScalar; }
+
+	/*
+	 *  Number of voxels that were updated by the last call of Diffuse
+	 */
+	unsigned int GetNumActiveVoxels() const { return m_nNumActiveVoxels; }
+
+	/*
+	 *  Marks all voxels with an iso value of at least fIsoValue, returns the number of marked voxels
+	 */
+	unsigned int ExtractIsoSurface(const CPUVolume* pVolume, float fIsoValue, std::vector<unsigned char>& vMask);
+
+	/*
+	 *  Frees the temporary buffers
+	 */
+	void Release();
+
+	/*
+	 *  Size of the temporary buffers in bytes
+	 */
+	unsigned __int64 GetMemorySize() const;
+
+protected:
+	/*
+	 *  Collects the active voxels of both colors, sorted by brick
+	 */
+	void ItlBuildActiveVoxels(const CPUVolume* pVolume);
+
+	/*
+	 *  Calls fnVoxels(pBegin, pEnd) for the active voxels of chunks of bricks in one parallel loop,
+	 *	iColor -1 includes both colors
+	 */
+	void ItlForEachActiveVoxel(int iColor, const std::function<void(const unsigned int*, const unsigned int*)>& fnVoxels);
+
+	/*
+	 *  Buffer formats of the steps, the first index of the kernel table
+	 */
+	enum STEPFORMAT
+	{
+		STEPFORMAT_RGBA32F,
+		STEPFORMAT_R32F,
+		NUM_STEPFORMATS
+	};
+
+	/*
+	 *  Everything a step kernel reads, pDest is pSource for the in place sweeps
+	 */
+	struct STEPPARAMS
+	{
+		int iWidth;
+		int iHeight;
+		int iDepth;
+		const float* pDistances;
+		const void* pSource;
+		void* pDest;
+		float fPolySize;
+		float fRelaxation;
+	};
+
+	typedef void (*STEPKERNEL)(const STEPPARAMS& params, const unsigned int* pBegin, const unsigned int* pEnd);
+
+	/*
+	 *  One jacobi step from pSource into pDest, or one red-black half sweep over the voxels with
+	 *	(x + y + z) % 2 == iColor in place. The kernel is picked once per step from s_pStepKernels.
+	 */
+	void ItlStep(const CPUVolume* pVolume, STEPFORMAT format, const void* pSource, void* pDest, int iColor, float fPolySize);
+
+	/*
+	 *  Step over the voxels pBegin..pEnd, specialized on the value type of the buffer and on the
+	 *	sweep, which defines the sample offsets, the border of the volume and the update
+	 */
+	template<typename T, typename Sweep>
+	static void ItlStepKernel(const STEPPARAMS& params, const unsigned int* pBegin, const unsigned int* pEnd);
+
+	//step kernels by format and sweep (jacobi, red-black)
+	static const STEPKERNEL s_pStepKernels[NUM_STEPFORMATS][2];
+
+	/*
+	 *  Diffuses the iso values of the volume in the scalar mode
+	 */
+	HRESULT ItlDiffuseScalar(CPUVolume* pVolume, int iNumSteps);
+
+	/*
+	 *  Diffuses the colors on a downsampled copy of the volume and interpolates them at the active voxels
+	 */
+	HRESULT ItlDiffuseDownsampledColors(CPUVolume* pVolume, int iNumSteps);
+
+	/*
+	 *  Calls fnBrick(x0, y0, z0, x1, y1, z1) for every brick of the volume in one parallel loop
+	 */
+	static void ItlForEachBrick(const CPUVolume* pVolume, const std::function<void(int, int, int, int, int, int)>& fnBrick);
+
+	bool m_bGaussSeidel;
+	float m_fRelaxation;
+
+	const unsigned char* m_pDomainMask;
+	bool m_bScalar;
+	int m_iColorDownsample;
+
+	//iso values of the scalar mode, the second buffer is only used by the jacobi steps
+	std::vector<float> m_vIsoValues[2];
+
+	//second color buffer for the ping-pong of the jacobi steps
+	std::vector<D3DXVECTOR4> m_vColors;
+
+	//indices of the active voxels per color, the voxels of brick i start at m_vBrickOffsets[color][i]
+	std::vector<unsigned int> m_vActiveVoxels[2];
+	std::vector<unsigned int> m_vBrickOffsets[2];
+	unsigned int m_nNumActiveVoxels;
+};
+
+#endif
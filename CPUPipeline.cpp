@@ -0,0 +1,151 @@
+#include "CPUPipeline.h"
+#include <math.h>
+
+//meshes of the media directory that can be given by name
+static const char* g_pNamedMeshes[][2] =
+{
+	{ "sphere",		"meshes\\Sphere\\sphere.obj" },
+	{ "cube",		"meshes\\Cube\\cube.obj" },
+	{ "cone",		"meshes\\Cone\\cone.obj" },
+	{ "cylinder",	"meshes\\Cylinder\\cylinder.obj" },
+	{ "pyramid",	"meshes\\Pyramid\\pyramid.obj" },
+	{ "torus",		"meshes\\Torus\\torus.obj" },
+	{ "teapot",		"meshes\\teapot.obj" },
+	{ "bunny",		"meshes\\bunny.obj" },
+};
+static const int g_iNumNamedMeshes = sizeof(g_pNamedMeshes) / sizeof(g_pNamedMeshes[0]);
+
+
+/****************************************************************************
+ ****************************************************************************/
+std::string CPUPipeline::GetMeshPath(const std::string& strMediaDirectory, const std::string& strMesh)
+{
+	for(int i = 0; i < g_iNumNamedMeshes; i++)
+	{
+		if(strMesh == g_pNamedMeshes[i][0])
+			return strMediaDirectory + g_pNamedMeshes[i][1];
+	}
+
+	//other meshes are given relative to the media directory
+	return strMediaDirectory + strMesh;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int CPUPipeline::GetNumNamedMeshes()
+{
+	return g_iNumNamedMeshes;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+const char* CPUPipeline::GetNamedMesh(int iIndex)
+{
+	assert(iIndex >= 0 && iIndex < g_iNumNamedMeshes);
+	return g_pNamedMeshes[iIndex][0];
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUPipeline::LoadSurface(const std::string& strMeshPath,
+								 const D3DXCOLOR& cColor,
+								 float fScale,
+								 const D3DXMATRIX& mTransform,
+								 float fIsoValue,
+								 MESHDATA* pMeshData,
+								 CPU_SURFACE* pSurface)
+{
+	HRESULT hr(S_OK);
+
+	V_RETURN(MeshCache::GetInstance()->LoadMesh(strMeshPath, pMeshData));
+
+	//uniform color and normalized size, like Surface::LoadMesh
+	for(unsigned int i = 0; i < pMeshData->vVertices.size(); i++)
+		pMeshData->vVertices[i].color = D3DXVECTOR4(cColor.r, cColor.g, cColor.b, 1.0f);
+
+	float fNormalizedScale = fScale / pMeshData->fMaxVertexValue;
+	D3DXMATRIX mScale;
+	D3DXMatrixScaling(&mScale, fNormalizedScale, fNormalizedScale, fNormalizedScale);
+
+	pSurface->pMesh = pMeshData;
+	pSurface->pTexture = NULL;
+	pSurface->fIsoValue = fIsoValue;
+	pSurface->mModel = mScale * mTransform;
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUPipeline::FitBoundingBox(std::vector<CPU_SURFACE>& vSurfaces,
+								 bool bOriented,
+								 OrientedBoundingBox* pBox)
+{
+	std::vector<D3DXVECTOR3> vPoints;
+	for(unsigned int i = 0; i < vSurfaces.size(); i++)
+	{
+		const std::vector<SURFACE_VERTEX>& vVertices = vSurfaces[i].pMesh->vVertices;
+		for(unsigned int j = 0; j < vVertices.size(); j++)
+		{
+			D3DXVECTOR3 vPosition;
+			D3DXVec3TransformCoord(&vPosition, &vVertices[j].pos, &vSurfaces[i].mModel);
+			vPoints.push_back(vPosition);
+		}
+	}
+
+	if(bOriented)
+		pBox->BuildOriented(vPoints);
+	else
+		pBox->BuildAxisAligned(vPoints);
+
+	D3DXVECTOR3 vExtent = pBox->GetExtent();
+	pBox->Pad(max(vExtent.x, max(vExtent.y, vExtent.z)) * CPU_PIPELINE_BOUNDINGBOX_PADDING);
+
+	//the volume is computed in the frame of the box
+	for(unsigned int i = 0; i < vSurfaces.size(); i++)
+		vSurfaces[i].mModel *= pBox->GetWorldToLocal();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUPipeline::AllocateVolume(const OrientedBoundingBox& box,
+									int iResolution,
+									CPUVolume* pVolume)
+{
+	D3DXVECTOR3 vExtent = box.GetExtent();
+	float fVoxelSize = max(vExtent.x, max(vExtent.y, vExtent.z)) / float(iResolution);
+
+	//like Scene::ItlComputeTextureSize with cubic voxels
+	int iWidth = max(1, int(ceil(vExtent.x / fVoxelSize - 0.001f)));
+	int iHeight = max(1, int(ceil(vExtent.y / fVoxelSize - 0.001f)));
+	int iDepth = max(1, int(ceil(vExtent.z / fVoxelSize - 0.001f)));
+
+	OrientedBoundingBox bbVolume = box;
+	bbVolume.Grow(D3DXVECTOR3(iWidth * fVoxelSize, iHeight * fVoxelSize, iDepth * fVoxelSize));
+
+	pVolume->SetBoundingBox(bbVolume.GetMin(), bbVolume.GetMax());
+	return pVolume->Allocate(iWidth, iHeight, iDepth);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUPipeline::GetPreviewCamera(const CPUVolume& volume,
+								   const OrientedBoundingBox& box,
+								   float fFovY,
+								   D3DXVECTOR3* pEye,
+								   D3DXVECTOR3* pAt,
+								   D3DXVECTOR3* pUp)
+{
+	//the view direction and the up vector of the world, rotated into the frame of the box
+	D3DXVECTOR3 vWorldViewDir(0.0f, 0.0f, 1.0f);
+	D3DXVECTOR3 vWorldUp(0.0f, 1.0f, 0.0f);
+	D3DXVECTOR3 vViewDir;
+	D3DXVec3TransformNormal(&vViewDir, &vWorldViewDir, &box.GetWorldToLocal());
+	D3DXVec3TransformNormal(pUp, &vWorldUp, &box.GetWorldToLocal());
+
+	D3DXVECTOR3 vExtent = volume.GetBBMax() - volume.GetBBMin();
+	float fDistance = 0.5f * D3DXVec3Length(&vExtent) / sinf(0.5f * fFovY);
+
+	*pAt = 0.5f * (volume.GetBBMin() + volume.GetBBMax());
+	*pEye = *pAt - fDistance * vViewDir;
+}
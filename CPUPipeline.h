@@ -0,0 +1,73 @@
+#ifndef _CPUPIPELINE_H_
+#define _CPUPIPELINE_H_
+
+#include "Globals.h"
+#include "MeshCache.h"
+#include "CPUVolume.h"
+#include "CPUVoronoi.h"
+#include "OrientedBoundingBox.h"
+#include <vector>
+
+//the bounding box is enlarged by this fraction of its largest extent on every side
+#define CPU_PIPELINE_BOUNDINGBOX_PADDING 0.05f
+
+/*
+ *  Scene setup of the command line tools that run the CPU implementation of the morph pipeline
+ *	(Batch, Benchmark and Thumbnail)
+ */
+class CPUPipeline
+{
+public:
+	/*
+	 *  Path of a mesh, the bundled meshes can be given by name, other meshes relative to the media directory
+	 */
+	static std::string GetMeshPath(const std::string& strMediaDirectory, const std::string& strMesh);
+
+	/*
+	 *  Number of bundled meshes and their names, e.g. "sphere" or "teapot"
+	 */
+	static int GetNumNamedMeshes();
+	static const char* GetNamedMesh(int iIndex);
+
+	/*
+	 *  Loads a mesh with a uniform color. The mesh is normalized like in Surface::LoadMesh and scaled
+	 *	to fScale, mTransform is applied after the scaling.
+	 *	The mesh cache is not thread safe, callers on several threads have to serialize the calls.
+	 */
+	static HRESULT LoadSurface(const std::string& strMeshPath,
+							   const D3DXCOLOR& cColor,
+							   float fScale,
+							   const D3DXMATRIX& mTransform,
+							   float fIsoValue,
+							   MESHDATA* pMeshData,
+							   CPU_SURFACE* pSurface);
+
+	/*
+	 *  Fits the box of the volume around the surfaces, like Scene::UpdateBoundingBox, and moves the
+	 *	surfaces into the local frame of the box. The box is padded by CPU_PIPELINE_BOUNDINGBOX_PADDING.
+	 */
+	static void FitBoundingBox(std::vector<CPU_SURFACE>& vSurfaces,
+							   bool bOriented,
+							   OrientedBoundingBox* pBox);
+
+	/*
+	 *  Allocates the volume for the box. The voxels are cubes, iResolution voxels cover the largest
+	 *	extent and the box grows to whole voxels along the others.
+	 */
+	static HRESULT AllocateVolume(const OrientedBoundingBox& box,
+								  int iResolution,
+								  CPUVolume* pVolume);
+
+	/*
+	 *  Camera in the frame of the volume that shows the whole box from the front of the world,
+	 *	like the initial view of the viewer
+	 */
+	static void GetPreviewCamera(const CPUVolume& volume,
+								 const OrientedBoundingBox& box,
+								 float fFovY,
+								 D3DXVECTOR3* pEye,
+								 D3DXVECTOR3* pAt,
+								 D3DXVECTOR3* pUp);
+};
+
+#endif
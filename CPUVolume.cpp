@@ -0,0 +1,83 @@
+#include "CPUVolume.h"
+#include <new>
+#include <limits.h>
+
+
+/****************************************************************************
+ ****************************************************************************/
+CPUVolume::CPUVolume()
+{
+	m_iWidth = 0;
+	m_iHeight = 0;
+	m_iDepth = 0;
+
+	m_vBBMin = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	m_vBBMax = D3DXVECTOR3(1.0f, 1.0f, 1.0f);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUVolume::Allocate(int iWidth, int iHeight, int iDepth)
+{
+	Release();
+
+	if(iWidth <= 0 || iHeight <= 0 || iDepth <= 0)
+		return E_INVALIDARG;
+
+	unsigned __int64 nNumVoxels = (unsigned __int64)iWidth * iHeight * iDepth;
+	if(nNumVoxels > UINT_MAX)
+		return E_OUTOFMEMORY;
+
+	try
+	{
+		m_vColors.resize((size_t)nNumVoxels, D3DXVECTOR4(0.0f, 0.0f, 0.0f, 0.0f));
+		m_vDistances.resize((size_t)nNumVoxels, 0.0f);
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_iDepth = iDepth;
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolume::Release()
+{
+	//swap with empty vectors, clear() keeps the memory
+	std::vector<D3DXVECTOR4>().swap(m_vColors);
+	std::vector<float>().swap(m_vDistances);
+
+	m_iWidth = m_iHeight = m_iDepth = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolume::SetBoundingBox(const D3DXVECTOR3& vBBMin, const D3DXVECTOR3& vBBMax)
+{
+	m_vBBMin = vBBMin;
+	m_vBBMax = vBBMax;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+D3DXVECTOR3 CPUVolume::WorldToVoxel(const D3DXVECTOR3& vPosition) const
+{
+	D3DXVECTOR3 vExtent = m_vBBMax - m_vBBMin;
+	return D3DXVECTOR3((vPosition.x - m_vBBMin.x) / vExtent.x * m_iWidth,
+					   (vPosition.y - m_vBBMin.y) / vExtent.y * m_iHeight,
+					   (vPosition.z - m_vBBMin.z) / vExtent.z * m_iDepth);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned __int64 CPUVolume::GetMemorySize() const
+{
+	return (unsigned __int64)m_vColors.size() * sizeof(D3DXVECTOR4) + (unsigned __int64)m_vDistances.size() * sizeof(float);
+}
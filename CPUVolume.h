@@ -0,0 +1,81 @@
+#ifndef _CPUVOLUME_H_
+#define _CPUVOLUME_H_
+
+#include "Globals.h"
+#include <vector>
+
+/*
+ *  Volume in system memory that is used by the CPU implementation of the morph pipeline.
+ *	Every voxel has an RGBA color (the alpha channel is the iso value) and the distance to
+ *	the closest surface in voxels. The volume covers the box [vBBMin, vBBMax] in world space,
+ *	voxel (x, y, z) is centered at (x + 0.5, y + 0.5, z + 0.5) in voxel coordinates.
+ */
+class CPUVolume
+{
+public:
+	/*
+	 *  Constructor, creates an empty volume
+	 */
+	CPUVolume();
+
+	/*
+	 *  Allocates the voxels, returns E_OUTOFMEMORY if the volume does not fit into memory
+	 */
+	HRESULT Allocate(int iWidth, int iHeight, int iDepth);
+
+	/*
+	 *  Frees the voxels
+	 */
+	void Release();
+
+	/*
+	 *  Box in world space that is covered by the volume
+	 */
+	void SetBoundingBox(const D3DXVECTOR3& vBBMin, const D3DXVECTOR3& vBBMax);
+	const D3DXVECTOR3& GetBBMin() const { return m_vBBMin; }
+	const D3DXVECTOR3& GetBBMax() const { return m_vBBMax; }
+
+	/*
+	 *  Transforms a point from world space into voxel coordinates
+	 */
+	D3DXVECTOR3 WorldToVoxel(const D3DXVECTOR3& vPosition) const;
+
+	int GetWidth() const { return m_iWidth; }
+	int GetHeight() const { return m_iHeight; }
+	int GetDepth() const { return m_iDepth; }
+	unsigned int GetNumVoxels() const { return (unsigned int)m_vColors.size(); }
+
+	unsigned int GetIndex(int x, int y, int z) const { return ((unsigned int)z * m_iHeight + y) * m_iWidth + x; }
+
+	D3DXVECTOR4* GetColors() { return m_vColors.empty() ? NULL : &m_vColors[0]; }
+	const D3DXVECTOR4* GetColors() const { return m_vColors.empty() ? NULL : &m_vColors[0]; }
+	float* GetDistances() { return m_vDistances.empty() ? NULL : &m_vDistances[0]; }
+	const float* GetDistances() const { return m_vDistances.empty() ? NULL : &m_vDistances[0]; }
+
+	/*
+	 *  Exchanges the colors with a buffer of the same size, used to ping-pong without a copy
+	 */
+	void SwapColors(std::vector<D3DXVECTOR4>& vColors) { m_vColors.swap(vColors); }
+
+	/*
+	 *  Size of the allocated voxels in bytes
+	 */
+	unsigned __int64 GetMemorySize() const;
+
+protected:
+	int m_iWidth;
+	int m_iHeight;
+	int m_iDepth;
+
+	D3DXVECTOR3 m_vBBMin;
+	D3DXVECTOR3 m_vBBMax;
+
+	std::vector<D3DXVECTOR4> m_vColors;
+	std::vector<float> m_vDistances;
+
+private:
+	CPUVolume(const CPUVolume&);
+	CPUVolume& operator=(const CPUVolume&);
+};
+
+#endif
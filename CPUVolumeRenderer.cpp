@@ -0,0 +1,526 @@
+#include "CPUVolumeRenderer.h"
+#include "ThreadPool.h"
+#include <FreeImage.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <new>
+#include <float.h>
+#include <limits.h>
+
+//the image is split into square tiles of this size, every tile is one task of the thread pool
+#define RAYCAST_TILE_SIZE 16
+
+//direction components below this are clamped, so the slab test does not divide by zero
+#define RAYCAST_MIN_DIRECTION 1e-8f
+
+//edge length of the bricks of the occupancy grid in voxels, same as in VolumeRenderer
+#define RAYCAST_BRICK_SIZE 8
+
+
+/****************************************************************************
+ ****************************************************************************/
+static inline __m128 ItlFloor(__m128 v)
+{
+	//sse2 only truncates, correct the negative values that were rounded up
+	__m128 vTrunc = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+	return _mm_sub_ps(vTrunc, _mm_and_ps(_mm_cmpgt_ps(vTrunc, v), _mm_set1_ps(1.0f)));
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static inline __m128 ItlClampDirection(__m128 v)
+{
+	__m128 vMin = _mm_set1_ps(RAYCAST_MIN_DIRECTION);
+	__m128 vAbs = _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	__m128 vSmall = _mm_cmplt_ps(vAbs, vMin);
+	return _mm_or_ps(_mm_and_ps(vSmall, vMin), _mm_andnot_ps(vSmall, v));
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static inline __m128 ItlLoadVoxel(const D3DXVECTOR4* pColors, int x, int y, int z, int iWidth, int iHeight, int iDepth)
+{
+	//border addressing with a transparent border color, like the samplers of VolumeRenderer.fx
+	if((unsigned int)x >= (unsigned int)iWidth || (unsigned int)y >= (unsigned int)iHeight || (unsigned int)z >= (unsigned int)iDepth)
+		return _mm_setzero_ps();
+	return _mm_loadu_ps(&pColors[((unsigned int)z * iHeight + y) * iWidth + x].x);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static inline __m128 ItlLerp(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+
+/****************************************************************************
+ ****************************************************************************/
+CPUVolumeRenderer::CPUVolumeRenderer()
+{
+	m_iImageWidth = 0;
+	m_iImageHeight = 0;
+
+	m_bLinearSampling = true;
+	m_bShowIsoSurface = false;
+	m_bShowIsoColor = false;
+	m_fIsoValue = 0.5f;
+	m_bSkipEmptySpace = true;
+	m_iGridWidth = 0;
+	m_iGridHeight = 0;
+	m_iGridDepth = 0;
+	m_cBackground = D3DXCOLOR(0.0f, 0.0f, 0.0f, 1.0f);
+
+	//camera of the viewer
+	SetCamera(D3DXVECTOR3(0.0f, 0.0f, -40.0f), D3DXVECTOR3(0.0f, 0.0f, 0.0f), D3DXVECTOR3(0.0f, 1.0f, 0.0f), D3DX_PI / 4);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUVolumeRenderer::SetImageSize(int iWidth, int iHeight)
+{
+	if(iWidth <= 0 || iHeight <= 0)
+		return E_INVALIDARG;
+
+	try
+	{
+		m_vPixels.resize((size_t)iWidth * iHeight * 4);
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	m_iImageWidth = iWidth;
+	m_iImageHeight = iHeight;
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::SetCamera(const D3DXVECTOR3& vEye, const D3DXVECTOR3& vLookAt, const D3DXVECTOR3& vUp, float fFovY)
+{
+	m_vEye = vEye;
+	m_fFovY = fFovY;
+
+	//same basis as D3DXMatrixLookAtLH
+	D3DXVECTOR3 vForward = vLookAt - vEye;
+	D3DXVec3Normalize(&m_vForward, &vForward);
+	D3DXVec3Cross(&m_vRight, &vUp, &m_vForward);
+	D3DXVec3Normalize(&m_vRight, &m_vRight);
+	D3DXVec3Cross(&m_vUp, &m_vForward, &m_vRight);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::ShowIsoSurface(bool bShow, float fIsoValue, bool bShowIsoColor)
+{
+	m_bShowIsoSurface = bShow;
+	m_fIsoValue = fIsoValue;
+	m_bShowIsoColor = bShowIsoColor;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::Release()
+{
+	std::vector<unsigned char>().swap(m_vPixels);
+	std::vector<D3DXVECTOR4>().swap(m_vIsoColors);
+	std::vector<float>().swap(m_vOccupancy);
+	m_iImageWidth = 0;
+	m_iImageHeight = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUVolumeRenderer::Render(const CPUVolume* pVolume)
+{
+	if(m_vPixels.empty() || pVolume->GetNumVoxels() == 0)
+		return E_INVALIDARG;
+
+	const D3DXVECTOR4* pColors = pVolume->GetColors();
+	if(m_bShowIsoSurface)
+	{
+		try
+		{
+			m_vIsoColors.resize(pVolume->GetNumVoxels());
+		}
+		catch(std::bad_alloc&)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		ItlRenderIsoSurface(pVolume);
+		pColors = &m_vIsoColors[0];
+	}
+
+	if(m_bSkipEmptySpace)
+	{
+		m_iGridWidth = (pVolume->GetWidth() + RAYCAST_BRICK_SIZE - 1) / RAYCAST_BRICK_SIZE;
+		m_iGridHeight = (pVolume->GetHeight() + RAYCAST_BRICK_SIZE - 1) / RAYCAST_BRICK_SIZE;
+		m_iGridDepth = (pVolume->GetDepth() + RAYCAST_BRICK_SIZE - 1) / RAYCAST_BRICK_SIZE;
+
+		try
+		{
+			m_vOccupancy.resize((size_t)m_iGridWidth * m_iGridHeight * m_iGridDepth);
+		}
+		catch(std::bad_alloc&)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		ItlBuildOccupancyGrid(pVolume, pColors);
+	}
+
+	int iNumTilesX = (m_iImageWidth + RAYCAST_TILE_SIZE - 1) / RAYCAST_TILE_SIZE;
+	int iNumTilesY = (m_iImageHeight + RAYCAST_TILE_SIZE - 1) / RAYCAST_TILE_SIZE;
+
+	ThreadPool::GetInstance()->ParallelFor(0, iNumTilesX * iNumTilesY, 1, [&](int iBegin, int iEnd)
+	{
+		for(int iTile = iBegin; iTile < iEnd; iTile++)
+			ItlRenderTile(pVolume, pColors, iTile);
+	});
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::ItlRenderIsoSurface(const CPUVolume* pVolume)
+{
+	int iSliceSize = pVolume->GetWidth() * pVolume->GetHeight();
+	const D3DXVECTOR4* pSource = pVolume->GetColors();
+	D3DXVECTOR4* pDest = &m_vIsoColors[0];
+
+	ThreadPool::GetInstance()->ParallelFor(0, pVolume->GetDepth(), 1, [&](int iBegin, int iEnd)
+	{
+		for(unsigned int nIndex = (unsigned int)iBegin * iSliceSize; nIndex < (unsigned int)iEnd * iSliceSize; nIndex++)
+		{
+			//same as IsoSurfacePS
+			if(pSource[nIndex].w >= m_fIsoValue)
+			{
+				pDest[nIndex] = m_bShowIsoColor ? pSource[nIndex] : D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+				pDest[nIndex].w = 1.0f;
+			}
+			else
+				pDest[nIndex] = D3DXVECTOR4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::ItlBuildOccupancyGrid(const CPUVolume* pVolume, const D3DXVECTOR4* pColors)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iDepth = pVolume->GetDepth();
+
+	ThreadPool::GetInstance()->ParallelFor(0, m_iGridDepth, 1, [&](int iBegin, int iEnd)
+	{
+		__m128 vSignMask = _mm_set1_ps(-0.0f);
+
+		for(int bz = iBegin; bz < iEnd; bz++)
+		{
+			for(int by = 0; by < m_iGridHeight; by++)
+			{
+				for(int bx = 0; bx < m_iGridWidth; bx++)
+				{
+					//the brick is enlarged by one voxel, so the linear sampling never reads a voxel of another brick
+					int x0 = max(0, bx * RAYCAST_BRICK_SIZE - 1), x1 = min(iWidth, (bx + 1) * RAYCAST_BRICK_SIZE + 1);
+					int y0 = max(0, by * RAYCAST_BRICK_SIZE - 1), y1 = min(iHeight, (by + 1) * RAYCAST_BRICK_SIZE + 1);
+					int z0 = max(0, bz * RAYCAST_BRICK_SIZE - 1), z1 = min(iDepth, (bz + 1) * RAYCAST_BRICK_SIZE + 1);
+
+					//the colors are added up along the rays, so a brick is only empty if all channels are zero
+					__m128 vMax = _mm_setzero_ps();
+					for(int z = z0; z < z1; z++)
+					{
+						for(int y = y0; y < y1; y++)
+						{
+							const D3DXVECTOR4* pRow = &pColors[((unsigned int)z * iHeight + y) * iWidth];
+							for(int x = x0; x < x1; x++)
+								vMax = _mm_max_ps(vMax, _mm_andnot_ps(vSignMask, _mm_loadu_ps(&pRow[x].x)));
+						}
+					}
+
+					vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(1, 0, 3, 2)));
+					vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(2, 3, 0, 1)));
+					m_vOccupancy[((size_t)bz * m_iGridHeight + by) * m_iGridWidth + bx] = _mm_cvtss_f32(vMax);
+				}
+			}
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int CPUVolumeRenderer::ItlGetEmptyBrickSteps(int x, int y, int z, const float pVoxel[3], const float pStep[3]) const
+{
+	//positions just outside of the volume use the border bricks, the linear sampling still reads the border voxels there
+	int pBrick[3];
+	pBrick[0] = max(0, min(m_iGridWidth - 1, (x >= 0 ? x : x - RAYCAST_BRICK_SIZE + 1) / RAYCAST_BRICK_SIZE));
+	pBrick[1] = max(0, min(m_iGridHeight - 1, (y >= 0 ? y : y - RAYCAST_BRICK_SIZE + 1) / RAYCAST_BRICK_SIZE));
+	pBrick[2] = max(0, min(m_iGridDepth - 1, (z >= 0 ? z : z - RAYCAST_BRICK_SIZE + 1) / RAYCAST_BRICK_SIZE));
+
+	if(m_vOccupancy[((size_t)pBrick[2] * m_iGridHeight + pBrick[1]) * m_iGridWidth + pBrick[0]] > 0.0f)
+		return 0;
+
+	//the ray continues at the first step outside of the brick, so the sample positions do not change
+	float fMinSteps = FLT_MAX;
+	for(int i = 0; i < 3; i++)
+	{
+		if(fabsf(pStep[i]) < RAYCAST_MIN_DIRECTION)
+			continue;
+
+		float fBrickMin = float(pBrick[i] * RAYCAST_BRICK_SIZE);
+		float fExit = pStep[i] > 0.0f ? fBrickMin + RAYCAST_BRICK_SIZE : fBrickMin;
+		fMinSteps = min(fMinSteps, (fExit - pVoxel[i]) / pStep[i]);
+	}
+
+	return max(1, (int)ceilf(min(fMinSteps, float(INT_MAX / 2))));
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVolumeRenderer::ItlRenderTile(const CPUVolume* pVolume, const D3DXVECTOR4* pColors, int iTile)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iDepth = pVolume->GetDepth();
+
+	//the rays are traced in normalized box coordinates like the front and back textures of VolumeRenderer.
+	//the step size and the number of iterations are the ones of VolumeRenderer::Update.
+	int iMaxSize = max(iWidth, max(iHeight, iDepth));
+	__m128 vNumIterations = _mm_set1_ps(float(iMaxSize * 2));
+	__m128 vStepSize = _mm_set1_ps(1.0f / float(iMaxSize));
+
+	D3DXVECTOR3 vExtent = pVolume->GetBBMax() - pVolume->GetBBMin();
+	D3DXVECTOR3 vInvExtent(1.0f / vExtent.x, 1.0f / vExtent.y, 1.0f / vExtent.z);
+	D3DXVECTOR3 vOrigin = m_vEye - pVolume->GetBBMin();
+
+	__m128 vOriginX = _mm_set1_ps(vOrigin.x * vInvExtent.x);
+	__m128 vOriginY = _mm_set1_ps(vOrigin.y * vInvExtent.y);
+	__m128 vOriginZ = _mm_set1_ps(vOrigin.z * vInvExtent.z);
+
+	//the volume has its first row at the bottom, so the y flip of PS_RAYCAST is not needed
+	__m128 vSizeX = _mm_set1_ps(float(iWidth));
+	__m128 vSizeY = _mm_set1_ps(float(iHeight));
+	__m128 vSizeZ = _mm_set1_ps(float(iDepth));
+	__m128 vHalf = _mm_set1_ps(m_bLinearSampling ? 0.5f : 0.0f);
+	__m128 vZero = _mm_setzero_ps();
+	__m128 vOne = _mm_set1_ps(1.0f);
+
+	float fTanY = tanf(0.5f * m_fFovY);
+	float fTanX = fTanY * float(m_iImageWidth) / float(m_iImageHeight);
+
+	__m128 vBackground = _mm_set_ps(m_cBackground.a, m_cBackground.b, m_cBackground.g, m_cBackground.r);
+	__m128 v255 = _mm_set1_ps(255.0f);
+
+	int iNumTilesX = (m_iImageWidth + RAYCAST_TILE_SIZE - 1) / RAYCAST_TILE_SIZE;
+	int iTileX = (iTile % iNumTilesX) * RAYCAST_TILE_SIZE;
+	int iTileY = (iTile / iNumTilesX) * RAYCAST_TILE_SIZE;
+	int iTileEndX = min(m_iImageWidth, iTileX + RAYCAST_TILE_SIZE);
+	int iTileEndY = min(m_iImageHeight, iTileY + RAYCAST_TILE_SIZE);
+
+	for(int py = iTileY; py < iTileEndY; py += 2)
+	{
+		for(int px = iTileX; px < iTileEndX; px += 2)
+		{
+			//lanes of the packet: (px, py), (px+1, py), (px, py+1), (px+1, py+1)
+			int iValid = 0;
+			for(int iLane = 0; iLane < 4; iLane++)
+			{
+				if(px + (iLane & 1) < iTileEndX && py + (iLane >> 1) < iTileEndY)
+					iValid |= 1 << iLane;
+			}
+
+			//screen position of the pixel centers
+			__m128 vScreenX = _mm_set_ps(float(px + 1), float(px), float(px + 1), float(px));
+			__m128 vScreenY = _mm_set_ps(float(py + 1), float(py + 1), float(py), float(py));
+			vScreenX = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(vScreenX, _mm_set1_ps(0.5f)), _mm_set1_ps(2.0f / m_iImageWidth)), vOne), _mm_set1_ps(fTanX));
+			vScreenY = _mm_mul_ps(_mm_sub_ps(vOne, _mm_mul_ps(_mm_add_ps(vScreenY, _mm_set1_ps(0.5f)), _mm_set1_ps(2.0f / m_iImageHeight))), _mm_set1_ps(fTanY));
+
+			//direction in world space, then in box coordinates
+			__m128 vDirX = _mm_add_ps(_mm_set1_ps(m_vForward.x), _mm_add_ps(_mm_mul_ps(vScreenX, _mm_set1_ps(m_vRight.x)), _mm_mul_ps(vScreenY, _mm_set1_ps(m_vUp.x))));
+			__m128 vDirY = _mm_add_ps(_mm_set1_ps(m_vForward.y), _mm_add_ps(_mm_mul_ps(vScreenX, _mm_set1_ps(m_vRight.y)), _mm_mul_ps(vScreenY, _mm_set1_ps(m_vUp.y))));
+			__m128 vDirZ = _mm_add_ps(_mm_set1_ps(m_vForward.z), _mm_add_ps(_mm_mul_ps(vScreenX, _mm_set1_ps(m_vRight.z)), _mm_mul_ps(vScreenY, _mm_set1_ps(m_vUp.z))));
+			vDirX = _mm_mul_ps(vDirX, _mm_set1_ps(vInvExtent.x));
+			vDirY = _mm_mul_ps(vDirY, _mm_set1_ps(vInvExtent.y));
+			vDirZ = _mm_mul_ps(vDirZ, _mm_set1_ps(vInvExtent.z));
+
+			//PS_RAYCAST normalizes the direction in box coordinates
+			__m128 vInvLength = _mm_div_ps(vOne, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vDirX, vDirX), _mm_add_ps(_mm_mul_ps(vDirY, vDirY), _mm_mul_ps(vDirZ, vDirZ)))));
+			vDirX = ItlClampDirection(_mm_mul_ps(vDirX, vInvLength));
+			vDirY = ItlClampDirection(_mm_mul_ps(vDirY, vInvLength));
+			vDirZ = ItlClampDirection(_mm_mul_ps(vDirZ, vInvLength));
+
+			//slab test against the unit box replaces the front and back textures
+			__m128 vT0X = _mm_div_ps(_mm_sub_ps(vZero, vOriginX), vDirX);
+			__m128 vT1X = _mm_div_ps(_mm_sub_ps(vOne, vOriginX), vDirX);
+			__m128 vT0Y = _mm_div_ps(_mm_sub_ps(vZero, vOriginY), vDirY);
+			__m128 vT1Y = _mm_div_ps(_mm_sub_ps(vOne, vOriginY), vDirY);
+			__m128 vT0Z = _mm_div_ps(_mm_sub_ps(vZero, vOriginZ), vDirZ);
+			__m128 vT1Z = _mm_div_ps(_mm_sub_ps(vOne, vOriginZ), vDirZ);
+
+			__m128 vNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(vT0X, vT1X), _mm_min_ps(vT0Y, vT1Y)), _mm_max_ps(_mm_min_ps(vT0Z, vT1Z), vZero));
+			__m128 vFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(vT0X, vT1X), _mm_max_ps(vT0Y, vT1Y)), _mm_max_ps(vT0Z, vT1Z));
+
+			int iActive = iValid & _mm_movemask_ps(_mm_cmplt_ps(vNear, vFar));
+
+			__m128 pAccum[4] = { vZero, vZero, vZero, vZero };
+
+			//every lane counts its steps, the empty space skipping lets them advance differently.
+			//the position is always computed from the step count, so it does not depend on the skipping.
+			float pSteps[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			//step along the ray in voxels
+			float pStepX[4], pStepY[4], pStepZ[4];
+			_mm_storeu_ps(pStepX, _mm_mul_ps(_mm_mul_ps(vDirX, vStepSize), vSizeX));
+			_mm_storeu_ps(pStepY, _mm_mul_ps(_mm_mul_ps(vDirY, vStepSize), vSizeY));
+			_mm_storeu_ps(pStepZ, _mm_mul_ps(_mm_mul_ps(vDirZ, vStepSize), vSizeZ));
+
+			while(iActive != 0)
+			{
+				__m128 vT = _mm_add_ps(vNear, _mm_mul_ps(_mm_loadu_ps(pSteps), vStepSize));
+
+				//rays that left the box or used up their iterations are done
+				iActive &= _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(vT, vFar), _mm_cmplt_ps(_mm_loadu_ps(pSteps), vNumIterations)));
+				if(iActive == 0)
+					break;
+
+				//voxel coordinates, linear sampling is relative to the voxel centers
+				__m128 vVoxelX = _mm_mul_ps(_mm_add_ps(vOriginX, _mm_mul_ps(vDirX, vT)), vSizeX);
+				__m128 vVoxelY = _mm_mul_ps(_mm_add_ps(vOriginY, _mm_mul_ps(vDirY, vT)), vSizeY);
+				__m128 vVoxelZ = _mm_mul_ps(_mm_add_ps(vOriginZ, _mm_mul_ps(vDirZ, vT)), vSizeZ);
+				__m128 vCoordX = _mm_sub_ps(vVoxelX, vHalf);
+				__m128 vCoordY = _mm_sub_ps(vVoxelY, vHalf);
+				__m128 vCoordZ = _mm_sub_ps(vVoxelZ, vHalf);
+
+				__m128 vFloorX = ItlFloor(vCoordX);
+				__m128 vFloorY = ItlFloor(vCoordY);
+				__m128 vFloorZ = ItlFloor(vCoordZ);
+
+				int pX[4], pY[4], pZ[4];
+				_mm_storeu_si128((__m128i*)pX, _mm_cvttps_epi32(vFloorX));
+				_mm_storeu_si128((__m128i*)pY, _mm_cvttps_epi32(vFloorY));
+				_mm_storeu_si128((__m128i*)pZ, _mm_cvttps_epi32(vFloorZ));
+
+				float pFracX[4], pFracY[4], pFracZ[4];
+				_mm_storeu_ps(pFracX, _mm_sub_ps(vCoordX, vFloorX));
+				_mm_storeu_ps(pFracY, _mm_sub_ps(vCoordY, vFloorY));
+				_mm_storeu_ps(pFracZ, _mm_sub_ps(vCoordZ, vFloorZ));
+
+				int pVoxelX[4], pVoxelY[4], pVoxelZ[4];
+				float pPosX[4], pPosY[4], pPosZ[4];
+				if(m_bSkipEmptySpace)
+				{
+					_mm_storeu_si128((__m128i*)pVoxelX, _mm_cvttps_epi32(ItlFloor(vVoxelX)));
+					_mm_storeu_si128((__m128i*)pVoxelY, _mm_cvttps_epi32(ItlFloor(vVoxelY)));
+					_mm_storeu_si128((__m128i*)pVoxelZ, _mm_cvttps_epi32(ItlFloor(vVoxelZ)));
+					_mm_storeu_ps(pPosX, vVoxelX);
+					_mm_storeu_ps(pPosY, vVoxelY);
+					_mm_storeu_ps(pPosZ, vVoxelZ);
+				}
+
+				for(int iLane = 0; iLane < 4; iLane++)
+				{
+					if((iActive & (1 << iLane)) == 0)
+						continue;
+
+					if(m_bSkipEmptySpace)
+					{
+						float pPosition[3] = { pPosX[iLane], pPosY[iLane], pPosZ[iLane] };
+						float pStep[3] = { pStepX[iLane], pStepY[iLane], pStepZ[iLane] };
+						int iSkip = ItlGetEmptyBrickSteps(pVoxelX[iLane], pVoxelY[iLane], pVoxelZ[iLane], pPosition, pStep);
+						if(iSkip > 0)
+						{
+							pSteps[iLane] += float(iSkip);
+							continue;
+						}
+					}
+
+					int x = pX[iLane], y = pY[iLane], z = pZ[iLane];
+					__m128 vSample = ItlLoadVoxel(pColors, x, y, z, iWidth, iHeight, iDepth);
+
+					if(m_bLinearSampling)
+					{
+						__m128 vFracX = _mm_set1_ps(pFracX[iLane]);
+						__m128 vFracY = _mm_set1_ps(pFracY[iLane]);
+						__m128 vFracZ = _mm_set1_ps(pFracZ[iLane]);
+
+						__m128 v00 = ItlLerp(vSample, ItlLoadVoxel(pColors, x + 1, y, z, iWidth, iHeight, iDepth), vFracX);
+						__m128 v10 = ItlLerp(ItlLoadVoxel(pColors, x, y + 1, z, iWidth, iHeight, iDepth), ItlLoadVoxel(pColors, x + 1, y + 1, z, iWidth, iHeight, iDepth), vFracX);
+						__m128 v01 = ItlLerp(ItlLoadVoxel(pColors, x, y, z + 1, iWidth, iHeight, iDepth), ItlLoadVoxel(pColors, x + 1, y, z + 1, iWidth, iHeight, iDepth), vFracX);
+						__m128 v11 = ItlLerp(ItlLoadVoxel(pColors, x, y + 1, z + 1, iWidth, iHeight, iDepth), ItlLoadVoxel(pColors, x + 1, y + 1, z + 1, iWidth, iHeight, iDepth), vFracX);
+						vSample = ItlLerp(ItlLerp(v00, v10, vFracY), ItlLerp(v01, v11, vFracY), vFracZ);
+					}
+
+					pAccum[iLane] = _mm_add_ps(pAccum[iLane], vSample);
+					pSteps[iLane] += 1.0f;
+
+					//early ray termination, a saturated ray is normalized. the division also sets the alpha to 1.
+					__m128 vAlpha = _mm_shuffle_ps(pAccum[iLane], pAccum[iLane], _MM_SHUFFLE(3, 3, 3, 3));
+					if(_mm_comige_ss(vAlpha, vOne))
+					{
+						pAccum[iLane] = _mm_div_ps(pAccum[iLane], vAlpha);
+						iActive &= ~(1 << iLane);
+					}
+				}
+			}
+
+			//AlphaBlending over the background and conversion to 8 bit
+			for(int iLane = 0; iLane < 4; iLane++)
+			{
+				if((iValid & (1 << iLane)) == 0)
+					continue;
+
+				__m128 vAlpha = _mm_shuffle_ps(pAccum[iLane], pAccum[iLane], _MM_SHUFFLE(3, 3, 3, 3));
+				__m128 vColor = _mm_add_ps(_mm_mul_ps(pAccum[iLane], vAlpha), _mm_mul_ps(vBackground, _mm_sub_ps(vOne, vAlpha)));
+
+				__m128i vInt = _mm_cvtps_epi32(_mm_mul_ps(vColor, v255));
+				vInt = _mm_packs_epi32(vInt, vInt);
+				vInt = _mm_packus_epi16(vInt, vInt);
+
+				int iPixel = _mm_cvtsi128_si32(vInt);
+				memcpy(&m_vPixels[((size_t)(py + (iLane >> 1)) * m_iImageWidth + px + (iLane & 1)) * 4], &iPixel, 4);
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUVolumeRenderer::SavePNG(const std::string& strFileName) const
+{
+	if(m_vPixels.empty())
+		return E_FAIL;
+
+	FIBITMAP* pBitmap = FreeImage_Allocate(m_iImageWidth, m_iImageHeight, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(pBitmap == NULL)
+		return E_OUTOFMEMORY;
+
+	//freeimage stores the bottom row first and uses its own channel order
+	for(int y = 0; y < m_iImageHeight; y++)
+	{
+		BYTE* pScanLine = FreeImage_GetScanLine(pBitmap, m_iImageHeight - 1 - y);
+		const unsigned char* pSource = &m_vPixels[(size_t)y * m_iImageWidth * 4];
+		for(int x = 0; x < m_iImageWidth; x++)
+		{
+			pScanLine[FI_RGBA_RED] = pSource[0];
+			pScanLine[FI_RGBA_GREEN] = pSource[1];
+			pScanLine[FI_RGBA_BLUE] = pSource[2];
+			pScanLine[FI_RGBA_ALPHA] = pSource[3];
+			pScanLine += 4;
+			pSource += 4;
+		}
+	}
+
+	BOOL bSaved = FreeImage_Save(FIF_PNG, pBitmap, strFileName.c_str(), PNG_DEFAULT);
+	FreeImage_Unload(pBitmap);
+
+	return bSaved ? S_OK : E_FAIL;
+}
@@ -0,0 +1,122 @@
+#ifndef _CPUVOLUMERENDERER_H_
+#define _CPUVOLUMERENDERER_H_
+
+#include "Globals.h"
+#include "CPUVolume.h"
+#include <vector>
+
+/*
+ *  Headless ray caster for a CPUVolume, used to render previews without a device.
+ *	The transfer is the same as in PS_RAYCAST: the samples are added up until the alpha
+ *	reaches 1, the result is blended over the background like the AlphaBlending state.
+ *	Rays are traced in packets of 2x2 pixels with SSE, the tiles of the image are rendered
+ *	in parallel by the thread pool.
+ */
+class CPUVolumeRenderer
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	CPUVolumeRenderer();
+
+	/*
+	 *  Size of the rendered image in pixels
+	 */
+	HRESULT SetImageSize(int iWidth, int iHeight);
+	int GetImageWidth() const { return m_iImageWidth; }
+	int GetImageHeight() const { return m_iImageHeight; }
+
+	/*
+	 *  Perspective camera in world space (left handed like the viewer), fFovY in radians
+	 */
+	void SetCamera(const D3DXVECTOR3& vEye, const D3DXVECTOR3& vLookAt, const D3DXVECTOR3& vUp, float fFovY);
+
+	/*
+	 *  Linear or point sampling of the volume, like VolumeRenderer::ChangeSampling
+	 */
+	void SetLinearSampling(bool bLinearSampling) { m_bLinearSampling = bLinearSampling; }
+
+	/*
+	 *  Renders the iso surface of the volume instead of the colors, like Diffusion::RenderIsoSurface
+	 */
+	void ShowIsoSurface(bool bShow, float fIsoValue, bool bShowIsoColor);
+
+	/*
+	 *  Skips completely transparent bricks of the volume, like VolumeRenderer::SetEmptySpaceSkipping
+	 */
+	void SetEmptySpaceSkipping(bool bSkip) { m_bSkipEmptySpace = bSkip; }
+
+	/*
+	 *  Color the rays are blended over, the viewer clears to opaque black
+	 */
+	void SetBackgroundColor(const D3DXCOLOR& cBackground) { m_cBackground = cBackground; }
+
+	/*
+	 *  Renders the volume into the image
+	 */
+	HRESULT Render(const CPUVolume* pVolume);
+
+	/*
+	 *  RGBA pixels of the image, the first row is the top of the image
+	 */
+	const unsigned char* GetPixels() const { return m_vPixels.empty() ? NULL : &m_vPixels[0]; }
+
+	/*
+	 *  Saves the image as 32 bit PNG with FreeImage
+	 */
+	HRESULT SavePNG(const std::string& strFileName) const;
+
+	/*
+	 *  Frees the image and the iso surface buffer
+	 */
+	void Release();
+
+protected:
+	/*
+	 *  Fills m_vIsoColors with the iso surface of the volume
+	 */
+	void ItlRenderIsoSurface(const CPUVolume* pVolume);
+
+	/*
+	 *  Fills m_vOccupancy with the maximum of every brick of the rendered colors
+	 */
+	void ItlBuildOccupancyGrid(const CPUVolume* pVolume, const D3DXVECTOR4* pColors);
+
+	/*
+	 *  Number of steps until the ray leaves the brick of the position, 0 if the brick is not empty
+	 */
+	int ItlGetEmptyBrickSteps(int x, int y, int z, const float pVoxel[3], const float pStep[3]) const;
+
+	/*
+	 *  Traces all packets of one tile
+	 */
+	void ItlRenderTile(const CPUVolume* pVolume, const D3DXVECTOR4* pColors, int iTile);
+
+	int m_iImageWidth;
+	int m_iImageHeight;
+
+	D3DXVECTOR3 m_vEye;
+	D3DXVECTOR3 m_vForward;
+	D3DXVECTOR3 m_vRight;
+	D3DXVECTOR3 m_vUp;
+	float m_fFovY;
+
+	bool m_bLinearSampling;
+	bool m_bShowIsoSurface;
+	bool m_bShowIsoColor;
+	float m_fIsoValue;
+	bool m_bSkipEmptySpace;
+	D3DXCOLOR m_cBackground;
+
+	std::vector<unsigned char> m_vPixels;
+	std::vector<D3DXVECTOR4> m_vIsoColors;
+
+	//occupancy grid, one value per brick of the volume
+	std::vector<float> m_vOccupancy;
+	int m_iGridWidth;
+	int m_iGridHeight;
+	int m_iGridDepth;
+};
+
+#endif
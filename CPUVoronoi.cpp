@@ -0,0 +1,567 @@
+#include "CPUVoronoi.h"
+#include "ThreadPool.h"
+#include <new>
+#include <float.h>
+
+//voxels with a center closer than half the voxel diagonal to a triangle are seeded
+#define CPUVORONOI_SEED_RADIUS 0.8660254f
+
+//edge length of the tiles the triangles are binned into
+#define CPUVORONOI_TILE_SIZE 16
+
+
+/****************************************************************************
+ ****************************************************************************/
+CPUVoronoi::CPUVoronoi()
+{
+	m_iTilesX = 0;
+	m_iTilesY = 0;
+	m_iTilesZ = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVoronoi::Release()
+{
+	std::vector<VORONOI_SEED>().swap(m_vSeeds);
+	std::vector<int>().swap(m_vNearest[0]);
+	std::vector<int>().swap(m_vNearest[1]);
+	std::vector<VORONOI_TRIANGLE>().swap(m_vTriangles);
+	std::vector<unsigned int>().swap(m_vTileTriangles);
+	std::vector<unsigned int>().swap(m_vTileOffsets);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned __int64 CPUVoronoi::GetMemorySize() const
+{
+	return (unsigned __int64)m_vSeeds.capacity() * sizeof(VORONOI_SEED)
+		 + (unsigned __int64)(m_vNearest[0].capacity() + m_vNearest[1].capacity()) * sizeof(int)
+		 + (unsigned __int64)m_vTriangles.capacity() * sizeof(VORONOI_TRIANGLE)
+		 + (unsigned __int64)(m_vTileTriangles.capacity() + m_vTileOffsets.capacity()) * sizeof(unsigned int);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT CPUVoronoi::Compute(const std::vector<CPU_SURFACE>& vSurfaces, CPUVolume* pVolume)
+{
+	unsigned int nNumVoxels = pVolume->GetNumVoxels();
+	if(nNumVoxels == 0)
+		return E_INVALIDARG;
+
+	m_vSeeds.clear();
+
+	int iNumTiles = 0;
+	std::vector<std::vector<VORONOI_SEED>> vTileSeeds;
+	std::vector<std::vector<unsigned int>> vTileVoxels;
+	std::vector<unsigned int> vSeedOffsets;
+
+	try
+	{
+		m_vNearest[0].assign(nNumVoxels, -1);
+		m_vNearest[1].resize(nNumVoxels);
+
+		ItlBinTriangles(vSurfaces, pVolume);
+		iNumTiles = m_iTilesX * m_iTilesY * m_iTilesZ;
+		vTileSeeds.resize(iNumTiles);
+		vTileVoxels.resize(iNumTiles);
+		vSeedOffsets.resize(iNumTiles + 1);
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	//seed the voxels at the surfaces, the voxels of a tile are only written by the thread of the tile
+	ThreadPool::GetInstance()->ParallelFor(0, iNumTiles, 1, [&](int iBegin, int iEnd)
+	{
+		for(int iTile = iBegin; iTile < iEnd; iTile++)
+			ItlSeedTile(iTile, pVolume, vTileSeeds[iTile], vTileVoxels[iTile]);
+	});
+
+	//concatenate the seeds in the order of the tiles
+	vSeedOffsets[0] = 0;
+	for(int iTile = 0; iTile < iNumTiles; iTile++)
+		vSeedOffsets[iTile + 1] = vSeedOffsets[iTile] + (unsigned int)vTileSeeds[iTile].size();
+
+	try
+	{
+		m_vSeeds.resize(vSeedOffsets.back());
+	}
+	catch(std::bad_alloc&)
+	{
+		Release();
+		return E_OUTOFMEMORY;
+	}
+
+	int* pNearest = &m_vNearest[0][0];
+	ThreadPool::GetInstance()->ParallelFor(0, iNumTiles, 1, [&](int iBegin, int iEnd)
+	{
+		for(int iTile = iBegin; iTile < iEnd; iTile++)
+		{
+			unsigned int nOffset = vSeedOffsets[iTile];
+			for(unsigned int i = 0; i < vTileSeeds[iTile].size(); i++)
+				m_vSeeds[nOffset + i] = vTileSeeds[iTile][i];
+			for(unsigned int i = 0; i < vTileVoxels[iTile].size(); i++)
+				pNearest[vTileVoxels[iTile][i]] += nOffset;
+
+			std::vector<VORONOI_SEED>().swap(vTileSeeds[iTile]);
+			std::vector<unsigned int>().swap(vTileVoxels[iTile]);
+		}
+	});
+
+	//propagate the seeds, the additional pass with step size one removes most of the errors of jump flooding
+	int iMaxDim = max(pVolume->GetWidth(), max(pVolume->GetHeight(), pVolume->GetDepth()));
+	int iStep = 1;
+	while(iStep * 2 < iMaxDim)
+		iStep *= 2;
+
+	int iSource = 0;
+	for(;; iStep /= 2)
+	{
+		ItlJumpFlood(max(1, iStep), &m_vNearest[iSource][0], &m_vNearest[1 - iSource][0], pVolume);
+		iSource = 1 - iSource;
+		if(iStep == 0)
+			break;
+	}
+
+	ItlResolve(&m_vNearest[iSource][0], pVolume);
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVoronoi::ItlBinTriangles(const std::vector<CPU_SURFACE>& vSurfaces, const CPUVolume* pVolume)
+{
+	m_iTilesX = (pVolume->GetWidth() + CPUVORONOI_TILE_SIZE - 1) / CPUVORONOI_TILE_SIZE;
+	m_iTilesY = (pVolume->GetHeight() + CPUVORONOI_TILE_SIZE - 1) / CPUVORONOI_TILE_SIZE;
+	m_iTilesZ = (pVolume->GetDepth() + CPUVORONOI_TILE_SIZE - 1) / CPUVORONOI_TILE_SIZE;
+	int iNumTiles = m_iTilesX * m_iTilesY * m_iTilesZ;
+
+	unsigned int nNumTriangles = 0;
+	for(unsigned int iSurface = 0; iSurface < vSurfaces.size(); iSurface++)
+		nNumTriangles += (unsigned int)vSurfaces[iSurface].pMesh->vTriangleIndices.size() / 3;
+	m_vTriangles.resize(nNumTriangles);
+
+	unsigned int nTriangle = 0;
+	for(unsigned int iSurface = 0; iSurface < vSurfaces.size(); iSurface++)
+	{
+		const CPU_SURFACE& surface = vSurfaces[iSurface];
+		const MESHDATA* pMesh = surface.pMesh;
+
+		std::vector<D3DXVECTOR3> vPositions(pMesh->vVertices.size());
+		for(unsigned int i = 0; i < vPositions.size(); i++)
+		{
+			D3DXVECTOR3 vWorld;
+			D3DXVec3TransformCoord(&vWorld, &pMesh->vVertices[i].pos, &surface.mModel);
+			vPositions[i] = pVolume->WorldToVoxel(vWorld);
+		}
+
+		for(unsigned int i = 0; i + 2 < pMesh->vTriangleIndices.size(); i += 3)
+		{
+			VORONOI_TRIANGLE& triangle = m_vTriangles[nTriangle++];
+			triangle.pSurface = &surface;
+			triangle.pIndices = &pMesh->vTriangleIndices[i];
+			for(int j = 0; j < 3; j++)
+				triangle.pPositions[j] = vPositions[triangle.pIndices[j]];
+		}
+	}
+
+	//the first pass counts the triangles of every tile, the second one stores them
+	std::vector<unsigned int> vNextTriangle;
+	m_vTileOffsets.assign(iNumTiles + 1, 0);
+
+	for(int iPass = 0; iPass < 2; iPass++)
+	{
+		for(unsigned int i = 0; i < nNumTriangles; i++)
+		{
+			int pStart[3], pEnd[3];
+			if(!ItlGetVoxelRange(m_vTriangles[i], pVolume, pStart, pEnd))
+				continue;
+
+			for(int z = pStart[2] / CPUVORONOI_TILE_SIZE; z <= pEnd[2] / CPUVORONOI_TILE_SIZE; z++)
+			{
+				for(int y = pStart[1] / CPUVORONOI_TILE_SIZE; y <= pEnd[1] / CPUVORONOI_TILE_SIZE; y++)
+				{
+					for(int x = pStart[0] / CPUVORONOI_TILE_SIZE; x <= pEnd[0] / CPUVORONOI_TILE_SIZE; x++)
+					{
+						int iTile = (z * m_iTilesY + y) * m_iTilesX + x;
+						if(iPass == 0)
+							m_vTileOffsets[iTile + 1]++;
+						else
+							m_vTileTriangles[vNextTriangle[iTile]++] = i;
+					}
+				}
+			}
+		}
+
+		if(iPass == 0)
+		{
+			for(int iTile = 0; iTile < iNumTiles; iTile++)
+				m_vTileOffsets[iTile + 1] += m_vTileOffsets[iTile];
+			m_vTileTriangles.resize(max(1u, m_vTileOffsets.back()));
+			vNextTriangle.assign(m_vTileOffsets.begin(), m_vTileOffsets.end() - 1);
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool CPUVoronoi::ItlGetVoxelRange(const VORONOI_TRIANGLE& triangle, const CPUVolume* pVolume, int pStart[3], int pEnd[3])
+{
+	D3DXVECTOR3 vMin, vMax;
+	D3DXVec3Minimize(&vMin, &triangle.pPositions[0], &triangle.pPositions[1]);
+	D3DXVec3Minimize(&vMin, &vMin, &triangle.pPositions[2]);
+	D3DXVec3Maximize(&vMax, &triangle.pPositions[0], &triangle.pPositions[1]);
+	D3DXVec3Maximize(&vMax, &vMax, &triangle.pPositions[2]);
+
+	//voxels with a center within the seed radius of the triangle bounds
+	int pSize[3] = { pVolume->GetWidth(), pVolume->GetHeight(), pVolume->GetDepth() };
+	for(int i = 0; i < 3; i++)
+	{
+		pStart[i] = max(0, (int)ceil(vMin[i] - CPUVORONOI_SEED_RADIUS - 0.5f));
+		pEnd[i] = min(pSize[i] - 1, (int)floor(vMax[i] + CPUVORONOI_SEED_RADIUS - 0.5f));
+		if(pStart[i] > pEnd[i])
+			return false;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVoronoi::ItlSeedTile(int iTile, const CPUVolume* pVolume, std::vector<VORONOI_SEED>& vSeeds, std::vector<unsigned int>& vVoxels)
+{
+	int iTileX = (iTile % m_iTilesX) * CPUVORONOI_TILE_SIZE;
+	int iTileY = ((iTile / m_iTilesX) % m_iTilesY) * CPUVORONOI_TILE_SIZE;
+	int iTileZ = (iTile / (m_iTilesX * m_iTilesY)) * CPUVORONOI_TILE_SIZE;
+
+	int* pNearest = &m_vNearest[0][0];
+
+	for(unsigned int iEntry = m_vTileOffsets[iTile]; iEntry < m_vTileOffsets[iTile + 1]; iEntry++)
+	{
+		const VORONOI_TRIANGLE& triangle = m_vTriangles[m_vTileTriangles[iEntry]];
+		const D3DXVECTOR3& a = triangle.pPositions[0];
+		const D3DXVECTOR3& b = triangle.pPositions[1];
+		const D3DXVECTOR3& c = triangle.pPositions[2];
+		const CPU_SURFACE& surface = *triangle.pSurface;
+		const SURFACE_VERTEX* pVertices = &surface.pMesh->vVertices[0];
+		const unsigned int* pIndices = triangle.pIndices;
+
+		int pStart[3], pEnd[3];
+		ItlGetVoxelRange(triangle, pVolume, pStart, pEnd);
+		int iStartX = max(iTileX, pStart[0]), iEndX = min(iTileX + CPUVORONOI_TILE_SIZE - 1, pEnd[0]);
+		int iStartY = max(iTileY, pStart[1]), iEndY = min(iTileY + CPUVORONOI_TILE_SIZE - 1, pEnd[1]);
+		int iStartZ = max(iTileZ, pStart[2]), iEndZ = min(iTileZ + CPUVORONOI_TILE_SIZE - 1, pEnd[2]);
+
+		for(int z = iStartZ; z <= iEndZ; z++)
+		{
+			for(int y = iStartY; y <= iEndY; y++)
+			{
+				for(int x = iStartX; x <= iEndX; x++)
+				{
+					//the box test rejects most voxels of large triangles before the closest point is computed
+					D3DXVECTOR3 vCenter(x + 0.5f, y + 0.5f, z + 0.5f);
+					if(!ItlTriangleOverlapsBox(vCenter, CPUVORONOI_SEED_RADIUS, a, b, c))
+						continue;
+
+					D3DXVECTOR3 vBarycentric;
+					D3DXVECTOR3 vPoint = ItlClosestPointOnTriangle(vCenter, a, b, c, &vBarycentric);
+
+					D3DXVECTOR3 vDiff = vPoint - vCenter;
+					float fDist2 = D3DXVec3LengthSq(&vDiff);
+					if(fDist2 > CPUVORONOI_SEED_RADIUS * CPUVORONOI_SEED_RADIUS)
+						continue;
+
+					//keep the closest of all triangles, like the depth test of the gpu version
+					unsigned int nIndex = pVolume->GetIndex(x, y, z);
+					int& iSeed = pNearest[nIndex];
+					if(iSeed >= 0)
+					{
+						D3DXVECTOR3 vSeedDiff = vSeeds[iSeed].vPoint - vCenter;
+						if(D3DXVec3LengthSq(&vSeedDiff) <= fDist2)
+							continue;
+					}
+					else
+					{
+						iSeed = (int)vSeeds.size();
+						vSeeds.push_back(VORONOI_SEED());
+						vVoxels.push_back(nIndex);
+					}
+
+					VORONOI_SEED& seed = vSeeds[iSeed];
+					seed.vPoint = vPoint;
+
+					if(surface.pTexture != NULL)
+					{
+						D3DXVECTOR2 vTexcoord = vBarycentric.x * pVertices[pIndices[0]].texcoord
+											  + vBarycentric.y * pVertices[pIndices[1]].texcoord
+											  + vBarycentric.z * pVertices[pIndices[2]].texcoord;
+						seed.vColor = ItlSampleTexture(surface.pTexture, vTexcoord);
+					}
+					else
+					{
+						seed.vColor = vBarycentric.x * pVertices[pIndices[0]].color
+									+ vBarycentric.y * pVertices[pIndices[1]].color
+									+ vBarycentric.z * pVertices[pIndices[2]].color;
+					}
+					seed.vColor.w = surface.fIsoValue;
+				}
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool CPUVoronoi::ItlTriangleOverlapsBox(const D3DXVECTOR3& vCenter, float fHalfSize, const D3DXVECTOR3& a, const D3DXVECTOR3& b, const D3DXVECTOR3& c)
+{
+	//triangle relative to the center of the box
+	D3DXVECTOR3 v0 = a - vCenter;
+	D3DXVECTOR3 v1 = b - vCenter;
+	D3DXVECTOR3 v2 = c - vCenter;
+	D3DXVECTOR3 pEdges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+
+	//cross products of the edges with the axes of the box
+	for(int i = 0; i < 3; i++)
+	{
+		const D3DXVECTOR3& e = pEdges[i];
+		D3DXVECTOR3 pAxes[3] = { D3DXVECTOR3(0.0f, -e.z, e.y), D3DXVECTOR3(e.z, 0.0f, -e.x), D3DXVECTOR3(-e.y, e.x, 0.0f) };
+
+		for(int j = 0; j < 3; j++)
+		{
+			const D3DXVECTOR3& vAxis = pAxes[j];
+			float p0 = D3DXVec3Dot(&vAxis, &v0);
+			float p1 = D3DXVec3Dot(&vAxis, &v1);
+			float p2 = D3DXVec3Dot(&vAxis, &v2);
+			float fRadius = fHalfSize * (fabs(vAxis.x) + fabs(vAxis.y) + fabs(vAxis.z));
+			if(min(p0, min(p1, p2)) > fRadius || max(p0, max(p1, p2)) < -fRadius)
+				return false;
+		}
+	}
+
+	//axes of the box
+	for(int i = 0; i < 3; i++)
+	{
+		if(min(v0[i], min(v1[i], v2[i])) > fHalfSize || max(v0[i], max(v1[i], v2[i])) < -fHalfSize)
+			return false;
+	}
+
+	//plane of the triangle
+	D3DXVECTOR3 vNormal;
+	D3DXVec3Cross(&vNormal, &pEdges[0], &pEdges[1]);
+	float fRadius = fHalfSize * (fabs(vNormal.x) + fabs(vNormal.y) + fabs(vNormal.z));
+	return fabs(D3DXVec3Dot(&vNormal, &v0)) <= fRadius;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVoronoi::ItlJumpFlood(int iStep, const int* pSource, int* pDest, const CPUVolume* pVolume)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	int iDepth = pVolume->GetDepth();
+	const VORONOI_SEED* pSeeds = m_vSeeds.empty() ? NULL : &m_vSeeds[0];
+
+	ThreadPool::GetInstance()->ParallelFor(0, iDepth, 1, [&](int iBegin, int iEnd)
+	{
+		for(int z = iBegin; z < iEnd; z++)
+		{
+			for(int y = 0; y < iHeight; y++)
+			{
+				for(int x = 0; x < iWidth; x++)
+				{
+					D3DXVECTOR3 vCenter(x + 0.5f, y + 0.5f, z + 0.5f);
+					int iBest = -1;
+					float fBestDist2 = FLT_MAX;
+
+					for(int dz = -iStep; dz <= iStep; dz += iStep)
+					{
+						int nz = z + dz;
+						if(nz < 0 || nz >= iDepth)
+							continue;
+
+						for(int dy = -iStep; dy <= iStep; dy += iStep)
+						{
+							int ny = y + dy;
+							if(ny < 0 || ny >= iHeight)
+								continue;
+
+							for(int dx = -iStep; dx <= iStep; dx += iStep)
+							{
+								int nx = x + dx;
+								if(nx < 0 || nx >= iWidth)
+									continue;
+
+								int iSeed = pSource[(nz * iHeight + ny) * iWidth + nx];
+								if(iSeed < 0 || iSeed == iBest)
+									continue;
+
+								D3DXVECTOR3 vDiff = pSeeds[iSeed].vPoint - vCenter;
+								float fDist2 = D3DXVec3LengthSq(&vDiff);
+								if(fDist2 < fBestDist2)
+								{
+									fBestDist2 = fDist2;
+									iBest = iSeed;
+								}
+							}
+						}
+					}
+
+					pDest[(z * iHeight + y) * iWidth + x] = iBest;
+				}
+			}
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void CPUVoronoi::ItlResolve(const int* pNearest, CPUVolume* pVolume)
+{
+	int iWidth = pVolume->GetWidth();
+	int iHeight = pVolume->GetHeight();
+	D3DXVECTOR4* pColors = pVolume->GetColors();
+	float* pDistances = pVolume->GetDistances();
+	const VORONOI_SEED* pSeeds = m_vSeeds.empty() ? NULL : &m_vSeeds[0];
+
+	ThreadPool::GetInstance()->ParallelFor(0, pVolume->GetDepth(), 1, [&](int iBegin, int iEnd)
+	{
+		for(int z = iBegin; z < iEnd; z++)
+		{
+			for(int y = 0; y < iHeight; y++)
+			{
+				for(int x = 0; x < iWidth; x++)
+				{
+					unsigned int nIndex = (z * iHeight + y) * iWidth + x;
+					int iSeed = pNearest[nIndex];
+					if(iSeed < 0)
+					{
+						pColors[nIndex] = D3DXVECTOR4(0.0f, 0.0f, 0.0f, 0.0f);
+						pDistances[nIndex] = 0.0f;
+						continue;
+					}
+
+					D3DXVECTOR3 vDiff = pSeeds[iSeed].vPoint - D3DXVECTOR3(x + 0.5f, y + 0.5f, z + 0.5f);
+					pColors[nIndex] = pSeeds[iSeed].vColor;
+					pDistances[nIndex] = D3DXVec3Length(&vDiff);
+				}
+			}
+		}
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+D3DXVECTOR3 CPUVoronoi::ItlClosestPointOnTriangle(const D3DXVECTOR3& p, const D3DXVECTOR3& a, const D3DXVECTOR3& b, const D3DXVECTOR3& c, D3DXVECTOR3* pBarycentric)
+{
+	//voronoi regions of the triangle (Ericson, Real-Time Collision Detection, 5.1.5)
+	D3DXVECTOR3 ab = b - a;
+	D3DXVECTOR3 ac = c - a;
+	D3DXVECTOR3 ap = p - a;
+
+	float d1 = D3DXVec3Dot(&ab, &ap);
+	float d2 = D3DXVec3Dot(&ac, &ap);
+	if(d1 <= 0.0f && d2 <= 0.0f)
+	{
+		*pBarycentric = D3DXVECTOR3(1.0f, 0.0f, 0.0f);
+		return a;
+	}
+
+	D3DXVECTOR3 bp = p - b;
+	float d3 = D3DXVec3Dot(&ab, &bp);
+	float d4 = D3DXVec3Dot(&ac, &bp);
+	if(d3 >= 0.0f && d4 <= d3)
+	{
+		*pBarycentric = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+		return b;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		float v = d1 / (d1 - d3);
+		*pBarycentric = D3DXVECTOR3(1.0f - v, v, 0.0f);
+		return a + v * ab;
+	}
+
+	D3DXVECTOR3 cp = p - c;
+	float d5 = D3DXVec3Dot(&ab, &cp);
+	float d6 = D3DXVec3Dot(&ac, &cp);
+	if(d6 >= 0.0f && d5 <= d6)
+	{
+		*pBarycentric = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+		return c;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		float w = d2 / (d2 - d6);
+		*pBarycentric = D3DXVECTOR3(1.0f - w, 0.0f, w);
+		return a + w * ac;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		*pBarycentric = D3DXVECTOR3(0.0f, 1.0f - w, w);
+		return b + w * (c - b);
+	}
+
+	//inside the face, degenerated triangles end up at vertex a
+	float fDenom = va + vb + vc;
+	if(fabs(fDenom) < 1e-20f)
+	{
+		*pBarycentric = D3DXVECTOR3(1.0f, 0.0f, 0.0f);
+		return a;
+	}
+
+	float v = vb / fDenom;
+	float w = vc / fDenom;
+	*pBarycentric = D3DXVECTOR3(1.0f - v - w, v, w);
+	return a + v * ab + w * ac;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+D3DXVECTOR4 CPUVoronoi::ItlSampleTexture(const TEXTUREDATA* pTexture, const D3DXVECTOR2& vTexcoord)
+{
+	if(pTexture->nWidth == 0 || pTexture->nHeight == 0)
+		return D3DXVECTOR4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	int iWidth = (int)pTexture->nWidth;
+	int iHeight = (int)pTexture->nHeight;
+
+	float fX = min(1.0f, max(0.0f, vTexcoord.x)) * iWidth - 0.5f;
+	float fY = min(1.0f, max(0.0f, vTexcoord.y)) * iHeight - 0.5f;
+
+	int x0 = (int)floor(fX);
+	int y0 = (int)floor(fY);
+	float fFracX = fX - x0;
+	float fFracY = fY - y0;
+
+	int x1 = min(iWidth - 1, x0 + 1);
+	int y1 = min(iHeight - 1, y0 + 1);
+	x0 = max(0, x0);
+	y0 = max(0, y0);
+
+	const unsigned char* pPixels = &pTexture->vPixels[0];
+	const unsigned char* p00 = pPixels + 4 * (y0 * iWidth + x0);
+	const unsigned char* p10 = pPixels + 4 * (y0 * iWidth + x1);
+	const unsigned char* p01 = pPixels + 4 * (y1 * iWidth + x0);
+	const unsigned char* p11 = pPixels + 4 * (y1 * iWidth + x1);
+
+	float pResult[4];
+	for(int i = 0; i < 4; i++)
+	{
+		float fTop = p00[i] + fFracX * (p10[i] - p00[i]);
+		float fBottom = p01[i] + fFracX * (p11[i] - p01[i]);
+		pResult[i] = (fTop + fFracY * (fBottom - fTop)) / 255.0f;
+	}
+
+	return D3DXVECTOR4(pResult[0], pResult[1], pResult[2], pResult[3]);
+}
@@ -0,0 +1,128 @@
+#ifndef _CPUVORONOI_H_
+#define _CPUVORONOI_H_
+
+#include "Globals.h"
+#include "MeshCache.h"
+#include "CPUVolume.h"
+#include <vector>
+
+/*
+ *  Surface that is voxelized by the CPU implementation of the morph pipeline
+ */
+struct CPU_SURFACE
+{
+	const MESHDATA*		pMesh;
+	const TEXTUREDATA*	pTexture;	//NULL if the vertex colors are used
+	D3DXMATRIX			mModel;
+	float				fIsoValue;
+};
+
+/*
+ *  CPU implementation of the voronoi stage.
+ *	Every voxel gets the color of the closest surface point and the distance to it, like the
+ *	depth tested prisms of the Voronoi class. Voxels close to the surfaces are seeded with the
+ *	exact closest point of the triangles, the seeds are propagated through the volume with the
+ *	jump flooding algorithm. The seed band is voxelized conservatively with a separating axis test
+ *	of the triangles and the voxels grown to the seed radius.
+ *
+ *	The triangles are binned into tiles of the volume and the tiles are voxelized in parallel.
+ *	The seeds do not depend on the number of threads.
+ */
+class CPUVoronoi
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	CPUVoronoi();
+
+	/*
+	 *  Computes colors and distances of all voxels of the volume
+	 */
+	HRESULT Compute(const std::vector<CPU_SURFACE>& vSurfaces, CPUVolume* pVolume);
+
+	/*
+	 *  Frees the temporary buffers
+	 */
+	void Release();
+
+	unsigned int GetNumSeeds() const { return (unsigned int)m_vSeeds.size(); }
+
+	/*
+	 *  Size of the temporary buffers in bytes
+	 */
+	unsigned __int64 GetMemorySize() const;
+
+protected:
+	struct VORONOI_SEED
+	{
+		D3DXVECTOR3 vPoint;		//closest surface point in voxel coordinates
+		D3DXVECTOR4 vColor;
+	};
+
+	struct VORONOI_TRIANGLE
+	{
+		D3DXVECTOR3			pPositions[3];	//voxel coordinates
+		const CPU_SURFACE*	pSurface;
+		const unsigned int*	pIndices;
+	};
+
+	/*
+	 *  Transforms the triangles of all surfaces into voxel coordinates and sorts them into the tiles
+	 *	they overlap, in the order of the surfaces
+	 */
+	void ItlBinTriangles(const std::vector<CPU_SURFACE>& vSurfaces, const CPUVolume* pVolume);
+
+	/*
+	 *  Seeds the voxels of one tile. The seeds are stored with indices relative to the tile in
+	 *	m_vNearest[0], the seeded voxels in vVoxels.
+	 */
+	void ItlSeedTile(int iTile, const CPUVolume* pVolume, std::vector<VORONOI_SEED>& vSeeds, std::vector<unsigned int>& vVoxels);
+
+	/*
+	 *  Voxels with a center within the seed radius of the bounding box of the triangle, false if
+	 *	there are none
+	 */
+	static bool ItlGetVoxelRange(const VORONOI_TRIANGLE& triangle, const CPUVolume* pVolume, int pStart[3], int pEnd[3]);
+
+	/*
+	 *  Separating axis test of the triangle abc and a cube (Akenine-Moeller), conservative for the
+	 *	sphere with the radius fHalfSize around the center
+	 */
+	static bool ItlTriangleOverlapsBox(const D3DXVECTOR3& vCenter, float fHalfSize, const D3DXVECTOR3& a, const D3DXVECTOR3& b, const D3DXVECTOR3& c);
+
+	/*
+	 *  One jump flooding pass with the given step size
+	 */
+	void ItlJumpFlood(int iStep, const int* pSource, int* pDest, const CPUVolume* pVolume);
+
+	/*
+	 *  Writes color and distance of the nearest seed into every voxel
+	 */
+	void ItlResolve(const int* pNearest, CPUVolume* pVolume);
+
+	/*
+	 *  Closest point on the triangle abc, returns its barycentric coordinates
+	 */
+	static D3DXVECTOR3 ItlClosestPointOnTriangle(const D3DXVECTOR3& p, const D3DXVECTOR3& a, const D3DXVECTOR3& b, const D3DXVECTOR3& c, D3DXVECTOR3* pBarycentric);
+
+	/*
+	 *  Bilinear texture lookup with clamping
+	 */
+	static D3DXVECTOR4 ItlSampleTexture(const TEXTUREDATA* pTexture, const D3DXVECTOR2& vTexcoord);
+
+	std::vector<VORONOI_SEED> m_vSeeds;
+
+	//triangles of all surfaces, the triangles of tile i start at m_vTileOffsets[i]
+	std::vector<VORONOI_TRIANGLE> m_vTriangles;
+	std::vector<unsigned int> m_vTileTriangles;
+	std::vector<unsigned int> m_vTileOffsets;
+	int m_iTilesX;
+	int m_iTilesY;
+	int m_iTilesZ;
+
+	//index of the nearest seed of every voxel, -1 if there is none yet (ping-pong buffers)
+	std::vector<int> m_vNearest[2];
+};
+
+#endif
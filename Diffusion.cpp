@@ -2,11 +2,15 @@
 #include "Diffusion.h"
 #include "TextureManager.h"
 #include "Scene.h"
+#include "BrickMap.h"
+#include "Profiler.h"
 
 /****************************************************************************
  ****************************************************************************/
-Diffusion::Diffusion(ID3DX11Effect *pDiffusionEffect)
+Diffusion::Diffusion(Scene* pScene, ID3DX11Effect *pDiffusionEffect)
 {
+	m_pScene = pScene;
+	m_pTextureManager = pScene->GetTextureManager();
 	m_pDiffusionEffect = pDiffusionEffect;
 
 	m_pInputLayout = NULL;
@@ -15,14 +19,12 @@ Diffusion::Diffusion(ID3DX11Effect *pDiffusionEffect)
 	m_nDiffuseTex3D[0] = 0;
 	m_nDiffuseTex3D[1] = 0;
 
-	m_nDiffuseSliceTex2D[0] = 0;
-	m_nDiffuseSliceTex2D[1] = 0;
-
-	m_nOneSliceTex3D = 0;
-	m_nOneSliceSliceTex2D = 0;
-
 	m_nIsoSurfaceTex3D = 0;
-	m_nIsoSurfaceSliceTex2D = 0;
+
+	m_nCoarseTex3D = 0;
+	m_pBrickMap = NULL;
+	m_fStartPolySize = 1.0f;
+	m_fSeedDistance = 0.0f;
 
 	m_iTextureWidth = 0;
 	m_iTextureHeight = 0;
@@ -45,6 +47,15 @@ void Diffusion::Cleanup()
 {
 	SAFE_RELEASE(m_pInputLayout);
 	SAFE_RELEASE(m_pSlicesVB);
+
+	//the textures go back into the pool of the texture manager
+	unsigned int* pTextures[] = { &m_nDiffuseTex3D[0], &m_nDiffuseTex3D[1], &m_nIsoSurfaceTex3D, &m_nCoarseTex3D };
+	for(int i = 0; i < 4; i++)
+	{
+		if(m_pTextureManager->IsValidTexture(*pTextures[i]))
+			m_pTextureManager->ReleaseTexture(*pTextures[i]);
+		*pTextures[i] = 0;
+	}
 }
 
 /****************************************************************************
@@ -65,17 +76,13 @@ HRESULT Diffusion::Initialize(const int iTextureWidth,
 	//Initialize Slices
 	V_RETURN(InitSlices());
 
-	m_nDiffuseTex3D[0] = TextureManager::GetInstance()->Create3DTexture("Diffusion 3D Tex1", iTextureWidth, iTextureHeight, iTextureDepth);
-	m_nDiffuseTex3D[1] = TextureManager::GetInstance()->Create3DTexture("Diffusion 3D Tex2", iTextureWidth, iTextureHeight, iTextureDepth);
-
-	m_nDiffuseSliceTex2D[0] = TextureManager::GetInstance()->Create2DTexture("Diffusion Slice 2D Tex1", iTextureWidth, iTextureHeight);
-	m_nDiffuseSliceTex2D[1] = TextureManager::GetInstance()->Create2DTexture("Diffusion Slice 2D Tex2", iTextureWidth, iTextureHeight);
+	m_nDiffuseTex3D[0] = m_pTextureManager->Create3DTexture("Diffusion 3D Tex1", iTextureWidth, iTextureHeight, iTextureDepth);
+	m_nDiffuseTex3D[1] = m_pTextureManager->Create3DTexture("Diffusion 3D Tex2", iTextureWidth, iTextureHeight, iTextureDepth);
 
-	m_nOneSliceTex3D = TextureManager::GetInstance()->Create3DTexture("One Slice 3D Tex", iTextureWidth, iTextureHeight, iTextureDepth);
-	m_nOneSliceSliceTex2D = TextureManager::GetInstance()->Create2DTexture("One Slice Slice 2D Tex", iTextureWidth, iTextureHeight);
+	m_nIsoSurfaceTex3D = m_pTextureManager->Create3DTexture("Isosurface 3D Tex", iTextureWidth, iTextureHeight, iTextureDepth);
 
-	m_nIsoSurfaceTex3D = TextureManager::GetInstance()->Create3DTexture("Isosurface 3D Tex", iTextureWidth, iTextureHeight, iTextureDepth);
-	m_nIsoSurfaceSliceTex2D = TextureManager::GetInstance()->Create2DTexture("Isosurface Slice 2D Tex", iTextureWidth, iTextureHeight);
+	//the coarse texture is only created for a refinement
+	m_nCoarseTex3D = 0;
 
 	m_iCurrentDiffusionStep = 0;
 	m_bRendering = false;
@@ -100,16 +107,10 @@ HRESULT Diffusion::Update(const int iTextureWidth,
 
 	V_RETURN(InitSlices());
 
-	TextureManager::GetInstance()->Update3DTexture(m_nDiffuseTex3D[0], iTextureWidth, iTextureHeight, iTextureDepth);
-	TextureManager::GetInstance()->Update3DTexture(m_nDiffuseTex3D[1], iTextureWidth, iTextureHeight, iTextureDepth);
-	TextureManager::GetInstance()->Update2DTexture(m_nDiffuseSliceTex2D[0], iTextureWidth, iTextureHeight);
-	TextureManager::GetInstance()->Update2DTexture(m_nDiffuseSliceTex2D[1], iTextureWidth, iTextureHeight);
-
-	TextureManager::GetInstance()->Update3DTexture(m_nOneSliceTex3D, iTextureWidth, iTextureHeight, iTextureDepth);
-	TextureManager::GetInstance()->Update2DTexture(m_nOneSliceSliceTex2D, iTextureWidth, iTextureHeight);
+	m_pTextureManager->Update3DTexture(m_nDiffuseTex3D[0], iTextureWidth, iTextureHeight, iTextureDepth);
+	m_pTextureManager->Update3DTexture(m_nDiffuseTex3D[1], iTextureWidth, iTextureHeight, iTextureDepth);
 
-	TextureManager::GetInstance()->Update3DTexture(m_nIsoSurfaceTex3D, iTextureWidth, iTextureHeight, iTextureDepth);
-	TextureManager::GetInstance()->Update2DTexture(m_nIsoSurfaceSliceTex2D, iTextureWidth, iTextureHeight);
+	m_pTextureManager->Update3DTexture(m_nIsoSurfaceTex3D, iTextureWidth, iTextureHeight, iTextureDepth);
 
 	m_iCurrentDiffusionStep = 0;
 	m_bRendering = false;
@@ -134,6 +135,8 @@ HRESULT Diffusion::InitShaders()
 	m_pPolySizeVar			= m_pDiffusionEffect->GetVariableByName("fPolySize")->AsScalar();
 	m_pSliceIndexVar		= m_pDiffusionEffect->GetVariableByName("iSliceIndex")->AsScalar();
 	m_pShowIsoColorVar		= m_pDiffusionEffect->GetVariableByName("bShowIsoColor")->AsScalar();
+	m_pCoarse3DTexSRVar		= m_pDiffusionEffect->GetVariableByName("CoarseTexture")->AsShaderResource();
+	m_pSeedDistanceVar		= m_pDiffusionEffect->GetVariableByName("fSeedDistance")->AsScalar();
 
 	assert(m_pDiffusionTechnique);
 	assert(m_pColor3DTexSRVar);
@@ -143,6 +146,8 @@ HRESULT Diffusion::InitShaders()
 	assert(m_pPolySizeVar);
 	assert(m_pSliceIndexVar);
 	assert(m_pShowIsoColorVar);
+	assert(m_pCoarse3DTexSRVar);
+	assert(m_pSeedDistanceVar);
 
 	return S_OK;
 }
@@ -161,7 +166,7 @@ HRESULT Diffusion::InitSlices()
 	{
 		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
 		{"TEXCOORD", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"SLICEINDEX", 0, DXGI_FORMAT_R8_UINT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		{"SLICEINDEX", 0, DXGI_FORMAT_R32_UINT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0}
 	};
 	D3DX11_PASS_SHADER_DESC passVsDesc;
 	m_pDiffusionTechnique->GetPassByIndex(0)->GetVertexShaderDesc(&passVsDesc);
@@ -169,7 +174,7 @@ HRESULT Diffusion::InitSlices()
 	passVsDesc.pShaderVariable->GetShaderDesc(passVsDesc.ShaderIndex, &effectVsDesc);
 	const void *vsCodePtr = effectVsDesc.pBytecode;
 	unsigned vsCodeLen = effectVsDesc.BytecodeLength;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateInputLayout(inputLayout, _countof(inputLayout), vsCodePtr, vsCodeLen, &m_pInputLayout));
+	V_RETURN(m_pScene->GetDevice()->CreateInputLayout(inputLayout, _countof(inputLayout), vsCodePtr, vsCodeLen, &m_pInputLayout));
 
 
 #define VERTEXCOUNT 6
@@ -185,6 +190,7 @@ HRESULT Diffusion::InitSlices()
 
 		sliceVerticesTemp[0].pos = D3DXVECTOR3(-1.0f, 1.0f, 0.5f);
 		sliceVerticesTemp[0].tex = D3DXVECTOR3(0.0f, 0.0f, float(z)/float(m_iTextureDepth-1));
+		sliceVerticesTemp[0].sliceindex = z;
 
 		sliceVerticesTemp[1].pos = D3DXVECTOR3(-1.0f, -1.0f, 0.5f);
 		sliceVerticesTemp[1].tex = D3DXVECTOR3(0.0f, 1.0f, float(z)/float(m_iTextureDepth-1));
@@ -218,7 +224,7 @@ HRESULT Diffusion::InitSlices()
 	initialData.pSysMem = sliceVertices;
 	initialData.SysMemPitch = 0;
 	initialData.SysMemSlicePitch = 0;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateBuffer(&vbDesc, &initialData, &m_pSlicesVB));
+	V_RETURN(m_pScene->GetDevice()->CreateBuffer(&vbDesc, &initialData, &m_pSlicesVB));
 
 	delete[] sliceVertices;
 	
@@ -239,6 +245,117 @@ void Diffusion::ShowIsoColor(bool bShow)
 	m_bShowIsoColor = bShow;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+void Diffusion::StoreCoarseSolution(const BrickMap* pBrickMap, float fScale)
+{
+	if(m_pTextureManager->IsValidTexture(m_nCoarseTex3D))
+		m_pTextureManager->ReleaseTexture(m_nCoarseTex3D);
+
+	//the coarse result becomes the coarse texture, the diffusion continues with a new texture
+	//that is resized to the fine resolution by the next Update
+	m_nCoarseTex3D = m_nDiffuseTex3D[1-m_iDiffTex];
+	m_nDiffuseTex3D[1-m_iDiffTex] = m_pTextureManager->Create3DTexture(m_iDiffTex == 1 ? "Diffusion 3D Tex1" : "Diffusion 3D Tex2",
+																	   m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+
+	m_pBrickMap = pBrickMap;
+
+	//the coarse solution already contains the far field, so the fine level only needs small kernels
+	//and takes the voronoi colors only close to the surfaces
+	m_fSeedDistance = 2.0f * fScale;
+	m_fStartPolySize = min(1.0f, 2.0f / fScale);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Diffusion::ClearCoarseSolution()
+{
+	//a changed number of diffusion steps seeds the refinement again, so the texture is kept until here
+	if(m_pTextureManager->IsValidTexture(m_nCoarseTex3D))
+		m_pTextureManager->ReleaseTexture(m_nCoarseTex3D);
+	m_nCoarseTex3D = 0;
+
+	m_pBrickMap = NULL;
+	m_fSeedDistance = 0.0f;
+	m_fStartPolySize = 1.0f;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Diffusion::ItlSeedFromCoarseSolution(const unsigned int nVoronoiTex3D)
+{
+	HRESULT hr(S_OK);
+
+	PROFILE_SCOPE("Seed from coarse");
+
+	//upsample the coarse solution into both color textures, the inactive bricks keep these values
+	m_pTextureManager->BindTextureAsSRV(m_nCoarseTex3D, m_pCoarse3DTexSRVar);
+
+	hr = m_pDiffusionTechnique->GetPassByName("Upsample")->Apply(0, m_pScene->GetContext());
+	assert(hr == S_OK);
+
+	m_pTextureManager->BindTextureAsRTV(m_nDiffuseTex3D[0]);
+	m_pScene->GetContext()->Draw(VERTEXCOUNT*m_iTextureDepth, 0);
+	m_pTextureManager->CopyTexture(m_nDiffuseTex3D[0], m_nDiffuseTex3D[1]);
+
+	//near the surfaces the active bricks start with the fine voronoi colors
+	m_pTextureManager->BindTextureAsSRV(nVoronoiTex3D, m_pColor3DTexSRVar);
+	hr = m_pSeedDistanceVar->SetFloat(m_fSeedDistance);
+	assert(hr == S_OK);
+
+	hr = m_pDiffusionTechnique->GetPassByName("SeedFromCoarse")->Apply(0, m_pScene->GetContext());
+	assert(hr == S_OK);
+
+	m_pTextureManager->BindTextureAsRTV(m_nDiffuseTex3D[1-m_iDiffTex]);
+	ItlDrawActiveSlices();
+
+	//unbind the render target, the diffusion reads this texture next
+	m_pScene->GetContext()->OMSetRenderTargets(0, NULL, NULL);
+
+	//unbind textures and apply pass again to confirm this
+	hr = m_pColor3DTexSRVar->SetResource(NULL);
+	assert(hr == S_OK);
+	hr = m_pCoarse3DTexSRVar->SetResource(NULL);
+	assert(hr == S_OK);
+	hr = m_pDiffusionTechnique->GetPassByName("SeedFromCoarse")->Apply(0, m_pScene->GetContext());
+	assert(hr == S_OK);
+
+	D3D11_RECT scissorRect = { 0, 0, m_iTextureWidth, m_iTextureHeight };
+	m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+double Diffusion::ItlDrawActiveSlices()
+{
+	double dNumVoxels = 0.0;
+
+	D3D11_RECT rect, nextRect;
+	int i = 0;
+	while(i < m_iTextureDepth)
+	{
+		if(!m_pBrickMap->GetSliceRect(i, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth, &rect))
+		{
+			i++;
+			continue;
+		}
+
+		//the slices of one brick layer share their rectangle
+		int iEnd = i + 1;
+		while(iEnd < m_iTextureDepth && m_pBrickMap->GetSliceRect(iEnd, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth, &nextRect) &&
+			  nextRect.left == rect.left && nextRect.top == rect.top && nextRect.right == rect.right && nextRect.bottom == rect.bottom)
+			iEnd++;
+
+		m_pScene->GetContext()->RSSetScissorRects(1, &rect);
+		m_pScene->GetContext()->Draw(VERTEXCOUNT*(iEnd - i), VERTEXCOUNT*i);
+
+		dNumVoxels += double(rect.right - rect.left) * double(rect.bottom - rect.top) * (iEnd - i);
+		i = iEnd;
+	}
+
+	return dNumVoxels;
+}
+
 /****************************************************************************
  ****************************************************************************/
 bool	Diffusion::RenderDiffusion(const unsigned int nVoronoiTex3D,
@@ -251,22 +368,23 @@ bool	Diffusion::RenderDiffusion(const unsigned int nVoronoiTex3D,
 	bool bFinished = false;
 
 	//store the old render targets and viewports
-    ID3D11RenderTargetView* pOldRTV = DXUTGetD3D11RenderTargetView();
-    ID3D11DepthStencilView* pOldDSV = DXUTGetD3D11DepthStencilView();
-	UINT NumViewports = 1;
-	D3D11_VIEWPORT pViewports[100];
-	Scene::GetInstance()->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
+	ID3D11RenderTargetView* pOldRTV = NULL;
+	ID3D11DepthStencilView* pOldDSV = NULL;
+	m_pScene->GetContext()->OMGetRenderTargets(1, &pOldRTV, &pOldDSV);
+	UINT NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	D3D11_VIEWPORT pViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	m_pScene->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
 
 	hr = m_pTextureSizeVar->SetFloatVector(D3DXVECTOR3((float)m_iTextureWidth, (float)m_iTextureHeight, (float)m_iTextureDepth));
 	assert(hr == S_OK);
 
-	TextureManager::GetInstance()->BindTextureAsSRV(nDistanceTex3D, m_pDist3DTexSRVar);
+	m_pTextureManager->BindTextureAsSRV(nDistanceTex3D, m_pDist3DTexSRVar);
 	
 	// Set viewport and scissor to match the size of a single slice 
 	D3D11_VIEWPORT viewport = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight), 0.0f, 1.0f };
-    Scene::GetInstance()->GetContext()->RSSetViewports(1, &viewport);
+    m_pScene->GetContext()->RSSetViewports(1, &viewport);
 	D3D11_RECT scissorRect = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight)};
-	Scene::GetInstance()->GetContext()->RSSetScissorRects(1, &scissorRect);
+	m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
 
 	assert(m_pInputLayout);
 	assert(m_pSlicesVB);
@@ -274,39 +392,55 @@ bool	Diffusion::RenderDiffusion(const unsigned int nVoronoiTex3D,
 	UINT strides = sizeof(SLICE_VERTEX);
 	UINT offsets = 0;
 
-	Scene::GetInstance()->GetContext()->IASetInputLayout(m_pInputLayout);
-	Scene::GetInstance()->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
-	Scene::GetInstance()->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_pScene->GetContext()->IASetInputLayout(m_pInputLayout);
+	m_pScene->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
+	m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 
 	//ping pong rendering
 	if(m_iCurrentDiffusionStep < iDiffusionSteps)
 	{
+		PROFILE_SCOPE("Diffusion step");
+
 		m_bRendering = true;
-		hr = m_pPolySizeVar->SetFloat(1.0 - (float)(m_iCurrentDiffusionStep)/(float)iDiffusionSteps);
+		hr = m_pPolySizeVar->SetFloat(m_fStartPolySize * (1.0 - (float)(m_iCurrentDiffusionStep)/(float)iDiffusionSteps));
 		assert(hr == S_OK);
 
-		if(m_iCurrentDiffusionStep == 0)
+		if(m_iCurrentDiffusionStep == 0 && m_pBrickMap != NULL)
+		{
+			//refinement: start from the upsampled coarse solution
+			ItlSeedFromCoarseSolution(nVoronoiTex3D);
+
+			m_pTextureManager->BindTextureAsSRV(m_nDiffuseTex3D[1-m_iDiffTex], m_pColor3DTexSRVar);
+		}
+		else if(m_iCurrentDiffusionStep == 0)
 		{
 			//As first resource texture you have to use the voronoi texture
-			TextureManager::GetInstance()->BindTextureAsRTV(m_nDiffuseSliceTex2D[m_iDiffTex]);
-			TextureManager::GetInstance()->BindTextureAsSRV(nVoronoiTex3D, m_pColor3DTexSRVar);
+			m_pTextureManager->BindTextureAsSRV(nVoronoiTex3D, m_pColor3DTexSRVar);
 		}
 		else
 		{
 			//after the first render pass, color textures are alternated
-			TextureManager::GetInstance()->BindTextureAsRTV(m_nDiffuseSliceTex2D[m_iDiffTex]);
-			TextureManager::GetInstance()->BindTextureAsSRV(m_nDiffuseTex3D[1-m_iDiffTex], m_pColor3DTexSRVar);
+			m_pTextureManager->BindTextureAsSRV(m_nDiffuseTex3D[1-m_iDiffTex], m_pColor3DTexSRVar);
 		}
 
-		hr = m_pDiffusionTechnique->GetPassByName("DiffuseTexture")->Apply(0, Scene::GetInstance()->GetContext());
+		hr = m_pDiffusionTechnique->GetPassByName("DiffuseTexture")->Apply(0, m_pScene->GetContext());
 		assert(hr == S_OK);
 
 		//RENDER
-		for(int i = 0; i < m_iTextureDepth; i++)
+		if(m_pBrickMap != NULL)
+		{
+			//only the slice rectangles of the active bricks are diffused, the rest keeps the coarse solution
+			m_pTextureManager->BindTextureAsRTV(m_nDiffuseTex3D[m_iDiffTex]);
+			Profiler::GetInstance()->AddCounter("Diffusion voxels", ItlDrawActiveSlices());
+			m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
+		}
+		else
 		{
-			Scene::GetInstance()->GetContext()->Draw(VERTEXCOUNT, VERTEXCOUNT*i);
-			TextureManager::GetInstance()->Render2DTextureInto3DSlice(m_nDiffuseSliceTex2D[m_iDiffTex], m_nDiffuseTex3D[m_iDiffTex], i);
+			//all slices in one draw call, the geometry shader selects the slice of the render target
+			m_pTextureManager->BindTextureAsRTV(m_nDiffuseTex3D[m_iDiffTex]);
+			m_pScene->GetContext()->Draw(VERTEXCOUNT*m_iTextureDepth, 0);
+			Profiler::GetInstance()->AddCounter("Diffusion voxels", double(m_iTextureWidth) * m_iTextureHeight * m_iTextureDepth);
 		}
 		
 		m_iDiffTex = 1-m_iDiffTex;
@@ -315,7 +449,7 @@ bool	Diffusion::RenderDiffusion(const unsigned int nVoronoiTex3D,
 		//unbind textures and apply pass again to confirm this
 		hr = m_pColor3DTexSRVar->SetResource(NULL);
 		assert(hr == S_OK);
-		hr = m_pDiffusionTechnique->GetPassByName("DiffuseTexture")->Apply(0, Scene::GetInstance()->GetContext());
+		hr = m_pDiffusionTechnique->GetPassByName("DiffuseTexture")->Apply(0, m_pScene->GetContext());
 		assert(hr == S_OK);
 	}
 	else
@@ -326,8 +460,10 @@ bool	Diffusion::RenderDiffusion(const unsigned int nVoronoiTex3D,
 	}
 
 	//restore old render targets
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
-	Scene::GetInstance()->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	m_pScene->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
+	m_pScene->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	SAFE_RELEASE(pOldRTV);
+	SAFE_RELEASE(pOldDSV);
 
 	return bFinished;//m_nDiffuseTex3D[1-m_iDiffTex];
 }
@@ -339,22 +475,28 @@ unsigned int	Diffusion::RenderOneDiffusionSlice(const int iSliceIndex,
 {
 	HRESULT hr(S_OK);
 
+	PROFILE_SCOPE("One slice");
+
 	//store the old render targets and viewports
-    ID3D11RenderTargetView* pOldRTV = DXUTGetD3D11RenderTargetView();
-    ID3D11DepthStencilView* pOldDSV = DXUTGetD3D11DepthStencilView();
-	UINT NumViewports = 1;
-	D3D11_VIEWPORT pViewports[100];
-	Scene::GetInstance()->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
+	ID3D11RenderTargetView* pOldRTV = NULL;
+	ID3D11DepthStencilView* pOldDSV = NULL;
+	m_pScene->GetContext()->OMGetRenderTargets(1, &pOldRTV, &pOldDSV);
+	UINT NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	D3D11_VIEWPORT pViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	m_pScene->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
+
+	//the idle diffusion texture holds the view, it must not be the source
+	unsigned int nOneSliceTex3D = m_nDiffuseTex3D[m_iDiffTex];
+	assert(!m_bRendering && nCurrentDiffusionTexture != nOneSliceTex3D);
 
-	//set one slice 2D texture as render target
-	TextureManager::GetInstance()->BindTextureAsRTV(m_nOneSliceSliceTex2D);
-	TextureManager::GetInstance()->BindTextureAsSRV(nCurrentDiffusionTexture, m_pColor3DTexSRVar);
+	//the slices of the one slice texture are render targets one after another
+	m_pTextureManager->BindTextureAsSRV(nCurrentDiffusionTexture, m_pColor3DTexSRVar);
 
 	// Set viewport and scissor to match the size of a single slice 
 	D3D11_VIEWPORT viewport = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight), 0.0f, 1.0f };
-    Scene::GetInstance()->GetContext()->RSSetViewports(1, &viewport);
+    m_pScene->GetContext()->RSSetViewports(1, &viewport);
 	D3D11_RECT scissorRect = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight)};
-	Scene::GetInstance()->GetContext()->RSSetScissorRects(1, &scissorRect);
+	m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
 	
 	//set shader variables
 	hr = m_pSliceIndexVar->SetFloat(iSliceIndex);
@@ -366,46 +508,36 @@ unsigned int	Diffusion::RenderOneDiffusionSlice(const int iSliceIndex,
 	UINT strides = sizeof(SLICE_VERTEX);
 	UINT offsets = 0;
 
-	Scene::GetInstance()->GetContext()->IASetInputLayout(m_pInputLayout);
-	Scene::GetInstance()->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
-	Scene::GetInstance()->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_pScene->GetContext()->IASetInputLayout(m_pInputLayout);
+	m_pScene->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
+	m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	//apply pass
-	hr = m_pDiffusionTechnique->GetPassByName("RenderOneBlackSlice")->Apply(0, Scene::GetInstance()->GetContext());
+	hr = m_pDiffusionTechnique->GetPassByName("RenderOneBlackSlice")->Apply(0, m_pScene->GetContext());
 	assert(hr == S_OK);	
 		
-	//RENDER
-	for(int j = 0; j < m_iTextureDepth; j++)
-	{
-		if(j == iSliceIndex)
-		{
-			hr = m_pDiffusionTechnique->GetPassByName("RenderOneColorSlice")->Apply(0, Scene::GetInstance()->GetContext());
-			assert(hr == S_OK);
-			Scene::GetInstance()->GetContext()->Draw(VERTEXCOUNT, VERTEXCOUNT*j);
-			hr = m_pDiffusionTechnique->GetPassByName("RenderOneBlackSlice")->Apply(0, Scene::GetInstance()->GetContext());
-			assert(hr == S_OK);
-		}
-		else
-		{
-			Scene::GetInstance()->GetContext()->Draw(VERTEXCOUNT, VERTEXCOUNT*j);
-		}
+	//RENDER: all slices black in one draw call, then the colored slice on top
+	m_pTextureManager->BindTextureAsRTV(nOneSliceTex3D);
+	m_pScene->GetContext()->Draw(VERTEXCOUNT*m_iTextureDepth, 0);
 
-		
-		TextureManager::GetInstance()->Render2DTextureInto3DSlice(m_nOneSliceSliceTex2D, m_nOneSliceTex3D, j);
-	}
+	hr = m_pDiffusionTechnique->GetPassByName("RenderOneColorSlice")->Apply(0, m_pScene->GetContext());
+	assert(hr == S_OK);
+	m_pScene->GetContext()->Draw(VERTEXCOUNT, VERTEXCOUNT*iSliceIndex);
 
 	hr = m_pColor3DTexSRVar->SetResource(NULL);
 	assert(hr == S_OK);
 
 	//apply pass again to unbind the resource texture
-	hr = m_pDiffusionTechnique->GetPassByName("RenderOneBlackSlice")->Apply(0, Scene::GetInstance()->GetContext());
+	hr = m_pDiffusionTechnique->GetPassByName("RenderOneBlackSlice")->Apply(0, m_pScene->GetContext());
 	assert(hr == S_OK);	
 	
 	//restore old render targets
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
-	Scene::GetInstance()->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	m_pScene->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
+	m_pScene->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	SAFE_RELEASE(pOldRTV);
+	SAFE_RELEASE(pOldDSV);
 
-	return m_nOneSliceTex3D;
+	return nOneSliceTex3D;
 }
 
 /****************************************************************************
@@ -414,22 +546,25 @@ unsigned int	Diffusion::RenderIsoSurface(const unsigned int nCurrentDiffusionTex
 {
 	HRESULT hr(S_OK);
 
+	PROFILE_SCOPE("Iso surface");
+	Profiler::GetInstance()->AddCounter("Iso surface voxels", double(m_iTextureWidth) * m_iTextureHeight * m_iTextureDepth);
+
 	//store the old render targets and viewports
-    ID3D11RenderTargetView* pOldRTV = DXUTGetD3D11RenderTargetView();
-    ID3D11DepthStencilView* pOldDSV = DXUTGetD3D11DepthStencilView();
-	UINT NumViewports = 1;
-	D3D11_VIEWPORT pViewports[100];
-	Scene::GetInstance()->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
+	ID3D11RenderTargetView* pOldRTV = NULL;
+	ID3D11DepthStencilView* pOldDSV = NULL;
+	m_pScene->GetContext()->OMGetRenderTargets(1, &pOldRTV, &pOldDSV);
+	UINT NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	D3D11_VIEWPORT pViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	m_pScene->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
 
 	// Set viewport and scissor to match the size of a single slice 
 	D3D11_VIEWPORT viewport = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight), 0.0f, 1.0f };
-    Scene::GetInstance()->GetContext()->RSSetViewports(1, &viewport);
+    m_pScene->GetContext()->RSSetViewports(1, &viewport);
 	D3D11_RECT scissorRect = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight)};
-	Scene::GetInstance()->GetContext()->RSSetScissorRects(1, &scissorRect);
+	m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
 
-	//set iso surface texture as render target
-	TextureManager::GetInstance()->BindTextureAsRTV(m_nIsoSurfaceSliceTex2D);
-	TextureManager::GetInstance()->BindTextureAsSRV(nCurrentDiffusionTexture, m_pColor3DTexSRVar);
+	//the slices of the iso surface texture are render targets one after another
+	m_pTextureManager->BindTextureAsSRV(nCurrentDiffusionTexture, m_pColor3DTexSRVar);
 	assert(hr == S_OK);
 	
 	//set shader variables
@@ -443,7 +578,7 @@ unsigned int	Diffusion::RenderIsoSurface(const unsigned int nCurrentDiffusionTex
 	m_pTextureSizeVar->SetFloatVector(D3DXVECTOR3((float)m_iTextureWidth, (float)m_iTextureHeight, (float)m_iTextureDepth));
 
 	//apply pass
-	hr = m_pDiffusionTechnique->GetPassByName("RenderIsoSurface")->Apply(0, Scene::GetInstance()->GetContext());
+	hr = m_pDiffusionTechnique->GetPassByName("RenderIsoSurface")->Apply(0, m_pScene->GetContext());
 	assert(hr == S_OK);	
 
 	assert(m_pInputLayout);
@@ -452,27 +587,26 @@ unsigned int	Diffusion::RenderIsoSurface(const unsigned int nCurrentDiffusionTex
 	UINT strides = sizeof(SLICE_VERTEX);
 	UINT offsets = 0;
 
-	Scene::GetInstance()->GetContext()->IASetInputLayout(m_pInputLayout);
-	Scene::GetInstance()->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
-	Scene::GetInstance()->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_pScene->GetContext()->IASetInputLayout(m_pInputLayout);
+	m_pScene->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
+	m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	
 	//RENDER
-	for(int j = 0; j < m_iTextureDepth; j++)
-	{
-		Scene::GetInstance()->GetContext()->Draw(VERTEXCOUNT, VERTEXCOUNT*j);
-		TextureManager::GetInstance()->Render2DTextureInto3DSlice(m_nIsoSurfaceSliceTex2D, m_nIsoSurfaceTex3D, j);
-	}
+	m_pTextureManager->BindTextureAsRTV(m_nIsoSurfaceTex3D);
+	m_pScene->GetContext()->Draw(VERTEXCOUNT*m_iTextureDepth, 0);
 
 	hr = m_pColor3DTexSRVar->SetResource(NULL);
 	assert(hr == S_OK);
 
 	//apply pass again to unbind the resource texture
-	hr = m_pDiffusionTechnique->GetPassByName("RenderIsoSurface")->Apply(0, Scene::GetInstance()->GetContext());
+	hr = m_pDiffusionTechnique->GetPassByName("RenderIsoSurface")->Apply(0, m_pScene->GetContext());
 	assert(hr == S_OK);	
 
 	//restore old render targets
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
-	Scene::GetInstance()->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	m_pScene->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
+	m_pScene->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	SAFE_RELEASE(pOldRTV);
+	SAFE_RELEASE(pOldDSV);
 	
 	return m_nIsoSurfaceTex3D;
 }
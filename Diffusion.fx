@@ -4,11 +4,13 @@
 
 Texture3D ColorTexture;
 Texture3D DistTexture;
+Texture3D CoarseTexture;
 
 float3 vTextureSize;
 float fIsoValue;
 float fPolySize;
 int iSliceIndex;
+float fSeedDistance;
 
 bool bShowIsoColor;
 
@@ -40,6 +42,7 @@ RasterizerState CullNone
 {
     MultiSampleEnable = True;
     CullMode = None;
+    ScissorEnable = True;
 };
 
 DepthStencilState DisableDepth
@@ -73,6 +76,15 @@ struct PS_DIFFUSION_INPUT
 	uint sliceindex : SLICEINDEX;
 };
 
+//the geometry shader sends every slice quad to its slice of the 3D render target
+struct GS_DIFFUSION_OUTPUT
+{
+	float4 pos		: SV_Position;
+	float3 tex		: TEXCOORD0;
+	uint sliceindex : SLICEINDEX;
+	uint rtindex	: SV_RenderTargetArrayIndex;
+};
+
 struct PS_DIFFUSION_OUTPUT
 {
 	float4 color	: SV_Target0;
@@ -92,6 +104,25 @@ PS_DIFFUSION_INPUT DiffusionVS(VS_DIFFUSION_INPUT input)
 	return output;
 }
 
+//--------------------------------------------------------------------------------------
+// Geometry Shader
+//--------------------------------------------------------------------------------------
+
+[maxvertexcount(3)]
+void SliceGS(triangle PS_DIFFUSION_INPUT input[3], inout TriangleStream<GS_DIFFUSION_OUTPUT> tStream)
+{
+	GS_DIFFUSION_OUTPUT output;
+	for(int v = 0; v < 3; v++)
+	{
+		output.pos = input[v].pos;
+		output.tex = input[v].tex;
+		output.sliceindex = input[v].sliceindex;
+		output.rtindex = input[0].sliceindex;
+		tStream.Append(output);
+	}
+	tStream.RestartStrip();
+}
+
 //--------------------------------------------------------------------------------------
 // Pixel Shader
 //--------------------------------------------------------------------------------------
@@ -140,6 +171,34 @@ PS_DIFFUSION_OUTPUT OneSliceBlackPS(PS_DIFFUSION_INPUT input)
 	return output;
 }
 
+//texture coordinate of the voxel center, the slice quads use z/(depth-1) as z coordinate
+float3 VoxelCenter(float3 tex)
+{
+	float fSlice = round(tex.z * (vTextureSize.z - 1));
+	return float3(tex.xy, (fSlice + 0.5f) / vTextureSize.z);
+}
+
+PS_DIFFUSION_OUTPUT UpsamplePS(PS_DIFFUSION_INPUT input)
+{
+	PS_DIFFUSION_OUTPUT output;
+	output.color = CoarseTexture.SampleLevel(linearSamplerClamp, VoxelCenter(input.tex), 0);
+	return output;
+}
+
+PS_DIFFUSION_OUTPUT SeedPS(PS_DIFFUSION_INPUT input)
+{
+	PS_DIFFUSION_OUTPUT output;
+
+	//close to a surface the fine voronoi diagram is used, further away the upsampled coarse solution
+	float fDistance = 0.92387*DistTexture.SampleLevel(pointSamplerClamp, input.tex, 0).x*vTextureSize.x;
+	if(fDistance < fSeedDistance)
+		output.color = ColorTexture.SampleLevel(pointSamplerClamp, input.tex, 0);
+	else
+		output.color = CoarseTexture.SampleLevel(linearSamplerClamp, VoxelCenter(input.tex), 0);
+
+	return output;
+}
+
 PS_DIFFUSION_OUTPUT IsoSurfacePS(PS_DIFFUSION_INPUT input)
 {
 	PS_DIFFUSION_OUTPUT output;
@@ -170,7 +229,7 @@ technique10 Diffusion
 	pass DiffuseTexture
 	{
 		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
-		SetGeometryShader(NULL);
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
 		SetPixelShader(CompileShader(ps_4_0, DiffusionPS()));
 		SetRasterizerState( CullNone );
         SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
@@ -180,7 +239,7 @@ technique10 Diffusion
 	pass RenderOneBlackSlice
 	{
 		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
-		SetGeometryShader(NULL);
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
 		SetPixelShader(CompileShader(ps_4_0, OneSliceBlackPS()));
 		SetRasterizerState( CullNone );
         SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
@@ -190,17 +249,37 @@ technique10 Diffusion
 	pass RenderOneColorSlice
 	{
 		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
-		SetGeometryShader(NULL);
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
 		SetPixelShader(CompileShader(ps_4_0, OneSliceColorPS()));
 		SetRasterizerState( CullNone );
         SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
         SetDepthStencilState( DisableDepth, 0 );
 	}
 
+	pass Upsample
+	{
+		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
+		SetPixelShader(CompileShader(ps_4_0, UpsamplePS()));
+		SetRasterizerState( CullNone );
+        SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+        SetDepthStencilState( DisableDepth, 0 );
+	}
+
+	pass SeedFromCoarse
+	{
+		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
+		SetPixelShader(CompileShader(ps_4_0, SeedPS()));
+		SetRasterizerState( CullNone );
+        SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+        SetDepthStencilState( DisableDepth, 0 );
+	}
+
 	pass RenderIsoSurface
 	{
 		SetVertexShader(CompileShader(vs_4_0, DiffusionVS()));
-		SetGeometryShader(NULL);
+		SetGeometryShader(CompileShader(gs_4_0, SliceGS()));
 		SetPixelShader(CompileShader(ps_4_0, IsoSurfacePS()));
 		SetRasterizerState( CullNone );
         SetBlendState( NoBlending, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
@@ -3,6 +3,10 @@
 
 #include "Surface.h"
 
+class BrickMap;
+class Scene;
+class TextureManager;
+
 /*
  *	Generates a 3D Diffusion Texture by using a Voronoi and Distance Texture.
  *  
@@ -15,7 +19,7 @@ public:
 	/*
 	 *  Constructor
 	 */
-	Diffusion(ID3DX11Effect *pDiffusionEffect);
+	Diffusion(Scene* pScene, ID3DX11Effect *pDiffusionEffect);
 
 	//Destructor
 	virtual ~Diffusion();
@@ -50,12 +54,30 @@ public:
 							const int iDiffusionSteps);
 
 	
+	/*
+	 *  Renders the slice into an otherwise black volume. The volume is the idle diffusion texture,
+	 *	it is only valid until the next diffusion run.
+	 */
 	unsigned int RenderOneDiffusionSlice(const int iSliceIndex, 
 										 const unsigned int nCurrentDiffusionTexture);
 
 	
 	unsigned int RenderIsoSurface(const unsigned int nCurrentDiffusionTexture);
 	
+	/*
+	 *  Keeps the current diffusion texture as coarse solution for a refinement at a finer resolution,
+	 *	the texture is handed over without a copy.
+	 *	The next diffusion run starts from the upsampled coarse solution and only renders the active
+	 *	bricks of the brick map. fScale is the ratio of the fine to the coarse resolution.
+	 */
+	void	StoreCoarseSolution(const BrickMap* pBrickMap, float fScale);
+
+	/*
+	 *  Removes the coarse solution and releases its texture, the next diffusion run renders the
+	 *	whole volume again
+	 */
+	void	ClearCoarseSolution();
+
 	unsigned int GetIsoSurfaceTexture() const { return m_nIsoSurfaceTex3D;}
 	unsigned int GetDiffusionTexture() const { return m_nDiffuseTex3D[1-m_iDiffTex];}
 
@@ -77,6 +99,17 @@ private:
 
 	void Cleanup();
 
+	//Fills both color textures with the upsampled coarse solution and seeds the active bricks with the voronoi texture
+	void ItlSeedFromCoarseSolution(const unsigned int nVoronoiTex3D);
+
+	//Draws the slices of the active bricks, one draw call per run of slices with the same rectangle.
+	//Returns the number of covered voxels
+	double ItlDrawActiveSlices();
+
+	//scene the diffusion belongs to, the textures are created by its texture manager
+	Scene						*m_pScene;
+	TextureManager				*m_pTextureManager;
+
 	//Shader
 	ID3DX11Effect				*m_pDiffusionEffect;
 	ID3DX11EffectTechnique		*m_pDiffusionTechnique;
@@ -85,17 +118,24 @@ private:
 	ID3D11InputLayout			*m_pInputLayout;
 	ID3D11Buffer                *m_pSlicesVB;
 
-	//Textures, RTVs and SRV
+	/*
+	 *  Textures, the passes render directly into their slices. Aliasing plan:
+	 *	- the one slice view is rendered into the diffusion texture that is not the result, it is
+	 *	  idle until the next diffusion run overwrites both of them
+	 *	- the coarse solution takes over the result texture of the coarse level instead of a copy,
+	 *	  the diffusion gets a texture of the pool for the refinement
+	 *	The iso surface texture has its own resource, the one slice view of the iso surface reads it.
+	 */
 	unsigned int				m_nDiffuseTex3D[2];
-	unsigned int				m_nDiffuseSliceTex2D[2];
 
-	//One Slice Texture, RTV and SRV
-	unsigned int				m_nOneSliceTex3D;
-	unsigned int				m_nOneSliceSliceTex2D;
-
-	//IsoSurface Texture, RTV and SRV
+	//IsoSurface Texture
 	unsigned int				m_nIsoSurfaceTex3D;
-	unsigned int				m_nIsoSurfaceSliceTex2D;
+
+	//Coarse solution and the bricks that are refined
+	unsigned int				m_nCoarseTex3D;
+	const BrickMap				*m_pBrickMap;
+	float						m_fStartPolySize;
+	float						m_fSeedDistance;
 
 	//Shader variables
 	ID3DX11EffectShaderResourceVariable		*m_pColor3DTexSRVar;
@@ -105,6 +145,8 @@ private:
 	ID3DX11EffectScalarVariable				*m_pSliceIndexVar;
 	ID3DX11EffectScalarVariable				*m_pShowIsoColorVar;
 	ID3DX11EffectVectorVariable				*m_pTextureSizeVar;
+	ID3DX11EffectShaderResourceVariable		*m_pCoarse3DTexSRVar;
+	ID3DX11EffectScalarVariable				*m_pSeedDistanceVar;
 
 	//3D texture size
 	int							m_iTextureWidth;
@@ -121,5 +121,20 @@ inline bool CheckIfPointIsInBoundingBox(BOUNDINGBOX bb, D3DXVECTOR3 point)
 		return false;
 }
 
+/*
+ *	writes the eight corners of the bounding box into pCorners
+ */
+inline void GetBoundingBoxCorners(BOUNDINGBOX bb, D3DXVECTOR3* pCorners)
+{
+	pCorners[0] = D3DXVECTOR3(bb.vMin.x, bb.vMin.y, bb.vMin.z);
+	pCorners[1] = D3DXVECTOR3(bb.vMax.x, bb.vMin.y, bb.vMin.z);
+	pCorners[2] = D3DXVECTOR3(bb.vMax.x, bb.vMax.y, bb.vMin.z);
+	pCorners[3] = D3DXVECTOR3(bb.vMin.x, bb.vMax.y, bb.vMin.z);
+	pCorners[4] = D3DXVECTOR3(bb.vMax.x, bb.vMin.y, bb.vMax.z);
+	pCorners[5] = D3DXVECTOR3(bb.vMin.x, bb.vMin.y, bb.vMax.z);
+	pCorners[6] = D3DXVECTOR3(bb.vMax.x, bb.vMax.y, bb.vMax.z);
+	pCorners[7] = D3DXVECTOR3(bb.vMin.x, bb.vMax.y, bb.vMax.z);
+}
+
 
 #endif
@@ -0,0 +1,75 @@
+#include "MappedFile.h"
+
+
+/****************************************************************************
+ ****************************************************************************/
+MappedFile::MappedFile()
+{
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+	m_pData = NULL;
+	m_nSize = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MappedFile::Open(const std::string& strFileName)
+{
+	Close();
+
+	m_hFile = CreateFileA(strFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER liSize;
+	if(!GetFileSizeEx(m_hFile, &liSize))
+	{
+		Close();
+		return false;
+	}
+	m_nSize = liSize.QuadPart;
+
+	//an empty file can not be mapped
+	if(m_nSize == 0)
+		return true;
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_hMapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if(m_pData == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MappedFile::Close()
+{
+	if(m_pData != NULL)
+		UnmapViewOfFile(m_pData);
+	if(m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if(m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+	m_pData = NULL;
+	m_nSize = 0;
+}
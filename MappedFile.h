@@ -0,0 +1,52 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include "Globals.h"
+
+/*
+ *  Read-only memory mapping of a whole file
+ */
+class MappedFile
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	MappedFile();
+
+	/*
+	 *  Destructor, unmaps the file if it is still open
+	 */
+	~MappedFile();
+
+	/*
+	 *  Opens and maps the file, returns false if the file could not be opened.
+	 *	Empty files can be opened, their data pointer is NULL.
+	 */
+	bool Open(const std::string& strFileName);
+
+	/*
+	 *  Unmaps and closes the file
+	 */
+	void Close();
+
+	/*
+	 *  Getter for the mapped data and its size in bytes
+	 */
+	const unsigned char* GetData() const { return m_pData; }
+	unsigned __int64 GetSize() const { return m_nSize; }
+
+	bool IsOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+
+protected:
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	const unsigned char* m_pData;
+	unsigned __int64 m_nSize;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "MappedIOSystem.h"
+
+
+/****************************************************************************
+ ****************************************************************************/
+MappedIOStream::MappedIOStream()
+{
+	m_nSize = 0;
+	m_nPosition = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MappedIOStream::~MappedIOStream()
+{
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MappedIOStream::Open(const std::string& strFileName)
+{
+	m_nSize = 0;
+	m_nPosition = 0;
+
+	if(!m_file.Open(strFileName))
+		return false;
+
+	//the whole file is mapped into the address space, which limits 32 bit builds anyway
+	if(m_file.GetSize() > (unsigned __int64)(size_t)-1)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	m_nSize = (size_t)m_file.GetSize();
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+size_t MappedIOStream::Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+	if(pSize == 0)
+		return 0;
+
+	//like fread, only complete elements are read
+	size_t nCount = min(pCount, (m_nSize - m_nPosition) / pSize);
+	if(nCount == 0)
+		return 0;
+
+	memcpy(pvBuffer, m_file.GetData() + m_nPosition, nCount * pSize);
+	m_nPosition += nCount * pSize;
+
+	return nCount;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+size_t MappedIOStream::Write(const void* pvBuffer, size_t pSize, size_t pCount)
+{
+	return 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+aiReturn MappedIOStream::Seek(size_t pOffset, aiOrigin pOrigin)
+{
+	//same semantics as fseek, the offset is negative for aiOrigin_END
+	size_t nBase = 0;
+	if(pOrigin == aiOrigin_CUR)
+		nBase = m_nPosition;
+	else if(pOrigin == aiOrigin_END)
+		nBase = m_nSize;
+
+	size_t nPosition = nBase + pOffset;
+	if(nPosition > m_nSize)
+		return AI_FAILURE;
+
+	m_nPosition = nPosition;
+	return AI_SUCCESS;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MappedIOSystem::MappedIOSystem()
+{
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MappedIOSystem::~MappedIOSystem()
+{
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MappedIOSystem::Exists(const char* pFile) const
+{
+	DWORD dwAttributes = GetFileAttributesA(pFile);
+	return dwAttributes != INVALID_FILE_ATTRIBUTES && !(dwAttributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+Assimp::IOStream* MappedIOSystem::Open(const char* pFile, const char* pMode)
+{
+	if(strchr(pMode, 'w') != NULL || strchr(pMode, 'a') != NULL || strchr(pMode, '+') != NULL)
+		return NULL;
+
+	MappedIOStream* pStream = new MappedIOStream();
+	if(!pStream->Open(pFile))
+	{
+		delete pStream;
+		return NULL;
+	}
+
+	return pStream;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MappedIOSystem::Close(Assimp::IOStream* pFile)
+{
+	delete pFile;
+}
@@ -0,0 +1,58 @@
+#ifndef _MAPPEDIOSYSTEM_H_
+#define _MAPPEDIOSYSTEM_H_
+
+#include "Globals.h"
+#include "MappedFile.h"
+#include <IOStream.h>
+#include <IOSystem.h>
+
+/*
+ *  Read-only assimp stream on a file mapping, reads are copies out of the page cache
+ *	instead of fread calls through the CRT buffer
+ */
+class MappedIOStream : public Assimp::IOStream
+{
+public:
+	MappedIOStream();
+	~MappedIOStream();
+
+	/*
+	 *  Maps the file, returns false if it could not be opened
+	 */
+	bool Open(const std::string& strFileName);
+
+	/*
+	 *  Mapped file content, valid while the stream is open
+	 */
+	const unsigned char* GetData() const { return m_file.GetData(); }
+
+	size_t Read(void* pvBuffer, size_t pSize, size_t pCount);
+	size_t Write(const void* pvBuffer, size_t pSize, size_t pCount);
+	aiReturn Seek(size_t pOffset, aiOrigin pOrigin);
+	size_t Tell() const { return m_nPosition; }
+	size_t FileSize() const { return m_nSize; }
+	void Flush() {}
+
+protected:
+	MappedFile m_file;
+	size_t m_nSize;
+	size_t m_nPosition;
+};
+
+/*
+ *  Assimp file system that opens all files as MappedIOStreams. Only read modes are supported,
+ *	the importer never writes.
+ */
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+	MappedIOSystem();
+	~MappedIOSystem();
+
+	bool Exists(const char* pFile) const;
+	char getOsSeparator() const { return '\\'; }
+	Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb");
+	void Close(Assimp::IOStream* pFile);
+};
+
+#endif
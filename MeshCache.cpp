@@ -0,0 +1,700 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "MappedIOSystem.h"
+#include "ThreadPool.h"
+#include <assimp.hpp>
+#include <aiScene.h>
+#include <aiPostProcess.h>
+#include <aiConfig.h>
+#include <FreeImage.h>
+#include <emmintrin.h>
+#include <iomanip>
+#include <algorithm>
+
+//increase whenever the cache file layout or the import settings change
+#define MESHCACHE_VERSION 4
+
+#define MESHCACHE_MESH_MAGIC 0x484d4456		// "VDMH"
+#define MESHCACHE_TEXTURE_MAGIC 0x54544456	// "VDTT"
+
+#define MESHCACHE_POSTPROCESS_FLAGS (aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices)
+
+//rows of a texture level per task of the thread pool when converting and downsampling
+#define MESHCACHE_TEXTURE_ROWS 16
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+//file header of a cached mesh, followed by the vertices, triangle indices and edge indices
+struct MESHCACHEHEADER
+{
+	unsigned int nMagic;
+	unsigned int nVersion;
+	unsigned __int64 nKey;
+	unsigned int nNumVertices;
+	unsigned int nNumTriangleIndices;
+	unsigned int nNumEdgeIndices;
+	unsigned int nHasTextureCoords;
+	float fMaxVertexValue;
+	unsigned int nPadding;
+};
+
+//file header of a cached texture, followed by the RGBA pixels of all mip levels
+struct TEXTURECACHEHEADER
+{
+	unsigned int nMagic;
+	unsigned int nVersion;
+	unsigned __int64 nKey;
+	unsigned int nWidth;
+	unsigned int nHeight;
+	unsigned int nNumMipLevels;
+	unsigned int nPadding;
+};
+
+
+/****************************************************************************
+ ****************************************************************************/
+static unsigned __int64 ItlGetMipChainSize(unsigned int nWidth, unsigned int nHeight, unsigned int nNumMipLevels)
+{
+	unsigned __int64 nSize = 0;
+	for(unsigned int i = 0; i < nNumMipLevels; i++)
+	{
+		nSize += (unsigned __int64)nWidth * nHeight * 4;
+		nWidth = max(1u, nWidth / 2);
+		nHeight = max(1u, nHeight / 2);
+	}
+	return nSize;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static FIBITMAP* ItlConvertTo32Bits(FIBITMAP* pBitmap)
+{
+	if(pBitmap == NULL)
+		return NULL;
+
+	//high dynamic range images are tone mapped, the other non standard types (16 bit tiffs,
+	//float greyscale) are scaled to 8 bit
+	FIBITMAP* pConverted = pBitmap;
+	FREE_IMAGE_TYPE type = FreeImage_GetImageType(pBitmap);
+	if(type == FIT_RGBF || type == FIT_RGBAF)
+		pConverted = FreeImage_ToneMapping(pBitmap, FITMO_DRAGO03);
+	else if(type != FIT_BITMAP)
+		pConverted = FreeImage_ConvertToType(pBitmap, FIT_BITMAP, TRUE);
+
+	if(pConverted != pBitmap)
+	{
+		FreeImage_Unload(pBitmap);
+		pBitmap = pConverted;
+		if(pBitmap == NULL)
+			return NULL;
+	}
+
+	//palettes, greyscale and 24 bit images get an opaque alpha channel
+	if(FreeImage_GetBPP(pBitmap) != 32)
+	{
+		pConverted = FreeImage_ConvertTo32Bits(pBitmap);
+		FreeImage_Unload(pBitmap);
+		pBitmap = pConverted;
+	}
+
+	return pBitmap;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static void ItlSwizzleRow(const unsigned char* pSource, unsigned char* pDest, unsigned int nWidth)
+{
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	//swap the red and blue bytes of four pixels at once
+	const __m128i vMaskRB = _mm_set1_epi32(0x00ff00ff);
+	const __m128i vMaskGA = _mm_set1_epi32((int)0xff00ff00);
+
+	unsigned int x = 0;
+	for(; x + 4 <= nWidth; x += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(pSource + 4 * x));
+		__m128i vRB = _mm_and_si128(v, vMaskRB);
+		vRB = _mm_or_si128(_mm_slli_epi32(vRB, 16), _mm_srli_epi32(vRB, 16));
+		_mm_storeu_si128((__m128i*)(pDest + 4 * x), _mm_or_si128(_mm_and_si128(v, vMaskGA), vRB));
+	}
+
+	for(; x < nWidth; x++)
+	{
+		pDest[4*x+0] = pSource[4*x+2];
+		pDest[4*x+1] = pSource[4*x+1];
+		pDest[4*x+2] = pSource[4*x+0];
+		pDest[4*x+3] = pSource[4*x+3];
+	}
+#else
+	memcpy(pDest, pSource, nWidth * 4);
+#endif
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static void ItlDownsampleRow(const unsigned char* pSource, unsigned int nSourceWidth, unsigned int nSourceHeight, unsigned int y, unsigned char* pDest, unsigned int nWidth, unsigned int nHeight)
+{
+	//2x2 box filter, for odd sizes the last row and column of the level also cover the last source row and column
+	unsigned int y0 = 2 * y;
+	unsigned int y1 = y + 1 < nHeight ? 2 * y + 1 : nSourceHeight - 1;
+	const unsigned char* pRow0 = pSource + (size_t)y0 * nSourceWidth * 4;
+	const unsigned char* pRow1 = pSource + (size_t)y1 * nSourceWidth * 4;
+
+	//vertical average of eight source pixels, then the average of the even and odd pixels
+	unsigned int x = 0;
+	if(y1 == y0 + 1)
+	{
+		for(; x + 4 < nWidth; x += 4)
+		{
+			__m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(pRow0 + 8 * x)), _mm_loadu_si128((const __m128i*)(pRow1 + 8 * x)));
+			__m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(pRow0 + 8 * x + 16)), _mm_loadu_si128((const __m128i*)(pRow1 + 8 * x + 16)));
+			__m128 vEven = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 vOdd = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_si128((__m128i*)(pDest + 4 * x), _mm_avg_epu8(_mm_castps_si128(vEven), _mm_castps_si128(vOdd)));
+		}
+	}
+
+	for(; x < nWidth; x++)
+	{
+		unsigned int x0 = 2 * x;
+		unsigned int x1 = x + 1 < nWidth ? 2 * x + 1 : nSourceWidth - 1;
+		for(int c = 0; c < 4; c++)
+		{
+			if(x1 == x0 + 1 && y1 == y0 + 1)
+			{
+				//same rounding as _mm_avg_epu8
+				unsigned int nLeft = (pRow0[4*x0+c] + pRow1[4*x0+c] + 1) >> 1;
+				unsigned int nRight = (pRow0[4*x1+c] + pRow1[4*x1+c] + 1) >> 1;
+				pDest[4*x+c] = (unsigned char)((nLeft + nRight + 1) >> 1);
+			}
+			else
+			{
+				//1, 2, 3, 6 or 9 source pixels at the odd borders
+				unsigned int nSum = 0;
+				for(unsigned int ys = y0; ys <= y1; ys++)
+					for(unsigned int xs = x0; xs <= x1; xs++)
+						nSum += pSource[((size_t)ys * nSourceWidth + xs) * 4 + c];
+
+				unsigned int nCount = (x1 - x0 + 1) * (y1 - y0 + 1);
+				pDest[4*x+c] = (unsigned char)((nSum + nCount / 2) / nCount);
+			}
+		}
+	}
+}
+
+
+
+MeshCache* MeshCache::s_pInstance = NULL;
+
+/****************************************************************************
+ ****************************************************************************/
+MeshCache* MeshCache::GetInstance()
+{
+	if(s_pInstance == NULL)
+		s_pInstance = new MeshCache();
+	return s_pInstance;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshCache::DeleteInstance()
+{
+	if(s_pInstance != NULL)
+		SAFE_DELETE(s_pInstance)
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MeshCache::MeshCache()
+{
+	m_bEnabled = true;
+	SetCacheDirectory("Cache\\");
+
+	FreeImage_Initialise();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+MeshCache::~MeshCache()
+{
+	FreeImage_DeInitialise();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshCache::SetCacheDirectory(const std::string& strDirectory)
+{
+	m_strCacheDirectory = strDirectory;
+	if(!m_strCacheDirectory.empty() && m_strCacheDirectory[m_strCacheDirectory.size()-1] != '\\')
+		m_strCacheDirectory += "\\";
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT MeshCache::LoadMesh(const std::string& strMeshName, MESHDATA* pMeshData)
+{
+	HRESULT hr(S_OK);
+
+	unsigned __int64 nKey = 0;
+	if(!m_bEnabled || !ItlComputeKey(strMeshName, MESHCACHE_MESH_MAGIC ^ MESHCACHE_POSTPROCESS_FLAGS, &nKey))
+		return ItlImportMesh(strMeshName, pMeshData);
+
+	std::string strCacheFile = ItlGetCacheFileName(nKey, "mesh");
+	if(ItlReadMesh(strCacheFile, nKey, pMeshData))
+		return S_OK;
+
+	V_RETURN(ItlImportMesh(strMeshName, pMeshData));
+
+	if(!ItlWriteMesh(strCacheFile, nKey, pMeshData))
+		WARN_OUT(L"Could not write mesh cache file");
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT MeshCache::LoadTexture(const std::string& strTextureName, TEXTUREDATA* pTextureData)
+{
+	HRESULT hr(S_OK);
+
+	unsigned __int64 nKey = 0;
+	if(!m_bEnabled || !ItlComputeKey(strTextureName, MESHCACHE_TEXTURE_MAGIC, &nKey))
+		return ItlDecodeTexture(strTextureName, pTextureData);
+
+	std::string strCacheFile = ItlGetCacheFileName(nKey, "tex");
+	if(ItlReadTexture(strCacheFile, nKey, pTextureData))
+		return S_OK;
+
+	V_RETURN(ItlDecodeTexture(strTextureName, pTextureData));
+
+	if(!ItlWriteTexture(strCacheFile, nKey, pTextureData))
+		WARN_OUT(L"Could not write texture cache file");
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlComputeKey(const std::string& strFileName, unsigned __int64 nSalt, unsigned __int64* pKey)
+{
+	MappedFile file;
+	if(!file.Open(strFileName))
+		return false;
+
+	unsigned __int64 nHash = FNV_OFFSET_BASIS;
+
+	const unsigned char* pData = file.GetData();
+	for(unsigned __int64 i = 0; i < file.GetSize(); i++)
+	{
+		nHash ^= pData[i];
+		nHash *= FNV_PRIME;
+	}
+
+	//mix in the salt and the version, so entries of other types or older layouts never match
+	const unsigned __int64 nMix[2] = { nSalt, MESHCACHE_VERSION };
+	const unsigned char* pMix = (const unsigned char*)nMix;
+	for(unsigned int i = 0; i < sizeof(nMix); i++)
+	{
+		nHash ^= pMix[i];
+		nHash *= FNV_PRIME;
+	}
+
+	*pKey = nHash;
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+std::string MeshCache::ItlGetCacheFileName(unsigned __int64 nKey, const char* strExtension)
+{
+	std::stringstream ss;
+	ss << m_strCacheDirectory << std::hex << std::setw(16) << std::setfill('0') << nKey << "." << strExtension;
+	return ss.str();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlReadMesh(const std::string& strCacheFile, unsigned __int64 nKey, MESHDATA* pMeshData)
+{
+	MappedFile file;
+	if(!file.Open(strCacheFile))
+		return false;
+
+	if(file.GetSize() < sizeof(MESHCACHEHEADER))
+		return false;
+
+	const MESHCACHEHEADER* pHeader = (const MESHCACHEHEADER*)file.GetData();
+	if(pHeader->nMagic != MESHCACHE_MESH_MAGIC || pHeader->nVersion != MESHCACHE_VERSION || pHeader->nKey != nKey)
+		return false;
+
+	unsigned __int64 nVertexBytes = (unsigned __int64)pHeader->nNumVertices * sizeof(SURFACE_VERTEX);
+	unsigned __int64 nTriangleBytes = (unsigned __int64)pHeader->nNumTriangleIndices * sizeof(unsigned int);
+	unsigned __int64 nEdgeBytes = (unsigned __int64)pHeader->nNumEdgeIndices * sizeof(unsigned int);
+	if(file.GetSize() != sizeof(MESHCACHEHEADER) + nVertexBytes + nTriangleBytes + nEdgeBytes)
+	{
+		WARN_OUT(L"Truncated mesh cache file, importing the mesh again");
+		return false;
+	}
+
+	const unsigned char* pData = file.GetData() + sizeof(MESHCACHEHEADER);
+
+	const SURFACE_VERTEX* pVertices = (const SURFACE_VERTEX*)pData;
+	pMeshData->vVertices.assign(pVertices, pVertices + pHeader->nNumVertices);
+	pData += nVertexBytes;
+
+	const unsigned int* pTriangleIndices = (const unsigned int*)pData;
+	pMeshData->vTriangleIndices.assign(pTriangleIndices, pTriangleIndices + pHeader->nNumTriangleIndices);
+	pData += nTriangleBytes;
+
+	const unsigned int* pEdgeIndices = (const unsigned int*)pData;
+	pMeshData->vEdgeIndices.assign(pEdgeIndices, pEdgeIndices + pHeader->nNumEdgeIndices);
+
+	pMeshData->fMaxVertexValue = pHeader->fMaxVertexValue;
+	pMeshData->bHasTextureCoords = pHeader->nHasTextureCoords != 0;
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlWriteMesh(const std::string& strCacheFile, unsigned __int64 nKey, const MESHDATA* pMeshData)
+{
+	if(pMeshData->vVertices.empty() || pMeshData->vTriangleIndices.empty())
+		return false;
+
+	MESHCACHEHEADER header;
+	ZeroMemory(&header, sizeof(header));
+	header.nMagic = MESHCACHE_MESH_MAGIC;
+	header.nVersion = MESHCACHE_VERSION;
+	header.nKey = nKey;
+	header.nNumVertices = pMeshData->vVertices.size();
+	header.nNumTriangleIndices = pMeshData->vTriangleIndices.size();
+	header.nNumEdgeIndices = pMeshData->vEdgeIndices.size();
+	header.nHasTextureCoords = pMeshData->bHasTextureCoords ? 1 : 0;
+	header.fMaxVertexValue = pMeshData->fMaxVertexValue;
+
+	const void* pChunks[3] = { &pMeshData->vVertices[0], &pMeshData->vTriangleIndices[0],
+								pMeshData->vEdgeIndices.empty() ? NULL : &pMeshData->vEdgeIndices[0] };
+	const unsigned int nChunkSizes[3] = { header.nNumVertices*sizeof(SURFACE_VERTEX),
+										  header.nNumTriangleIndices*sizeof(unsigned int),
+										  header.nNumEdgeIndices*sizeof(unsigned int) };
+
+	return ItlWriteFile(strCacheFile, &header, sizeof(header), pChunks, nChunkSizes, 3);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlReadTexture(const std::string& strCacheFile, unsigned __int64 nKey, TEXTUREDATA* pTextureData)
+{
+	MappedFile file;
+	if(!file.Open(strCacheFile))
+		return false;
+
+	if(file.GetSize() < sizeof(TEXTURECACHEHEADER))
+		return false;
+
+	const TEXTURECACHEHEADER* pHeader = (const TEXTURECACHEHEADER*)file.GetData();
+	if(pHeader->nMagic != MESHCACHE_TEXTURE_MAGIC || pHeader->nVersion != MESHCACHE_VERSION || pHeader->nKey != nKey)
+		return false;
+
+	unsigned __int64 nPixelBytes = ItlGetMipChainSize(pHeader->nWidth, pHeader->nHeight, pHeader->nNumMipLevels);
+	if(pHeader->nNumMipLevels == 0 || pHeader->nNumMipLevels > 32 || file.GetSize() != sizeof(TEXTURECACHEHEADER) + nPixelBytes)
+	{
+		WARN_OUT(L"Truncated texture cache file, decoding the texture again");
+		return false;
+	}
+
+	const unsigned char* pPixels = file.GetData() + sizeof(TEXTURECACHEHEADER);
+	pTextureData->nWidth = pHeader->nWidth;
+	pTextureData->nHeight = pHeader->nHeight;
+	pTextureData->nNumMipLevels = pHeader->nNumMipLevels;
+	pTextureData->vPixels.assign(pPixels, pPixels + nPixelBytes);
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlWriteTexture(const std::string& strCacheFile, unsigned __int64 nKey, const TEXTUREDATA* pTextureData)
+{
+	if(pTextureData->vPixels.empty())
+		return false;
+
+	TEXTURECACHEHEADER header;
+	ZeroMemory(&header, sizeof(header));
+	header.nMagic = MESHCACHE_TEXTURE_MAGIC;
+	header.nVersion = MESHCACHE_VERSION;
+	header.nKey = nKey;
+	header.nWidth = pTextureData->nWidth;
+	header.nHeight = pTextureData->nHeight;
+	header.nNumMipLevels = pTextureData->nNumMipLevels;
+
+	const void* pChunks[1] = { &pTextureData->vPixels[0] };
+	const unsigned int nChunkSizes[1] = { pTextureData->vPixels.size() };
+
+	return ItlWriteFile(strCacheFile, &header, sizeof(header), pChunks, nChunkSizes, 1);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshCache::ItlWriteFile(const std::string& strCacheFile, const void* pHeader, unsigned int nHeaderSize, const void** ppChunks, const unsigned int* pChunkSizes, unsigned int nNumChunks)
+{
+	CreateDirectoryA(m_strCacheDirectory.c_str(), NULL);
+
+	//write into a temporary file first and move it into place afterwards, so that
+	//concurrent batch jobs never map a half written entry
+	std::stringstream ssTempFile;
+	ssTempFile << strCacheFile << "." << GetCurrentProcessId() << "_" << GetCurrentThreadId() << ".tmp";
+	std::string strTempFile = ssTempFile.str();
+
+	HANDLE hFile = CreateFileA(strTempFile.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD dwWritten = 0;
+	bool bSuccess = WriteFile(hFile, pHeader, nHeaderSize, &dwWritten, NULL) && dwWritten == nHeaderSize;
+
+	for(unsigned int i = 0; i < nNumChunks && bSuccess; i++)
+	{
+		if(pChunkSizes[i] == 0)
+			continue;
+		bSuccess = WriteFile(hFile, ppChunks[i], pChunkSizes[i], &dwWritten, NULL) && dwWritten == pChunkSizes[i];
+	}
+
+	CloseHandle(hFile);
+
+	if(bSuccess)
+		bSuccess = MoveFileExA(strTempFile.c_str(), strCacheFile.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+
+	if(!bSuccess)
+		DeleteFileA(strTempFile.c_str());
+
+	return bSuccess;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT MeshCache::ItlImportMesh(const std::string& strMeshName, MESHDATA* pMeshData)
+{
+	//load mesh with assimp
+	Assimp::Importer Importer;
+
+	//the importer reads the source files from a mapping, it takes ownership of the io system
+	Importer.SetIOHandler(new MappedIOSystem());
+
+	//the spatial sort of the vertex welding degenerates on large meshes with split UV seams,
+	//the hash grid joins the same vertices (only equal positions, no epsilon welding)
+	Importer.SetPropertyInteger(AI_CONFIG_PP_JV_HASH_GRID, 1);
+
+	const aiScene* pScene = Importer.ReadFile(strMeshName.c_str(), MESHCACHE_POSTPROCESS_FLAGS);
+
+	if(pScene == NULL)
+		return E_FAIL;
+
+	unsigned int nNumVertices = 0;
+	unsigned int nNumIndices = 0;
+
+	// Get vertex and index count of the whole mesh
+	for(unsigned int i = 0; i < pScene->mNumMeshes; i++)
+	{
+		nNumVertices += pScene->mMeshes[i]->mNumVertices;
+		nNumIndices += pScene->mMeshes[i]->mNumFaces*3;
+	}
+
+	pMeshData->vVertices.resize(nNumVertices);
+	pMeshData->vTriangleIndices.resize(nNumIndices);
+	pMeshData->fMaxVertexValue = 0;
+	pMeshData->bHasTextureCoords = false;
+
+	unsigned int nCurrentVertex = 0;
+	unsigned int nCurrentIndex = 0;
+
+	//load vertices, colors and texcoords
+	for(unsigned int i = 0; i < pScene->mNumMeshes; i++)
+	{
+		const aiMesh* paiMesh = pScene->mMeshes[i];
+		unsigned int nBaseVertex = nCurrentVertex;
+
+		if(paiMesh->HasTextureCoords(0))
+			pMeshData->bHasTextureCoords = true;
+
+		for(unsigned int j = 0; j < paiMesh->mNumVertices; j++)
+		{
+			const aiVector3D* pPos = &(paiMesh->mVertices[j]);
+
+			SURFACE_VERTEX vertex;
+			vertex.pos = D3DXVECTOR3(pPos->x, pPos->y, pPos->z);
+			if(paiMesh->HasTextureCoords(0))
+				vertex.texcoord = D3DXVECTOR2(paiMesh->mTextureCoords[0][j].x, paiMesh->mTextureCoords[0][j].y);
+			else
+				vertex.texcoord = D3DXVECTOR2(0.0f, 0.0f);
+
+			if(paiMesh->HasVertexColors(0))
+			{
+				const aiColor4D* pColor = &(paiMesh->mColors[0][j]);
+				vertex.color = D3DXVECTOR4(pColor->r, pColor->g, pColor->b, pColor->a);
+			}
+			else
+				vertex.color = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+
+			//get maximum vertex value to scale the model inside the window
+			if(abs(vertex.pos.x) > pMeshData->fMaxVertexValue)
+				pMeshData->fMaxVertexValue = abs(vertex.pos.x);
+			if(abs(vertex.pos.y) > pMeshData->fMaxVertexValue)
+				pMeshData->fMaxVertexValue = abs(vertex.pos.y);
+			if(abs(vertex.pos.z) > pMeshData->fMaxVertexValue)
+				pMeshData->fMaxVertexValue = abs(vertex.pos.z);
+
+			pMeshData->vVertices[nCurrentVertex] = vertex;
+			nCurrentVertex++;
+		}
+
+		//face indices are local to the assimp mesh, offset them into the combined vertex array
+		for(unsigned int j = 0; j < paiMesh->mNumFaces; j++)
+		{
+			const aiFace& face = paiMesh->mFaces[j];
+			assert(face.mNumIndices == 3);
+			unsigned int* pTriangle = &pMeshData->vTriangleIndices[nCurrentIndex];
+			pTriangle[0] = nBaseVertex + face.mIndices[0];
+			pTriangle[1] = nBaseVertex + face.mIndices[1];
+			pTriangle[2] = nBaseVertex + face.mIndices[2];
+
+			nCurrentIndex += 3;
+		}
+	}
+
+	if(nNumVertices == 0 || nNumIndices == 0)
+		return E_FAIL;
+
+	BuildEdgeIndices(pMeshData);
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshCache::BuildEdgeIndices(MESHDATA* pMeshData)
+{
+	const std::vector<SURFACE_VERTEX>& vVertices = pMeshData->vVertices;
+	const std::vector<unsigned int>& vTriangleIndices = pMeshData->vTriangleIndices;
+
+	//vertices that are only split by their attributes (seams, assimp meshes) get the index
+	//of the first vertex with the same position, so that their edges are merged as well
+	std::vector<unsigned int> vOrder(vVertices.size());
+	for(unsigned int i = 0; i < vOrder.size(); i++)
+		vOrder[i] = i;
+
+	std::sort(vOrder.begin(), vOrder.end(), [&vVertices](unsigned int a, unsigned int b) -> bool
+	{
+		int iCompare = memcmp(&vVertices[a].pos, &vVertices[b].pos, sizeof(D3DXVECTOR3));
+		return iCompare != 0 ? iCompare < 0 : a < b;
+	});
+
+	std::vector<unsigned int> vPositionIndex(vVertices.size());
+	for(unsigned int i = 0; i < vOrder.size(); i++)
+	{
+		if(i > 0 && memcmp(&vVertices[vOrder[i]].pos, &vVertices[vOrder[i-1]].pos, sizeof(D3DXVECTOR3)) == 0)
+			vPositionIndex[vOrder[i]] = vPositionIndex[vOrder[i-1]];
+		else
+			vPositionIndex[vOrder[i]] = vOrder[i];
+	}
+
+	//undirected edges as (smaller index, larger index) keys, sorted to remove the edges that are
+	//shared by two triangles
+	std::vector<unsigned __int64> vEdges;
+	vEdges.reserve(vTriangleIndices.size());
+	for(unsigned int i = 0; i < vTriangleIndices.size(); i += 3)
+	{
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			unsigned int a = vPositionIndex[vTriangleIndices[i + j]];
+			unsigned int b = vPositionIndex[vTriangleIndices[i + (j + 1) % 3]];
+			if(a != b)
+				vEdges.push_back((unsigned __int64)min(a, b) << 32 | max(a, b));
+		}
+	}
+
+	std::sort(vEdges.begin(), vEdges.end());
+	vEdges.erase(std::unique(vEdges.begin(), vEdges.end()), vEdges.end());
+
+	pMeshData->vEdgeIndices.resize(vEdges.size() * 2);
+	for(unsigned int i = 0; i < vEdges.size(); i++)
+	{
+		pMeshData->vEdgeIndices[2*i] = (unsigned int)(vEdges[i] >> 32);
+		pMeshData->vEdgeIndices[2*i+1] = (unsigned int)vEdges[i];
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT MeshCache::ItlDecodeTexture(const std::string& strTextureName, TEXTUREDATA* pTextureData)
+{
+	//freeimage decodes from a memory stream on the mapping of the file, which it does not copy
+	MappedFile file;
+	if(!file.Open(strTextureName) || file.GetData() == NULL)
+		return E_FAIL;
+
+	FIMEMORY* pMemory = FreeImage_OpenMemory((BYTE*)file.GetData(), (DWORD)file.GetSize());
+	if(pMemory == NULL)
+		return E_FAIL;
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(pMemory);
+	if(fif == FIF_UNKNOWN)
+		fif = FreeImage_GetFIFFromFilename(strTextureName.c_str());
+
+	FIBITMAP* pBitmap = NULL;
+	if(fif != FIF_UNKNOWN && FreeImage_FIFSupportsReading(fif))
+		pBitmap = FreeImage_LoadFromMemory(fif, pMemory);
+	FreeImage_CloseMemory(pMemory);
+
+	pBitmap = ItlConvertTo32Bits(pBitmap);
+	if(pBitmap == NULL)
+		return E_FAIL;
+
+	unsigned int nWidth = FreeImage_GetWidth(pBitmap);
+	unsigned int nHeight = FreeImage_GetHeight(pBitmap);
+
+	unsigned int nNumMipLevels = 1;
+	while((max(nWidth, nHeight) >> nNumMipLevels) > 0)
+		nNumMipLevels++;
+
+	pTextureData->nWidth = nWidth;
+	pTextureData->nHeight = nHeight;
+	pTextureData->nNumMipLevels = nNumMipLevels;
+	pTextureData->vPixels.resize((size_t)ItlGetMipChainSize(nWidth, nHeight, nNumMipLevels));
+
+	ThreadPool* pThreadPool = ThreadPool::GetInstance();
+
+	//the scanlines are padded to the pitch of the bitmap, the levels are tightly packed
+	unsigned char* pLevel = &pTextureData->vPixels[0];
+	pThreadPool->ParallelFor(0, nHeight, MESHCACHE_TEXTURE_ROWS, [&](int iBegin, int iEnd)
+	{
+		for(int y = iBegin; y < iEnd; y++)
+			ItlSwizzleRow(FreeImage_GetScanLine(pBitmap, y), pLevel + (size_t)y * nWidth * 4, nWidth);
+	});
+
+	FreeImage_Unload(pBitmap);
+
+	//every level is filtered from the previous one, the rows of a level are independent
+	unsigned int nLevelWidth = nWidth;
+	unsigned int nLevelHeight = nHeight;
+	for(unsigned int i = 1; i < nNumMipLevels; i++)
+	{
+		const unsigned char* pSource = pLevel;
+		unsigned int nSourceWidth = nLevelWidth;
+		unsigned int nSourceHeight = nLevelHeight;
+
+		pLevel += (size_t)nLevelWidth * nLevelHeight * 4;
+		nLevelWidth = max(1u, nLevelWidth / 2);
+		nLevelHeight = max(1u, nLevelHeight / 2);
+
+		pThreadPool->ParallelFor(0, nLevelHeight, MESHCACHE_TEXTURE_ROWS, [&](int iBegin, int iEnd)
+		{
+			for(int y = iBegin; y < iEnd; y++)
+				ItlDownsampleRow(pSource, nSourceWidth, nSourceHeight, y, pLevel + (size_t)y * nLevelWidth * 4, nLevelWidth, nLevelHeight);
+		});
+	}
+
+	return S_OK;
+}
@@ -0,0 +1,105 @@
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+#include "Globals.h"
+#include <vector>
+
+/*
+ *  Geometry of a surface after the assimp import and post processing
+ */
+struct MESHDATA
+{
+	std::vector<SURFACE_VERTEX> vVertices;
+	std::vector<unsigned int> vTriangleIndices;
+	std::vector<unsigned int> vEdgeIndices;
+
+	//maximum absolute vertex coordinate, used to normalize the model
+	float fMaxVertexValue;
+	bool bHasTextureCoords;
+};
+
+/*
+ *  Decoded texture, RGBA with 8 bit per channel.
+ *	vPixels holds the complete mip chain down to 1x1, largest level first, every level tightly packed.
+ */
+struct TEXTUREDATA
+{
+	unsigned int nWidth;
+	unsigned int nHeight;
+	unsigned int nNumMipLevels;
+	std::vector<unsigned char> vPixels;
+};
+
+/*
+ *  On-disk cache of imported meshes and decoded textures.
+ *	The entries are keyed by a hash of the source file content and the import settings,
+ *	so a changed source file never hits a stale entry. A hit is read back with one file mapping.
+ */
+class MeshCache
+{
+public:
+	static MeshCache* GetInstance();
+	static void DeleteInstance();
+
+	/*
+	 *  Loads a mesh from the cache or imports it with assimp on a cache miss.
+	 *	Imported meshes are written to the cache.
+	 */
+	HRESULT LoadMesh(const std::string& strMeshName, MESHDATA* pMeshData);
+
+	/*
+	 *  Loads a texture from the cache or decodes it with freeimage on a cache miss.
+	 *	Decoded textures are written to the cache.
+	 */
+	HRESULT LoadTexture(const std::string& strTextureName, TEXTUREDATA* pTextureData);
+
+	/*
+	 *  Rebuilds the edge indices from the triangles, every edge is listed once.
+	 *	Vertices with the same position share their edges even if their attributes differ.
+	 */
+	static void BuildEdgeIndices(MESHDATA* pMeshData);
+
+	/*
+	 *  Directory of the cache files (default "Cache\\")
+	 */
+	void SetCacheDirectory(const std::string& strDirectory);
+	std::string GetCacheDirectory() const { return m_strCacheDirectory; }
+
+	/*
+	 *  Enables or disables the cache, a disabled cache always imports the source files
+	 */
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool IsEnabled() const { return m_bEnabled; }
+
+protected:
+	MeshCache();
+	~MeshCache();
+
+	static MeshCache* s_pInstance;
+
+	/*
+	 *  Computes the cache key of a file (FNV-1a of its content mixed with a salt)
+	 */
+	bool ItlComputeKey(const std::string& strFileName, unsigned __int64 nSalt, unsigned __int64* pKey);
+	std::string ItlGetCacheFileName(unsigned __int64 nKey, const char* strExtension);
+
+	/*
+	 *  Reading and writing of the cache files
+	 */
+	bool ItlReadMesh(const std::string& strCacheFile, unsigned __int64 nKey, MESHDATA* pMeshData);
+	bool ItlWriteMesh(const std::string& strCacheFile, unsigned __int64 nKey, const MESHDATA* pMeshData);
+	bool ItlReadTexture(const std::string& strCacheFile, unsigned __int64 nKey, TEXTUREDATA* pTextureData);
+	bool ItlWriteTexture(const std::string& strCacheFile, unsigned __int64 nKey, const TEXTUREDATA* pTextureData);
+	bool ItlWriteFile(const std::string& strCacheFile, const void* pHeader, unsigned int nHeaderSize, const void** ppChunks, const unsigned int* pChunkSizes, unsigned int nNumChunks);
+
+	/*
+	 *  Import of the source files on a cache miss
+	 */
+	HRESULT ItlImportMesh(const std::string& strMeshName, MESHDATA* pMeshData);
+	HRESULT ItlDecodeTexture(const std::string& strTextureName, TEXTUREDATA* pTextureData);
+
+	std::string m_strCacheDirectory;
+	bool m_bEnabled;
+};
+
+#endif
@@ -0,0 +1,478 @@
+#include "MeshDecimation.h"
+#include <algorithm>
+#include <new>
+#include <limits.h>
+
+
+/****************************************************************************
+ ****************************************************************************/
+MeshDecimation::MeshDecimation()
+{
+	m_fMaxCost = 0.0f;
+	m_nNumRemovedTriangles = 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT MeshDecimation::Decimate(MESHDATA* pMesh, float fMaxError)
+{
+	m_nNumRemovedTriangles = 0;
+
+	if(pMesh->vVertices.empty() || pMesh->vTriangleIndices.size() < 3)
+		return E_INVALIDARG;
+	if(fMaxError <= 0.0f)
+		return S_OK;
+
+	m_fMaxCost = fMaxError * fMaxError;
+
+	try
+	{
+		ItlBuildTopology(pMesh);
+
+		for(unsigned int i = 0; i < m_vVertices.size(); i++)
+			ItlQueueCollapses(i);
+
+		while(!m_collapses.empty())
+		{
+			COLLAPSE collapse = m_collapses.top();
+			m_collapses.pop();
+
+			//one of the vertices changed after the collapse was queued, its new collapses are queued as well
+			if(m_vVertexRemoved[collapse.nKeep] || m_vVertexRemoved[collapse.nRemove] ||
+			   m_vStamps[collapse.nKeep] != collapse.nKeepStamp || m_vStamps[collapse.nRemove] != collapse.nRemoveStamp)
+				continue;
+
+			if(!ItlIsValidCollapse(collapse))
+				continue;
+
+			ItlCollapse(collapse);
+		}
+
+		ItlWriteMesh(pMesh);
+	}
+	catch(std::bad_alloc&)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	//free the working set
+	std::vector<SURFACE_VERTEX>().swap(m_vVertices);
+	std::vector<QUADRIC>().swap(m_vQuadrics);
+	std::vector<unsigned int>().swap(m_vStamps);
+	std::vector<unsigned char>().swap(m_vBorder);
+	std::vector<unsigned char>().swap(m_vVertexRemoved);
+	std::vector<std::vector<unsigned int>>().swap(m_vVertexTriangles);
+	std::vector<unsigned int>().swap(m_vTriangles);
+	std::vector<unsigned char>().swap(m_vTriangleRemoved);
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshDecimation::ItlBuildTopology(const MESHDATA* pMesh)
+{
+	const std::vector<SURFACE_VERTEX>& vVertices = pMesh->vVertices;
+	unsigned int nNumVertices = (unsigned int)vVertices.size();
+
+	//weld the vertices with the same position and attributes, the importer splits them per face
+	std::vector<unsigned int> vOrder(nNumVertices);
+	for(unsigned int i = 0; i < nNumVertices; i++)
+		vOrder[i] = i;
+	std::sort(vOrder.begin(), vOrder.end(), [&](unsigned int a, unsigned int b)
+	{
+		return memcmp(&vVertices[a], &vVertices[b], sizeof(SURFACE_VERTEX)) < 0;
+	});
+
+	std::vector<unsigned int> vWelded(nNumVertices);
+	m_vVertices.clear();
+	for(unsigned int i = 0; i < nNumVertices; i++)
+	{
+		if(i == 0 || memcmp(&vVertices[vOrder[i]], &vVertices[vOrder[i - 1]], sizeof(SURFACE_VERTEX)) != 0)
+			m_vVertices.push_back(vVertices[vOrder[i]]);
+		vWelded[vOrder[i]] = (unsigned int)m_vVertices.size() - 1;
+	}
+
+	nNumVertices = (unsigned int)m_vVertices.size();
+	QUADRIC zero;
+	memset(&zero, 0, sizeof(zero));
+	m_vQuadrics.assign(nNumVertices, zero);
+	m_vStamps.assign(nNumVertices, 0);
+	m_vBorder.assign(nNumVertices, 0);
+	m_vVertexRemoved.assign(nNumVertices, 0);
+	m_vVertexTriangles.assign(nNumVertices, std::vector<unsigned int>());
+
+	//triangles that became degenerated by the welding are dropped
+	m_vTriangles.clear();
+	const std::vector<unsigned int>& vIndices = pMesh->vTriangleIndices;
+	for(unsigned int i = 0; i + 2 < vIndices.size(); i += 3)
+	{
+		unsigned int a = vWelded[vIndices[i]], b = vWelded[vIndices[i + 1]], c = vWelded[vIndices[i + 2]];
+		if(a == b || b == c || c == a)
+			continue;
+		m_vTriangles.push_back(a);
+		m_vTriangles.push_back(b);
+		m_vTriangles.push_back(c);
+	}
+
+	unsigned int nNumTriangles = (unsigned int)m_vTriangles.size() / 3;
+	m_vTriangleRemoved.assign(nNumTriangles, 0);
+	m_nNumRemovedTriangles = (unsigned int)vIndices.size() / 3 - nNumTriangles;
+
+	//the edges are sorted to find the ones that do not have exactly two triangles
+	std::vector<unsigned __int64> vEdges;
+	vEdges.reserve(3 * nNumTriangles);
+
+	for(unsigned int t = 0; t < nNumTriangles; t++)
+	{
+		const unsigned int* pTriangle = &m_vTriangles[3 * t];
+		const D3DXVECTOR3& a = m_vVertices[pTriangle[0]].pos;
+		const D3DXVECTOR3& b = m_vVertices[pTriangle[1]].pos;
+		const D3DXVECTOR3& c = m_vVertices[pTriangle[2]].pos;
+
+		//planes are not weighted by the area, so that the cost bounds the distance to every plane
+		D3DXVECTOR3 vNormal, ab = b - a, ac = c - a;
+		D3DXVec3Cross(&vNormal, &ab, &ac);
+		float fLength = D3DXVec3Length(&vNormal);
+
+		for(int i = 0; i < 3; i++)
+		{
+			unsigned int v0 = pTriangle[i], v1 = pTriangle[(i + 1) % 3];
+			m_vVertexTriangles[v0].push_back(t);
+			if(fLength > 0.0f)
+				ItlAddPlane(m_vQuadrics[v0], vNormal / fLength, -D3DXVec3Dot(&vNormal, &a) / fLength);
+			vEdges.push_back(((unsigned __int64)min(v0, v1) << 32) | max(v0, v1));
+		}
+	}
+
+	std::sort(vEdges.begin(), vEdges.end());
+	for(unsigned int i = 0; i < vEdges.size(); )
+	{
+		unsigned int j = i + 1;
+		while(j < vEdges.size() && vEdges[j] == vEdges[i])
+			j++;
+
+		//open borders, seams between attributes and non manifold edges
+		if(j - i != 2)
+		{
+			m_vBorder[(unsigned int)(vEdges[i] >> 32)] = 1;
+			m_vBorder[(unsigned int)(vEdges[i] & 0xffffffff)] = 1;
+		}
+		i = j;
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshDecimation::ItlQueueCollapses(unsigned int nVertex)
+{
+	const std::vector<unsigned int>& vTriangles = m_vVertexTriangles[nVertex];
+	for(unsigned int i = 0; i < vTriangles.size(); i++)
+	{
+		const unsigned int* pTriangle = &m_vTriangles[3 * vTriangles[i]];
+
+		//every edge of the vertex is in two triangles, the one to the next corner is queued
+		for(int j = 0; j < 3; j++)
+		{
+			if(pTriangle[j] != nVertex)
+				continue;
+
+			COLLAPSE collapse;
+			if(ItlComputeCollapse(nVertex, pTriangle[(j + 1) % 3], &collapse) && collapse.fCost <= m_fMaxCost)
+				m_collapses.push(collapse);
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshDecimation::ItlComputeCollapse(unsigned int a, unsigned int b, COLLAPSE* pCollapse) const
+{
+	if(m_vBorder[a] && m_vBorder[b])
+		return false;
+
+	//a border vertex keeps its position
+	if(m_vBorder[b])
+		std::swap(a, b);
+
+	QUADRIC quadric;
+	for(int i = 0; i < 10; i++)
+		quadric.q[i] = m_vQuadrics[a].q[i] + m_vQuadrics[b].q[i];
+
+	const D3DXVECTOR3& vA = m_vVertices[a].pos;
+	const D3DXVECTOR3& vB = m_vVertices[b].pos;
+
+	pCollapse->nKeep = a;
+	pCollapse->nRemove = b;
+	pCollapse->nKeepStamp = m_vStamps[a];
+	pCollapse->nRemoveStamp = m_vStamps[b];
+	pCollapse->vPosition = vA;
+	pCollapse->fAttributeWeight = 0.0f;
+	pCollapse->fCost = (float)ItlEvaluate(quadric, vA);
+
+	if(m_vBorder[a])
+		return true;
+
+	//the optimal position, otherwise the end points and the middle of the edge
+	D3DXVECTOR3 vOptimal;
+	if(ItlMinimize(quadric, &vOptimal))
+	{
+		D3DXVECTOR3 vEdge = vB - vA, vOffset = vOptimal - vA;
+		float fLength2 = D3DXVec3LengthSq(&vEdge);
+		float fCost = (float)ItlEvaluate(quadric, vOptimal);
+		if(fCost < pCollapse->fCost)
+		{
+			pCollapse->vPosition = vOptimal;
+			pCollapse->fAttributeWeight = fLength2 > 0.0f ? min(1.0f, max(0.0f, D3DXVec3Dot(&vOffset, &vEdge) / fLength2)) : 0.0f;
+			pCollapse->fCost = fCost;
+		}
+	}
+
+	float pWeights[2] = { 0.5f, 1.0f };
+	for(int i = 0; i < 2; i++)
+	{
+		D3DXVECTOR3 vPosition = vA + pWeights[i] * (vB - vA);
+		float fCost = (float)ItlEvaluate(quadric, vPosition);
+		if(fCost < pCollapse->fCost)
+		{
+			pCollapse->vPosition = vPosition;
+			pCollapse->fAttributeWeight = pWeights[i];
+			pCollapse->fCost = fCost;
+		}
+	}
+
+	//rounding of the optimal position can give slightly negative costs
+	pCollapse->fCost = max(0.0f, pCollapse->fCost);
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshDecimation::ItlIsValidCollapse(const COLLAPSE& collapse) const
+{
+	unsigned int nKeep = collapse.nKeep;
+	unsigned int nRemove = collapse.nRemove;
+
+	//link condition: the only common neighbors are the opposite corners of the triangles of the edge
+	std::vector<unsigned int> vNeighbors[2];
+	unsigned int nNumSharedTriangles = 0;
+
+	for(int iVertex = 0; iVertex < 2; iVertex++)
+	{
+		unsigned int nVertex = iVertex == 0 ? nKeep : nRemove;
+		const std::vector<unsigned int>& vTriangles = m_vVertexTriangles[nVertex];
+
+		for(unsigned int i = 0; i < vTriangles.size(); i++)
+		{
+			const unsigned int* pTriangle = &m_vTriangles[3 * vTriangles[i]];
+			bool bShared = pTriangle[0] == nKeep || pTriangle[1] == nKeep || pTriangle[2] == nKeep;
+			bShared = bShared && (pTriangle[0] == nRemove || pTriangle[1] == nRemove || pTriangle[2] == nRemove);
+
+			if(bShared)
+			{
+				if(iVertex == 0)
+					nNumSharedTriangles++;
+				continue;
+			}
+
+			for(int j = 0; j < 3; j++)
+			{
+				if(pTriangle[j] != nVertex)
+					vNeighbors[iVertex].push_back(pTriangle[j]);
+			}
+
+			//the triangle must not flip or degenerate at the new position
+			const D3DXVECTOR3* pPositions[3];
+			for(int j = 0; j < 3; j++)
+				pPositions[j] = &m_vVertices[pTriangle[j]].pos;
+
+			D3DXVECTOR3 vOldNormal, ab = *pPositions[1] - *pPositions[0], ac = *pPositions[2] - *pPositions[0];
+			D3DXVec3Cross(&vOldNormal, &ab, &ac);
+
+			for(int j = 0; j < 3; j++)
+			{
+				if(pTriangle[j] == nVertex)
+					pPositions[j] = &collapse.vPosition;
+			}
+
+			D3DXVECTOR3 vNewNormal;
+			ab = *pPositions[1] - *pPositions[0];
+			ac = *pPositions[2] - *pPositions[0];
+			D3DXVec3Cross(&vNewNormal, &ab, &ac);
+
+			if(D3DXVec3Dot(&vOldNormal, &vNewNormal) <= 0.0f)
+				return false;
+		}
+	}
+
+	if(nNumSharedTriangles != 2)
+		return false;
+
+	//the opposite corners of the shared triangles are no neighbors in the other triangles
+	std::sort(vNeighbors[0].begin(), vNeighbors[0].end());
+	std::sort(vNeighbors[1].begin(), vNeighbors[1].end());
+	vNeighbors[0].erase(std::unique(vNeighbors[0].begin(), vNeighbors[0].end()), vNeighbors[0].end());
+	vNeighbors[1].erase(std::unique(vNeighbors[1].begin(), vNeighbors[1].end()), vNeighbors[1].end());
+
+	unsigned int nNumCommon = 0;
+	for(unsigned int i = 0, j = 0; i < vNeighbors[0].size() && j < vNeighbors[1].size(); )
+	{
+		if(vNeighbors[0][i] < vNeighbors[1][j])
+			i++;
+		else if(vNeighbors[1][j] < vNeighbors[0][i])
+			j++;
+		else
+		{
+			nNumCommon++;
+			i++;
+			j++;
+		}
+	}
+
+	//the corners of the shared triangles are also in their neighboring triangles
+	return nNumCommon == 2;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshDecimation::ItlCollapse(const COLLAPSE& collapse)
+{
+	unsigned int nKeep = collapse.nKeep;
+	unsigned int nRemove = collapse.nRemove;
+
+	SURFACE_VERTEX& keep = m_vVertices[nKeep];
+	const SURFACE_VERTEX& remove = m_vVertices[nRemove];
+	float fWeight = collapse.fAttributeWeight;
+	keep.pos = collapse.vPosition;
+	keep.texcoord = keep.texcoord + fWeight * (remove.texcoord - keep.texcoord);
+	keep.color = keep.color + fWeight * (remove.color - keep.color);
+
+	for(int i = 0; i < 10; i++)
+		m_vQuadrics[nKeep].q[i] += m_vQuadrics[nRemove].q[i];
+
+	//the shared triangles are removed, the others are moved to the kept vertex
+	std::vector<unsigned int>& vKeepTriangles = m_vVertexTriangles[nKeep];
+	const std::vector<unsigned int>& vRemoveTriangles = m_vVertexTriangles[nRemove];
+	for(unsigned int i = 0; i < vRemoveTriangles.size(); i++)
+	{
+		unsigned int t = vRemoveTriangles[i];
+		unsigned int* pTriangle = &m_vTriangles[3 * t];
+		if(pTriangle[0] == nKeep || pTriangle[1] == nKeep || pTriangle[2] == nKeep)
+		{
+			m_vTriangleRemoved[t] = 1;
+			m_nNumRemovedTriangles++;
+			continue;
+		}
+
+		for(int j = 0; j < 3; j++)
+		{
+			if(pTriangle[j] == nRemove)
+				pTriangle[j] = nKeep;
+		}
+		vKeepTriangles.push_back(t);
+	}
+
+	unsigned int nNumTriangles = 0;
+	for(unsigned int i = 0; i < vKeepTriangles.size(); i++)
+	{
+		if(!m_vTriangleRemoved[vKeepTriangles[i]])
+			vKeepTriangles[nNumTriangles++] = vKeepTriangles[i];
+	}
+	vKeepTriangles.resize(nNumTriangles);
+
+	m_vVertexRemoved[nRemove] = 1;
+	std::vector<unsigned int>().swap(m_vVertexTriangles[nRemove]);
+
+	m_vStamps[nKeep]++;
+	ItlQueueCollapses(nKeep);
+
+	//the edges from the neighbors to the kept vertex changed as well
+	for(unsigned int i = 0; i < vKeepTriangles.size(); i++)
+	{
+		const unsigned int* pTriangle = &m_vTriangles[3 * vKeepTriangles[i]];
+		for(int j = 0; j < 3; j++)
+		{
+			COLLAPSE neighborCollapse;
+			if(pTriangle[(j + 1) % 3] == nKeep && ItlComputeCollapse(pTriangle[j], nKeep, &neighborCollapse) && neighborCollapse.fCost <= m_fMaxCost)
+				m_collapses.push(neighborCollapse);
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshDecimation::ItlWriteMesh(MESHDATA* pMesh) const
+{
+	std::vector<unsigned int> vRemap(m_vVertices.size(), UINT_MAX);
+	pMesh->vVertices.clear();
+	pMesh->vTriangleIndices.clear();
+
+	for(unsigned int t = 0; t < m_vTriangleRemoved.size(); t++)
+	{
+		if(m_vTriangleRemoved[t])
+			continue;
+
+		for(int i = 0; i < 3; i++)
+		{
+			unsigned int nVertex = m_vTriangles[3 * t + i];
+			if(vRemap[nVertex] == UINT_MAX)
+			{
+				vRemap[nVertex] = (unsigned int)pMesh->vVertices.size();
+				pMesh->vVertices.push_back(m_vVertices[nVertex]);
+			}
+			pMesh->vTriangleIndices.push_back(vRemap[nVertex]);
+		}
+	}
+
+	//same edge list as the import
+	MeshCache::BuildEdgeIndices(pMesh);
+
+	//fMaxVertexValue is kept, the normalization of the model does not change
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void MeshDecimation::ItlAddPlane(QUADRIC& quadric, const D3DXVECTOR3& vNormal, float fDistance)
+{
+	double a = vNormal.x, b = vNormal.y, c = vNormal.z, d = fDistance;
+	double* q = quadric.q;
+	q[0] += a * a; q[1] += a * b; q[2] += a * c; q[3] += a * d;
+	q[4] += b * b; q[5] += b * c; q[6] += b * d;
+	q[7] += c * c; q[8] += c * d;
+	q[9] += d * d;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+double MeshDecimation::ItlEvaluate(const QUADRIC& quadric, const D3DXVECTOR3& v)
+{
+	const double* q = quadric.q;
+	double x = v.x, y = v.y, z = v.z;
+	return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+		 + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+		 + q[7] * z * z + 2.0 * q[8] * z
+		 + q[9];
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool MeshDecimation::ItlMinimize(const QUADRIC& quadric, D3DXVECTOR3* pPosition)
+{
+	const double* q = quadric.q;
+
+	//gradient is zero: A x = -b with the upper 3x3 matrix A, Cramer's rule
+	double fDet = q[0] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * q[5] - q[4] * q[2]);
+
+	//the planes of a flat or cylindrical neighborhood do not define a point
+	double fScale = q[0] + q[4] + q[7];
+	if(fabs(fDet) <= 1e-6 * fScale * fScale * fScale)
+		return false;
+
+	double bx = -q[3], by = -q[6], bz = -q[8];
+	double x = bx * (q[4] * q[7] - q[5] * q[5]) - q[1] * (by * q[7] - q[5] * bz) + q[2] * (by * q[5] - q[4] * bz);
+	double y = q[0] * (by * q[7] - q[5] * bz) - bx * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * bz - by * q[2]);
+	double z = q[0] * (q[4] * bz - by * q[5]) - q[1] * (q[1] * bz - by * q[2]) + bx * (q[1] * q[5] - q[4] * q[2]);
+
+	*pPosition = D3DXVECTOR3((float)(x / fDet), (float)(y / fDet), (float)(z / fDet));
+	return true;
+}
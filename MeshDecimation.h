@@ -0,0 +1,106 @@
+#ifndef _MESHDECIMATION_H_
+#define _MESHDECIMATION_H_
+
+#include "Globals.h"
+#include "MeshCache.h"
+#include <vector>
+#include <queue>
+
+/*
+ *  Edge collapse decimation with quadric error metrics (Garland and Heckbert 1997).
+ *	The quadric of a vertex sums the squared distances to the planes of the original triangles
+ *	around it, a collapse with a cost below fMaxError^2 keeps the vertex within fMaxError of all
+ *	of these planes. Vertices with the same position and attributes are welded first, vertices on
+ *	open borders and attribute seams are never moved.
+ */
+class MeshDecimation
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	MeshDecimation();
+
+	/*
+	 *  Decimates the mesh in place, fMaxError is in model space. The edge indices are rebuilt
+	 *	from the remaining triangles.
+	 */
+	HRESULT Decimate(MESHDATA* pMesh, float fMaxError);
+
+	/*
+	 *  Number of triangles that were removed by the last call of Decimate
+	 */
+	unsigned int GetNumRemovedTriangles() const { return m_nNumRemovedTriangles; }
+
+protected:
+	//symmetric 4x4 matrix: a2, ab, ac, ad, b2, bc, bd, c2, cd, d2
+	struct QUADRIC
+	{
+		double q[10];
+	};
+
+	struct COLLAPSE
+	{
+		float fCost;
+		unsigned int nKeep;
+		unsigned int nRemove;
+		unsigned int nKeepStamp;
+		unsigned int nRemoveStamp;
+		D3DXVECTOR3 vPosition;
+		float fAttributeWeight;		//attributes of the kept vertex are interpolated towards the removed one
+
+		//std::priority_queue returns the largest element first
+		bool operator<(const COLLAPSE& other) const { return fCost > other.fCost; }
+	};
+
+	/*
+	 *  Welds the vertices, builds the triangle lists, quadrics and border flags of the vertices
+	 */
+	void ItlBuildTopology(const MESHDATA* pMesh);
+
+	/*
+	 *  Cheapest collapse of the edge ab, false if both vertices are on a border
+	 */
+	bool ItlComputeCollapse(unsigned int a, unsigned int b, COLLAPSE* pCollapse) const;
+
+	/*
+	 *  Checks that the collapse keeps the mesh manifold and flips no triangle
+	 */
+	bool ItlIsValidCollapse(const COLLAPSE& collapse) const;
+
+	void ItlCollapse(const COLLAPSE& collapse);
+
+	/*
+	 *  Queues the collapses of all edges of the vertex that are below the error bound
+	 */
+	void ItlQueueCollapses(unsigned int nVertex);
+
+	/*
+	 *  Writes the remaining vertices and triangles into the mesh
+	 */
+	void ItlWriteMesh(MESHDATA* pMesh) const;
+
+	static void ItlAddPlane(QUADRIC& quadric, const D3DXVECTOR3& vNormal, float fDistance);
+	static double ItlEvaluate(const QUADRIC& quadric, const D3DXVECTOR3& v);
+
+	/*
+	 *  Position with the minimal error, false if the quadric is singular (planar or linear neighborhood)
+	 */
+	static bool ItlMinimize(const QUADRIC& quadric, D3DXVECTOR3* pPosition);
+
+	std::vector<SURFACE_VERTEX> m_vVertices;
+	std::vector<QUADRIC> m_vQuadrics;
+	std::vector<unsigned int> m_vStamps;		//incremented whenever a vertex changes, invalidates its queued collapses
+	std::vector<unsigned char> m_vBorder;
+	std::vector<unsigned char> m_vVertexRemoved;
+	std::vector<std::vector<unsigned int>> m_vVertexTriangles;
+
+	std::vector<unsigned int> m_vTriangles;
+	std::vector<unsigned char> m_vTriangleRemoved;
+
+	std::priority_queue<COLLAPSE> m_collapses;
+	float m_fMaxCost;
+	unsigned int m_nNumRemovedTriangles;
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "OrientedBoundingBox.h"
+#include <float.h>
+
+//maximum number of points that are used to search the rotation of the box
+#define OBB_MAX_SEARCH_POINTS 4096
+
+//the box is rotated around each axis in steps of this angle (degrees) between 0 and 90 degrees
+#define OBB_SEARCH_ANGLE_STEP 3
+
+
+/****************************************************************************
+ ****************************************************************************/
+OrientedBoundingBox::OrientedBoundingBox()
+{
+	m_vMin = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	m_vMax = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+	D3DXMatrixIdentity(&m_mWorldToLocal);
+	D3DXMatrixIdentity(&m_mLocalToWorld);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::BuildAxisAligned(const std::vector<D3DXVECTOR3>& vPoints)
+{
+	D3DXVECTOR3 pAxes[3] = { D3DXVECTOR3(1.0f, 0.0f, 0.0f), D3DXVECTOR3(0.0f, 1.0f, 0.0f), D3DXVECTOR3(0.0f, 0.0f, 1.0f) };
+	ItlFit(vPoints, pAxes);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::BuildOriented(const std::vector<D3DXVECTOR3>& vPoints)
+{
+	D3DXVECTOR3 pWorldAxes[3] = { D3DXVECTOR3(1.0f, 0.0f, 0.0f), D3DXVECTOR3(0.0f, 1.0f, 0.0f), D3DXVECTOR3(0.0f, 0.0f, 1.0f) };
+
+	if(vPoints.size() < 4)
+	{
+		ItlFit(vPoints, pWorldAxes);
+		return;
+	}
+
+	//the search only needs a subset of the points
+	std::vector<D3DXVECTOR3> vSearchPoints;
+	unsigned int nStep = max(1u, (unsigned int)vPoints.size() / OBB_MAX_SEARCH_POINTS);
+	for(unsigned int i = 0; i < vPoints.size(); i += nStep)
+		vSearchPoints.push_back(vPoints[i]);
+
+	//covariance matrix of the points
+	D3DXVECTOR3 vMean(0.0f, 0.0f, 0.0f);
+	for(unsigned int i = 0; i < vSearchPoints.size(); i++)
+		vMean += vSearchPoints[i];
+	vMean /= float(vSearchPoints.size());
+
+	double pCovariance[3][3] = { {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0} };
+	for(unsigned int i = 0; i < vSearchPoints.size(); i++)
+	{
+		D3DXVECTOR3 vDiff = vSearchPoints[i] - vMean;
+		const float* pDiff = vDiff;
+		for(int r = 0; r < 3; r++)
+			for(int c = 0; c < 3; c++)
+				pCovariance[r][c] += double(pDiff[r]) * double(pDiff[c]);
+	}
+
+	//principal axes as right handed frame
+	D3DXVECTOR3 pAxes[3];
+	ItlEigenvectors(pCovariance, pAxes);
+	D3DXVec3Normalize(&pAxes[0], &pAxes[0]);
+	D3DXVec3Cross(&pAxes[2], &pAxes[0], &pAxes[1]);
+	D3DXVec3Normalize(&pAxes[2], &pAxes[2]);
+	D3DXVec3Cross(&pAxes[1], &pAxes[2], &pAxes[0]);
+
+	//the principal axes are not always the axes of the smallest box, so the box is rotated around each of them
+	float fBestVolume = ItlVolume(vSearchPoints, pAxes);
+	for(int k = 0; k < 3; k++)
+	{
+		int i = (k + 1) % 3;
+		int j = (k + 2) % 3;
+
+		D3DXVECTOR3 vAxisI = pAxes[i];
+		D3DXVECTOR3 vAxisJ = pAxes[j];
+
+		for(int iAngle = OBB_SEARCH_ANGLE_STEP; iAngle < 90; iAngle += OBB_SEARCH_ANGLE_STEP)
+		{
+			float fAngle = float(iAngle * PI / 180.0);
+			D3DXVECTOR3 pRotated[3];
+			pRotated[k] = pAxes[k];
+			pRotated[i] = cos(fAngle) * vAxisI + sin(fAngle) * vAxisJ;
+			pRotated[j] = cos(fAngle) * vAxisJ - sin(fAngle) * vAxisI;
+
+			float fVolume = ItlVolume(vSearchPoints, pRotated);
+			if(fVolume < fBestVolume)
+			{
+				fBestVolume = fVolume;
+				pAxes[i] = pRotated[i];
+				pAxes[j] = pRotated[j];
+			}
+		}
+	}
+
+	//never return a box that is bigger than the axis aligned one
+	if(ItlVolume(vSearchPoints, pWorldAxes) <= fBestVolume)
+		ItlFit(vPoints, pWorldAxes);
+	else
+		ItlFit(vPoints, pAxes);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::Pad(float fMargin)
+{
+	D3DXVECTOR3 vMargin(fMargin, fMargin, fMargin);
+	m_vMin -= vMargin;
+	m_vMax += vMargin;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::Grow(const D3DXVECTOR3& vExtent)
+{
+	D3DXVECTOR3 vDiff = vExtent - GetExtent();
+	vDiff.x = max(0.0f, vDiff.x);
+	vDiff.y = max(0.0f, vDiff.y);
+	vDiff.z = max(0.0f, vDiff.z);
+
+	m_vMin -= 0.5f * vDiff;
+	m_vMax += 0.5f * vDiff;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::ItlFit(const std::vector<D3DXVECTOR3>& vPoints, const D3DXVECTOR3* pAxes)
+{
+	//the rows of the local to world matrix are the axes, the world to local matrix is its transpose
+	D3DXMatrixIdentity(&m_mLocalToWorld);
+	for(int i = 0; i < 3; i++)
+	{
+		m_mLocalToWorld.m[i][0] = pAxes[i].x;
+		m_mLocalToWorld.m[i][1] = pAxes[i].y;
+		m_mLocalToWorld.m[i][2] = pAxes[i].z;
+	}
+	D3DXMatrixTranspose(&m_mWorldToLocal, &m_mLocalToWorld);
+
+	if(vPoints.empty())
+	{
+		m_vMin = m_vMax = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	m_vMin = D3DXVECTOR3(FLT_MAX, FLT_MAX, FLT_MAX);
+	m_vMax = D3DXVECTOR3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(unsigned int i = 0; i < vPoints.size(); i++)
+	{
+		D3DXVECTOR3 vLocal(D3DXVec3Dot(&vPoints[i], &pAxes[0]), D3DXVec3Dot(&vPoints[i], &pAxes[1]), D3DXVec3Dot(&vPoints[i], &pAxes[2]));
+		D3DXVec3Minimize(&m_vMin, &m_vMin, &vLocal);
+		D3DXVec3Maximize(&m_vMax, &m_vMax, &vLocal);
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+float OrientedBoundingBox::ItlVolume(const std::vector<D3DXVECTOR3>& vPoints, const D3DXVECTOR3* pAxes)
+{
+	float pMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float pMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for(unsigned int i = 0; i < vPoints.size(); i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			float fProjection = D3DXVec3Dot(&vPoints[i], &pAxes[j]);
+			pMin[j] = min(pMin[j], fProjection);
+			pMax[j] = max(pMax[j], fProjection);
+		}
+	}
+
+	return (pMax[0] - pMin[0]) * (pMax[1] - pMin[1]) * (pMax[2] - pMin[2]);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void OrientedBoundingBox::ItlEigenvectors(double pMatrix[3][3], D3DXVECTOR3* pAxes)
+{
+	double pVectors[3][3] = { {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0} };
+
+	//cyclic jacobi rotations, a few sweeps are enough for a 3x3 matrix
+	for(int iSweep = 0; iSweep < 50; iSweep++)
+	{
+		double fOffDiagonal = fabs(pMatrix[0][1]) + fabs(pMatrix[0][2]) + fabs(pMatrix[1][2]);
+		if(fOffDiagonal < 1e-12)
+			break;
+
+		for(int p = 0; p < 2; p++)
+		{
+			for(int q = p + 1; q < 3; q++)
+			{
+				if(fabs(pMatrix[p][q]) < 1e-15)
+					continue;
+
+				double fTheta = (pMatrix[q][q] - pMatrix[p][p]) / (2.0 * pMatrix[p][q]);
+				double t = (fTheta >= 0.0 ? 1.0 : -1.0) / (fabs(fTheta) + sqrt(fTheta * fTheta + 1.0));
+				double c = 1.0 / sqrt(t * t + 1.0);
+				double s = t * c;
+
+				//A' = J^T A J
+				for(int k = 0; k < 3; k++)
+				{
+					double fKP = pMatrix[k][p];
+					double fKQ = pMatrix[k][q];
+					pMatrix[k][p] = c * fKP - s * fKQ;
+					pMatrix[k][q] = s * fKP + c * fKQ;
+				}
+				for(int k = 0; k < 3; k++)
+				{
+					double fPK = pMatrix[p][k];
+					double fQK = pMatrix[q][k];
+					pMatrix[p][k] = c * fPK - s * fQK;
+					pMatrix[q][k] = s * fPK + c * fQK;
+				}
+
+				//V' = V J, the columns of V are the eigenvectors
+				for(int k = 0; k < 3; k++)
+				{
+					double fKP = pVectors[k][p];
+					double fKQ = pVectors[k][q];
+					pVectors[k][p] = c * fKP - s * fKQ;
+					pVectors[k][q] = s * fKP + c * fKQ;
+				}
+			}
+		}
+	}
+
+	//sort by descending eigenvalue
+	int pOrder[3] = { 0, 1, 2 };
+	for(int i = 0; i < 2; i++)
+		for(int j = i + 1; j < 3; j++)
+			if(pMatrix[pOrder[j]][pOrder[j]] > pMatrix[pOrder[i]][pOrder[i]])
+			{
+				int iTemp = pOrder[i];
+				pOrder[i] = pOrder[j];
+				pOrder[j] = iTemp;
+			}
+
+	for(int i = 0; i < 3; i++)
+		pAxes[i] = D3DXVECTOR3(float(pVectors[0][pOrder[i]]), float(pVectors[1][pOrder[i]]), float(pVectors[2][pOrder[i]]));
+}
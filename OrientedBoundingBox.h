@@ -0,0 +1,77 @@
+#ifndef _ORIENTEDBOUNDINGBOX_H_
+#define _ORIENTEDBOUNDINGBOX_H_
+
+#include "Globals.h"
+#include <vector>
+
+/*
+ *  Bounding box of a point set in its own orthonormal frame.
+ *	The frame is either the world frame (axis aligned box) or found with a principal component
+ *	analysis of the points that is refined by rotating the box around each of its axes to
+ *	approximate the box with the minimum volume.
+ */
+class OrientedBoundingBox
+{
+public:
+	/*
+	 *  Constructor, creates an empty axis aligned box
+	 */
+	OrientedBoundingBox();
+
+	/*
+	 *  Fits an axis aligned box around the points
+	 */
+	void BuildAxisAligned(const std::vector<D3DXVECTOR3>& vPoints);
+
+	/*
+	 *  Fits an oriented box around the points. The box is never bigger than the axis aligned one.
+	 */
+	void BuildOriented(const std::vector<D3DXVECTOR3>& vPoints);
+
+	/*
+	 *  Enlarges the box by fMargin on every side
+	 */
+	void Pad(float fMargin);
+
+	/*
+	 *  Enlarges the box symmetrically to the given extent, smaller extents are ignored
+	 */
+	void Grow(const D3DXVECTOR3& vExtent);
+
+	/*
+	 *  Bounds of the box in its local frame
+	 */
+	const D3DXVECTOR3& GetMin() const { return m_vMin; }
+	const D3DXVECTOR3& GetMax() const { return m_vMax; }
+	D3DXVECTOR3 GetExtent() const { return m_vMax - m_vMin; }
+
+	/*
+	 *  Transformation from world space into the local frame of the box and back (rotation only)
+	 */
+	const D3DXMATRIX& GetWorldToLocal() const { return m_mWorldToLocal; }
+	const D3DXMATRIX& GetLocalToWorld() const { return m_mLocalToWorld; }
+
+protected:
+	/*
+	 *  Sets the frame to the given right handed orthonormal axes and fits the bounds to the points
+	 */
+	void ItlFit(const std::vector<D3DXVECTOR3>& vPoints, const D3DXVECTOR3* pAxes);
+
+	/*
+	 *  Volume of the box around the points in the frame of the given axes
+	 */
+	static float ItlVolume(const std::vector<D3DXVECTOR3>& vPoints, const D3DXVECTOR3* pAxes);
+
+	/*
+	 *  Eigenvectors of a symmetric 3x3 matrix (Jacobi rotations), sorted by descending eigenvalue
+	 */
+	static void ItlEigenvectors(double pMatrix[3][3], D3DXVECTOR3* pAxes);
+
+	D3DXVECTOR3 m_vMin;
+	D3DXVECTOR3 m_vMax;
+
+	D3DXMATRIX m_mWorldToLocal;
+	D3DXMATRIX m_mLocalToWorld;
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "Profiler.h"
+#include <iomanip>
+#include <limits.h>
+
+Profiler* Profiler::s_pInstance = NULL;
+
+Profiler* Profiler::GetInstance()
+{
+	if(s_pInstance == NULL)
+		s_pInstance = new Profiler();
+	return s_pInstance;
+}
+
+void Profiler::DeleteInstance()
+{
+	SAFE_DELETE(s_pInstance);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+Profiler::Profiler()
+{
+	m_bEnabled = true;
+	m_bSynchronize = false;
+	m_nDropped = 0;
+	m_dwThreadId = GetCurrentThreadId();
+	m_pContext = NULL;
+	m_pEventQuery = NULL;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_nFrequency = frequency.QuadPart;
+	m_nStartTime = ItlGetTime();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+Profiler::~Profiler()
+{
+	SAFE_RELEASE(m_pEventQuery);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+LONGLONG Profiler::ItlGetTime() const
+{
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	return time.QuadPart;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::BeginEvent(const char* szName)
+{
+	if(!ItlIsRecording())
+		return;
+
+	if(m_vEvents.size() >= PROFILER_MAX_EVENTS)
+	{
+		//keep the nesting consistent, the event is not stored
+		m_vOpenEvents.push_back(UINT_MAX);
+		m_nDropped++;
+		return;
+	}
+
+	PROFILE_EVENT event;
+	event.sName = szName;
+	event.iDepth = (int)m_vOpenEvents.size();
+	event.nEnd = 0;
+
+	m_vOpenEvents.push_back((unsigned int)m_vEvents.size());
+	m_vEvents.push_back(event);
+
+	//the start time is taken last so the bookkeeping is not measured
+	m_vEvents.back().nStart = ItlGetTime();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::EndEvent()
+{
+	if(GetCurrentThreadId() != m_dwThreadId || m_vOpenEvents.empty())
+		return;
+
+	if(m_bSynchronize)
+		ItlWaitForGPU();
+
+	LONGLONG nEnd = ItlGetTime();
+
+	unsigned int nEvent = m_vOpenEvents.back();
+	m_vOpenEvents.pop_back();
+
+	if(nEvent != UINT_MAX)
+		m_vEvents[nEvent].nEnd = nEnd;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::AddCounter(const char* szName, double fValue)
+{
+	if(!ItlIsRecording())
+		return;
+
+	double& fTotal = m_mCounters[szName];
+	fTotal += fValue;
+
+	if(m_vCounterSamples.size() >= PROFILER_MAX_EVENTS)
+	{
+		m_nDropped++;
+		return;
+	}
+
+	PROFILE_COUNTER_SAMPLE sample;
+	sample.sName = szName;
+	sample.nTime = ItlGetTime();
+	sample.fTotal = fTotal;
+	m_vCounterSamples.push_back(sample);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::Clear()
+{
+	m_vEvents.clear();
+	m_vOpenEvents.clear();
+	m_vCounterSamples.clear();
+	m_mCounters.clear();
+	m_nDropped = 0;
+	m_nStartTime = ItlGetTime();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::SetContext(ID3D11DeviceContext* pd3dImmediateContext)
+{
+	//the query belongs to the device of the old context
+	if(pd3dImmediateContext != m_pContext)
+		SAFE_RELEASE(m_pEventQuery);
+
+	m_pContext = pd3dImmediateContext;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::ItlWaitForGPU()
+{
+	if(m_pContext == NULL)
+		return;
+
+	if(m_pEventQuery == NULL)
+	{
+		ID3D11Device* pDevice = NULL;
+		m_pContext->GetDevice(&pDevice);
+
+		D3D11_QUERY_DESC queryDesc;
+		queryDesc.Query = D3D11_QUERY_EVENT;
+		queryDesc.MiscFlags = 0;
+		HRESULT hr = pDevice->CreateQuery(&queryDesc, &m_pEventQuery);
+		SAFE_RELEASE(pDevice);
+		if(FAILED(hr))
+			return;
+	}
+
+	m_pContext->End(m_pEventQuery);
+	while(m_pContext->GetData(m_pEventQuery, NULL, 0, 0) == S_FALSE)
+		;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+double Profiler::GetTotalTime(const char* szName) const
+{
+	double fTotal = 0.0;
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		if(m_vEvents[i].nEnd != 0 && m_vEvents[i].sName == szName)
+			fTotal += ItlToMilliseconds(m_vEvents[i].nEnd - m_vEvents[i].nStart);
+	}
+	return fTotal;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Profiler::ItlComputeStatistics(std::map<std::string, PROFILE_STATISTICS>& mStatistics) const
+{
+	mStatistics.clear();
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		const PROFILE_EVENT& event = m_vEvents[i];
+		if(event.nEnd == 0)
+			continue;
+
+		double fDuration = ItlToMilliseconds(event.nEnd - event.nStart);
+
+		std::map<std::string, PROFILE_STATISTICS>::iterator it = mStatistics.find(event.sName);
+		if(it == mStatistics.end())
+		{
+			PROFILE_STATISTICS statistics;
+			statistics.nCount = 1;
+			statistics.fTotal = statistics.fMin = statistics.fMax = fDuration;
+			mStatistics[event.sName] = statistics;
+		}
+		else
+		{
+			it->second.nCount++;
+			it->second.fTotal += fDuration;
+			it->second.fMin = min(it->second.fMin, fDuration);
+			it->second.fMax = max(it->second.fMax, fDuration);
+		}
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+double Profiler::ItlGetBusyTime() const
+{
+	double fBusy = 0.0;
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		if(m_vEvents[i].iDepth == 0 && m_vEvents[i].nEnd != 0)
+			fBusy += ItlToMilliseconds(m_vEvents[i].nEnd - m_vEvents[i].nStart);
+	}
+	return fBusy;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Profiler::SaveJSON(LPCTSTR sDestination) const
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(4);
+
+	ss << "{\n  \"events\": [\n";
+	bool bFirst = true;
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		const PROFILE_EVENT& event = m_vEvents[i];
+		if(event.nEnd == 0)
+			continue;
+
+		ss << (bFirst ? "" : ",\n") << "    {\"name\": \"" << ItlEscape(event.sName) << "\""
+		   << ", \"start_ms\": " << ItlToMilliseconds(event.nStart - m_nStartTime)
+		   << ", \"duration_ms\": " << ItlToMilliseconds(event.nEnd - event.nStart)
+		   << ", \"depth\": " << event.iDepth << "}";
+		bFirst = false;
+	}
+	ss << "\n  ],\n";
+
+	std::map<std::string, PROFILE_STATISTICS> mStatistics;
+	ItlComputeStatistics(mStatistics);
+
+	ss << "  \"stages\": {\n";
+	bFirst = true;
+	for(std::map<std::string, PROFILE_STATISTICS>::iterator it = mStatistics.begin(); it != mStatistics.end(); it++)
+	{
+		ss << (bFirst ? "" : ",\n") << "    \"" << ItlEscape(it->first) << "\": {"
+		   << "\"count\": " << it->second.nCount
+		   << ", \"total_ms\": " << it->second.fTotal
+		   << ", \"mean_ms\": " << it->second.fTotal / it->second.nCount
+		   << ", \"min_ms\": " << it->second.fMin
+		   << ", \"max_ms\": " << it->second.fMax << "}";
+		bFirst = false;
+	}
+	ss << "\n  },\n";
+
+	//rates are relative to the time spent in top level events
+	double fBusySeconds = ItlGetBusyTime() / 1000.0;
+
+	ss << "  \"counters\": {\n";
+	bFirst = true;
+	for(std::map<std::string, double>::const_iterator it = m_mCounters.begin(); it != m_mCounters.end(); it++)
+	{
+		ss << (bFirst ? "" : ",\n") << "    \"" << ItlEscape(it->first) << "\": {"
+		   << "\"total\": " << it->second
+		   << ", \"per_second\": " << (fBusySeconds > 0.0 ? it->second / fBusySeconds : 0.0) << "}";
+		bFirst = false;
+	}
+	ss << "\n  },\n";
+
+	ss << "  \"busy_ms\": " << fBusySeconds * 1000.0 << ",\n";
+	ss << "  \"dropped\": " << m_nDropped << "\n}\n";
+
+	return ItlWriteFile(sDestination, ss.str());
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Profiler::SaveCSV(LPCTSTR sDestination) const
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(4);
+
+	ss << "name,start_ms,duration_ms,depth\n";
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		const PROFILE_EVENT& event = m_vEvents[i];
+		if(event.nEnd == 0)
+			continue;
+
+		ss << "\"" << event.sName << "\","
+		   << ItlToMilliseconds(event.nStart - m_nStartTime) << ","
+		   << ItlToMilliseconds(event.nEnd - event.nStart) << ","
+		   << event.iDepth << "\n";
+	}
+
+	return ItlWriteFile(sDestination, ss.str());
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Profiler::SaveChromeTrace(LPCTSTR sDestination) const
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(3);
+
+	//timestamps and durations are in microseconds
+	ss << "{\"traceEvents\": [\n";
+	bool bFirst = true;
+	for(unsigned int i = 0; i < m_vEvents.size(); i++)
+	{
+		const PROFILE_EVENT& event = m_vEvents[i];
+		if(event.nEnd == 0)
+			continue;
+
+		ss << (bFirst ? "" : ",\n") << "{\"name\": \"" << ItlEscape(event.sName) << "\", \"cat\": \"morph\", \"ph\": \"X\""
+		   << ", \"ts\": " << 1000.0 * ItlToMilliseconds(event.nStart - m_nStartTime)
+		   << ", \"dur\": " << 1000.0 * ItlToMilliseconds(event.nEnd - event.nStart)
+		   << ", \"pid\": 0, \"tid\": 0}";
+		bFirst = false;
+	}
+
+	for(unsigned int i = 0; i < m_vCounterSamples.size(); i++)
+	{
+		const PROFILE_COUNTER_SAMPLE& sample = m_vCounterSamples[i];
+
+		ss << (bFirst ? "" : ",\n") << "{\"name\": \"" << ItlEscape(sample.sName) << "\", \"ph\": \"C\""
+		   << ", \"ts\": " << 1000.0 * ItlToMilliseconds(sample.nTime - m_nStartTime)
+		   << ", \"pid\": 0, \"args\": {\"total\": " << sample.fTotal << "}}";
+		bFirst = false;
+	}
+	ss << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+
+	return ItlWriteFile(sDestination, ss.str());
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Profiler::ItlWriteFile(LPCTSTR sDestination, const std::string& sContent)
+{
+	HANDLE hFile = CreateFile(sDestination, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return E_FAIL;
+
+	DWORD nWritten = 0;
+	BOOL bSuccess = WriteFile(hFile, sContent.c_str(), (DWORD)sContent.size(), &nWritten, NULL);
+	CloseHandle(hFile);
+
+	return (bSuccess && nWritten == sContent.size()) ? S_OK : E_FAIL;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+std::string Profiler::ItlEscape(const std::string& sString)
+{
+	std::string sEscaped;
+	for(unsigned int i = 0; i < sString.size(); i++)
+	{
+		if(sString[i] == '"' || sString[i] == '\\')
+			sEscaped += '\\';
+		sEscaped += sString[i];
+	}
+	return sEscaped;
+}
@@ -0,0 +1,155 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "Globals.h"
+#include <vector>
+#include <map>
+
+//maximum number of recorded events and counter samples, further ones are dropped
+#define PROFILER_MAX_EVENTS 1000000
+
+/*
+ *  Records nested, named timing events with the high resolution performance counter and
+ *	accumulates counters (voxels, bytes, ...). The trace can be saved as JSON, CSV or in the
+ *	Chrome trace format (chrome://tracing).
+ *
+ *	GPU work is asynchronous, the CPU timers only measure the submission unless the profiler
+ *	waits for the GPU at the end of every event (SetSynchronize).
+ *
+ *	The profiler is shared by all scenes but only records the thread that created it, events of
+ *	scenes that run on other threads are ignored.
+ */
+class Profiler
+{
+public:
+	static Profiler* GetInstance();
+	static void DeleteInstance();
+
+	/*
+	 *  Starts and ends an event, events can be nested
+	 */
+	void BeginEvent(const char* szName);
+	void EndEvent();
+
+	/*
+	 *  Adds a value to a counter
+	 */
+	void AddCounter(const char* szName, double fValue);
+
+	/*
+	 *  Removes all events and counters
+	 */
+	void Clear();
+
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool IsEnabled() const { return m_bEnabled; }
+
+	/*
+	 *  if true, EndEvent waits until the GPU has finished all submitted work
+	 */
+	void SetSynchronize(bool bSynchronize) { m_bSynchronize = bSynchronize; }
+
+	/*
+	 *  Context that is synchronized, the immediate context of the viewer
+	 */
+	void SetContext(ID3D11DeviceContext* pd3dImmediateContext);
+
+	/*
+	 *  Total time in ms of all events with the given name
+	 */
+	double GetTotalTime(const char* szName) const;
+
+	/*
+	 *  Saves the trace
+	 *		- JSON: all events, statistics per event name and counters
+	 *		- CSV: one line per event
+	 *		- Chrome trace: complete events and counter events
+	 */
+	HRESULT SaveJSON(LPCTSTR sDestination) const;
+	HRESULT SaveCSV(LPCTSTR sDestination) const;
+	HRESULT SaveChromeTrace(LPCTSTR sDestination) const;
+
+protected:
+	Profiler();
+	~Profiler();
+
+	struct PROFILE_EVENT
+	{
+		std::string sName;
+		LONGLONG	nStart;
+		LONGLONG	nEnd;
+		int			iDepth;
+	};
+
+	struct PROFILE_COUNTER_SAMPLE
+	{
+		std::string sName;
+		LONGLONG	nTime;
+		double		fTotal;
+	};
+
+	struct PROFILE_STATISTICS
+	{
+		unsigned int	nCount;
+		double			fTotal;
+		double			fMin;
+		double			fMax;
+	};
+
+	LONGLONG ItlGetTime() const;
+	double ItlToMilliseconds(LONGLONG nTicks) const { return double(nTicks) * 1000.0 / double(m_nFrequency); }
+
+	/*
+	 *  Blocks until the GPU is idle
+	 */
+	void ItlWaitForGPU();
+
+	/*
+	 *  true, if the calling thread is recorded
+	 */
+	bool ItlIsRecording() const { return m_bEnabled && GetCurrentThreadId() == m_dwThreadId; }
+
+	void ItlComputeStatistics(std::map<std::string, PROFILE_STATISTICS>& mStatistics) const;
+
+	/*
+	 *  Sum of the durations of all top level events in ms
+	 */
+	double ItlGetBusyTime() const;
+
+	static HRESULT ItlWriteFile(LPCTSTR sDestination, const std::string& sContent);
+	static std::string ItlEscape(const std::string& sString);
+
+	static Profiler* s_pInstance;
+
+	bool m_bEnabled;
+	bool m_bSynchronize;
+	DWORD m_dwThreadId;
+
+	LONGLONG m_nFrequency;
+	LONGLONG m_nStartTime;
+
+	std::vector<PROFILE_EVENT>				m_vEvents;
+	std::vector<unsigned int>				m_vOpenEvents;
+	std::vector<PROFILE_COUNTER_SAMPLE>		m_vCounterSamples;
+	std::map<std::string, double>			m_mCounters;
+	unsigned int							m_nDropped;
+
+	ID3D11DeviceContext*	m_pContext;
+	ID3D11Query*			m_pEventQuery;
+};
+
+/*
+ *  Measures the lifetime of the object as event
+ */
+class ProfileScope
+{
+public:
+	ProfileScope(const char* szName) { Profiler::GetInstance()->BeginEvent(szName); }
+	~ProfileScope() { Profiler::GetInstance()->EndEvent(); }
+};
+
+#define PROFILE_SCOPE_NAME2(line) profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(szName) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(szName)
+
+#endif
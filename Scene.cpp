@@ -4,6 +4,11 @@
 #include "Voronoi.h"
 #include "Diffusion.h"
 #include "TextureManager.h"
+#include "BrickMap.h"
+#include "OrientedBoundingBox.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <limits.h>
 
 Scene* Scene::s_pInstance = NULL;
 
@@ -23,6 +28,10 @@ void	Scene::DeleteInstance()
  ****************************************************************************/
 Scene::Scene()
 {
+	m_pd3dDevice = NULL;
+	m_pd3dImmediateContext = NULL;
+	m_pTextureManager = new TextureManager(this);
+
 	m_pVolumeRenderEffect = NULL;
 	m_pDiffusionEffect = NULL;
 	m_pVoronoiEffect = NULL;
@@ -35,10 +44,27 @@ Scene::Scene()
 	m_bGenerateDiffusion = false;
 	m_bIsoValueChanged = true;
 	m_bGenerateOneSliceTexture = true;
+	m_bNestingChanged = true;
+	m_bBoundingBoxChanged = true;
 
 	m_iTextureWidth = 128;
 	m_iTextureHeight = 128;
 	m_iTextureDepth = 128;
+	m_iMaxResolution = 128;
+
+	D3DXMatrixIdentity(&m_mWorldToVolume);
+	D3DXMatrixIdentity(&m_mVolumeToWorld);
+	m_bOrientedBoundingBox = false;
+	m_fBoundingBoxPadding = 0.1f;
+	m_iTextureAlignment = 4;
+
+	m_iSolveWidth = 0;
+	m_iSolveHeight = 0;
+	m_iSolveDepth = 0;
+
+	m_bCoarseToFine = false;
+	m_iRefinementLevel = 0;
+	m_pBrickMap = new BrickMap();
 
 	m_pVoronoi = NULL;
 	m_pDiffusion = NULL;
@@ -56,9 +82,6 @@ Scene::Scene()
  ****************************************************************************/
 Scene::~Scene()
 {
-	SAFE_RELEASE(m_pd3dDevice);
-	SAFE_RELEASE(m_pd3dImmediateContext);
-
 	SAFE_RELEASE(m_pVolumeRenderEffect);
 	SAFE_RELEASE(m_pSurfaceEffect);
 	SAFE_RELEASE(m_pVoronoiEffect);
@@ -66,11 +89,19 @@ Scene::~Scene()
 	SAFE_DELETE(m_pVoronoi);
 	SAFE_DELETE(m_pDiffusion);
 	SAFE_DELETE(m_pVolumeRenderer);
+	SAFE_DELETE(m_pBrickMap);
 
 	SAFE_DELETE(m_pBBVertices);
 	
-	SAFE_DELETE(m_pSurface1);
-	SAFE_DELETE(m_pSurface2);
+	for(unsigned int i = 0; i < m_vSurfaces.size(); i++)
+		SAFE_DELETE(m_vSurfaces[i]);
+	m_vSurfaces.clear();
+
+	//the passes above return their textures to the texture manager
+	SAFE_DELETE(m_pTextureManager);
+
+	SAFE_RELEASE(m_pd3dDevice);
+	SAFE_RELEASE(m_pd3dImmediateContext);
 }
 
 /****************************************************************************
@@ -97,20 +128,21 @@ HRESULT Scene::Initialize(int iTexWidth, int iTexHeight, int iTexDepth)
 	m_iTextureWidth = iTexWidth;
 	m_iTextureHeight = iTexHeight;
 	m_iTextureDepth = iTexDepth;
+	m_iMaxResolution = max(iTexWidth, max(iTexHeight, iTexDepth));
 
 	// Initialize Surfaces
 	V_RETURN(ItlInitSurfaces());
 
 	// Initialize Voronoi Diagram Renderer
-	m_pVoronoi = new Voronoi(m_pVoronoiEffect);
+	m_pVoronoi = new Voronoi(this, m_pVoronoiEffect);
 	V_RETURN(m_pVoronoi->Initialize(m_iTextureWidth, m_iTextureHeight, m_iTextureDepth));
 
 	// Initialize Diffusion Renderer
-	m_pDiffusion = new Diffusion(m_pDiffusionEffect);
+	m_pDiffusion = new Diffusion(this, m_pDiffusionEffect);
 	V_RETURN(m_pDiffusion->Initialize(m_iTextureWidth, m_iTextureHeight, m_iTextureDepth));
 
 	// Initialize VolumeRenderer
-	m_pVolumeRenderer = new VolumeRenderer(m_pVolumeRenderEffect);
+	m_pVolumeRenderer = new VolumeRenderer(this, m_pVolumeRenderEffect);
 	V_RETURN(m_pVolumeRenderer->Initialize());
 	
 	// Update bounding box
@@ -126,164 +158,286 @@ HRESULT Scene::ItlInitSurfaces()
 	HRESULT hr;
 
 	// Create surface1 and its buffers
-	m_pSurface1 = new Surface(m_pd3dDevice, m_pd3dImmediateContext, m_pSurfaceEffect);
-	V_RETURN(m_pSurface1->Initialize("Media\\meshes\\Sphere\\sphere.obj", D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f)));
-	m_pSurface1->Scale(2.0f);
-	m_pSurface1->SetIsoColor(0.0f);
+	Surface* pSurface1 = new Surface(m_pd3dDevice, m_pd3dImmediateContext, m_pSurfaceEffect);
+	m_vSurfaces.push_back(pSurface1);
+	m_vIsoValueFixed.push_back(false);
+	V_RETURN(pSurface1->Initialize("Media\\meshes\\Sphere\\sphere.obj", D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f)));
+	pSurface1->Scale(2.0f);
+	pSurface1->SetIsoColor(0.0f);
 	
 	// Create surface2 and its buffers
-	m_pSurface2 = new Surface(m_pd3dDevice, m_pd3dImmediateContext, m_pSurfaceEffect);
-	V_RETURN(m_pSurface2->Initialize("Media\\meshes\\teapot.obj", D3DXCOLOR(0.0f, 0.5f, 1.0f, 1.0f)));
-	m_pSurface2->SetIsoColor(1.0f);
-	m_pSurface2->Scale(1.4f);
-	m_pSurface2->Translate(0.0f, -0.4f, 0.0f);
+	Surface* pSurface2 = new Surface(m_pd3dDevice, m_pd3dImmediateContext, m_pSurfaceEffect);
+	m_vSurfaces.push_back(pSurface2);
+	m_vIsoValueFixed.push_back(false);
+	V_RETURN(pSurface2->Initialize("Media\\meshes\\teapot.obj", D3DXCOLOR(0.0f, 0.5f, 1.0f, 1.0f)));
+	pSurface2->SetIsoColor(1.0f);
+	pSurface2->Scale(1.4f);
+	pSurface2->Translate(0.0f, -0.4f, 0.0f);
 
-	//m_pSurface2->RotateX(3*PI/2);
-
-	m_pControlledSurface = m_pSurface1;
+	//pSurface2->RotateX(3*PI/2);
 
 	return S_OK;
 }
 
 /****************************************************************************
  ****************************************************************************/
-HRESULT Scene::UpdateBoundingBox()
+void Scene::ItlUpdateIsoValues()
 {
-	HRESULT hr;
+	int iNumSurfaces = GetSurfaceCount();
 
-	//Get the bounding boxes of the surfaces
-	BOUNDINGBOX bbSurface1 = m_pSurface1->GetBoundingBox();
-	BOUNDINGBOX bbSurface2 = m_pSurface2->GetBoundingBox();
-
-
-	//check which surface is the inner surface
-	bool bSurface1IsInner = false;
-	D3DXVECTOR3* bbVerticesSurface1 = new D3DXVECTOR3[8];
-	bbVerticesSurface1[0].x = bbSurface1.vMin.x;
-	bbVerticesSurface1[0].y = bbSurface1.vMin.y;
-	bbVerticesSurface1[0].z = bbSurface1.vMin.z;
-	bbVerticesSurface1[1].x = bbSurface1.vMax.x;
-	bbVerticesSurface1[1].y = bbSurface1.vMin.y;
-	bbVerticesSurface1[1].z = bbSurface1.vMin.z;
-	bbVerticesSurface1[2].x = bbSurface1.vMax.x;
-	bbVerticesSurface1[2].y = bbSurface1.vMax.y;
-	bbVerticesSurface1[2].z = bbSurface1.vMin.z;
-	bbVerticesSurface1[3].x = bbSurface1.vMin.x;
-	bbVerticesSurface1[3].y = bbSurface1.vMax.y;
-	bbVerticesSurface1[3].z = bbSurface1.vMin.z;
-	bbVerticesSurface1[4].x = bbSurface1.vMax.x;
-	bbVerticesSurface1[4].y = bbSurface1.vMin.y;
-	bbVerticesSurface1[4].z = bbSurface1.vMax.z;
-	bbVerticesSurface1[5].x = bbSurface1.vMin.x;
-	bbVerticesSurface1[5].y = bbSurface1.vMin.y;
-	bbVerticesSurface1[5].z = bbSurface1.vMax.z;
-	bbVerticesSurface1[6].x = bbSurface1.vMax.x;
-	bbVerticesSurface1[6].y = bbSurface1.vMax.y;
-	bbVerticesSurface1[6].z = bbSurface1.vMax.z;
-	bbVerticesSurface1[7].x = bbSurface1.vMin.x;
-	bbVerticesSurface1[7].y = bbSurface1.vMax.y;
-	bbVerticesSurface1[7].z = bbSurface1.vMax.z;
+	if(m_bNestingChanged || (int)m_vNestingOrder.size() != iNumSurfaces)
+	{
+		PROFILE_SCOPE("Nesting order");
 
-	for(int i = 0; i < 8; i++)
+		std::vector<BOUNDINGBOX> vBoundingBoxes(iNumSurfaces);
+		for(int i = 0; i < iNumSurfaces; i++)
+			vBoundingBoxes[i] = m_vSurfaces[i]->GetBoundingBox();
+
+		ItlComputeNestingOrder(vBoundingBoxes);
+		m_bNestingChanged = false;
+	}
+
+	//spread the iso values evenly between 0.0 (outermost) and 1.0 (innermost)
+	for(int i = 0; i < iNumSurfaces; i++)
 	{
-		bSurface1IsInner = CheckIfPointIsInBoundingBox(bbSurface2, bbVerticesSurface1[i]);
-		if(bSurface1IsInner == true)
-			break;
+		int iSurface = m_vNestingOrder[i];
+		if(!m_vIsoValueFixed[iSurface])
+			m_vSurfaces[iSurface]->SetIsoColor(iNumSurfaces > 1 ? float(i) / float(iNumSurfaces - 1) : 0.0f);
 	}
+}
 
-	SAFE_DELETE_ARRAY(bbVerticesSurface1);
+/****************************************************************************
+ ****************************************************************************/
+void Scene::ItlComputeNestingOrder(const std::vector<BOUNDINGBOX>& vBoundingBoxes)
+{
+	int iNumSurfaces = GetSurfaceCount();
+
+	/*
+	 *	the nesting depth of a surface is the number of other surfaces that contain it.
+	 *	A surface contains another one if the majority of the sample points of the other surface
+	 *	lies inside of it according to the winding number, so touching or slightly intersecting
+	 *	surfaces are still classified correctly.
+	 */
+	std::vector<int> vNestingDepth(iNumSurfaces, 0);
+	std::vector<float> vVolume(iNumSurfaces, 0.0f);
+	std::vector<D3DXVECTOR3> vSamplePoints;
 
-	if(bSurface1IsInner)
+	for(int i = 0; i < iNumSurfaces; i++)
 	{
-		m_pSurface1->SetIsoColor(1.0f);
-		m_pSurface2->SetIsoColor(0.0f);
+		D3DXVECTOR4 vDiff = vBoundingBoxes[i].vMax - vBoundingBoxes[i].vMin;
+		vVolume[i] = vDiff.x * vDiff.y * vDiff.z;
+
+		m_vSurfaces[i]->GetSamplePoints(vSamplePoints, SCENE_NESTING_SAMPLES);
+
+		for(int j = 0; j < iNumSurfaces; j++)
+		{
+			if(i == j)
+				continue;
+
+			unsigned int nInside = 0;
+			for(unsigned int k = 0; k < vSamplePoints.size(); k++)
+			{
+				//points outside of the bounding box can not be inside of the surface
+				if(CheckIfPointIsInBoundingBox(vBoundingBoxes[j], vSamplePoints[k]) && m_vSurfaces[j]->IsPointInside(vSamplePoints[k]))
+					nInside++;
+			}
+
+			if(2 * nInside > vSamplePoints.size())
+				vNestingDepth[i]++;
+		}
 	}
-	else
+
+	//sort the surfaces from outside to inside, on equal depth the bigger surface is the outer one
+	m_vNestingOrder.resize(iNumSurfaces);
+	for(int i = 0; i < iNumSurfaces; i++)
+		m_vNestingOrder[i] = i;
+
+	std::sort(m_vNestingOrder.begin(), m_vNestingOrder.end(), [&](int a, int b) -> bool
 	{
-		m_pSurface1->SetIsoColor(0.0f);
-		m_pSurface2->SetIsoColor(1.0f);
+		if(vNestingDepth[a] != vNestingDepth[b])
+			return vNestingDepth[a] < vNestingDepth[b];
+		return vVolume[a] > vVolume[b];
+	});
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Scene::UpdateBoundingBox()
+{
+	HRESULT hr;
+
+	//check which surfaces are the inner surfaces
+	ItlUpdateIsoValues();
+
+	//fit the volume around the vertices of all surfaces
+	std::vector<D3DXVECTOR3> vPoints, vSurfacePoints;
+	for(unsigned int i = 0; i < m_vSurfaces.size(); i++)
+	{
+		m_vSurfaces[i]->GetSamplePoints(vSurfacePoints, UINT_MAX);
+		vPoints.insert(vPoints.end(), vSurfacePoints.begin(), vSurfacePoints.end());
 	}
 
-	//get overall bounding box
-	BOUNDINGBOX bbFinal = bbSurface1;
-
-	if(bbSurface2.vMin.x < bbFinal.vMin.x)
-		bbFinal.vMin.x = bbSurface2.vMin.x;
-	if(bbSurface2.vMin.y < bbFinal.vMin.y)
-		bbFinal.vMin.y = bbSurface2.vMin.y;
-	if(bbSurface2.vMin.z < bbFinal.vMin.z)
-		bbFinal.vMin.z = bbSurface2.vMin.z;
-	if(bbSurface2.vMax.x > bbFinal.vMax.x)
-		bbFinal.vMax.x = bbSurface2.vMax.x;
-	if(bbSurface2.vMax.y > bbFinal.vMax.y)
-		bbFinal.vMax.y = bbSurface2.vMax.y;
-	if(bbSurface2.vMax.z > bbFinal.vMax.z)
-		bbFinal.vMax.z = bbSurface2.vMax.z;
+	OrientedBoundingBox bbVolume;
+	if(m_bOrientedBoundingBox)
+		bbVolume.BuildOriented(vPoints);
+	else
+		bbVolume.BuildAxisAligned(vPoints);
+	bbVolume.Pad(m_fBoundingBoxPadding);
+
+	// Change texture size corresponding to the ratio between x y and z of the box, the box grows to the aligned size
+	bbVolume.Grow(ItlComputeTextureSize(bbVolume.GetExtent()));
+	m_bBoundingBoxChanged = false;
 
 	//early break, when bounding box was not changed
 	if(m_bUpdate3DTextures
-		&& bbFinal.vMin.x == m_vMin.x
-		&& bbFinal.vMin.y == m_vMin.y
-		&& bbFinal.vMin.z == m_vMin.z
-		&& bbFinal.vMax.x == m_vMax.x
-		&& bbFinal.vMax.y == m_vMax.y
-		&& bbFinal.vMax.z == m_vMax.z)
+		&& bbVolume.GetMin() == m_vMin
+		&& bbVolume.GetMax() == m_vMax
+		&& bbVolume.GetWorldToLocal() == m_mWorldToVolume)
 		return S_OK;
 		
-	m_vMin = D3DXVECTOR3(bbFinal.vMin.x, bbFinal.vMin.y, bbFinal.vMin.z);
-	m_vMax = D3DXVECTOR3(bbFinal.vMax.x, bbFinal.vMax.y, bbFinal.vMax.z);
+	m_vMin = bbVolume.GetMin();
+	m_vMax = bbVolume.GetMax();
+	m_mWorldToVolume = bbVolume.GetWorldToLocal();
+	m_mVolumeToWorld = bbVolume.GetLocalToWorld();
 	
-	//update bounding box vertices according to the new bounding box
-	m_pBBVertices[0].pos.x = m_vMin.x;
-	m_pBBVertices[0].pos.y = m_vMin.y;
-	m_pBBVertices[0].pos.z = m_vMin.z;
-	m_pBBVertices[1].pos.x = m_vMax.x;
-	m_pBBVertices[1].pos.y = m_vMin.y;
-	m_pBBVertices[1].pos.z = m_vMin.z;
-	m_pBBVertices[2].pos.x = m_vMax.x;
-	m_pBBVertices[2].pos.y = m_vMax.y;
-	m_pBBVertices[2].pos.z = m_vMin.z;
-	m_pBBVertices[3].pos.x = m_vMin.x;
-	m_pBBVertices[3].pos.y = m_vMax.y;
-	m_pBBVertices[3].pos.z = m_vMin.z;
-	m_pBBVertices[4].pos.x = m_vMax.x;
-	m_pBBVertices[4].pos.y = m_vMin.y;
-	m_pBBVertices[4].pos.z = m_vMax.z;
-	m_pBBVertices[5].pos.x = m_vMin.x;
-	m_pBBVertices[5].pos.y = m_vMin.y;
-	m_pBBVertices[5].pos.z = m_vMax.z;
-	m_pBBVertices[6].pos.x = m_vMax.x;
-	m_pBBVertices[6].pos.y = m_vMax.y;
-	m_pBBVertices[6].pos.z = m_vMax.z;
-	m_pBBVertices[7].pos.x = m_vMin.x;
-	m_pBBVertices[7].pos.y = m_vMax.y;
-	m_pBBVertices[7].pos.z = m_vMax.z;
-
-
-	// Change texture size corresponding to the ratio between x y and z of BB
-	D3DXVECTOR3 vDiff = m_vMax - m_vMin;
-	float fMaxDiff = max(vDiff.x, max(vDiff.y, vDiff.z));
-	vDiff /= fMaxDiff;
-
-	int previousMax = max(m_iTextureWidth, max(m_iTextureHeight, m_iTextureDepth));
-	m_iTextureWidth = int(vDiff.x * previousMax + 0.5);
-	m_iTextureHeight = int(vDiff.y * previousMax + 0.5);
-	m_iTextureDepth = int(vDiff.z * previousMax + 0.5);
+	//update bounding box vertices according to the new bounding box, they are in the local frame of the volume
+	BOUNDINGBOX bbLocal;
+	bbLocal.vMin = D3DXVECTOR4(m_vMin, 1.0f);
+	bbLocal.vMax = D3DXVECTOR4(m_vMax, 1.0f);
+
+	D3DXVECTOR3 vCorners[8];
+	GetBoundingBoxCorners(bbLocal, vCorners);
+	for(int i = 0; i < 8; i++)
+		m_pBBVertices[i].pos = vCorners[i];
 	
 	//Initialize the textures, voronoi, volumerenderer and diffusion
-	V_RETURN(m_pVoronoi->Update(m_iTextureWidth, m_iTextureHeight, m_iTextureDepth));
-	V_RETURN(m_pVolumeRenderer->Update(m_iTextureWidth, m_iTextureHeight, m_iTextureDepth));
-
-	V_RETURN(m_pDiffusion->Update(m_iTextureWidth, 
-								  m_iTextureHeight, 
-								  m_iTextureDepth, 
-								  m_fIsoValue));
+	V_RETURN(ItlUpdateSolveResolution());
 
 	m_bUpdate3DTextures = true;
 	
 	return S_OK;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+D3DXVECTOR3 Scene::ItlComputeTextureSize(const D3DXVECTOR3& vExtent)
+{
+	float fMaxExtent = max(vExtent.x, max(vExtent.y, vExtent.z));
+
+	if(m_iTextureAlignment <= 1)
+	{
+		D3DXVECTOR3 vDiff = vExtent / fMaxExtent;
+		m_iTextureWidth = int(vDiff.x * m_iMaxResolution + 0.5);
+		m_iTextureHeight = int(vDiff.y * m_iMaxResolution + 0.5);
+		m_iTextureDepth = int(vDiff.z * m_iMaxResolution + 0.5);
+		return vExtent;
+	}
+
+	//round up to the alignment, the voxels stay cubic
+	float fVoxelSize = fMaxExtent / float(m_iMaxResolution);
+	int iAlign = m_iTextureAlignment;
+	m_iTextureWidth = max(1, (int(ceil(vExtent.x / fVoxelSize - 0.001f)) + iAlign - 1) / iAlign) * iAlign;
+	m_iTextureHeight = max(1, (int(ceil(vExtent.y / fVoxelSize - 0.001f)) + iAlign - 1) / iAlign) * iAlign;
+	m_iTextureDepth = max(1, (int(ceil(vExtent.z / fVoxelSize - 0.001f)) + iAlign - 1) / iAlign) * iAlign;
+
+	return D3DXVECTOR3(m_iTextureWidth * fVoxelSize, m_iTextureHeight * fVoxelSize, m_iTextureDepth * fVoxelSize);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Scene::SetOrientedBoundingBox(bool bOriented)
+{
+	m_bOrientedBoundingBox = bOriented;
+	m_bUpdate3DTextures = false;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Scene::SetBoundingBoxPadding(float fPadding)
+{
+	m_fBoundingBoxPadding = max(0.0f, fPadding);
+	m_bUpdate3DTextures = false;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Scene::SetTextureAlignment(int iAlignment)
+{
+	m_iTextureAlignment = max(1, iAlignment);
+	m_bUpdate3DTextures = false;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Scene::ItlUpdateSolveResolution()
+{
+	HRESULT hr;
+
+	m_iSolveWidth = m_iTextureWidth;
+	m_iSolveHeight = m_iTextureHeight;
+	m_iSolveDepth = m_iTextureDepth;
+
+	//the first level keeps the ratio of the texture sizes but is limited to the coarse resolution
+	int iMaxRes = max(m_iTextureWidth, max(m_iTextureHeight, m_iTextureDepth));
+	if(m_bCoarseToFine && m_iRefinementLevel == 0 && iMaxRes > SCENE_COARSE_RESOLUTION)
+	{
+		float fScale = float(SCENE_COARSE_RESOLUTION) / float(iMaxRes);
+		m_iSolveWidth = max(2, int(m_iTextureWidth * fScale + 0.5f));
+		m_iSolveHeight = max(2, int(m_iTextureHeight * fScale + 0.5f));
+		m_iSolveDepth = max(2, int(m_iTextureDepth * fScale + 0.5f));
+	}
+
+	V_RETURN(m_pVoronoi->Update(m_iSolveWidth, m_iSolveHeight, m_iSolveDepth));
+	V_RETURN(m_pVolumeRenderer->Update(m_iSolveWidth, m_iSolveHeight, m_iSolveDepth));
+
+	V_RETURN(m_pDiffusion->Update(m_iSolveWidth, 
+								  m_iSolveHeight, 
+								  m_iSolveDepth, 
+								  m_fIsoValue));
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Scene::ItlStartRefinement()
+{
+	HRESULT hr;
+
+	PROFILE_SCOPE("Refinement setup");
+
+	//the bricks whose value range contains the iso value are solved again at full resolution
+	std::vector<float> vValues;
+	V_RETURN(m_pTextureManager->ReadBack3DTexture(m_pDiffusion->GetDiffusionTexture(), 3, vValues));
+
+	std::vector<float> vIsoValues(1, m_fIsoValue);
+	m_pBrickMap->Build(vValues, m_iSolveWidth, m_iSolveHeight, m_iSolveDepth, vIsoValues);
+
+	float fScale = float(max(m_iTextureWidth, max(m_iTextureHeight, m_iTextureDepth)))
+				 / float(max(m_iSolveWidth, max(m_iSolveHeight, m_iSolveDepth)));
+	m_pDiffusion->StoreCoarseSolution(m_pBrickMap, fScale);
+
+	m_iRefinementLevel = 1;
+	V_RETURN(ItlUpdateSolveResolution());
+
+	m_pVoronoi->SetBrickMap(m_pBrickMap);
+
+	m_bGenerateVoronoi = true;
+	m_bGenerateDiffusion = false;
+	m_bRender3DTexture = false;
+	m_bIsoValueChanged = true;
+	m_bGenerateOneSliceTexture = true;
+
+	return S_OK;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Scene::SetCoarseToFine(bool bCoarseToFine)
+{
+	m_bCoarseToFine = bCoarseToFine;
+}
+
 /****************************************************************************
  ****************************************************************************/
 HRESULT Scene::SetScreenSize(int iWidth, int iHeight)
@@ -295,46 +449,46 @@ HRESULT Scene::SetScreenSize(int iWidth, int iHeight)
  ****************************************************************************/
 void Scene::UpdateTextureResolution(int iMaxRes)
 {
-	D3DXVECTOR3 vDiff = m_vMax - m_vMin;
-	float fMaxDiff = max(vDiff.x, max(vDiff.y, vDiff.z));
-	vDiff /= fMaxDiff;
-
-	m_iTextureWidth = int(vDiff.x * iMaxRes + 0.5);
-	m_iTextureHeight = int(vDiff.y * iMaxRes + 0.5);
-	m_iTextureDepth = int(vDiff.z * iMaxRes + 0.5);
+	m_iMaxResolution = iMaxRes;
+	ItlComputeTextureSize(m_vMax - m_vMin);
 
 	m_bUpdate3DTextures = false;
 }
 
 /****************************************************************************
  ****************************************************************************/
-void Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
+HRESULT Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
 {
+	HRESULT hr;
+
 	bool bContinue = true;
 
 	if(m_bGenerateVoronoi) //if voronoi has to be generated
 	{
-		UpdateBoundingBox();
+		//the box is only fitted again after a surface or a setting of the volume changed
+		if(m_bBoundingBoxChanged || !m_bUpdate3DTextures)
+		{
+			PROFILE_SCOPE("Update bounding box");
+			UpdateBoundingBox();
+		}
 		/*
 		 *	Voronoi diagram is generated in more steps. this is done because if it would be generated all at once,
 		 *  the graphics driver would crash due to a timeout
 		 */
-		bContinue = m_pVoronoi->RenderVoronoi(m_vMin, m_vMax);
+		bContinue = m_pVoronoi->RenderVoronoi(m_vMin, m_vMax, m_mWorldToVolume);
 		m_wsRenderProgress = m_pVoronoi->GetRenderProgress();
+		if(m_iRefinementLevel > 0)
+		{
+			std::wstringstream sstm;
+			sstm << m_wsRenderProgress << " (refining " << int(m_pBrickMap->GetActiveFraction() * 100.0f + 0.5f) << " % of the volume)";
+			m_wsRenderProgress = sstm.str();
+		}
 		if(bContinue)
 		{
 			m_bGenerateVoronoi = false;
 			m_bGenerateDiffusion = true;
 			m_bRender3DTexture = true;
 			m_wsRenderProgress = L"Generate Diffusion...";
-			/*GetSystemTime(&m_tEndRenderingVoronoi);
-			
-			std::wstringstream ssStream;
-			ssStream << "START: "<< m_tStartRenderingVoronoi.wHour << ":" << m_tStartRenderingVoronoi.wMinute << ":" << m_tStartRenderingVoronoi.wSecond << "." << m_tStartRenderingVoronoi.wMilliseconds << std::endl;
-			ssStream << "END: "<< m_tEndRenderingVoronoi.wHour << ":" << m_tEndRenderingVoronoi.wMinute << ":" << m_tEndRenderingVoronoi.wSecond << "." << m_tEndRenderingVoronoi.wMilliseconds << std::endl;
-			MessageBox ( NULL , ssStream.str().c_str(), L"Renderingtime of Voronoi", MB_OK);
-			
-			GetSystemTime(&m_tStartRenderingDiffusion);*/
 		}
 	}
 
@@ -351,13 +505,18 @@ void Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
 			if(bContinue)
 			{
 				m_bGenerateDiffusion = false;
-				
-				/*GetSystemTime(&m_tEndRenderingDiffusion);
-				std::wstringstream ssStream;
-				ssStream << "START: "<< m_tStartRenderingDiffusion.wHour << ":" << m_tStartRenderingDiffusion.wMinute << ":" << m_tStartRenderingDiffusion.wSecond << "." << m_tStartRenderingDiffusion.wMilliseconds << std::endl;
-				ssStream << "END: "<< m_tEndRenderingDiffusion.wHour << ":" << m_tEndRenderingDiffusion.wMinute << ":" << m_tEndRenderingDiffusion.wSecond << "." << m_tEndRenderingDiffusion.wMilliseconds << std::endl;
-				MessageBox ( NULL , ssStream.str().c_str(), L"Renderingtime of Diffusion", MB_OK);*/
-				
+				m_pVolumeRenderer->InvalidateOccupancy();
+
+				//the one slice view shares its texture with the diffusion, which overwrote it
+				m_bGenerateOneSliceTexture = true;
+
+				//the coarse level is finished, continue with the refinement of the bricks around the isosurface
+				if(m_bCoarseToFine && m_iRefinementLevel == 0 
+					&& (m_iSolveWidth != m_iTextureWidth || m_iSolveHeight != m_iTextureHeight || m_iSolveDepth != m_iTextureDepth))
+				{
+					V_RETURN(ItlStartRefinement());
+					bContinue = false;
+				}
 			}
 		}
 
@@ -365,16 +524,16 @@ void Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
 		{
 			m_nIsoSurfaceTexture = m_pDiffusion->RenderIsoSurface(m_pDiffusion->GetDiffusionTexture());
 			m_bIsoValueChanged = false;
-
-			/*GetSystemTime(&m_tEndRenderingIsoSurface);
-			std::wstringstream ssStream;
-			ssStream << "START: "<< m_tStartRenderingIsoSurface.wHour << ":" << m_tStartRenderingIsoSurface.wMinute << ":" << m_tStartRenderingIsoSurface.wSecond << "." << m_tStartRenderingIsoSurface.wMilliseconds << std::endl;
-			ssStream << "END: "<< m_tEndRenderingIsoSurface.wHour << ":" << m_tEndRenderingIsoSurface.wMinute << ":" << m_tEndRenderingIsoSurface.wSecond << "." << m_tEndRenderingIsoSurface.wMilliseconds << std::endl;
-			MessageBox ( NULL , ssStream.str().c_str(), L"Renderingtime of Isosurface", MB_OK);*/
+			m_pVolumeRenderer->InvalidateOccupancy();
 		}
 		
 		if(bContinue)
 		{
+			PROFILE_SCOPE("Volume rendering");
+
+			//the bounding box vertices are in the local frame of the volume
+			D3DXMATRIX mVolumeViewProjection = m_mVolumeToWorld * mViewProjection;
+
 			if(m_bDrawAllSlices == false)//draw only one slice
 			{
 				if(m_bGenerateOneSliceTexture)
@@ -392,23 +551,24 @@ void Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
 						//m_nOneSliceTexture = m_pDiffusion->RenderOneDiffusionSlice(m_iCurrentSlice, m_pVoronoi->GetColor3DTexture());
 					}
 					m_bGenerateOneSliceTexture = false;
+					m_pVolumeRenderer->InvalidateOccupancy();
 				}
 				
-				m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mViewProjection, m_nOneSliceTexture);
+				m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mVolumeViewProjection, m_nOneSliceTexture);
 			}
 			else//draw all slices
 			{
 				if(m_bRenderIsoSurface)
 				{
 					m_wsRenderProgress = L"Rendering the Isosurface 3D Texture";
-					m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mViewProjection, m_nIsoSurfaceTexture);
-					//m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mViewProjection, m_pVoronoi->GetColor3DTexture());
+					m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mVolumeViewProjection, m_nIsoSurfaceTexture);
+					//m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mVolumeViewProjection, m_pVoronoi->GetColor3DTexture());
 				}
 				else
 				{
 					m_wsRenderProgress = L"Rendering the Diffusion 3D Texture";
-					m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mViewProjection, m_pDiffusion->GetDiffusionTexture());
-					//m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mViewProjection, m_pVoronoi->GetColor3DTexture());
+					m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mVolumeViewProjection, m_pDiffusion->GetDiffusionTexture());
+					//m_pVolumeRenderer->Render(m_pBBVertices, m_vMin, m_vMax, mVolumeViewProjection, m_pVoronoi->GetColor3DTexture());
 				}
 			}
 
@@ -418,9 +578,11 @@ void Scene::Render(D3DXMATRIX mViewProjection, bool bShowSurfaces)
 	//show surfaces
 	if(bShowSurfaces)
 	{
-		m_pSurface1->Render(mViewProjection);
-		m_pSurface2->Render(mViewProjection);
+		for(unsigned int i = 0; i < m_vSurfaces.size(); i++)
+			m_vSurfaces[i]->Render(mViewProjection);
 	}
+
+	return S_OK;
 }	
 
 /****************************************************************************
@@ -441,8 +603,6 @@ void Scene::ShowIsoSurface(bool bShow)
 	m_pVolumeRenderer->ShowIsoSurface(bShow);
 	m_bIsoValueChanged = true;
 	m_bGenerateOneSliceTexture = true;
-	if(bShow)
-		GetSystemTime(&m_tStartRenderingIsoSurface);
 }
 
 /****************************************************************************
@@ -508,69 +668,89 @@ void Scene::ChangeSampling()
 
 /****************************************************************************
  ****************************************************************************/
-void Scene::TranslateSurface1(float fX, float fY, float fZ)
+void Scene::TranslateSurface(int iSurface, float fX, float fY, float fZ)
 {
-	m_pSurface1->Translate(fX, fY, fZ);
+	m_vSurfaces[iSurface]->Translate(fX, fY, fZ);
+	ItlInvalidateSurfaces();
 }
 
-void Scene::RotateSurface1(D3DXVECTOR3 axis, float fFactor)
+void Scene::RotateSurface(int iSurface, D3DXVECTOR3 axis, float fFactor)
 {
-	m_pSurface1->Rotate(axis, fFactor);
+	m_vSurfaces[iSurface]->Rotate(axis, fFactor);
+	ItlInvalidateSurfaces();
 }
 
-void Scene::RotateXSurface1(float fFactor)
+void Scene::RotateXSurface(int iSurface, float fFactor)
 {
-	m_pSurface1->RotateX(fFactor);
+	m_vSurfaces[iSurface]->RotateX(fFactor);
+	ItlInvalidateSurfaces();
 }
 
-void Scene::RotateYSurface1(float fFactor)
+void Scene::RotateYSurface(int iSurface, float fFactor)
 {
-	m_pSurface1->RotateY(fFactor);
+	m_vSurfaces[iSurface]->RotateY(fFactor);
+	ItlInvalidateSurfaces();
 }
 
-void Scene::ScaleSurface1(float fFactor)
+void Scene::ScaleSurface(int iSurface, float fFactor)
 {
-	m_pSurface1->Scale(fFactor);
+	m_vSurfaces[iSurface]->Scale(fFactor);
+	ItlInvalidateSurfaces();
 }
 
-void Scene::TranslateSurface2(float fX, float fY, float fZ)
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Scene::LoadSurface(int iSurface, std::string strMeshName)
 {
-	m_pSurface2->Translate(fX, fY, fZ);
+	HRESULT hr(S_OK);
+	V_RETURN(m_vSurfaces[iSurface]->LoadMesh(strMeshName));
+	ItlInvalidateSurfaces();
+	return hr;
 }
 
-void Scene::RotateSurface2(D3DXVECTOR3 axis, float fFactor)
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Scene::AddSurface(std::string strMeshName)
 {
-	m_pSurface2->Rotate(axis, fFactor);
-}
+	HRESULT hr(S_OK);
 
-void Scene::RotateXSurface2(float fFactor)
-{
-	m_pSurface2->RotateX(fFactor);
+	Surface* pSurface = new Surface(m_pd3dDevice, m_pd3dImmediateContext, m_pSurfaceEffect);
+	hr = pSurface->Initialize(strMeshName);
+	if(FAILED(hr))
+	{
+		SAFE_DELETE(pSurface);
+		return hr;
+	}
+
+	m_vSurfaces.push_back(pSurface);
+	m_vIsoValueFixed.push_back(false);
+	ItlInvalidateSurfaces();
+
+	return hr;
 }
 
-void Scene::RotateYSurface2(float fFactor)
+/****************************************************************************
+ ****************************************************************************/
+void Scene::SetSurfaceIsoValue(int iSurface, float fIsoValue)
 {
-	m_pSurface2->RotateY(fFactor);
+	m_vSurfaces[iSurface]->SetIsoColor(fIsoValue);
+	m_vIsoValueFixed[iSurface] = true;
 }
 
-void Scene::ScaleSurface2(float fFactor)
+void Scene::ResetSurfaceIsoValue(int iSurface)
 {
-	m_pSurface2->Scale(fFactor);
+	m_vIsoValueFixed[iSurface] = false;
+
+	//the bounding box is not fitted again for it, so the iso value is assigned here
+	ItlUpdateIsoValues();
 }
 
 /****************************************************************************
  ****************************************************************************/
-HRESULT Scene::LoadSurface1(std::string strMeshName)
-{
-	HRESULT hr(S_OK);
-	V_RETURN(m_pSurface1->LoadMesh(strMeshName));
-	return hr;
-}
-HRESULT Scene::LoadSurface2(std::string strMeshName)
+void Scene::ItlInvalidateSurfaces()
 {
-	HRESULT hr(S_OK);
-	V_RETURN(m_pSurface2->LoadMesh(strMeshName));
-	return hr;
+	m_bNestingChanged = true;
+	m_bBoundingBoxChanged = true;
 }
 
 /****************************************************************************
@@ -582,7 +762,16 @@ void Scene::GenerateVoronoi()
 	m_bIsoValueChanged = true;
 	m_bRender3DTexture = false;
 
-	GetSystemTime(&m_tStartRenderingVoronoi);
+	//start again at the coarse level, the resolution is updated with the bounding box
+	if(m_iRefinementLevel > 0 || m_bCoarseToFine)
+		m_bUpdate3DTextures = false;
+	m_iRefinementLevel = 0;
+	m_pBrickMap->Clear();
+	m_pVoronoi->SetBrickMap(NULL);
+	m_pDiffusion->ClearCoarseSolution();
+
+	//the profile covers the last generation
+	Profiler::GetInstance()->Clear();
 }
 
 /****************************************************************************
@@ -605,11 +794,11 @@ HRESULT Scene::SaveCurrentVolume(LPCTSTR sDestination)
 {
 	if(m_bRenderIsoSurface)
 	{
-		return D3DX11SaveTextureToFile(m_pd3dImmediateContext, TextureManager::GetInstance()->GetTexture(m_pDiffusion->GetIsoSurfaceTexture()), D3DX11_IFF_DDS, sDestination);
+		return D3DX11SaveTextureToFile(m_pd3dImmediateContext, m_pTextureManager->GetTexture(m_pDiffusion->GetIsoSurfaceTexture()), D3DX11_IFF_DDS, sDestination);
 	}
 	else
 	{
-		return D3DX11SaveTextureToFile(m_pd3dImmediateContext, TextureManager::GetInstance()->GetTexture(m_pDiffusion->GetDiffusionTexture()), D3DX11_IFF_DDS, sDestination);
+		return D3DX11SaveTextureToFile(m_pd3dImmediateContext, m_pTextureManager->GetTexture(m_pDiffusion->GetDiffusionTexture()), D3DX11_IFF_DDS, sDestination);
 	}
 
 	return S_OK;
@@ -7,15 +7,42 @@ class VolumeRenderer;
 class TextureGrid;
 class Voronoi;
 class Diffusion;
+class BrickMap;
+class TextureManager;
 
 #include "Globals.h"
+#include <vector>
 
+//number of vertices per surface that are tested against the other surfaces to find the nesting order
+#define SCENE_NESTING_SAMPLES 64
+
+//maximum resolution of the first level of the coarse-to-fine solve
+#define SCENE_COARSE_RESOLUTION 64
+
+/*
+ *	A scene owns the surfaces, the morph passes and the texture manager they share. Scenes are
+ *	independent of each other, every scene renders with its own device and context.
+ */
 class Scene
 {
 public:
+	/*
+	 *	Scene of the viewer
+	 */
 	static Scene* GetInstance();
 	static void DeleteInstance();
 
+	/*
+	 *	Constructor
+	 */
+	Scene();
+
+	/*
+	 *	Destructor
+	 *	Release all textures
+	 */
+	~Scene();
+
 	void SetDevice(ID3D11Device* pd3dDevice) 
 		{ m_pd3dDevice = pd3dDevice; }
 
@@ -28,8 +55,14 @@ public:
 	ID3D11DeviceContext * GetContext() const 
 		{ return m_pd3dImmediateContext; }
 
-	Surface* GetSurface1() const { return m_pSurface1; }
-	Surface* GetSurface2() const { return m_pSurface2; }
+	TextureManager* GetTextureManager() const
+		{ return m_pTextureManager; }
+
+	/*
+	 *	Returns the surfaces of the scene, there are always at least two of them
+	 */
+	int GetSurfaceCount() const { return (int)m_vSurfaces.size(); }
+	Surface* GetSurface(int iSurface) const { return m_vSurfaces[iSurface]; }
 
 
 	/*
@@ -52,10 +85,27 @@ public:
 	 */
 	void UpdateTextureResolution(int iMaxRes);
 
+	/*
+	 *	If enabled, voronoi and diffusion are first solved at SCENE_COARSE_RESOLUTION and then only
+	 *	the bricks around the isosurface are solved again at the texture resolution
+	 */
+	void SetCoarseToFine(bool bCoarseToFine);
+
+	/*
+	 *	Settings of the volume domain:
+	 *		- if bOriented is true, the volume is an oriented box around the surfaces instead of the axis aligned one
+	 *		- fPadding is the margin between the surfaces and the box (world units)
+	 *		- the texture sizes are rounded up to multiples of iAlignment, the box grows accordingly
+	 *	The changes take effect with the next voronoi generation.
+	 */
+	void SetOrientedBoundingBox(bool bOriented);
+	void SetBoundingBoxPadding(float fPadding);
+	void SetTextureAlignment(int iAlignment);
+
 	/*
 	 *	Render the scene, gets called in a loop
 	 */
-	void Render(D3DXMATRIX mViewProjection, bool bShowSurfaces);
+	HRESULT Render(D3DXMATRIX mViewProjection, bool bShowSurfaces);
 
 	/*
 	 *	Changes the isovalue of the isosurface
@@ -103,24 +153,31 @@ public:
 	void ChangeBoundingBoxVisibility(bool bVisible);
 
 	/*
-	 *	Translation, Rotation and Scale functions of surface 1 and 2
+	 *	Translation, Rotation and Scale functions of the surfaces
+	 */
+	void TranslateSurface(int iSurface, float fX, float fY, float fZ);
+	void RotateSurface(int iSurface, D3DXVECTOR3 axis, float fFactor);
+	void RotateXSurface(int iSurface, float fFactor);
+	void RotateYSurface(int iSurface, float fFactor);
+	void ScaleSurface(int iSurface, float fFactor);
+
+	/*
+	 *	Replaces the mesh of a surface with a new mesh
+	 */
+	HRESULT LoadSurface(int iSurface, std::string strMeshName);
+
+	/*
+	 *	Adds a new surface to the scene, its color or texture is chosen in a dialog
 	 */
-	void TranslateSurface1(float fX, float fY, float fZ);
-	void RotateSurface1(D3DXVECTOR3 axis, float fFactor);
-	void RotateXSurface1(float fFactor);
-	void RotateYSurface1(float fFactor);
-	void ScaleSurface1(float fFactor);
-	void TranslateSurface2(float fX, float fY, float fZ);
-	void RotateSurface2(D3DXVECTOR3 axis, float fFactor);
-	void RotateXSurface2(float fFactor);
-	void RotateYSurface2(float fFactor);
-	void ScaleSurface2(float fFactor);
+	HRESULT AddSurface(std::string strMeshName);
 
 	/*
-	 *	Replaces current surface 1 or 2 with a new surface
+	 *	Fixes the iso value of a surface. Surfaces without a fixed iso value get it from
+	 *	their nesting order: the outermost surface gets 0.0, the innermost 1.0 and the
+	 *	surfaces in between are spread evenly.
 	 */
-	HRESULT LoadSurface1(std::string strMeshName);
-	HRESULT LoadSurface2(std::string strMeshName);
+	void SetSurfaceIsoValue(int iSurface, float fIsoValue);
+	void ResetSurfaceIsoValue(int iSurface);
 
 	/*
 	 *	returns the texture sizes
@@ -141,7 +198,8 @@ public:
 	void Render3DTexture(bool bRender);
 
 	/*
-	 *	Updates the bounding box
+	 *	Fits the bounding box around the surfaces and resizes the textures if it changed. The render
+	 *	loop only calls it after a surface or a setting of the volume changed.
 	 */
 	HRESULT UpdateBoundingBox();
 
@@ -158,20 +216,43 @@ public:
 protected:
 
 	/*
-	 *	Constructor
+	 *	Initializes the surfaces (is only called when the application starts
 	 */
-	Scene();
+	HRESULT ItlInitSurfaces();
 
 	/*
-	 *	Destructor
-	 *	Release all textures
+	 *	Assigns the iso values of all surfaces without a fixed iso value. The nesting order is only
+	 *	computed again when a surface was moved or got a new mesh.
 	 */
-	~Scene();
+	void ItlUpdateIsoValues();
 
 	/*
-	 *	Initializes the surfaces (is only called when the application starts
+	 *	Sorts the surfaces from outside to inside with the winding numbers of their sample points
 	 */
-	HRESULT ItlInitSurfaces();
+	void ItlComputeNestingOrder(const std::vector<BOUNDINGBOX>& vBoundingBoxes);
+
+	/*
+	 *	Called when a surface was moved or got a new mesh, the nesting order and the bounding box
+	 *	are computed again with the next voronoi generation
+	 */
+	void ItlInvalidateSurfaces();
+
+	/*
+	 *	Resizes voronoi, diffusion and volumerenderer to the resolution of the current refinement level
+	 */
+	HRESULT ItlUpdateSolveResolution();
+
+	/*
+	 *	Computes the texture sizes for the extent of the volume, returns the extent that is covered by
+	 *	the aligned texture sizes with cubic voxels
+	 */
+	D3DXVECTOR3 ItlComputeTextureSize(const D3DXVECTOR3& vExtent);
+
+	/*
+	 *	Builds the brick map from the coarse diffusion texture and restarts the voronoi
+	 *	generation at the texture resolution
+	 */
+	HRESULT ItlStartRefinement();
 
 
 	static Scene* s_pInstance;
@@ -196,20 +277,48 @@ protected:
 	ID3D11Device*			m_pd3dDevice;
 	ID3D11DeviceContext*	m_pd3dImmediateContext;
 
+	// Textures of the voronoi diagram, the diffusion and the volume renderer
+	TextureManager*			m_pTextureManager;
+
 	// Surfaces
-	Surface*	m_pSurface1;
-	Surface*	m_pSurface2;
-	Surface*	m_pControlledSurface;
-	bool		m_bSurface1IsControlled;
+	std::vector<Surface*>	m_vSurfaces;
+	std::vector<bool>		m_vIsoValueFixed;
+
+	//surfaces sorted from outside to inside, valid until a surface is moved or gets a new mesh
+	std::vector<int>		m_vNestingOrder;
+	bool					m_bNestingChanged;
+
+	//the bounding box is fitted again before the next voronoi slice
+	bool					m_bBoundingBoxChanged;
 
 	//Texture size
 	int m_iTextureWidth;
 	int m_iTextureHeight;
 	int m_iTextureDepth;
 
-	//bounding box
+	//Texture size along the longest side of the volume
+	int m_iMaxResolution;
+
+	//Resolution of the current refinement level, equals the texture size if coarse-to-fine is disabled
+	int m_iSolveWidth;
+	int m_iSolveHeight;
+	int m_iSolveDepth;
+
+	//Coarse-to-fine solve
+	bool		m_bCoarseToFine;
+	int			m_iRefinementLevel;
+	BrickMap*	m_pBrickMap;
+
+	//bounding box in the local frame of the volume
 	D3DXVECTOR3 m_vMin;
 	D3DXVECTOR3 m_vMax;
+	D3DXMATRIX	m_mWorldToVolume;
+	D3DXMATRIX	m_mVolumeToWorld;
+
+	//settings of the volume domain
+	bool	m_bOrientedBoundingBox;
+	float	m_fBoundingBoxPadding;
+	int		m_iTextureAlignment;
 
 	// Voronoi Diagram Renderer
 	Voronoi*				m_pVoronoi;
@@ -240,14 +349,6 @@ protected:
 	HRESULT CreateEffect(WCHAR* name, ID3DX11Effect **ppEffect);
 	HRESULT CompileShaderFromFile( WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut );
 
-	// variables for measuring the time it took to render
-	SYSTEMTIME	m_tStartRenderingVoronoi;
-	SYSTEMTIME	m_tEndRenderingVoronoi;
-	SYSTEMTIME	m_tStartRenderingDiffusion;
-	SYSTEMTIME	m_tEndRenderingDiffusion;
-	SYSTEMTIME m_tStartRenderingIsoSurface;
-	SYSTEMTIME	m_tEndRenderingIsoSurface;
-
 };
 
 #endif //_SCENE_H_
\ No newline at end of file
@@ -1,9 +1,8 @@
 #include "Globals.h"
 #include "Surface.h"
 #include "SDKMesh.h"
-#include <assimp.hpp>
-#include <aiScene.h>
-#include <aiPostProcess.h>
+#include "MeshCache.h"
+#include "WindingNumber.h"
 #include <FreeImage.h>
 
 
@@ -19,11 +18,13 @@ Surface::Surface(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateCon
 	m_pTriangleIndexBuffer = NULL;
 	m_pEdgeIndexBuffer = NULL;
 	m_pVertices = NULL;
+	m_pWindingNumber = new WindingNumber();
 
 	m_pDiffuseTexture = NULL;
 	m_pDiffuseTextureSRV = NULL;
 
 	D3DXMatrixIdentity(&m_mModel);
+	D3DXMatrixIdentity(&m_mModelInv);
 	D3DXMatrixIdentity(&m_mRot);
 	D3DXMatrixIdentity(&m_mTrans);
 	D3DXMatrixIdentity(&m_mTransInv);
@@ -49,6 +50,17 @@ Surface::~Surface()
 
 	SAFE_RELEASE(m_pDiffuseTexture);
 	SAFE_RELEASE(m_pDiffuseTextureSRV);
+
+	SAFE_DELETE_ARRAY(m_pVertices);
+	SAFE_DELETE(m_pWindingNumber);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Surface::SetModelMatrix(const D3DXMATRIX& mModel)
+{
+	m_mModel = mModel;
+	D3DXMatrixInverse(&m_mModelInv, NULL, &m_mModel);
 }
 
 /****************************************************************************
@@ -64,7 +76,7 @@ void Surface::Translate(float fX, float fY, float fZ)
 	D3DXMatrixTranslation(&m_mTrans, m_vTranslation.x, m_vTranslation.y, m_vTranslation.z);
 	D3DXMatrixTranslation(&m_mTransInv, -m_vTranslation.x, -m_vTranslation.y, -m_vTranslation.z);
 
-	m_mModel *= mTrans;
+	SetModelMatrix(m_mModel * mTrans);
 }
 
 /****************************************************************************
@@ -74,7 +86,7 @@ void Surface::Rotate(D3DXVECTOR3 axis, float fFactor)
 	D3DXMATRIX mRot;
 	D3DXMatrixRotationAxis(&mRot, &axis, fFactor);
 
-	m_mModel *= m_mTransInv * mRot * m_mTrans;
+	SetModelMatrix(m_mModel * m_mTransInv * mRot * m_mTrans);
 }
 
 /****************************************************************************
@@ -84,7 +96,7 @@ void Surface::RotateX(float fFactor)
 	D3DXMATRIX mRot;
 	D3DXMatrixRotationX(&mRot, fFactor);
 
-	m_mModel *= m_mTransInv * mRot * m_mTrans;
+	SetModelMatrix(m_mModel * m_mTransInv * mRot * m_mTrans);
 }
 
 /****************************************************************************
@@ -94,7 +106,7 @@ void Surface::RotateY(float fFactor)
 	D3DXMATRIX mRot;
 	D3DXMatrixRotationY(&mRot, fFactor);
 
-	m_mModel *= m_mTransInv * mRot * m_mTrans;
+	SetModelMatrix(m_mModel * m_mTransInv * mRot * m_mTrans);
 }
 
 /****************************************************************************
@@ -104,7 +116,7 @@ void Surface::RotateZ(float fFactor)
 	D3DXMATRIX mRot;
 	D3DXMatrixRotationZ(&mRot, fFactor);
 
-	m_mModel *= m_mTransInv * mRot * m_mTrans;
+	SetModelMatrix(m_mModel * m_mTransInv * mRot * m_mTrans);
 }
 
 /****************************************************************************
@@ -114,7 +126,7 @@ void Surface::Scale(float fFactor)
 	D3DXMATRIX mScale;
 	D3DXMatrixScaling(&mScale, fFactor, fFactor, fFactor);
 
-	m_mModel *= mScale;
+	SetModelMatrix(m_mModel * mScale);
 }
 
 /****************************************************************************
@@ -135,108 +147,39 @@ HRESULT Surface::LoadMesh(std::string strMeshName, std::string* pTextureName /*
 {
 	HRESULT hr(S_OK);
 	
-	//load mesh with assimp
-	Assimp::Importer Importer;
-
-	const aiScene* pScene = Importer.ReadFile(strMeshName.c_str(), aiProcess_Triangulate |
-																	aiProcess_GenNormals
-																	);
-
-	if(pScene == NULL)
+	//load mesh from the mesh cache, the cache imports it with assimp if necessary
+	MESHDATA meshData;
+	if(FAILED(MeshCache::GetInstance()->LoadMesh(strMeshName, &meshData)))
 	{
-		std::string errorstring = Importer.GetErrorString();
-
 		MessageBox ( NULL , L"Mesh type is not supported!", ConvertMultibyteToWideChar(strMeshName).c_str(), MB_OK);
 		return S_OK;
 	}
 
 	//reset model matrix
-	D3DXMatrixIdentity(&m_mModel);
+	D3DXMATRIX mIdentity;
+	D3DXMatrixIdentity(&mIdentity);
+	SetModelMatrix(mIdentity);
 
 	//release buffers
 	SAFE_RELEASE(m_pTriangleVertexBuffer);
 	SAFE_RELEASE(m_pTriangleIndexBuffer);
 	SAFE_RELEASE(m_pEdgeIndexBuffer);
-	SAFE_DELETE(m_pVertices);
-
-	m_nNumVertices = 0;
-	m_nNumIndices = 0;
+	SAFE_DELETE_ARRAY(m_pVertices);
 
-	// Get vertex and index count of the whole mesh
-	for(unsigned int i = 0; i < pScene->mNumMeshes; i++)
-	{
-		m_nNumVertices += pScene->mMeshes[i]->mNumVertices;
-		m_nNumIndices += pScene->mMeshes[i]->mNumFaces*3;
-	}
+	m_nNumVertices = meshData.vVertices.size();
+	m_nNumIndices = meshData.vTriangleIndices.size();
+	m_nNumEdgeIndices = meshData.vEdgeIndices.size();
 
-	// Create vertex and index array
+	// Create vertex array
 	m_pVertices = new SURFACE_VERTEX[m_nNumVertices];
-	unsigned int* pTriangleIndices = new unsigned int[m_nNumIndices];
-	unsigned int* pEdgeIndices = new unsigned int[m_nNumIndices*2];
-	unsigned int mCurrentVertex = 0;
-	unsigned int mCurrentIndex = 0;
-	float fMaxVertexValue = 0;
-
-	bool bLoadTexture = false;
-	m_bHasTextureCoords = false;
-	m_bIsTextured = false;
-
-	//load vertices, normals and texcoords
-	for(unsigned int i = 0; i < pScene->mNumMeshes; i++)
-	{
-		const aiMesh* paiMesh = pScene->mMeshes[i];
+	memcpy(m_pVertices, &meshData.vVertices[0], m_nNumVertices*sizeof(SURFACE_VERTEX));
+	float fMaxVertexValue = meshData.fMaxVertexValue;
 
-		if(paiMesh->HasTextureCoords(0))
-			m_bHasTextureCoords = true;
+	//build the inside/outside classifier of the new mesh
+	m_pWindingNumber->Build(m_pVertices, m_nNumVertices, &meshData.vTriangleIndices[0], m_nNumIndices);
 
-		for(unsigned int j = 0; j < paiMesh->mNumVertices; j++)
-		{
-			const aiVector3D* pPos = &(paiMesh->mVertices[j]);
-			const aiVector3D* pTexcoord = &(paiMesh->mTextureCoords[0][j]);
-			const aiColor4D* pColor = &(paiMesh->mColors[0][j]);
-
-			SURFACE_VERTEX vertex;
-			vertex.pos = D3DXVECTOR3(pPos->x, pPos->y, pPos->z);
-			if(paiMesh->HasTextureCoords(0) && pTexcoord != NULL)
-				vertex.texcoord = D3DXVECTOR2(pTexcoord->x, pTexcoord->y);
-			else
-				vertex.texcoord = D3DXVECTOR2();
-
-			if(paiMesh->HasVertexColors(0) && pColor != NULL)
-				vertex.color = D3DXVECTOR4(pColor->r, pColor->g, pColor->b, pColor->a);
-			else
-				vertex.color = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
-
-			//get maximum vertex value to scale the model inside the window
-			if(abs(vertex.pos.x) > fMaxVertexValue)
-				fMaxVertexValue = abs(vertex.pos.x);
-			if(abs(vertex.pos.y) > fMaxVertexValue)
-				fMaxVertexValue = abs(vertex.pos.y);
-			if(abs(vertex.pos.z) > fMaxVertexValue)
-				fMaxVertexValue = abs(vertex.pos.z);
-			
-			m_pVertices[mCurrentVertex] = vertex;
-			mCurrentVertex++;
-		}
-
-		for(unsigned int j = 0; j < paiMesh->mNumFaces; j++)
-		{
-			const aiFace& face = paiMesh->mFaces[j];
-			assert(face.mNumIndices == 3);
-			pTriangleIndices[mCurrentIndex] = face.mIndices[0];
-			pTriangleIndices[mCurrentIndex+1] = face.mIndices[1];
-			pTriangleIndices[mCurrentIndex+2] = face.mIndices[2];
-
-			pEdgeIndices[mCurrentIndex*2] = face.mIndices[0];
-			pEdgeIndices[mCurrentIndex*2+1] = face.mIndices[1];
-			pEdgeIndices[mCurrentIndex*2+2] = face.mIndices[1];
-			pEdgeIndices[mCurrentIndex*2+3] = face.mIndices[2];
-			pEdgeIndices[mCurrentIndex*2+4] = face.mIndices[2];
-			pEdgeIndices[mCurrentIndex*2+5] = face.mIndices[0];
-
-			mCurrentIndex += 3;
-		}
-	}
+	m_bHasTextureCoords = meshData.bHasTextureCoords;
+	m_bIsTextured = false;
 
 	if(m_bHasTextureCoords && pColor == NULL)
 	{
@@ -270,42 +213,10 @@ HRESULT Surface::LoadMesh(std::string strMeshName, std::string* pTextureName /*
 			sTextureName = *pTextureName;
 		}
 
-		//load the texture with freeimage
-		//Get the image file type
-		FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(sTextureName.c_str());
-
-		//load the image file
-		FIBITMAP *texture = FreeImage_Load(fif, sTextureName.c_str());
-	
-		if(texture != NULL)
+		//load the texture from the mesh cache, the cache decodes it with freeimage if necessary
+		TEXTUREDATA textureData;
+		if(SUCCEEDED(MeshCache::GetInstance()->LoadTexture(sTextureName, &textureData)))
 		{
-			unsigned char* bits = (unsigned char*)FreeImage_GetBits(texture);
-		
-			unsigned int nBPP = FreeImage_GetBPP(texture);
-			unsigned int nWidth = FreeImage_GetWidth(texture);
-			unsigned int nHeight = FreeImage_GetHeight(texture);
-			unsigned int nPitch = FreeImage_GetPitch(texture);
-			unsigned int nLine = FreeImage_GetLine(texture);
-	
-			unsigned char* texturedata = new unsigned char[nWidth*nHeight*4];
-	
-			int offset = 0;
-			int offset_img = 0;
-
-			for(unsigned int y = 0; y < nHeight; y++)
-			{
-				for(unsigned int x = 0; x < nWidth; x++)
-				{
-					texturedata[offset+2] = ((unsigned char*)bits)[offset_img+0];
-					texturedata[offset+1] = ((unsigned char*)bits)[offset_img+1];
-					texturedata[offset+0] = ((unsigned char*)bits)[offset_img+2];
-					texturedata[offset+3] = ((unsigned char*)bits)[offset_img+3];
-					offset += 4;
-					offset_img += 3;
-				}
-				offset_img = y * nPitch;
-			}
-	
 			//release previous texture
 			SAFE_RELEASE(m_pDiffuseTexture);
 			SAFE_RELEASE(m_pDiffuseTextureSRV);
@@ -314,20 +225,32 @@ HRESULT Surface::LoadMesh(std::string strMeshName, std::string* pTextureName /*
 			D3D11_TEXTURE2D_DESC texDesc;
 			texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 			texDesc.CPUAccessFlags = 0;
-			texDesc.MipLevels = 1;
+			texDesc.MipLevels = textureData.nNumMipLevels;
 			texDesc.MiscFlags = 0;
 			texDesc.SampleDesc.Count = 1;
 			texDesc.SampleDesc.Quality = 0;
 			texDesc.Usage = D3D11_USAGE_DEFAULT;
-			texDesc.Width = FreeImage_GetWidth(texture);
-			texDesc.Height = FreeImage_GetHeight(texture);
+			texDesc.Width = textureData.nWidth;
+			texDesc.Height = textureData.nHeight;
 			texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 			texDesc.ArraySize = 1;
-			D3D11_SUBRESOURCE_DATA texData;
-			texData.pSysMem = texturedata;
-			texData.SysMemPitch = nWidth*4;
-			texData.SysMemSlicePitch = 0;
-			V_RETURN(m_pd3dDevice->CreateTexture2D(&texDesc, &texData, &m_pDiffuseTexture));
+
+			//the mip levels are packed one after another
+			std::vector<D3D11_SUBRESOURCE_DATA> vTexData(textureData.nNumMipLevels);
+			const unsigned char* pLevel = &textureData.vPixels[0];
+			unsigned int nLevelWidth = textureData.nWidth;
+			unsigned int nLevelHeight = textureData.nHeight;
+			for(unsigned int i = 0; i < textureData.nNumMipLevels; i++)
+			{
+				vTexData[i].pSysMem = pLevel;
+				vTexData[i].SysMemPitch = nLevelWidth*4;
+				vTexData[i].SysMemSlicePitch = 0;
+
+				pLevel += nLevelWidth*nLevelHeight*4;
+				nLevelWidth = max(1u, nLevelWidth/2);
+				nLevelHeight = max(1u, nLevelHeight/2);
+			}
+			V_RETURN(m_pd3dDevice->CreateTexture2D(&texDesc, &vTexData[0], &m_pDiffuseTexture));
 			DXUT_SetDebugName( m_pDiffuseTexture, sTextureName.c_str());
 	
 			//create SRV
@@ -335,13 +258,11 @@ HRESULT Surface::LoadMesh(std::string strMeshName, std::string* pTextureName /*
 			ZeroMemory(&srvDesc, sizeof(srvDesc));
 			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 			srvDesc.Texture2D.MostDetailedMip = 0;
-			srvDesc.Texture2D.MipLevels = 1;
+			srvDesc.Texture2D.MipLevels = textureData.nNumMipLevels;
 			srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 			V_RETURN(m_pd3dDevice->CreateShaderResourceView(m_pDiffuseTexture, &srvDesc, &m_pDiffuseTextureSRV));	
 		}
 
-		FreeImage_Unload(texture);
-
 		m_bIsTextured = true;
 	}
 	else
@@ -417,20 +338,20 @@ HRESULT Surface::LoadMesh(std::string strMeshName, std::string* pTextureName /*
 	ibtDesc.CPUAccessFlags = 0;
 	ibtDesc.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA ibtInitialData;
-	ibtInitialData.pSysMem = pTriangleIndices;
+	ibtInitialData.pSysMem = &meshData.vTriangleIndices[0];
 	ibtInitialData.SysMemPitch = 0;
 	ibtInitialData.SysMemSlicePitch = 0;
 	m_pd3dDevice->CreateBuffer(&ibtDesc, &ibtInitialData, &m_pTriangleIndexBuffer);
 
 	//Create edge index buffer
 	D3D11_BUFFER_DESC ibeDesc;
-	ibeDesc.ByteWidth = m_nNumIndices*2*sizeof(unsigned int);
+	ibeDesc.ByteWidth = m_nNumEdgeIndices*sizeof(unsigned int);
 	ibeDesc.Usage = D3D11_USAGE_DEFAULT;
 	ibeDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibeDesc.CPUAccessFlags = 0;
 	ibeDesc.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA ibeInitialData;
-	ibeInitialData.pSysMem = pEdgeIndices;
+	ibeInitialData.pSysMem = &meshData.vEdgeIndices[0];
 	ibeInitialData.SysMemPitch = 0;
 	ibeInitialData.SysMemSlicePitch = 0;
 	m_pd3dDevice->CreateBuffer(&ibeDesc, &ibeInitialData, &m_pEdgeIndexBuffer);
@@ -466,6 +387,19 @@ HRESULT Surface::Initialize(std::string strMeshName, D3DXCOLOR cColor)
 	return hr;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+HRESULT Surface::Initialize(std::string strMeshName)
+{
+	HRESULT hr(S_OK);
+
+	V_RETURN(InitializeShader());
+
+	V_RETURN(LoadMesh(strMeshName));
+
+	return hr;
+}
+
 /****************************************************************************
  ****************************************************************************/
 void Surface::Render(D3DXMATRIX mViewProjection)
@@ -533,7 +467,7 @@ void Surface::RenderVoronoi(ID3DX11EffectTechnique* pVoronoiTechnique, ID3DX11Ef
 	//apply edge pass
 	pVoronoiTechnique->GetPassByName("Edge")->Apply( 0, m_pd3dImmediateContext);
 	
-	m_pd3dImmediateContext->DrawIndexed(m_nNumIndices*2, 0, 0);
+	m_pd3dImmediateContext->DrawIndexed(m_nNumEdgeIndices, 0, 0);
 
 	//POINT
 	m_pd3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
@@ -581,6 +515,41 @@ BOUNDINGBOX Surface::GetBoundingBox()
 	return bbFinal;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+float Surface::GetWindingNumber(D3DXVECTOR3 vPosition)
+{
+	//the winding number is invariant under the model transformation, so the point is moved to object space
+	D3DXVECTOR3 vObjectPosition;
+	D3DXVec3TransformCoord(&vObjectPosition, &vPosition, &m_mModelInv);
+
+	return m_pWindingNumber->Compute(vObjectPosition);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+bool Surface::IsPointInside(D3DXVECTOR3 vPosition)
+{
+	return fabs(GetWindingNumber(vPosition)) > 0.5f;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void Surface::GetSamplePoints(std::vector<D3DXVECTOR3>& vPoints, unsigned int nMaxPoints)
+{
+	vPoints.clear();
+	if(m_nNumVertices == 0 || nMaxPoints == 0)
+		return;
+
+	unsigned int nStep = max(1u, m_nNumVertices / nMaxPoints);
+	for(unsigned int i = 0; i < m_nNumVertices && vPoints.size() < nMaxPoints; i += nStep)
+	{
+		D3DXVECTOR3 vPosition;
+		D3DXVec3TransformCoord(&vPosition, &m_pVertices[i].pos, &m_mModel);
+		vPoints.push_back(vPosition);
+	}
+}
+
 /****************************************************************************
  ****************************************************************************/
 HRESULT Surface::InitializeShader()
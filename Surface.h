@@ -1,6 +1,10 @@
 #ifndef SURFACE_H
 #define SURFACE_H
 
+#include <vector>
+
+class WindingNumber;
+
 class Surface
 {
 public:
@@ -15,9 +19,10 @@ public:
 	~Surface();
 	
 	/*
-	 *  Model matrix
+	 *  Getter and setter for the model matrix, the setter also updates its cached inverse
 	 */
-	D3DXMATRIX m_mModel;
+	const D3DXMATRIX& GetModelMatrix() const { return m_mModel; }
+	void SetModelMatrix(const D3DXMATRIX& mModel);
 
 	/*
 	 *  Translation, rotation and scale functions
@@ -51,6 +56,7 @@ public:
 	 */
 	HRESULT Initialize(std::string strMeshName, std::string strTextureName);
 	HRESULT Initialize(std::string strMeshName, D3DXCOLOR cColor);
+	HRESULT Initialize(std::string strMeshName);
 
 	/*
 	 *  Render surface
@@ -67,7 +73,24 @@ public:
 	 */
 	BOUNDINGBOX GetBoundingBox();
 
+	/*
+	 *  Inside/outside classification of a point in world space with the generalized winding number
+	 */
+	float GetWindingNumber(D3DXVECTOR3 vPosition);
+	bool IsPointInside(D3DXVECTOR3 vPosition);
+
+	/*
+	 *  Returns up to nMaxPoints vertices of the surface in world space, evenly picked from the vertex list
+	 */
+	void GetSamplePoints(std::vector<D3DXVECTOR3>& vPoints, unsigned int nMaxPoints);
+
 protected:
+	/*
+	 *  Model matrix and its inverse, which moves the winding number queries to object space
+	 */
+	D3DXMATRIX m_mModel;
+	D3DXMATRIX m_mModelInv;
+
 	/*
 	 *  Initializes the shader
 	 */
@@ -90,6 +113,11 @@ protected:
 	 */
 	SURFACE_VERTEX* m_pVertices;
 
+	/*
+	 *  Winding number hierarchy of the triangles in object space
+	 */
+	WindingNumber* m_pWindingNumber;
+
 	/*
 	 *  Vertexbuffer - two index buffers are needed because of the differences in the voronoi 
 	 *  algorithm of triangle and edge rendering
@@ -99,6 +127,7 @@ protected:
 	ID3D11Buffer*	m_pEdgeIndexBuffer;
 	unsigned int m_nNumVertices;
 	unsigned int m_nNumIndices;
+	unsigned int m_nNumEdgeIndices;
 
 	/*
 	 *  Texture of the surface and its SRV
@@ -1,69 +1,70 @@
 #include "TextureManager.h"
 #include "Scene.h"
+#include "Profiler.h"
 
 
-
-TextureManager* TextureManager::s_pInstance = NULL;
-
-/****************************************************************************
- ****************************************************************************/
-TextureManager * TextureManager::GetInstance()
-{
-	if(s_pInstance == NULL)
-		s_pInstance = new TextureManager();
-	return s_pInstance;
-}
-
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::DeleteInstance()
-{
-	if(s_pInstance != NULL)
-		SAFE_DELETE(s_pInstance)
-}
-
-/****************************************************************************
- ****************************************************************************/
-TextureManager::TextureManager()
+TextureManager::TextureManager(Scene* pScene)
 {
+	m_pScene = pScene;
 	m_pOldRTV = NULL;
 	m_pOldDSV = NULL;
 	m_nOldViewports = 0;
 	m_pViewports[100];
 
-	m_nCurrentTextureID = 1;
-	m_nCurrentDepthBufferID = 1;
+	//slot 0 is never handed out, the IDs start at 1
+	TEXTURESLOT textureSlot;
+	textureSlot.nGeneration = 0;
+	textureSlot.bUsed = false;
+	textureSlot.pResource = NULL;
+	textureSlot.pRTV = NULL;
+	textureSlot.pSRV = NULL;
+	m_vTextureSlots.push_back(textureSlot);
+
+	DEPTHBUFFERSLOT depthBufferSlot;
+	depthBufferSlot.nGeneration = 0;
+	depthBufferSlot.bUsed = false;
+	depthBufferSlot.pTexture = NULL;
+	depthBufferSlot.pDSV = NULL;
+	m_vDepthBufferSlots.push_back(depthBufferSlot);
+
+	m_MemoryStats.nLiveBytes = 0;
+	m_MemoryStats.nPooledBytes = 0;
+	m_MemoryStats.nHighWaterMark = 0;
+	m_MemoryStats.nBudget = TEXTURE_DEFAULT_MEMORY_BUDGET;
+	m_MemoryStats.nNumCreated = 0;
+	m_MemoryStats.nNumReused = 0;
+	m_MemoryStats.nNumEvicted = 0;
+	m_MemoryStats.nNumOverBudget = 0;
 }
 
 /****************************************************************************
  ****************************************************************************/
 TextureManager::~TextureManager()
 {
-	for(unsigned int i = 1; i < m_nCurrentTextureID; i++)
+	for(unsigned int i = 1; i < m_vTextureSlots.size(); i++)
 	{
-		SAFE_RELEASE(m_TextureMap[i]);
-		SAFE_RELEASE(m_TextureRTVs[i]);
-		SAFE_RELEASE(m_TextureSRVs[i]);
+		TEXTURESLOT& slot = m_vTextureSlots[i];
+		if(!slot.bUsed)
+			continue;
+
+		SAFE_RELEASE(slot.pResource);
+		ItlReleaseViews(slot);
 	}
 
-	for(unsigned int i = 1; i < m_nCurrentDepthBufferID; i++)
+	for(unsigned int i = 1; i < m_vDepthBufferSlots.size(); i++)
 	{
-		SAFE_RELEASE(m_DepthBufferMap[i]);
-		SAFE_RELEASE(m_DepthBufferViewMap[i]);
+		SAFE_RELEASE(m_vDepthBufferSlots[i].pTexture);
+		SAFE_RELEASE(m_vDepthBufferSlots[i].pDSV);
 	}
-}
-
-/****************************************************************************
- ****************************************************************************/
-unsigned int	TextureManager::Create2DTexture(const std::string sDebugName,
-												const int iWidth,
-												const int iHeight)
-{
-	unsigned int nID = ItlGetNewTextureID();
-
-	ItlCreate2DTexture(sDebugName, nID, iWidth, iHeight);
 
-	return nID;
+	for(unsigned int i = 0; i < m_vTexturePool.size(); i++)
+	{
+		SAFE_RELEASE(m_vTexturePool[i].pResource);
+		SAFE_RELEASE(m_vTexturePool[i].pDSV);
+	}
+	m_vTexturePool.clear();
 }
 
 /****************************************************************************
@@ -73,11 +74,7 @@ unsigned int	TextureManager::Create3DTexture(const std::string sDebugName,
 												const int iHeight,
 												const int iDepth)
 {
-	unsigned int nID = ItlGetNewTextureID();
-
-	ItlCreate3DTexture(sDebugName, nID, iWidth, iHeight, iDepth);
-
-	return nID;
+	return ItlCreateTexture(sDebugName, 1, iWidth, iHeight, iDepth);
 }
 
 /****************************************************************************
@@ -95,90 +92,117 @@ unsigned int	TextureManager::Create2DDepthBuffer(const std::string sDebugName,
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::Update2DTexture(const unsigned int nID,
+void	TextureManager::Update3DTexture(const unsigned int nID,
 										const int iWidth,
-										const int iHeight)
+										const int iHeight, 
+										const int iDepth)
 {
-	assert(m_TextureMap.find(nID) != m_TextureMap.end());
+	assert(ItlGetTextureSlot(nID).state.nType == 1);
 
-	SAFE_RELEASE(m_TextureMap[nID]);
-	SAFE_RELEASE(m_TextureRTVs[nID]);
-	SAFE_RELEASE(m_TextureSRVs[nID]);
+	ItlResizeTexture(nID, iWidth, iHeight, iDepth);
+}
 
-	ItlCreate2DTexture(m_TextureStateMap[nID].sDebugName, nID, iWidth, iHeight);
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::Update2DDepthBuffer(const unsigned int nID,
+											const int iWidth,
+											const int iHeight)
+{
+	DEPTHBUFFERSLOT& slot = ItlGetDepthBufferSlot(nID);
+
+	DEPTHBUFFERSTATE state = slot.state;
+	if(state.iWidth == iWidth && state.iHeight == iHeight)
+		return;
+
+	TEXTUREKEY key;
+	key.nType = 2;
+	key.iWidth = state.iWidth;
+	key.iHeight = state.iHeight;
+	key.iDepth = 1;
+	key.format = DXGI_FORMAT_D32_FLOAT;
+	ItlReleaseResource(key, slot.pTexture, slot.pDSV);
+	slot.pTexture = NULL;
+	slot.pDSV = NULL;
+
+	ItlCreate2DDepthBuffer(state.sDebugName, nID, iWidth, iHeight);
+}
 
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::Clear2DDepthBuffer(const unsigned int nID)
+{
+	m_pScene->GetContext()->ClearDepthStencilView(ItlGetDepthBufferSlot(nID).pDSV, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
 }
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::Update3DTexture(const unsigned int nID,
-										const int iWidth,
-										const int iHeight, 
-										const int iDepth)
+void	TextureManager::ReleaseTexture(const unsigned int nID)
 {
-	assert(m_TextureMap.find(nID) != m_TextureMap.end());
+	TEXTURESLOT& slot = ItlGetTextureSlot(nID);
 
-	SAFE_RELEASE(m_TextureMap[nID]);
-	SAFE_RELEASE(m_TextureRTVs[nID]);
-	SAFE_RELEASE(m_TextureSRVs[nID]);
+	ItlReleaseViews(slot);
+	ItlReleaseResource(ItlGetTextureKey(slot.state), slot.pResource, NULL);
 
-	ItlCreate3DTexture(m_TextureStateMap[nID].sDebugName, nID, iWidth, iHeight, iDepth);
+	slot.pResource = NULL;
+	slot.bUsed = false;
+	slot.nGeneration++;
+	m_vFreeTextureSlots.push_back(nID & TEXTURE_HANDLE_INDEX_MASK);
 }
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::Update2DDepthBuffer(const unsigned int nID,
-											const int iWidth,
-											const int iHeight)
+void	TextureManager::ReleaseDepthBuffer(const unsigned int nID)
 {
-	assert(m_DepthBufferMap.find(nID) != m_DepthBufferMap.end());
+	DEPTHBUFFERSLOT& slot = ItlGetDepthBufferSlot(nID);
+
+	TEXTUREKEY key;
+	key.nType = 2;
+	key.iWidth = slot.state.iWidth;
+	key.iHeight = slot.state.iHeight;
+	key.iDepth = 1;
+	key.format = DXGI_FORMAT_D32_FLOAT;
+	ItlReleaseResource(key, slot.pTexture, slot.pDSV);
+
+	slot.pTexture = NULL;
+	slot.pDSV = NULL;
+	slot.bUsed = false;
+	slot.nGeneration++;
+	m_vFreeDepthBufferSlots.push_back(nID & TEXTURE_HANDLE_INDEX_MASK);
+}
 
-	SAFE_RELEASE(m_DepthBufferMap[nID]);
-	SAFE_RELEASE(m_DepthBufferViewMap[nID]);
+/****************************************************************************
+ ****************************************************************************/
+bool	TextureManager::IsValidTexture(const unsigned int nID) const
+{
+	unsigned int nIndex = nID & TEXTURE_HANDLE_INDEX_MASK;
+	if(nIndex == 0 || nIndex >= m_vTextureSlots.size())
+		return false;
 
-	ItlCreate2DDepthBuffer(m_DepthBufferStateMap[nID].sDebugName, nID, iWidth, iHeight);
+	const TEXTURESLOT& slot = m_vTextureSlots[nIndex];
+	return slot.bUsed && slot.nGeneration == (nID >> TEXTURE_HANDLE_INDEX_BITS);
 }
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::Clear2DDepthBuffer(const unsigned int nID)
+bool	TextureManager::IsValidDepthBuffer(const unsigned int nID) const
 {
-	assert(m_DepthBufferMap.find(nID) != m_DepthBufferMap.end());
+	unsigned int nIndex = nID & TEXTURE_HANDLE_INDEX_MASK;
+	if(nIndex == 0 || nIndex >= m_vDepthBufferSlots.size())
+		return false;
 
-	Scene::GetInstance()->GetContext()->ClearDepthStencilView(m_DepthBufferViewMap[nID], D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
+	const DEPTHBUFFERSLOT& slot = m_vDepthBufferSlots[nIndex];
+	return slot.bUsed && slot.nGeneration == (nID >> TEXTURE_HANDLE_INDEX_BITS);
 }
 
 /****************************************************************************
  ****************************************************************************/
 void	TextureManager::BindTextureAsRTV(const unsigned int nID)
 {
-	assert(m_TextureMap.find(nID) != m_TextureMap.end());
-
 	ItlStoreOldRenderState();
 
-	TEXTURESTATE state = GetTextureState(nID);
-
-	SAFE_RELEASE(m_TextureRTVs[nID]);
-
-	D3D11_RENDER_TARGET_VIEW_DESC desc;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	if(state.nType == 0)
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipSlice = 0;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MipSlice = 0;
-		desc.Texture3D.FirstWSlice = 0;
-		desc.Texture3D.WSize = state.iDepth;
-	}
-
-	Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_TextureMap[nID], &desc, &m_TextureRTVs[nID]);
-
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(1, &m_TextureRTVs[nID], NULL);
+	ID3D11RenderTargetView* pRTV = ItlGetRTV(ItlGetTextureSlot(nID));
 
+	m_pScene->GetContext()->OMSetRenderTargets(1, &pRTV, NULL);
 }
 
 /****************************************************************************
@@ -186,52 +210,12 @@ void	TextureManager::BindTextureAsRTV(const unsigned int nID)
 void	TextureManager::BindTextureAsRTV(const unsigned int nID1, 
 										 const unsigned int nID2)
 {
-	assert(m_TextureMap.find(nID1) != m_TextureMap.end());
-	assert(m_TextureMap.find(nID2) != m_TextureMap.end());
-
 	ItlStoreOldRenderState();
 
-	TEXTURESTATE state1 = GetTextureState(nID1);
-	TEXTURESTATE state2 = GetTextureState(nID2);
-
-	SAFE_RELEASE(m_TextureRTVs[nID1]);
-	SAFE_RELEASE(m_TextureRTVs[nID2]);
-
-	D3D11_RENDER_TARGET_VIEW_DESC desc;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	if(state1.nType == 0)
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipSlice = 0;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MipSlice = 0;
-		desc.Texture3D.FirstWSlice = 0;
-		desc.Texture3D.WSize = state1.iDepth;
-	}
-
-	if(state2.nType == 0)
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipSlice = 0;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MipSlice = 0;
-		desc.Texture3D.FirstWSlice = 0;
-		desc.Texture3D.WSize = state2.iDepth;
-	}
-
-	Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_TextureMap[nID1], &desc, &m_TextureRTVs[nID1]);
-	Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_TextureMap[nID2], &desc, &m_TextureRTVs[nID2]);
-
 	ID3D11RenderTargetView* destRTVs[2];
-	destRTVs[0] = m_TextureRTVs[nID1];
-	destRTVs[1] = m_TextureRTVs[nID2];
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(2, destRTVs, NULL);
+	destRTVs[0] = ItlGetRTV(ItlGetTextureSlot(nID1));
+	destRTVs[1] = ItlGetRTV(ItlGetTextureSlot(nID2));
+	m_pScene->GetContext()->OMSetRenderTargets(2, destRTVs, NULL);
 }
 
 /****************************************************************************
@@ -240,53 +224,39 @@ void	TextureManager::BindTextureAsRTV(const unsigned int nID1,
 										 const unsigned int nID2,
 										 const unsigned int nDepthBufferID)
 {
-	assert(m_TextureMap.find(nID1) != m_TextureMap.end());
-	assert(m_TextureMap.find(nID2) != m_TextureMap.end());
-	assert(m_DepthBufferMap.find(nDepthBufferID) != m_DepthBufferMap.end());
-
 	ItlStoreOldRenderState();
 
-	TEXTURESTATE state1 = GetTextureState(nID1);
-	TEXTURESTATE state2 = GetTextureState(nID2);
+	ID3D11RenderTargetView* destRTVs[2];
+	destRTVs[0] = ItlGetRTV(ItlGetTextureSlot(nID1));
+	destRTVs[1] = ItlGetRTV(ItlGetTextureSlot(nID2));
+	m_pScene->GetContext()->OMSetRenderTargets(2, destRTVs, ItlGetDepthBufferSlot(nDepthBufferID).pDSV);
+}
 
-	SAFE_RELEASE(m_TextureRTVs[nID1]);
-	SAFE_RELEASE(m_TextureRTVs[nID2]);
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::BindTextureSliceAsRTV(const unsigned int nID,
+											  const int iSliceIndex)
+{
+	ItlStoreOldRenderState();
 
-	D3D11_RENDER_TARGET_VIEW_DESC desc;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	if(state1.nType == 0)
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipSlice = 0;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MipSlice = 0;
-		desc.Texture3D.FirstWSlice = 0;
-		desc.Texture3D.WSize = state1.iDepth;
-	}
+	ID3D11RenderTargetView* pRTV = ItlGetSliceRTV(ItlGetTextureSlot(nID), iSliceIndex);
 
-	if(state2.nType == 0)
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipSlice = 0;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MipSlice = 0;
-		desc.Texture3D.FirstWSlice = 0;
-		desc.Texture3D.WSize = state2.iDepth;
-	}
+	m_pScene->GetContext()->OMSetRenderTargets(1, &pRTV, NULL);
+}
 
-	Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_TextureMap[nID1], &desc, &m_TextureRTVs[nID1]);
-	Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_TextureMap[nID2], &desc, &m_TextureRTVs[nID2]);
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::BindTextureSliceAsRTV(const unsigned int nID1, 
+											  const unsigned int nID2,
+											  const int iSliceIndex,
+											  const unsigned int nDepthBufferID)
+{
+	ItlStoreOldRenderState();
 
 	ID3D11RenderTargetView* destRTVs[2];
-	destRTVs[0] = m_TextureRTVs[nID1];
-	destRTVs[1] = m_TextureRTVs[nID2];
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(2, destRTVs, m_DepthBufferViewMap[nDepthBufferID]);
+	destRTVs[0] = ItlGetSliceRTV(ItlGetTextureSlot(nID1), iSliceIndex);
+	destRTVs[1] = ItlGetSliceRTV(ItlGetTextureSlot(nID2), iSliceIndex);
+	m_pScene->GetContext()->OMSetRenderTargets(2, destRTVs, ItlGetDepthBufferSlot(nDepthBufferID).pDSV);
 }
 
 /****************************************************************************
@@ -306,28 +276,7 @@ void	TextureManager::UnBindRTVs()
 void	TextureManager::BindTextureAsSRV(const unsigned int nID, 
 										 ID3DX11EffectShaderResourceVariable* pSRVar)
 {
-	TEXTURESTATE state = GetTextureState(nID);
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC desc;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	if(state.nType == 0)
-	{
-		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MostDetailedMip = 0;
-		desc.Texture2D.MipLevels = 1;
-	}
-	else
-	{
-		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
-		desc.Texture3D.MostDetailedMip = 0;
-		desc.Texture3D.MipLevels = 1;
-	}
-
-	SAFE_RELEASE(m_TextureSRVs[nID]);
-	
-	Scene::GetInstance()->GetDevice()->CreateShaderResourceView(m_TextureMap[nID], &desc, &m_TextureSRVs[nID]);
-
-	pSRVar->SetResource(m_TextureSRVs[nID]);
+	pSRVar->SetResource(ItlGetSRV(ItlGetTextureSlot(nID)));
 }
 
 /****************************************************************************
@@ -339,122 +288,168 @@ void	TextureManager::UnBindSRV(ID3DX11EffectShaderResourceVariable* pSRVar)
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::Render2DTextureInto3DSlice(const unsigned int n2DTexture,
-												   const unsigned int n3DTexture,
-												   const int iSliceIndex)
+void	TextureManager::CopyTexture(const unsigned int nSourceID,
+									const unsigned int nDestID)
 {
-	Scene::GetInstance()->GetContext()->CopySubresourceRegion(m_TextureMap[n3DTexture], 0, 0, 0, iSliceIndex, m_TextureMap[n2DTexture], 0, NULL);
+	m_pScene->GetContext()->CopyResource(ItlGetTextureSlot(nDestID).pResource, ItlGetTextureSlot(nSourceID).pResource);
 }
 
 /****************************************************************************
  ****************************************************************************/
-TextureManager::TEXTURESTATE	TextureManager::GetTextureState(const unsigned int nID)
+void	TextureManager::CopyTextureSlice(const unsigned int nSourceID,
+										 const int iSourceSlice,
+										 const unsigned int nDestID,
+										 const int iDestSlice,
+										 const D3D11_RECT& rect)
 {
-	return m_TextureStateMap[nID];
-}
+	PROFILE_SCOPE("Slice copy");
+	Profiler::GetInstance()->AddCounter("Bytes copied", 16.0 * (rect.right - rect.left) * (rect.bottom - rect.top));
 
-/****************************************************************************
- ****************************************************************************/
-TextureManager::DEPTHBUFFERSTATE	TextureManager::GetDepthBufferState(const unsigned int nID)
-{
-	return m_DepthBufferStateMap[nID];
+	TEXTURESLOT& source = ItlGetTextureSlot(nSourceID);
+	TEXTURESLOT& dest = ItlGetTextureSlot(nDestID);
+	assert(source.state.nType == 1 && dest.state.nType == 1);
+
+	//CopySubresourceRegion needs different subresources
+	assert(source.pResource != dest.pResource);
+
+	D3D11_BOX box;
+	box.left = rect.left;
+	box.top = rect.top;
+	box.front = iSourceSlice;
+	box.right = rect.right;
+	box.bottom = rect.bottom;
+	box.back = iSourceSlice + 1;
+
+	m_pScene->GetContext()->CopySubresourceRegion(dest.pResource, 0, rect.left, rect.top, iDestSlice, source.pResource, 0, &box);
 }
 
 /****************************************************************************
  ****************************************************************************/
-ID3D11Resource*		TextureManager::GetTexture(const unsigned int nID)
+void	TextureManager::ClearTextureSlice(const unsigned int nID,
+										  const int iSliceIndex)
 {
-	return m_TextureMap[nID];
+	float pClearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	m_pScene->GetContext()->ClearRenderTargetView(ItlGetSliceRTV(ItlGetTextureSlot(nID), iSliceIndex), pClearColor);
 }
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::ItlCreate2DTexture(const std::string sDebugName,
-										   const unsigned int nID,
-										   const int iWidth, 
-										   const int iHeight)
+HRESULT	TextureManager::ReadBack3DTexture(const unsigned int nID,
+										  const int iChannel,
+										  std::vector<float>& vData)
 {
 	HRESULT hr;
 
-	D3D11_TEXTURE2D_DESC desc;
-	desc.Width = iWidth;
-	desc.Height = iHeight;
+	TEXTURESLOT& slot = ItlGetTextureSlot(nID);
+	TEXTURESTATE state = slot.state;
+	assert(state.nType == 1);
+
+	//create a staging copy of the texture
+	D3D11_TEXTURE3D_DESC desc;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 	desc.MipLevels = 1;
-	desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	desc.SampleDesc.Count = 1;
-	desc.SampleDesc.Quality = 0;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
-	desc.CPUAccessFlags = 0;
 	desc.MiscFlags = 0;
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.Width = state.iWidth;
+	desc.Height = state.iHeight;
+	desc.Depth = state.iDepth;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 
-	ID3D11Texture2D* pTexture2D;
+	ID3D11Texture3D* pStagingTexture = NULL;
+	V_RETURN(m_pScene->GetDevice()->CreateTexture3D(&desc, NULL, &pStagingTexture));
 
-	hr = Scene::GetInstance()->GetDevice()->CreateTexture2D(&desc, NULL, &pTexture2D);
-	assert(hr == S_OK);
+	m_pScene->GetContext()->CopyResource(pStagingTexture, slot.pResource);
 
-	DXUT_SetDebugName(pTexture2D, sDebugName.c_str());
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	hr = m_pScene->GetContext()->Map(pStagingTexture, 0, D3D11_MAP_READ, 0, &mapped);
+	if(FAILED(hr))
+	{
+		SAFE_RELEASE(pStagingTexture);
+		return hr;
+	}
 
+	vData.resize(state.iWidth * state.iHeight * state.iDepth);
+	for(int z = 0; z < state.iDepth; z++)
+	{
+		for(int y = 0; y < state.iHeight; y++)
+		{
+			const float* pRow = (const float*)((const unsigned char*)mapped.pData + z * mapped.DepthPitch + y * mapped.RowPitch);
+			float* pDest = &vData[(z * state.iHeight + y) * state.iWidth];
+			for(int x = 0; x < state.iWidth; x++)
+				pDest[x] = pRow[4 * x + iChannel];
+		}
+	}
 
-	TEXTURESTATE state;
-	state.sDebugName = sDebugName;
-	state.nID = nID;
-	state.bBoundAsRTV = false;
-	state.bBoundAsSRV = false;
-	state.nType = 0;
-	state.iWidth = iWidth;
-	state.iHeight = iHeight;
-	state.iDepth = 1;
+	m_pScene->GetContext()->Unmap(pStagingTexture, 0);
+	SAFE_RELEASE(pStagingTexture);
 
-	m_TextureStateMap[state.nID] = state;
-	m_TextureMap[state.nID] = pTexture2D;
-	m_TextureRTVs[state.nID] = NULL;
-	m_TextureSRVs[state.nID] = NULL;
+	return S_OK;
 }
 
 /****************************************************************************
  ****************************************************************************/
-void	TextureManager::ItlCreate3DTexture(const std::string sDebugName,
-										   const unsigned int nID,
-										   const int iWidth, 
-										   const int iHeight, 
-										   const int iDepth)
+void	TextureManager::SetMemoryBudget(unsigned __int64 nBytes)
 {
-	HRESULT hr;
+	m_MemoryStats.nBudget = nBytes;
 
-	D3D11_TEXTURE3D_DESC desc;
-	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
-	desc.CPUAccessFlags = 0;
-	desc.MipLevels = 1;
-	desc.MiscFlags = 0;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.Width = iWidth;
-	desc.Height = iHeight;
-	desc.Depth = iDepth;
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	
-	ID3D11Texture3D* pTexture3D;
+	ItlTrimPool(0);
+}
 
-	hr = Scene::GetInstance()->GetDevice()->CreateTexture3D(&desc, NULL, &pTexture3D);
-	assert(hr == S_OK);
+/****************************************************************************
+ ****************************************************************************/
+TextureManager::TEXTURESTATE	TextureManager::GetTextureState(const unsigned int nID)
+{
+	return ItlGetTextureSlot(nID).state;
+}
 
-	DXUT_SetDebugName(pTexture3D, sDebugName.c_str());
+/****************************************************************************
+ ****************************************************************************/
+TextureManager::DEPTHBUFFERSTATE	TextureManager::GetDepthBufferState(const unsigned int nID)
+{
+	return ItlGetDepthBufferSlot(nID).state;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ID3D11Resource*		TextureManager::GetTexture(const unsigned int nID)
+{
+	return ItlGetTextureSlot(nID).pResource;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned int	TextureManager::ItlCreateTexture(const std::string sDebugName,
+												 const unsigned int nType,
+												 const int iWidth, 
+												 const int iHeight, 
+												 const int iDepth)
+{
+	HRESULT hr;
+
+	unsigned int nID = ItlGetNewTextureID();
 
 	TEXTURESTATE state;
 	state.sDebugName = sDebugName;
 	state.nID = nID;
 	state.bBoundAsRTV = false;
 	state.bBoundAsSRV = false;
-	state.nType = 1;
+	state.nType = nType;
 	state.iWidth = iWidth;
 	state.iHeight = iHeight;
 	state.iDepth = iDepth;
 
-	m_TextureStateMap[state.nID] = state;
-	m_TextureMap[state.nID] = pTexture3D;
-	m_TextureRTVs[state.nID] = NULL;
-	m_TextureSRVs[state.nID] = NULL;
+	ID3D11Resource* pResource = NULL;
+	hr = ItlAcquireResource(ItlGetTextureKey(state), sDebugName, &pResource, NULL);
+	assert(hr == S_OK);
+
+	TEXTURESLOT& slot = m_vTextureSlots[nID & TEXTURE_HANDLE_INDEX_MASK];
+	slot.state = state;
+	slot.pResource = pResource;
+	slot.pRTV = NULL;
+	slot.pSRV = NULL;
+
+	return nID;
 }
 
 /****************************************************************************
@@ -466,50 +461,433 @@ void	TextureManager::ItlCreate2DDepthBuffer(const std::string sDebugName,
 {
 	HRESULT hr;
 
-	D3D11_TEXTURE2D_DESC desc;
-	desc.Width = iWidth;
-	desc.Height = iHeight;
-	desc.MipLevels = 1;
-	desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_D32_FLOAT;
-	desc.SampleDesc.Count = 1;
-	desc.SampleDesc.Quality = 0;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	desc.CPUAccessFlags = 0;
-	desc.MiscFlags = 0;
+	TEXTUREKEY key;
+	key.nType = 2;
+	key.iWidth = iWidth;
+	key.iHeight = iHeight;
+	key.iDepth = 1;
+	key.format = DXGI_FORMAT_D32_FLOAT;
 
-	ID3D11Texture2D			*p2DDepthBufferTex2D;
-	ID3D11DepthStencilView	*p2DDepthBufferView;
+	ID3D11Resource			*p2DDepthBufferTex2D = NULL;
+	ID3D11DepthStencilView	*p2DDepthBufferView = NULL;
 
-	hr = Scene::GetInstance()->GetDevice()->CreateTexture2D(&desc, NULL, &p2DDepthBufferTex2D);
+	hr = ItlAcquireResource(key, sDebugName, &p2DDepthBufferTex2D, &p2DDepthBufferView);
 	assert(hr == S_OK);
-	hr = Scene::GetInstance()->GetDevice()->CreateDepthStencilView(p2DDepthBufferTex2D, NULL, &p2DDepthBufferView);
-
-	DXUT_SetDebugName(p2DDepthBufferTex2D, sDebugName.c_str());
 
 	DEPTHBUFFERSTATE state;
 	state.sDebugName = sDebugName;
 	state.nID = nID;
 	state.bBound = false;
+	state.iWidth = iWidth;
+	state.iHeight = iHeight;
+
+	DEPTHBUFFERSLOT& slot = m_vDepthBufferSlots[nID & TEXTURE_HANDLE_INDEX_MASK];
+	slot.state = state;
+	slot.pTexture = (ID3D11Texture2D*)p2DDepthBufferTex2D;
+	slot.pDSV = p2DDepthBufferView;
+}
+
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT	TextureManager::ItlAcquireResource(const TEXTUREKEY& key,
+										   const std::string& sDebugName,
+										   ID3D11Resource** ppResource,
+										   ID3D11DepthStencilView** ppDSV)
+{
+	HRESULT hr;
+
+	unsigned __int64 nSize = ItlGetMemorySize(key);
+
+	//the most recently released resource is the most likely one to be still resident
+	for(int i = (int)m_vTexturePool.size() - 1; i >= 0; i--)
+	{
+		if(!(m_vTexturePool[i].key == key))
+			continue;
+
+		*ppResource = m_vTexturePool[i].pResource;
+		if(ppDSV != NULL)
+			*ppDSV = m_vTexturePool[i].pDSV;
+		m_vTexturePool.erase(m_vTexturePool.begin() + i);
+
+		m_MemoryStats.nPooledBytes -= nSize;
+		m_MemoryStats.nLiveBytes += nSize;
+		m_MemoryStats.nNumReused++;
+
+		DXUT_SetDebugName(*ppResource, sDebugName.c_str());
+		ItlClearResource(key, *ppResource, ppDSV != NULL ? *ppDSV : NULL);
+
+		return S_OK;
+	}
+
+	ItlTrimPool(nSize);
+	if(m_MemoryStats.nLiveBytes + nSize > m_MemoryStats.nBudget)
+	{
+		WARN_OUT(L"Texture memory budget exceeded");
+		m_MemoryStats.nNumOverBudget++;
+	}
+
+	ID3D11Device* pDevice = m_pScene->GetDevice();
+
+	if(key.nType == 1)
+	{
+		D3D11_TEXTURE3D_DESC desc;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.CPUAccessFlags = 0;
+		desc.MipLevels = 1;
+		desc.MiscFlags = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.Width = key.iWidth;
+		desc.Height = key.iHeight;
+		desc.Depth = key.iDepth;
+		desc.Format = key.format;
+
+		ID3D11Texture3D* pTexture3D = NULL;
+		V_RETURN(pDevice->CreateTexture3D(&desc, NULL, &pTexture3D));
+		*ppResource = pTexture3D;
+	}
+	else
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		desc.Width = key.iWidth;
+		desc.Height = key.iHeight;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = key.format;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = key.nType == 2 ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		ID3D11Texture2D* pTexture2D = NULL;
+		V_RETURN(pDevice->CreateTexture2D(&desc, NULL, &pTexture2D));
+		*ppResource = pTexture2D;
+
+		if(key.nType == 2)
+		{
+			hr = pDevice->CreateDepthStencilView(pTexture2D, NULL, ppDSV);
+			if(FAILED(hr))
+			{
+				SAFE_RELEASE(*ppResource);
+				return hr;
+			}
+		}
+	}
+
+	DXUT_SetDebugName(*ppResource, sDebugName.c_str());
+
+	m_MemoryStats.nLiveBytes += nSize;
+	m_MemoryStats.nNumCreated++;
+	m_MemoryStats.nHighWaterMark = max(m_MemoryStats.nHighWaterMark, m_MemoryStats.nLiveBytes + m_MemoryStats.nPooledBytes);
+
+	return S_OK;
+}
 
-	m_DepthBufferStateMap[state.nID] = state;
-	m_DepthBufferMap[state.nID] = p2DDepthBufferTex2D;
-	m_DepthBufferViewMap[state.nID] = p2DDepthBufferView;
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::ItlReleaseResource(const TEXTUREKEY& key,
+										   ID3D11Resource* pResource,
+										   ID3D11DepthStencilView* pDSV)
+{
+	if(pResource == NULL)
+		return;
+
+	unsigned __int64 nSize = ItlGetMemorySize(key);
+
+	POOLEDTEXTURE pooled;
+	pooled.key = key;
+	pooled.pResource = pResource;
+	pooled.pDSV = pDSV;
+	m_vTexturePool.push_back(pooled);
+
+	m_MemoryStats.nLiveBytes -= nSize;
+	m_MemoryStats.nPooledBytes += nSize;
+
+	ItlTrimPool(0);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::ItlTrimPool(unsigned __int64 nAdditionalBytes)
+{
+	unsigned int nNumEvicted = 0;
+	while(nNumEvicted < m_vTexturePool.size() && 
+		  m_MemoryStats.nLiveBytes + m_MemoryStats.nPooledBytes + nAdditionalBytes > m_MemoryStats.nBudget)
+	{
+		POOLEDTEXTURE& pooled = m_vTexturePool[nNumEvicted];
+		m_MemoryStats.nPooledBytes -= ItlGetMemorySize(pooled.key);
+		SAFE_RELEASE(pooled.pResource);
+		SAFE_RELEASE(pooled.pDSV);
+		nNumEvicted++;
+	}
+
+	m_vTexturePool.erase(m_vTexturePool.begin(), m_vTexturePool.begin() + nNumEvicted);
+	m_MemoryStats.nNumEvicted += nNumEvicted;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::ItlResizeTexture(const unsigned int nID,
+										 const int iWidth, 
+										 const int iHeight, 
+										 const int iDepth)
+{
+	HRESULT hr;
+
+	TEXTURESLOT& slot = ItlGetTextureSlot(nID);
+	TEXTURESTATE state = slot.state;
+
+	TEXTUREKEY key = ItlGetTextureKey(state);
+
+	//same size, only the content is reset
+	if(state.iWidth == iWidth && state.iHeight == iHeight && state.iDepth == iDepth)
+	{
+		ItlClearResource(key, slot.pResource, NULL);
+		return;
+	}
+
+	ItlReleaseResource(key, slot.pResource, NULL);
+
+	key.iWidth = iWidth;
+	key.iHeight = iHeight;
+	key.iDepth = iDepth;
+
+	ItlReleaseViews(slot);
+	slot.pResource = NULL;
+
+	hr = ItlAcquireResource(key, state.sDebugName, &slot.pResource, NULL);
+	assert(hr == S_OK);
+
+	slot.state.iWidth = iWidth;
+	slot.state.iHeight = iHeight;
+	slot.state.iDepth = iDepth;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::ItlClearResource(const TEXTUREKEY& key,
+										 ID3D11Resource* pResource,
+										 ID3D11DepthStencilView* pDSV)
+{
+	if(key.nType == 2)
+	{
+		m_pScene->GetContext()->ClearDepthStencilView(pDSV, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
+		return;
+	}
+
+	D3D11_RENDER_TARGET_VIEW_DESC desc;
+	desc.Format = key.format;
+	if(key.nType == 0)
+	{
+		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		desc.Texture2D.MipSlice = 0;
+	}
+	else
+	{
+		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
+		desc.Texture3D.MipSlice = 0;
+		desc.Texture3D.FirstWSlice = 0;
+		desc.Texture3D.WSize = key.iDepth;
+	}
+
+	ID3D11RenderTargetView* pRTV = NULL;
+	if(FAILED(m_pScene->GetDevice()->CreateRenderTargetView(pResource, &desc, &pRTV)))
+		return;
+
+	float pClearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	m_pScene->GetContext()->ClearRenderTargetView(pRTV, pClearColor);
+	SAFE_RELEASE(pRTV);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+TextureManager::TEXTUREKEY	TextureManager::ItlGetTextureKey(const TEXTURESTATE& state)
+{
+	TEXTUREKEY key;
+	key.nType = state.nType;
+	key.iWidth = state.iWidth;
+	key.iHeight = state.iHeight;
+	key.iDepth = state.iDepth;
+	key.format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	return key;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned __int64	TextureManager::ItlGetMemorySize(const TEXTUREKEY& key)
+{
+	unsigned __int64 nBytesPerTexel = key.format == DXGI_FORMAT_D32_FLOAT ? 4 : 16;
+	return nBytesPerTexel * key.iWidth * key.iHeight * key.iDepth;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+TextureManager::TEXTURESLOT&	TextureManager::ItlGetTextureSlot(const unsigned int nID)
+{
+	assert(IsValidTexture(nID));
+	return m_vTextureSlots[nID & TEXTURE_HANDLE_INDEX_MASK];
+}
+
+/****************************************************************************
+ ****************************************************************************/
+TextureManager::DEPTHBUFFERSLOT&	TextureManager::ItlGetDepthBufferSlot(const unsigned int nID)
+{
+	assert(IsValidDepthBuffer(nID));
+	return m_vDepthBufferSlots[nID & TEXTURE_HANDLE_INDEX_MASK];
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ID3D11RenderTargetView*	TextureManager::ItlGetRTV(TEXTURESLOT& slot)
+{
+	if(slot.pRTV != NULL)
+		return slot.pRTV;
+
+	D3D11_RENDER_TARGET_VIEW_DESC desc;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	if(slot.state.nType == 0)
+	{
+		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		desc.Texture2D.MipSlice = 0;
+	}
+	else
+	{
+		desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
+		desc.Texture3D.MipSlice = 0;
+		desc.Texture3D.FirstWSlice = 0;
+		desc.Texture3D.WSize = slot.state.iDepth;
+	}
+
+	m_pScene->GetDevice()->CreateRenderTargetView(slot.pResource, &desc, &slot.pRTV);
+
+	return slot.pRTV;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ID3D11ShaderResourceView*	TextureManager::ItlGetSRV(TEXTURESLOT& slot)
+{
+	if(slot.pSRV != NULL)
+		return slot.pSRV;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC desc;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	if(slot.state.nType == 0)
+	{
+		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		desc.Texture2D.MostDetailedMip = 0;
+		desc.Texture2D.MipLevels = 1;
+	}
+	else
+	{
+		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+		desc.Texture3D.MostDetailedMip = 0;
+		desc.Texture3D.MipLevels = 1;
+	}
+
+	m_pScene->GetDevice()->CreateShaderResourceView(slot.pResource, &desc, &slot.pSRV);
+
+	return slot.pSRV;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ID3D11RenderTargetView*	TextureManager::ItlGetSliceRTV(TEXTURESLOT& slot, const int iSliceIndex)
+{
+	assert(slot.state.nType == 1);
+	assert(iSliceIndex >= 0 && iSliceIndex < slot.state.iDepth);
+
+	if(slot.vSliceRTVs.empty())
+		slot.vSliceRTVs.resize(slot.state.iDepth, NULL);
+
+	if(slot.vSliceRTVs[iSliceIndex] != NULL)
+		return slot.vSliceRTVs[iSliceIndex];
+
+	D3D11_RENDER_TARGET_VIEW_DESC desc;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
+	desc.Texture3D.MipSlice = 0;
+	desc.Texture3D.FirstWSlice = iSliceIndex;
+	desc.Texture3D.WSize = 1;
+
+	m_pScene->GetDevice()->CreateRenderTargetView(slot.pResource, &desc, &slot.vSliceRTVs[iSliceIndex]);
+
+	return slot.vSliceRTVs[iSliceIndex];
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void	TextureManager::ItlReleaseViews(TEXTURESLOT& slot)
+{
+	SAFE_RELEASE(slot.pRTV);
+	SAFE_RELEASE(slot.pSRV);
+
+	for(unsigned int i = 0; i < slot.vSliceRTVs.size(); i++)
+		SAFE_RELEASE(slot.vSliceRTVs[i]);
+	slot.vSliceRTVs.clear();
 }
 
 /****************************************************************************
  ****************************************************************************/
 unsigned int	TextureManager::ItlGetNewTextureID()
 {
-	return m_nCurrentTextureID++;
+	unsigned int nIndex;
+	if(!m_vFreeTextureSlots.empty())
+	{
+		nIndex = m_vFreeTextureSlots.back();
+		m_vFreeTextureSlots.pop_back();
+	}
+	else
+	{
+		nIndex = (unsigned int)m_vTextureSlots.size();
+		assert(nIndex <= TEXTURE_HANDLE_INDEX_MASK);
+
+		TEXTURESLOT slot;
+		slot.nGeneration = 0;
+		slot.pResource = NULL;
+		slot.pRTV = NULL;
+		slot.pSRV = NULL;
+		m_vTextureSlots.push_back(slot);
+	}
+
+	TEXTURESLOT& slot = m_vTextureSlots[nIndex];
+	slot.bUsed = true;
+	slot.state.nID = 0;
+
+	//the generation wraps around, an ID is only reused after many releases of its slot
+	slot.nGeneration &= (1u << (32 - TEXTURE_HANDLE_INDEX_BITS)) - 1;
+	return (slot.nGeneration << TEXTURE_HANDLE_INDEX_BITS) | nIndex;
 }
 
 /****************************************************************************
  ****************************************************************************/
 unsigned int	TextureManager::ItlGetNewDepthBufferID()
 {
-	return m_nCurrentDepthBufferID++;
+	unsigned int nIndex;
+	if(!m_vFreeDepthBufferSlots.empty())
+	{
+		nIndex = m_vFreeDepthBufferSlots.back();
+		m_vFreeDepthBufferSlots.pop_back();
+	}
+	else
+	{
+		nIndex = (unsigned int)m_vDepthBufferSlots.size();
+		assert(nIndex <= TEXTURE_HANDLE_INDEX_MASK);
+
+		DEPTHBUFFERSLOT slot;
+		slot.nGeneration = 0;
+		slot.pTexture = NULL;
+		slot.pDSV = NULL;
+		m_vDepthBufferSlots.push_back(slot);
+	}
+
+	DEPTHBUFFERSLOT& slot = m_vDepthBufferSlots[nIndex];
+	slot.bUsed = true;
+
+	slot.nGeneration &= (1u << (32 - TEXTURE_HANDLE_INDEX_BITS)) - 1;
+	return (slot.nGeneration << TEXTURE_HANDLE_INDEX_BITS) | nIndex;
 }
 
 /****************************************************************************
@@ -518,13 +896,13 @@ void	TextureManager::ItlStoreOldRenderState()
 {
 	/*m_pOldRTV = DXUTGetD3D11RenderTargetView();
 	m_pOldDSV = DXUTGetD3D11DepthStencilView();
-	Scene::GetInstance()->GetContext()->RSGetViewports( &m_nOldViewports, &m_pViewports[0]);*/
+	m_pScene->GetContext()->RSGetViewports( &m_nOldViewports, &m_pViewports[0]);*/
 }
 
 /****************************************************************************
  ****************************************************************************/
 void	TextureManager::ItlRestoreOldRenderState()
 {
-	/*Scene::GetInstance()->GetContext()->OMSetRenderTargets( 1,  &m_pOldRTV,  m_pOldDSV );
-	Scene::GetInstance()->GetContext()->RSSetViewports( m_nOldViewports, &m_pViewports[0]);*/
+	/*m_pScene->GetContext()->OMSetRenderTargets( 1,  &m_pOldRTV,  m_pOldDSV );
+	m_pScene->GetContext()->RSSetViewports( m_nOldViewports, &m_pViewports[0]);*/
 }
\ No newline at end of file
@@ -4,6 +4,20 @@
 #include "Globals.h"
 #include <map>
 #include <string>
+#include <vector>
+
+class Scene;
+
+//released textures are kept for reuse as long as all textures fit into the budget
+#define TEXTURE_DEFAULT_MEMORY_BUDGET ((unsigned __int64)1024 * 1024 * 1024)
+
+/*
+ *  Texture IDs are handles: the lower bits are the index of the slot, the upper bits count how often
+ *	the slot was reused. An ID of a released texture does not match the new texture of its slot.
+ *	The slot 0 is never used, 0 is no valid ID.
+ */
+#define TEXTURE_HANDLE_INDEX_BITS 20
+#define TEXTURE_HANDLE_INDEX_MASK ((1u << TEXTURE_HANDLE_INDEX_BITS) - 1)
 
 class TextureManager
 {
@@ -25,15 +39,28 @@ public:
 		std::string sDebugName;
 		unsigned int nID;
 		bool bBound;
+		int iWidth;
+		int iHeight;
+	};
+
+	struct MEMORYSTATS
+	{
+		unsigned __int64 nLiveBytes;		//textures in use
+		unsigned __int64 nPooledBytes;		//released textures that are kept for reuse
+		unsigned __int64 nHighWaterMark;	//maximum of live and pooled bytes
+		unsigned __int64 nBudget;
+		unsigned int nNumCreated;
+		unsigned int nNumReused;
+		unsigned int nNumEvicted;
+		unsigned int nNumOverBudget;		//allocations that did not fit into the budget
 	};
 
-	static TextureManager* GetInstance();
-	static void DeleteInstance();
+	/*
+	 *  Every scene has its own texture manager, the textures are created on the device of the scene
+	 */
+	TextureManager(Scene* pScene);
+	~TextureManager();
 
-	
-	unsigned int	Create2DTexture(const std::string sDebugName,
-									const int iWidth, 
-									const int iHeight);
 
 	unsigned int	Create3DTexture(const std::string sDebugName,
 									const int iWidth, 
@@ -44,10 +71,10 @@ public:
 										const int iWidth, 
 										const int iHeight);
 
-	void	Update2DTexture(const unsigned int nID, 
-							const int iWidth, 
-							const int iHeight);
-
+	/*
+	 *  Resizes the texture, the content is cleared.
+	 *  The old resource goes back into the pool, a pooled resource of the new size is reused.
+	 */
 	void	Update3DTexture(const unsigned int nID, 
 							const int iWidth, 
 							const int iHeight, 
@@ -59,6 +86,15 @@ public:
 
 	void	Clear2DDepthBuffer(const unsigned int nID);
 
+	/*
+	 *  Puts the resource back into the pool, the ID becomes invalid
+	 */
+	void	ReleaseTexture(const unsigned int nID);
+	void	ReleaseDepthBuffer(const unsigned int nID);
+
+	bool	IsValidTexture(const unsigned int nID) const;
+	bool	IsValidDepthBuffer(const unsigned int nID) const;
+
 	void	BindTextureAsRTV(const unsigned int nID);
 
 	void	BindTextureAsRTV(const unsigned int nID1, 
@@ -68,35 +104,164 @@ public:
 							 const unsigned int nID2, 
 							 const unsigned int nDepthBufferID);
 
+	/*
+	 *  Binds one slice of a 3D texture as render target, the pixel shader writes directly into the volume
+	 */
+	void	BindTextureSliceAsRTV(const unsigned int nID,
+								  const int iSliceIndex);
+
+	void	BindTextureSliceAsRTV(const unsigned int nID1, 
+								  const unsigned int nID2, 
+								  const int iSliceIndex,
+								  const unsigned int nDepthBufferID);
+
 	void	UnBindRTVs();
 
 	void	BindTextureAsSRV(const unsigned int nID, 
 							 ID3DX11EffectShaderResourceVariable* pSRVar);
 
 	void	UnBindSRV(ID3DX11EffectShaderResourceVariable* pSRVar);
-	
-	void	Render2DTextureInto3DSlice(const unsigned int n2DTexture, 
-									   const unsigned int n3DTexture,
-									   const int iSliceIndex);
+
+	/*
+	 *  Copies the whole content of a texture into another texture of the same size and type
+	 */
+	void	CopyTexture(const unsigned int nSourceID,
+						const unsigned int nDestID);
+
+	/*
+	 *  Copies the given rectangle of one slice of a 3D texture into a slice of another 3D texture.
+	 *	A 3D texture has one subresource, so a copy between slices of the same texture has to go
+	 *	through a third texture.
+	 */
+	void	CopyTextureSlice(const unsigned int nSourceID,
+							 const int iSourceSlice,
+							 const unsigned int nDestID,
+							 const int iDestSlice,
+							 const D3D11_RECT& rect);
+
+	/*
+	 *  Clears one slice of a 3D texture to zero
+	 */
+	void	ClearTextureSlice(const unsigned int nID,
+							  const int iSliceIndex);
+
+	/*
+	 *  Copies one channel of a 3D texture to the CPU (x, y, z order), this stalls the pipeline
+	 */
+	HRESULT	ReadBack3DTexture(const unsigned int nID,
+							  const int iChannel,
+							  std::vector<float>& vData);
+
+	/*
+	 *  Released textures are evicted (oldest first) until all textures fit into the budget
+	 */
+	void	SetMemoryBudget(unsigned __int64 nBytes);
+
+	MEMORYSTATS	GetMemoryStats() const { return m_MemoryStats; }
 
 	TEXTURESTATE		GetTextureState(const unsigned int nID);
 	DEPTHBUFFERSTATE	GetDepthBufferState(const unsigned int nID);
 	ID3D11Resource*		GetTexture(const unsigned int nID);
 
 protected:
-	TextureManager();
-	~TextureManager();
+	//textures of the pool are interchangeable if their keys are equal
+	struct TEXTUREKEY
+	{
+		unsigned int nType; // 0 if 2D, 1 if 3D, 2 if depth buffer
+		int iWidth;
+		int iHeight;
+		int iDepth;
+		DXGI_FORMAT format;
+
+		bool operator==(const TEXTUREKEY& other) const
+		{
+			return nType == other.nType && iWidth == other.iWidth && iHeight == other.iHeight && iDepth == other.iDepth && format == other.format;
+		}
+	};
+
+	struct POOLEDTEXTURE
+	{
+		TEXTUREKEY key;
+		ID3D11Resource* pResource;
+		ID3D11DepthStencilView* pDSV; //NULL if not a depth buffer
+	};
+
+	//the views are created on the first bind and kept until the resource changes
+	struct TEXTURESLOT
+	{
+		unsigned int nGeneration;
+		bool bUsed;
+		ID3D11Resource* pResource;
+		ID3D11RenderTargetView* pRTV;
+		ID3D11ShaderResourceView* pSRV;
+		std::vector<ID3D11RenderTargetView*> vSliceRTVs; //one view per slice of a 3D texture
+		TEXTURESTATE state;
+	};
 
-	void	ItlCreate2DTexture(const std::string sDebugName, 
-							   const unsigned int nID, 
-							   const int iWidth, 
-							   const int iHeight);
+	struct DEPTHBUFFERSLOT
+	{
+		unsigned int nGeneration;
+		bool bUsed;
+		ID3D11Texture2D* pTexture;
+		ID3D11DepthStencilView* pDSV;
+		DEPTHBUFFERSTATE state;
+	};
+
+	/*
+	 *  Takes a resource of the pool or creates a new one
+	 */
+	HRESULT	ItlAcquireResource(const TEXTUREKEY& key,
+							   const std::string& sDebugName,
+							   ID3D11Resource** ppResource,
+							   ID3D11DepthStencilView** ppDSV);
+
+	/*
+	 *  Puts a resource that is not used anymore into the pool
+	 */
+	void	ItlReleaseResource(const TEXTUREKEY& key,
+							   ID3D11Resource* pResource,
+							   ID3D11DepthStencilView* pDSV);
+
+	/*
+	 *  Evicts pooled resources until nAdditionalBytes more fit into the budget
+	 */
+	void	ItlTrimPool(unsigned __int64 nAdditionalBytes);
+
+	/*
+	 *  Replaces the resource of a texture
+	 */
+	void	ItlResizeTexture(const unsigned int nID,
+							 const int iWidth, 
+							 const int iHeight, 
+							 const int iDepth);
 
-	void	ItlCreate3DTexture(const std::string sDebugName, 
-							   const unsigned int nID, 
-							   const int iWidth, 
-							   const int iHeight, 
-							   const int iDepth);
+	/*
+	 *  Reused resources are cleared, the textures start with zeros like new ones
+	 */
+	void	ItlClearResource(const TEXTUREKEY& key,
+							 ID3D11Resource* pResource,
+							 ID3D11DepthStencilView* pDSV);
+
+	/*
+	 *  Slot of a valid ID
+	 */
+	TEXTURESLOT&		ItlGetTextureSlot(const unsigned int nID);
+	DEPTHBUFFERSLOT&	ItlGetDepthBufferSlot(const unsigned int nID);
+
+	ID3D11RenderTargetView*		ItlGetRTV(TEXTURESLOT& slot);
+	ID3D11ShaderResourceView*	ItlGetSRV(TEXTURESLOT& slot);
+	ID3D11RenderTargetView*		ItlGetSliceRTV(TEXTURESLOT& slot, const int iSliceIndex);
+
+	static void	ItlReleaseViews(TEXTURESLOT& slot);
+
+	static TEXTUREKEY ItlGetTextureKey(const TEXTURESTATE& state);
+	static unsigned __int64 ItlGetMemorySize(const TEXTUREKEY& key);
+
+	unsigned int	ItlCreateTexture(const std::string sDebugName,
+									 const unsigned int nType,
+									 const int iWidth, 
+									 const int iHeight, 
+									 const int iDepth);
 
 	void	ItlCreate2DDepthBuffer(const std::string sDebugName, 
 								   const unsigned int nID, 
@@ -110,23 +275,23 @@ protected:
 	void	ItlRestoreOldRenderState();
 
 
-	static TextureManager* s_pInstance;
+	Scene* m_pScene;
 
 	ID3D11RenderTargetView*	m_pOldRTV;
 	ID3D11DepthStencilView* m_pOldDSV;
 	unsigned int m_nOldViewports;
 	D3D11_VIEWPORT *m_pViewports;
 
-	unsigned int m_nCurrentTextureID;
-	unsigned int m_nCurrentDepthBufferID;
+	//slot 0 is a placeholder, released slots are reused first
+	std::vector<TEXTURESLOT>		m_vTextureSlots;
+	std::vector<unsigned int>		m_vFreeTextureSlots;
+
+	std::vector<DEPTHBUFFERSLOT>	m_vDepthBufferSlots;
+	std::vector<unsigned int>		m_vFreeDepthBufferSlots;
 
-	std::map<unsigned int, ID3D11Resource*>				m_TextureMap;
-	std::map<unsigned int, ID3D11RenderTargetView*>		m_TextureRTVs;
-	std::map<unsigned int, ID3D11ShaderResourceView*>	m_TextureSRVs;
-	std::map<unsigned int, TEXTURESTATE>				m_TextureStateMap;
+	//released resources, the oldest one first
+	std::vector<POOLEDTEXTURE>							m_vTexturePool;
 
-	std::map<unsigned int, ID3D11Texture2D*>			m_DepthBufferMap;
-	std::map<unsigned int, ID3D11DepthStencilView*>		m_DepthBufferViewMap;
-	std::map<unsigned int, DEPTHBUFFERSTATE>			m_DepthBufferStateMap;
+	MEMORYSTATS m_MemoryStats;
 };
 #endif //_TEXTUREMANAGER_H_
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "ThreadPool.h"
+#include <limits.h>
+
+ThreadPool* ThreadPool::s_pInstance = NULL;
+
+ThreadPool* ThreadPool::GetInstance()
+{
+	if(s_pInstance == NULL)
+		s_pInstance = new ThreadPool();
+	return s_pInstance;
+}
+
+void ThreadPool::DeleteInstance()
+{
+	SAFE_DELETE(s_pInstance);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ThreadPool::ThreadPool()
+{
+	m_bQuit = false;
+	m_pBody = NULL;
+	m_iBegin = 0;
+	m_iEnd = 0;
+	m_iGrainSize = 1;
+	m_nNextChunk = 0;
+	m_nPendingWorkers = 0;
+
+	InitializeCriticalSection(&m_csLoop);
+	m_hStartSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	m_hDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	ItlStartThreads(GetNumProcessors() - 1);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+ThreadPool::~ThreadPool()
+{
+	ItlStopThreads();
+
+	CloseHandle(m_hStartSemaphore);
+	CloseHandle(m_hDoneEvent);
+	DeleteCriticalSection(&m_csLoop);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+unsigned int ThreadPool::GetNumProcessors()
+{
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	return max(1u, (unsigned int)systemInfo.dwNumberOfProcessors);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void ThreadPool::SetNumThreads(unsigned int nNumThreads)
+{
+	if(nNumThreads == 0)
+		nNumThreads = GetNumProcessors();
+
+	if(nNumThreads == GetNumThreads())
+		return;
+
+	ItlStopThreads();
+	ItlStartThreads(nNumThreads - 1);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void ThreadPool::ItlStartThreads(unsigned int nNumWorkers)
+{
+	m_bQuit = false;
+	for(unsigned int i = 0; i < nNumWorkers; i++)
+	{
+		HANDLE hThread = CreateThread(NULL, 0, ItlWorkerProc, this, 0, NULL);
+		if(hThread == NULL)
+			break;
+		m_vThreads.push_back(hThread);
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void ThreadPool::ItlStopThreads()
+{
+	if(m_vThreads.empty())
+		return;
+
+	m_bQuit = true;
+	ReleaseSemaphore(m_hStartSemaphore, (LONG)m_vThreads.size(), NULL);
+
+	//WaitForMultipleObjects is limited to MAXIMUM_WAIT_OBJECTS handles
+	for(unsigned int i = 0; i < m_vThreads.size(); i++)
+	{
+		WaitForSingleObject(m_vThreads[i], INFINITE);
+		CloseHandle(m_vThreads[i]);
+	}
+	m_vThreads.clear();
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void ThreadPool::ParallelFor(int iBegin, int iEnd, int iGrainSize, const std::function<void(int, int)>& fnBody)
+{
+	if(iEnd <= iBegin)
+		return;
+
+	iGrainSize = max(1, iGrainSize);
+
+	//nothing to distribute
+	bool bSerial = m_vThreads.empty() || iEnd - iBegin <= iGrainSize;
+
+	//the workers are busy with the loop of another thread, or this is a nested loop of the
+	//running one (the critical section is recursive, so the body pointer is checked as well)
+	if(!bSerial)
+	{
+		if(!TryEnterCriticalSection(&m_csLoop))
+			bSerial = true;
+		else if(m_pBody != NULL)
+		{
+			LeaveCriticalSection(&m_csLoop);
+			bSerial = true;
+		}
+	}
+
+	if(bSerial)
+	{
+		for(int i = iBegin; i < iEnd; i += iGrainSize)
+			fnBody(i, min(iEnd, i + iGrainSize));
+		return;
+	}
+
+	m_pBody = &fnBody;
+	m_iBegin = iBegin;
+	m_iEnd = iEnd;
+	m_iGrainSize = iGrainSize;
+	m_nNextChunk = 0;
+	m_nPendingWorkers = (LONG)m_vThreads.size();
+
+	//the semaphore and event calls are full memory barriers, the workers see the loop above
+	ReleaseSemaphore(m_hStartSemaphore, (LONG)m_vThreads.size(), NULL);
+
+	ItlRunChunks();
+
+	WaitForSingleObject(m_hDoneEvent, INFINITE);
+	m_pBody = NULL;
+
+	LeaveCriticalSection(&m_csLoop);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void ThreadPool::ItlRunChunks()
+{
+	int nNumChunks = (m_iEnd - m_iBegin + m_iGrainSize - 1) / m_iGrainSize;
+
+	for(;;)
+	{
+		LONG nChunk = InterlockedIncrement(&m_nNextChunk) - 1;
+		if(nChunk >= nNumChunks)
+			break;
+
+		int iChunkBegin = m_iBegin + nChunk * m_iGrainSize;
+		(*m_pBody)(iChunkBegin, min(m_iEnd, iChunkBegin + m_iGrainSize));
+	}
+}
+
+/****************************************************************************
+ ****************************************************************************/
+DWORD WINAPI ThreadPool::ItlWorkerProc(LPVOID pParameter)
+{
+	ThreadPool* pPool = (ThreadPool*)pParameter;
+
+	for(;;)
+	{
+		WaitForSingleObject(pPool->m_hStartSemaphore, INFINITE);
+		if(pPool->m_bQuit)
+			break;
+
+		pPool->ItlRunChunks();
+
+		//the last worker of the loop wakes up the calling thread
+		if(InterlockedDecrement(&pPool->m_nPendingWorkers) == 0)
+			SetEvent(pPool->m_hDoneEvent);
+	}
+
+	return 0;
+}
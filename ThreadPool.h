@@ -0,0 +1,72 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include "Globals.h"
+#include <vector>
+#include <functional>
+
+/*
+ *  Fixed set of worker threads that execute parallel loops.
+ *	A loop is split into chunks which are fetched by the workers and the calling thread,
+ *	ParallelFor returns when all chunks are done.
+ */
+class ThreadPool
+{
+public:
+	static ThreadPool* GetInstance();
+	static void DeleteInstance();
+
+	/*
+	 *  Sets the number of threads including the calling thread, 0 uses one thread per core
+	 */
+	void SetNumThreads(unsigned int nNumThreads);
+	unsigned int GetNumThreads() const { return (unsigned int)m_vThreads.size() + 1; }
+
+	/*
+	 *  Calls fnBody(iChunkBegin, iChunkEnd) for chunks of at most iGrainSize elements of [iBegin, iEnd).
+	 *	The chunks are processed in parallel. If the pool is busy with a loop of another thread
+	 *	or fnBody calls ParallelFor, the loop runs on the calling thread only.
+	 */
+	void ParallelFor(int iBegin, int iEnd, int iGrainSize, const std::function<void(int, int)>& fnBody);
+
+	/*
+	 *  Number of logical processors
+	 */
+	static unsigned int GetNumProcessors();
+
+protected:
+	ThreadPool();
+	~ThreadPool();
+
+	static ThreadPool* s_pInstance;
+
+	void ItlStartThreads(unsigned int nNumWorkers);
+	void ItlStopThreads();
+
+	/*
+	 *  Fetches and processes chunks of the current loop until none are left
+	 */
+	void ItlRunChunks();
+
+	static DWORD WINAPI ItlWorkerProc(LPVOID pParameter);
+
+	std::vector<HANDLE> m_vThreads;
+
+	//held by the thread whose loop is distributed to the workers
+	CRITICAL_SECTION m_csLoop;
+
+	//workers wait on the semaphore, it is released once per worker for every loop
+	HANDLE m_hStartSemaphore;
+	HANDLE m_hDoneEvent;
+	volatile bool m_bQuit;
+
+	//current loop
+	const std::function<void(int, int)>* m_pBody;
+	int m_iBegin;
+	int m_iEnd;
+	int m_iGrainSize;
+	volatile LONG m_nNextChunk;
+	volatile LONG m_nPendingWorkers;
+};
+
+#endif
@@ -0,0 +1,263 @@
+//--------------------------------------------------------------------------------------
+// Thumbnail renderer
+//
+// Runs morph jobs through the CPU implementation of the pipeline and renders a preview
+// of the result with the CPU ray caster, no graphics device is needed.
+// A job morphs the first surface (iso value 0) into the second one (iso value 1),
+// with the sizes and colors of the benchmark.
+//
+// Usage: Thumbnail [options]
+//   --surface1 mesh         first surface of a single job (default: sphere)
+//   --surface2 mesh         second surface of a single job
+//   --output file           PNG file of a single job
+//   --jobs file             file with one job per line: surface1,surface2,output
+//   --resolution n          volume resolution (default: 64)
+//   --size n                width and height of the image in pixels (default: 256)
+//   --steps n               diffusion steps (default: 8)
+//   --threads n             number of threads, 0 is one thread per core (default: 0)
+//   --media dir             media directory (default: Media\)
+//   --iso value             renders the iso surface with this iso value
+//   --iso-color             colors the iso surface with the diffused colors
+//   --point                 point sampling instead of linear sampling
+//   --oriented              fits an oriented box around the surfaces instead of an axis aligned one
+//
+// The exit code is 1 if at least one job failed.
+//--------------------------------------------------------------------------------------
+#include "Globals.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "CPUVolume.h"
+#include "CPUVoronoi.h"
+#include "CPUDiffusion.h"
+#include "CPUVolumeRenderer.h"
+#include "CPUPipeline.h"
+#include <vector>
+#include <fstream>
+
+#define THUMBNAIL_DEFAULT_RESOLUTION 64
+#define THUMBNAIL_DEFAULT_SIZE 256
+#define THUMBNAIL_DEFAULT_STEPS 8
+
+struct THUMBNAIL_JOB
+{
+	std::string strSurface1;
+	std::string strSurface2;
+	std::string strOutput;
+};
+
+struct THUMBNAIL_SETTINGS
+{
+	std::vector<THUMBNAIL_JOB>	vJobs;
+	int							iResolution;
+	int							iImageSize;
+	int							iNumSteps;
+	unsigned int				nThreads;
+	std::string					strMediaDirectory;
+	bool						bShowIsoSurface;
+	float						fIsoValue;
+	bool						bShowIsoColor;
+	bool						bLinearSampling;
+	bool						bOrientedBoundingBox;
+};
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ReadJobs(const std::string& strFileName, std::vector<THUMBNAIL_JOB>& vJobs)
+{
+	std::ifstream file(strFileName.c_str());
+	if(!file)
+		return false;
+
+	std::string strLine;
+	while(std::getline(file, strLine))
+	{
+		if(strLine.empty() || strLine[0] == '#')
+			continue;
+
+		std::stringstream ss(strLine);
+		THUMBNAIL_JOB job;
+		if(std::getline(ss, job.strSurface1, ',') && std::getline(ss, job.strSurface2, ',') && std::getline(ss, job.strOutput))
+			vJobs.push_back(job);
+		else
+			std::cerr << "Skipping invalid job " << strLine << std::endl;
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static bool ParseArguments(int argc, wchar_t* argv[], THUMBNAIL_SETTINGS* pSettings)
+{
+	pSettings->iResolution = THUMBNAIL_DEFAULT_RESOLUTION;
+	pSettings->iImageSize = THUMBNAIL_DEFAULT_SIZE;
+	pSettings->iNumSteps = THUMBNAIL_DEFAULT_STEPS;
+	pSettings->nThreads = 0;
+	pSettings->strMediaDirectory = "Media\\";
+	pSettings->bShowIsoSurface = false;
+	pSettings->fIsoValue = 0.5f;
+	pSettings->bShowIsoColor = false;
+	pSettings->bLinearSampling = true;
+	pSettings->bOrientedBoundingBox = false;
+
+	THUMBNAIL_JOB job;
+	job.strSurface1 = "sphere";
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string strOption = ConvertWideCharToChar(argv[i]);
+
+		//options without a value
+		if(strOption == "--iso-color")
+		{
+			pSettings->bShowIsoColor = true;
+			continue;
+		}
+		else if(strOption == "--point")
+		{
+			pSettings->bLinearSampling = false;
+			continue;
+		}
+		else if(strOption == "--oriented")
+		{
+			pSettings->bOrientedBoundingBox = true;
+			continue;
+		}
+
+		if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value of " << strOption << std::endl;
+			return false;
+		}
+		std::string strValue = ConvertWideCharToChar(argv[++i]);
+
+		if(strOption == "--surface1")
+			job.strSurface1 = strValue;
+		else if(strOption == "--surface2")
+			job.strSurface2 = strValue;
+		else if(strOption == "--output")
+			job.strOutput = strValue;
+		else if(strOption == "--jobs")
+		{
+			if(!ReadJobs(strValue, pSettings->vJobs))
+			{
+				std::cerr << "Could not read the jobs " << strValue << std::endl;
+				return false;
+			}
+		}
+		else if(strOption == "--resolution")
+			pSettings->iResolution = atoi(strValue.c_str());
+		else if(strOption == "--size")
+			pSettings->iImageSize = atoi(strValue.c_str());
+		else if(strOption == "--steps")
+			pSettings->iNumSteps = atoi(strValue.c_str());
+		else if(strOption == "--threads")
+			pSettings->nThreads = (unsigned int)atoi(strValue.c_str());
+		else if(strOption == "--media")
+		{
+			pSettings->strMediaDirectory = strValue;
+			if(!strValue.empty() && strValue[strValue.size() - 1] != '\\' && strValue[strValue.size() - 1] != '/')
+				pSettings->strMediaDirectory += "\\";
+		}
+		else if(strOption == "--iso")
+		{
+			pSettings->bShowIsoSurface = true;
+			pSettings->fIsoValue = (float)atof(strValue.c_str());
+		}
+		else
+		{
+			std::cerr << "Unknown option " << strOption << std::endl;
+			return false;
+		}
+	}
+
+	if(!job.strSurface2.empty() && !job.strOutput.empty())
+		pSettings->vJobs.push_back(job);
+
+	if(pSettings->vJobs.empty())
+	{
+		std::cerr << "No jobs, use --surface2 and --output or --jobs" << std::endl;
+		return false;
+	}
+
+	return pSettings->iResolution > 1 && pSettings->iImageSize > 0 && pSettings->iNumSteps > 0;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+static HRESULT RunJob(const THUMBNAIL_SETTINGS& settings, const THUMBNAIL_JOB& job, CPUVolumeRenderer* pRenderer)
+{
+	HRESULT hr(S_OK);
+
+	D3DXMATRIX mIdentity;
+	D3DXMatrixIdentity(&mIdentity);
+
+	MESHDATA pMeshData[2];
+	std::vector<CPU_SURFACE> vSurfaces(2);
+	V_RETURN(CPUPipeline::LoadSurface(CPUPipeline::GetMeshPath(settings.strMediaDirectory, job.strSurface1), D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f), 0.25f, mIdentity, 0.0f, &pMeshData[0], &vSurfaces[0]));
+	V_RETURN(CPUPipeline::LoadSurface(CPUPipeline::GetMeshPath(settings.strMediaDirectory, job.strSurface2), D3DXCOLOR(0.0f, 0.5f, 1.0f, 1.0f), 0.5f, mIdentity, 1.0f, &pMeshData[1], &vSurfaces[1]));
+
+	OrientedBoundingBox bbVolume;
+	CPUPipeline::FitBoundingBox(vSurfaces, settings.bOrientedBoundingBox, &bbVolume);
+
+	CPUVolume volume;
+	V_RETURN(CPUPipeline::AllocateVolume(bbVolume, settings.iResolution, &volume));
+
+	CPUVoronoi voronoi;
+	V_RETURN(voronoi.Compute(vSurfaces, &volume));
+	voronoi.Release();
+
+	CPUDiffusion diffusion;
+	V_RETURN(diffusion.Diffuse(&volume, settings.iNumSteps));
+	diffusion.Release();
+
+	float fFovY = D3DX_PI / 4;
+	D3DXVECTOR3 vEye, vAt, vUp;
+	CPUPipeline::GetPreviewCamera(volume, bbVolume, fFovY, &vEye, &vAt, &vUp);
+	pRenderer->SetCamera(vEye, vAt, vUp, fFovY);
+
+	V_RETURN(pRenderer->Render(&volume));
+	V_RETURN(pRenderer->SavePNG(job.strOutput));
+
+	return hr;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int wmain(int argc, wchar_t* argv[])
+{
+	THUMBNAIL_SETTINGS settings;
+	if(!ParseArguments(argc, argv, &settings))
+		return 2;
+
+	ThreadPool::GetInstance()->SetNumThreads(settings.nThreads);
+
+	CPUVolumeRenderer renderer;
+	renderer.SetLinearSampling(settings.bLinearSampling);
+	renderer.ShowIsoSurface(settings.bShowIsoSurface, settings.fIsoValue, settings.bShowIsoColor);
+	if(FAILED(renderer.SetImageSize(settings.iImageSize, settings.iImageSize)))
+	{
+		std::cerr << "Could not allocate the image" << std::endl;
+		return 2;
+	}
+
+	int iNumFailed = 0;
+	for(unsigned int i = 0; i < settings.vJobs.size(); i++)
+	{
+		const THUMBNAIL_JOB& job = settings.vJobs[i];
+		if(FAILED(RunJob(settings, job, &renderer)))
+		{
+			std::cerr << "Failed: " << job.strSurface1 << " -> " << job.strSurface2 << std::endl;
+			iNumFailed++;
+		}
+		else
+			std::cout << job.strOutput << std::endl;
+	}
+
+	std::cout << settings.vJobs.size() - iNumFailed << " of " << settings.vJobs.size() << " thumbnails rendered" << std::endl;
+
+	ThreadPool::DeleteInstance();
+	MeshCache::DeleteInstance();
+
+	return iNumFailed > 0 ? 1 : 0;
+}
@@ -3,10 +3,15 @@
 #include "Scene.h"
 #include "TextureManager.h"
 
+//edge length of the bricks of the occupancy grid in voxels
+#define VOLUME_BRICK_SIZE 8
+
 /****************************************************************************
  ****************************************************************************/
-VolumeRenderer::VolumeRenderer(ID3DX11Effect* pEffect)
+VolumeRenderer::VolumeRenderer(Scene* pScene, ID3DX11Effect* pEffect)
 {
+	m_pScene = pScene;
+	m_pTextureManager = pScene->GetTextureManager();
 	m_pEffect = pEffect;
 
 	m_pVolumeRenderTechnique = NULL;
@@ -25,9 +30,18 @@ VolumeRenderer::VolumeRenderer(ID3DX11Effect* pEffect)
 	m_pSQInputLayout = NULL;
 	m_pSQVertexBuffer = NULL;
 
+	m_pOccupancyTexture3D = NULL;
+	m_pOccupancySRV = NULL;
+	m_iOccupancyWidth = 0;
+	m_iOccupancyHeight = 0;
+	m_iOccupancyDepth = 0;
+	m_nOccupancySource = 0;
+	m_bOccupancyValid = false;
+
 	m_bLinearSampling = true;
 	m_bShowIsoSurface = false;
 	m_bShowBoundingBox = true;
+	m_bSkipEmptySpace = true;
 }
 
 /****************************************************************************
@@ -47,6 +61,8 @@ VolumeRenderer::~VolumeRenderer()
 
 	SAFE_RELEASE(m_pSQInputLayout);
 	SAFE_RELEASE(m_pSQVertexBuffer);
+
+	ReleaseOccupancyGrid();
 }
 
 /****************************************************************************
@@ -72,10 +88,76 @@ HRESULT VolumeRenderer::Update(int iWidth, int iHeight, int iDepth)
 
 	int iIterations = (int)maxSize * 2;
 	m_pIterationsVar->SetInt(iIterations);
+
+	m_pVolumeSizeVar->SetFloatVector(D3DXVECTOR3(float(iWidth), float(iHeight), float(iDepth)));
 	
+	return InitOccupancyGrid(iWidth, iHeight, iDepth);
+}
+
+/****************************************************************************
+ ****************************************************************************/
+HRESULT VolumeRenderer::InitOccupancyGrid(int iWidth, int iHeight, int iDepth)
+{
+	HRESULT hr;
+
+	ReleaseOccupancyGrid();
+
+	m_iOccupancyWidth = (iWidth + VOLUME_BRICK_SIZE - 1) / VOLUME_BRICK_SIZE;
+	m_iOccupancyHeight = (iHeight + VOLUME_BRICK_SIZE - 1) / VOLUME_BRICK_SIZE;
+	m_iOccupancyDepth = (iDepth + VOLUME_BRICK_SIZE - 1) / VOLUME_BRICK_SIZE;
+
+	D3D11_TEXTURE3D_DESC desc;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	desc.CPUAccessFlags = 0;
+	desc.MipLevels = 1;
+	desc.MiscFlags = 0;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.Width = m_iOccupancyWidth;
+	desc.Height = m_iOccupancyHeight;
+	desc.Depth = m_iOccupancyDepth;
+	desc.Format = DXGI_FORMAT_R32_FLOAT;
+	V_RETURN(m_pScene->GetDevice()->CreateTexture3D(&desc, NULL, &m_pOccupancyTexture3D));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
+	descSRV.Format = DXGI_FORMAT_R32_FLOAT;
+	descSRV.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+	descSRV.Texture3D.MostDetailedMip = 0;
+	descSRV.Texture3D.MipLevels = 1;
+	V_RETURN(m_pScene->GetDevice()->CreateShaderResourceView(m_pOccupancyTexture3D, &descSRV, &m_pOccupancySRV));
+
+	//one render target view per slice of the grid
+	D3D11_RENDER_TARGET_VIEW_DESC descRT;
+	descRT.Format = DXGI_FORMAT_R32_FLOAT;
+	descRT.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE3D;
+	descRT.Texture3D.MipSlice = 0;
+	descRT.Texture3D.WSize = 1;
+	m_vOccupancyRTVs.resize(m_iOccupancyDepth, NULL);
+	for(int z = 0; z < m_iOccupancyDepth; z++)
+	{
+		descRT.Texture3D.FirstWSlice = z;
+		V_RETURN(m_pScene->GetDevice()->CreateRenderTargetView(m_pOccupancyTexture3D, &descRT, &m_vOccupancyRTVs[z]));
+	}
+
+	m_pBrickSizeVar->SetInt(VOLUME_BRICK_SIZE);
+	m_bOccupancyValid = false;
+
 	return S_OK;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+void VolumeRenderer::ReleaseOccupancyGrid()
+{
+	for(unsigned int i = 0; i < m_vOccupancyRTVs.size(); i++)
+		SAFE_RELEASE(m_vOccupancyRTVs[i]);
+	m_vOccupancyRTVs.clear();
+
+	SAFE_RELEASE(m_pOccupancySRV);
+	SAFE_RELEASE(m_pOccupancyTexture3D);
+
+	m_bOccupancyValid = false;
+}
+
 /****************************************************************************
  ****************************************************************************/
 HRESULT VolumeRenderer::SetScreenSize(int iWidth, int iHeight)
@@ -107,16 +189,16 @@ HRESULT VolumeRenderer::SetScreenSize(int iWidth, int iHeight)
 	desc.Width = iWidth;
 	desc.Height = iHeight;
 	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateTexture2D(&desc, NULL, &m_pFrontTexture2D));
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateTexture2D(&desc, NULL, &m_pBackTexture2D));
+	V_RETURN(m_pScene->GetDevice()->CreateTexture2D(&desc, NULL, &m_pFrontTexture2D));
+	V_RETURN(m_pScene->GetDevice()->CreateTexture2D(&desc, NULL, &m_pBackTexture2D));
 
 	//create the render target views
 	D3D11_RENDER_TARGET_VIEW_DESC descRT;
 	descRT.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	descRT.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
 	descRT.Texture2D.MipSlice = 0;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_pFrontTexture2D, &descRT, &m_pFrontRTV));
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateRenderTargetView(m_pBackTexture2D, &descRT, &m_pBackRTV));
+	V_RETURN(m_pScene->GetDevice()->CreateRenderTargetView(m_pFrontTexture2D, &descRT, &m_pFrontRTV));
+	V_RETURN(m_pScene->GetDevice()->CreateRenderTargetView(m_pBackTexture2D, &descRT, &m_pBackRTV));
 
 	//create the shader resource views
 	D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
@@ -125,8 +207,8 @@ HRESULT VolumeRenderer::SetScreenSize(int iWidth, int iHeight)
 	descSRV.Texture2D.MostDetailedMip = 0;
 	descSRV.Texture2D.MipLevels = 1;
 	descSRV.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateShaderResourceView(m_pFrontTexture2D, &descSRV, &m_pFrontSRV));
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateShaderResourceView(m_pBackTexture2D, &descSRV, &m_pBackSRV));
+	V_RETURN(m_pScene->GetDevice()->CreateShaderResourceView(m_pFrontTexture2D, &descSRV, &m_pFrontSRV));
+	V_RETURN(m_pScene->GetDevice()->CreateShaderResourceView(m_pBackTexture2D, &descSRV, &m_pBackSRV));
 
 	return S_OK;
 }
@@ -152,6 +234,54 @@ void VolumeRenderer::ShowBoundingBox(bool bShow)
 	m_bShowBoundingBox = bShow;
 }
 
+/****************************************************************************
+ ****************************************************************************/
+void VolumeRenderer::SetEmptySpaceSkipping(bool bSkip)
+{
+	m_bSkipEmptySpace = bSkip;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void VolumeRenderer::InvalidateOccupancy()
+{
+	m_bOccupancyValid = false;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void VolumeRenderer::BuildOccupancyGrid(const unsigned int n3DTexture)
+{
+	D3D11_VIEWPORT viewport;
+	viewport.TopLeftX = 0;
+	viewport.TopLeftY = 0;
+	viewport.MinDepth = 0;
+	viewport.MaxDepth = 1;
+	viewport.Width = float(m_iOccupancyWidth);
+	viewport.Height = float(m_iOccupancyHeight);
+	m_pScene->GetContext()->RSSetViewports(1, &viewport);
+
+	m_pTextureManager->BindTextureAsSRV(n3DTexture, m_pVolumeTextureVar);
+
+	//the full screen triangle is generated from the vertex id
+	m_pScene->GetContext()->IASetInputLayout(NULL);
+	m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	for(int z = 0; z < m_iOccupancyDepth; z++)
+	{
+		m_pScene->GetContext()->OMSetRenderTargets(1, &m_vOccupancyRTVs[z], NULL);
+		m_pOccupancySliceVar->SetInt(z);
+		m_pVolumeRenderTechnique->GetPassByName("BuildOccupancy")->Apply(0, m_pScene->GetContext());
+		m_pScene->GetContext()->Draw(3, 0);
+	}
+
+	m_pVolumeTextureVar->SetResource(NULL);
+	m_pVolumeRenderTechnique->GetPassByName("BuildOccupancy")->Apply(0, m_pScene->GetContext());
+
+	m_nOccupancySource = n3DTexture;
+	m_bOccupancyValid = true;
+}
+
 
 /****************************************************************************
  ****************************************************************************/
@@ -165,6 +295,12 @@ void VolumeRenderer::Render(SURFACE_VERTEX* pBBVertices,
 	m_pBBMaxVar->SetFloatVector(vBBMax);
 	m_pSamplingVar->SetBool(m_bLinearSampling);
 	m_pShowIsoSurfaceVar->SetBool(m_bShowIsoSurface);
+
+	//the grid only changes with the volume, it is not rebuilt every frame
+	bool bSkipEmptySpace = m_bSkipEmptySpace && m_pOccupancySRV != NULL;
+	if(bSkipEmptySpace && (!m_bOccupancyValid || m_nOccupancySource != n3DTexture))
+		BuildOccupancyGrid(n3DTexture);
+	m_pSkipEmptySpaceVar->SetBool(bSkipEmptySpace);
 	
 	//Update vertex buffer for boundingbox
 	UpdateBoundingVertices(pBBVertices);
@@ -174,6 +310,14 @@ void VolumeRenderer::Render(SURFACE_VERTEX* pBBVertices,
 	//Update shader variables
 	m_pWorldViewProjectionVar->SetMatrix(mWorldViewProjection);
 
+	//store the rendertarget, depthstencilview and viewports of the caller
+	ID3D11RenderTargetView* pOldRTV = NULL;
+	ID3D11DepthStencilView* pOldDSV = NULL;
+	m_pScene->GetContext()->OMGetRenderTargets(1, &pOldRTV, &pOldDSV);
+	UINT NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	D3D11_VIEWPORT pViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	m_pScene->GetContext()->RSGetViewports(&NumViewports, &pViewports[0]);
+
 	//Set rendertarget-viewport
 	D3D11_VIEWPORT rtViewport;
 	rtViewport.TopLeftX = 0;
@@ -182,49 +326,51 @@ void VolumeRenderer::Render(SURFACE_VERTEX* pBBVertices,
 	rtViewport.MaxDepth = 1;
 	rtViewport.Width = float(m_iWidth);
 	rtViewport.Height = float(m_iHeight);
-	Scene::GetInstance()->GetContext()->RSSetViewports(1, &rtViewport);
+	m_pScene->GetContext()->RSSetViewports(1, &rtViewport);
 
 	//Render frontfaces of boundingbox
-	Scene::GetInstance()->GetContext()->ClearRenderTargetView(m_pFrontRTV, clearColor);
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(1, &m_pFrontRTV, NULL);
-	m_pVolumeRenderTechnique->GetPassByName("BoundingBoxFront")->Apply(0, Scene::GetInstance()->GetContext());
+	m_pScene->GetContext()->ClearRenderTargetView(m_pFrontRTV, clearColor);
+	m_pScene->GetContext()->OMSetRenderTargets(1, &m_pFrontRTV, NULL);
+	m_pVolumeRenderTechnique->GetPassByName("BoundingBoxFront")->Apply(0, m_pScene->GetContext());
 	DrawBoundingBox();
 
 	//Render backfaces of boundingbox
-	Scene::GetInstance()->GetContext()->ClearRenderTargetView(m_pBackRTV, clearColor);
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(1, &m_pBackRTV, NULL);
-	m_pVolumeRenderTechnique->GetPassByName("BoundingBoxBack")->Apply(0, Scene::GetInstance()->GetContext());
+	m_pScene->GetContext()->ClearRenderTargetView(m_pBackRTV, clearColor);
+	m_pScene->GetContext()->OMSetRenderTargets(1, &m_pBackRTV, NULL);
+	m_pVolumeRenderTechnique->GetPassByName("BoundingBoxBack")->Apply(0, m_pScene->GetContext());
 	DrawBoundingBox();
 
 	
 
 	//Restore Rendertarget- and Depthstencilview
-	ID3D11RenderTargetView* pRTV = DXUTGetD3D11RenderTargetView();
-    ID3D11DepthStencilView* pDSV = DXUTGetD3D11DepthStencilView();
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets(1, &pRTV, pDSV);
+	m_pScene->GetContext()->OMSetRenderTargets(1, &pOldRTV, pOldDSV);
 
 	m_pFrontTextureVar->SetResource(m_pFrontSRV);
 	m_pBackTextureVar->SetResource(m_pBackSRV);
-	TextureManager::GetInstance()->BindTextureAsSRV(n3DTexture, m_pVolumeTextureVar);
+	m_pTextureManager->BindTextureAsSRV(n3DTexture, m_pVolumeTextureVar);
+	m_pOccupancyTextureVar->SetResource(m_pOccupancySRV);
 
-	m_pVolumeRenderTechnique->GetPassByName("RayCast")->Apply(0, Scene::GetInstance()->GetContext());
+	m_pVolumeRenderTechnique->GetPassByName("RayCast")->Apply(0, m_pScene->GetContext());
 	DrawBoundingBox();
 
 	//unbind textures
 	m_pFrontTextureVar->SetResource(NULL);
 	m_pBackTextureVar->SetResource(NULL);
 	m_pVolumeTextureVar->SetResource(NULL);
-	m_pVolumeRenderTechnique->GetPassByName("RayCast")->Apply(0, Scene::GetInstance()->GetContext());
+	m_pOccupancyTextureVar->SetResource(NULL);
+	m_pVolumeRenderTechnique->GetPassByName("RayCast")->Apply(0, m_pScene->GetContext());
 	
 
 	//Draw wireframe boundingbox
 	if(m_bShowBoundingBox)
 	{
-		m_pVolumeRenderTechnique->GetPassByName("Wireframe")->Apply(0, Scene::GetInstance()->GetContext());
+		m_pVolumeRenderTechnique->GetPassByName("Wireframe")->Apply(0, m_pScene->GetContext());
 		DrawBoundingBox();
 	}
 
-	
+	m_pScene->GetContext()->RSSetViewports(NumViewports, &pViewports[0]);
+	SAFE_RELEASE(pOldRTV);
+	SAFE_RELEASE(pOldDSV);
 }
 
 /****************************************************************************
@@ -242,6 +388,11 @@ HRESULT VolumeRenderer::InitShader()
 	m_pBBMaxVar = m_pEffect->GetVariableByName("vBBMax")->AsVector();
 	m_pSamplingVar = m_pEffect->GetVariableByName("bLinearSampling")->AsScalar();
 	m_pShowIsoSurfaceVar = m_pEffect->GetVariableByName("bShowIsoSurface")->AsScalar();
+	m_pOccupancyTextureVar = m_pEffect->GetVariableByName("OccupancyTexture")->AsShaderResource();
+	m_pVolumeSizeVar = m_pEffect->GetVariableByName("vVolumeSize")->AsVector();
+	m_pBrickSizeVar = m_pEffect->GetVariableByName("iBrickSize")->AsScalar();
+	m_pOccupancySliceVar = m_pEffect->GetVariableByName("iOccupancySlice")->AsScalar();
+	m_pSkipEmptySpaceVar = m_pEffect->GetVariableByName("bSkipEmptySpace")->AsScalar();
 
 	return S_OK;
 }
@@ -269,7 +420,7 @@ HRESULT VolumeRenderer::InitBoundingIndicesAndLayout()
 	indexData.pSysMem = indices;
 	indexData.SysMemPitch = 0;
 	indexData.SysMemSlicePitch = 0;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateBuffer(&ibd, &indexData, &m_pBBIndexBuffer));
+	V_RETURN(m_pScene->GetDevice()->CreateBuffer(&ibd, &indexData, &m_pBBIndexBuffer));
 
 	
 	D3DX11_PASS_SHADER_DESC passVsDesc;
@@ -284,7 +435,7 @@ HRESULT VolumeRenderer::InitBoundingIndicesAndLayout()
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 }
     };
 
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateInputLayout(layout, _countof(layout), vsCodePtr, vsCodeLen, &m_pBBInputLayout));
+	V_RETURN(m_pScene->GetDevice()->CreateInputLayout(layout, _countof(layout), vsCodePtr, vsCodeLen, &m_pBBInputLayout));
 
 	return S_OK;
 }
@@ -309,7 +460,7 @@ HRESULT VolumeRenderer::UpdateBoundingVertices(SURFACE_VERTEX* BBVertices)
 	vertexData.SysMemPitch = 0;
 	vertexData.SysMemSlicePitch = 0;
 	
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateBuffer(&vbd, &vertexData, &m_pBBVertexBuffer));
+	V_RETURN(m_pScene->GetDevice()->CreateBuffer(&vbd, &vertexData, &m_pBBVertexBuffer));
 
 	return S_OK;
 }
@@ -320,10 +471,10 @@ void VolumeRenderer::DrawBoundingBox()
 {
 	UINT strides = sizeof(SURFACE_VERTEX);
     UINT offsets = 0;
-	Scene::GetInstance()->GetContext()->IASetInputLayout(m_pBBInputLayout);
-	Scene::GetInstance()->GetContext()->IASetIndexBuffer(m_pBBIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	Scene::GetInstance()->GetContext()->IASetVertexBuffers(0, 1, &m_pBBVertexBuffer, &strides, &offsets);
-    Scene::GetInstance()->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    Scene::GetInstance()->GetContext()->DrawIndexed(36, 0, 0);
+	m_pScene->GetContext()->IASetInputLayout(m_pBBInputLayout);
+	m_pScene->GetContext()->IASetIndexBuffer(m_pBBIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	m_pScene->GetContext()->IASetVertexBuffers(0, 1, &m_pBBVertexBuffer, &strides, &offsets);
+    m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_pScene->GetContext()->DrawIndexed(36, 0, 0);
 }
 
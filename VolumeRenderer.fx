@@ -17,6 +17,13 @@ float3 vBBMax;
 bool bLinearSampling;
 bool bShowIsoSurface;
 
+//occupancy grid for the empty space skipping, one texel per brick with the maximum of its voxels
+Texture3D OccupancyTexture;
+float3 vVolumeSize;
+int iBrickSize;
+int iOccupancySlice;
+bool bSkipEmptySpace;
+
 //------------------------------------------------------------------------------------------------------
 // States
 //------------------------------------------------------------------------------------------------------
@@ -128,6 +135,11 @@ struct VsSQOutput
 	float4 pos2 : TEXCOORD;
 };
 
+struct VsOccupancyOutput
+{
+	float4 pos : SV_POSITION;
+};
+
 struct PsOutput
 {
     float4 color : SV_Target;
@@ -153,10 +165,69 @@ VsSQOutput VS_RAYCAST(VsSQInput input)
 	return output;
 }
 
+VsOccupancyOutput VS_OCCUPANCY(uint id : SV_VertexID)
+{
+	//full screen triangle
+	VsOccupancyOutput output;
+	float2 tex = float2((id << 1) & 2, id & 2);
+	output.pos = float4(tex * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+	return output;
+}
+
 //------------------------------------------------------------------------------------------------------
 // Pixel Shaders
 //------------------------------------------------------------------------------------------------------
 
+float PS_OCCUPANCY(VsOccupancyOutput input) : SV_Target
+{
+	int3 size = int3(vVolumeSize);
+	
+	//the brick is enlarged by one voxel, so the linear sampler never reads a voxel of another brick
+	int3 first = int3(int2(input.pos.xy), iOccupancySlice) * iBrickSize - 1;
+	
+	float occupancy = 0.0f;
+	[loop] for(int z = 0; z < iBrickSize + 2; z++)
+	{
+		[loop] for(int y = 0; y < iBrickSize + 2; y++)
+		{
+			[loop] for(int x = 0; x < iBrickSize + 2; x++)
+			{
+				int3 voxel = first + int3(x, y, z);
+				if(all(voxel >= 0) && all(voxel < size))
+				{
+					//the colors are added up during the raycast, so a brick is only empty if all channels are zero
+					float4 color = abs(VolumeTexture.Load(int4(voxel, 0)));
+					occupancy = max(occupancy, max(max(color.r, color.g), max(color.b, color.a)));
+				}
+			}
+		}
+	}
+	return occupancy;
+}
+
+//returns the number of steps until the ray leaves the brick, 0 if the brick is not empty
+int EmptyBrickSteps(float3 pos2, float3 Step)
+{
+	float3 voxel = pos2 * vVolumeSize;
+	
+	//positions just outside of the volume use the border bricks, the linear sampler still reads the border voxels there
+	int3 gridSize = (int3(vVolumeSize) + iBrickSize - 1) / iBrickSize;
+	int3 brick = clamp(int3(floor(voxel / iBrickSize)), 0, gridSize - 1);
+	
+	if(OccupancyTexture.Load(int4(brick, 0)).r > 0.0f)
+		return 0;
+
+	float3 dir = float3(Step.x, -Step.y, Step.z) * vVolumeSize;
+	dir = (abs(dir) < 1e-6f) ? 1e-6f : dir;
+	
+	float3 brickMin = brick * iBrickSize;
+	float3 brickExit = (dir > 0.0f) ? brickMin + iBrickSize : brickMin;
+	float3 steps = (brickExit - voxel) / dir;
+	
+	//the skipped positions are the same as without skipping, so the result does not change
+	return max(1, (int)ceil(min(steps.x, min(steps.y, steps.z))));
+}
+
 PsOutput PS_BB_WIREFRAME(VsBBOutput input)
 {
 	PsOutput output;
@@ -191,31 +262,39 @@ PsOutput PS_RAYCAST(VsSQOutput input)
     
 	float3 Step = dir * vStepSize;
     
-    for(int i = 0; i < iIterations; i++)
+    int i = 0;
+    [loop] while(i < iIterations)
     {
 		float4 pos2 = pos;
 		pos2.y = 1 - pos2.y;
-		if(bLinearSampling)
-			src = VolumeTexture.SampleLevel(linearSampler, pos2, 0).rgba;
-		else
-			src = VolumeTexture.SampleLevel(pointSampler, pos2, 0).rgba;
-		
-		//if(!bShowIsoSurface)
-		//	src.a *= 0.01;
-		output.color = output.color + src;
 		
-		if(output.color.a >= 1.0f)
+		int steps = bSkipEmptySpace ? EmptyBrickSteps(pos2.xyz, Step) : 0;
+		if(steps == 0)
 		{
-			output.color.rgb /= output.color.a;
-			output.color.a = 1.0f;
-			break;
+			if(bLinearSampling)
+				src = VolumeTexture.SampleLevel(linearSampler, pos2, 0).rgba;
+			else
+				src = VolumeTexture.SampleLevel(pointSampler, pos2, 0).rgba;
+			
+			//if(!bShowIsoSurface)
+			//	src.a *= 0.01;
+			output.color = output.color + src;
+			
+			if(output.color.a >= 1.0f)
+			{
+				output.color.rgb /= output.color.a;
+				output.color.a = 1.0f;
+				break;
+			}
+			steps = 1;
 		}
 
 		//advance the current position
-		pos.xyz += Step;
+		pos.xyz += Step * steps;
+		i += steps;
 		
-		//break if the position is greater than <1, 1, 1>
-		if(pos.x > 1.0f || pos.y > 1.0f || pos.z > 1.0f)
+		//break if the position is greater than <1, 1, 1> or behind the front faces, nothing is added outside of the box
+		if(pos.x > 1.0f || pos.y > 1.0f || pos.z > 1.0f || any(pos.xyz < -vStepSize))
 			break;
     }
     return output;
@@ -249,6 +328,17 @@ technique10 VolumeRendering
 		SetDepthStencilState( DisableDepth, 0 );
 	}
 
+	pass BuildOccupancy
+	{
+		SetVertexShader(CompileShader(vs_4_0, VS_OCCUPANCY()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_4_0, PS_OCCUPANCY()));
+
+		SetBlendState(NoBlending, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+		SetRasterizerState(CullNone);
+		SetDepthStencilState( DisableDepth, 0 );
+	}
+
 	pass RayCast
 	{
 		SetVertexShader(CompileShader(vs_4_0, VS_RAYCAST()));
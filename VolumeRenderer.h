@@ -1,10 +1,13 @@
+class Scene;
+class TextureManager;
+
 class VolumeRenderer
 {
 public:
 	/*
 	 *  Constructor
 	 */
-	VolumeRenderer(ID3DX11Effect* pEffect);
+	VolumeRenderer(Scene* pScene, ID3DX11Effect* pEffect);
 
 	/*
 	 *  Destructor
@@ -43,6 +46,17 @@ public:
 	 */
 	void ShowBoundingBox(bool bShow);
 
+	/*
+	 *  Switch the skipping of completely transparent bricks on or off
+	 */
+	void SetEmptySpaceSkipping(bool bSkip);
+
+	/*
+	 *  Has to be called if the content of a rendered 3D texture changed, the occupancy grid is rebuilt
+	 *  before the next raycast
+	 */
+	void InvalidateOccupancy();
+
 	/*
 	 *  Render a given 3D Texture into the bounding box
 	 */
@@ -62,6 +76,13 @@ private:
 	//controls the visibility of the bounding box
 	bool m_bShowBoundingBox;
 
+	//true, if empty bricks are skipped during the raycast
+	bool m_bSkipEmptySpace;
+
+	//scene the volume renderer belongs to
+	Scene*									m_pScene;
+	TextureManager*							m_pTextureManager;
+
 	// Shader effect and variables
 	ID3DX11Effect*							m_pEffect;
 	ID3DX11EffectTechnique*					m_pVolumeRenderTechnique;
@@ -81,6 +102,12 @@ private:
 	ID3DX11EffectScalarVariable*			m_pSamplingVar;
 	ID3DX11EffectScalarVariable*			m_pShowIsoSurfaceVar;
 
+	ID3DX11EffectShaderResourceVariable*	m_pOccupancyTextureVar;
+	ID3DX11EffectVectorVariable*			m_pVolumeSizeVar;
+	ID3DX11EffectScalarVariable*			m_pBrickSizeVar;
+	ID3DX11EffectScalarVariable*			m_pOccupancySliceVar;
+	ID3DX11EffectScalarVariable*			m_pSkipEmptySpaceVar;
+
 	//Screen size
 	int m_iWidth;
 	int m_iHeight;
@@ -102,12 +129,31 @@ private:
 	ID3D11Buffer*			m_pSQVertexBuffer;
 	ID3D11InputLayout*		m_pSQInputLayout;
 
+	//occupancy grid, one texel per brick of the volume with the maximum of its voxels
+	ID3D11Texture3D*						m_pOccupancyTexture3D;
+	ID3D11ShaderResourceView*				m_pOccupancySRV;
+	std::vector<ID3D11RenderTargetView*>	m_vOccupancyRTVs;
+	int										m_iOccupancyWidth;
+	int										m_iOccupancyHeight;
+	int										m_iOccupancyDepth;
+
+	//3D texture the occupancy grid was built from, the grid is rebuilt if another texture is rendered
+	unsigned int	m_nOccupancySource;
+	bool			m_bOccupancyValid;
+
 	/*
 	 *  Initializing functions
 	 */
 	HRESULT InitShader();
 	HRESULT InitBoundingIndicesAndLayout();
 	HRESULT UpdateBoundingVertices(SURFACE_VERTEX* BBVertices);
+	HRESULT InitOccupancyGrid(int iWidth, int iHeight, int iDepth);
+	void	ReleaseOccupancyGrid();
+
+	/*
+	 *  Computes the maximum of every brick of the 3D texture into the occupancy grid
+	 */
+	void BuildOccupancyGrid(const unsigned int n3DTexture);
 
 	/*
 	 * Gets called when:
@@ -4,6 +4,9 @@
 #include <string>
 #include <Commdlg.h>
 #include "TextureManager.h"
+#include "MeshCache.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
 //--------------------------------------------------------------------------------------
 // Global variables
@@ -47,7 +50,7 @@ int							g_iSliceIndex = 64;
 bool						g_bShowSurfaces = true;
 float						g_fIsoValue = 0.5f;
 int							g_iDiffusionSteps = 8;
-bool						g_bSurface1IsControlled = true;
+int							g_iControlledSurface = 0;
 bool						g_bShowIsoSurface = false;
 bool						g_bShowIsoColor = false;
 bool						g_bShowVolume = false;
@@ -94,6 +97,12 @@ CDXUTTextHelper*            g_pTxtHelper = NULL;
 #define IDC_SAMPLING_POINT			30
 #define IDC_SHOW_BOUNDINGBOX		31
 #define IDC_SAVEVOLUME_BUTTON		32
+#define IDC_ADD_SURFACE				33
+#define IDC_SELECT_SURFACE			34
+#define IDC_COARSE_TO_FINE			35
+#define IDC_ORIENTED_BOUNDINGBOX	36
+#define IDC_PROFILE_SYNC			37
+#define IDC_SAVEPROFILE_BUTTON		38
 
 //--------------------------------------------------------------------------------------
 // Forward declarations 
@@ -168,6 +177,10 @@ void InitApp()
     g_SampleUI.SetCallback( OnGUIEvent ); int iY = 10;
 	g_SampleUI.AddButton(IDC_LOAD_SURFACE_1, L"Load Surface 1", 0, iY, 170, 30);
 	g_SampleUI.AddButton(IDC_LOAD_SURFACE_2, L"Load Surface 2", 0, iY+=30, 170, 30);
+	g_SampleUI.AddButton(IDC_ADD_SURFACE, L"Add Surface", 0, iY+=30, 170, 30);
+	g_SampleUI.AddComboBox(IDC_SELECT_SURFACE, 0, iY+=35, 170, 24);
+	g_SampleUI.GetComboBox(IDC_SELECT_SURFACE)->AddItem(L"Left Mouse: Surface 1", NULL);
+	g_SampleUI.GetComboBox(IDC_SELECT_SURFACE)->AddItem(L"Left Mouse: Surface 2", NULL);
 	g_SampleUI.AddRadioButton( IDC_ROTATE, IDC_ROTATE_MOVE_CAMERA, L"Rotate & Scale", 0, iY += 30, 170, 22);
 	g_SampleUI.AddRadioButton( IDC_MOVE, IDC_ROTATE_MOVE_CAMERA, L"Move", 0, iY += 20, 170, 22);
 	g_SampleUI.AddRadioButton( IDC_CAMERA, IDC_ROTATE_MOVE_CAMERA, L"Camera", 0, iY += 20, 170, 22);
@@ -187,6 +200,12 @@ void InitApp()
 	g_SampleUI.AddCheckBox(IDC_SHOW_BOUNDINGBOX, L"Show BoundingBox", 0, iY+=20, 170, 22);
 	g_SampleUI.GetCheckBox(IDC_SHOW_BOUNDINGBOX)->SetChecked(true);
 
+	g_SampleUI.AddCheckBox(IDC_COARSE_TO_FINE, L"Coarse-to-fine", 0, iY+=20, 170, 22);
+	g_SampleUI.GetCheckBox(IDC_COARSE_TO_FINE)->SetChecked(false);
+
+	g_SampleUI.AddCheckBox(IDC_ORIENTED_BOUNDINGBOX, L"Oriented BoundingBox", 0, iY+=20, 170, 22);
+	g_SampleUI.GetCheckBox(IDC_ORIENTED_BOUNDINGBOX)->SetChecked(false);
+
 	g_SampleUI.AddButton(IDC_DIFFUSION, L"Diffuse!", 0, iY+=30, 170, 30);
 
 	StringCchPrintf( sz, 100, L"Steps: %d", g_iDiffusionSteps);
@@ -226,6 +245,10 @@ void InitApp()
 	g_SampleUI.AddButton(IDC_SAVEVOLUME_BUTTON, L"Save Volume...", 0, iY+=30, 170, 30);
 	g_SampleUI.GetButton(IDC_SAVEVOLUME_BUTTON)->SetVisible(false);
 
+	g_SampleUI.AddCheckBox(IDC_PROFILE_SYNC, L"GPU Timing", 0, iY+=35, 170, 22);
+	g_SampleUI.GetCheckBox(IDC_PROFILE_SYNC)->SetChecked(false);
+	g_SampleUI.AddButton(IDC_SAVEPROFILE_BUTTON, L"Save Profile...", 0, iY+=25, 170, 30);
+
 	// Setup the camera's view parameters
     D3DXVECTOR3 vecEye( 0.0f, 0.0f, -40.0f );
     D3DXVECTOR3 vecAt ( 0.0f, 0.0f, 0.0f );
@@ -280,6 +303,10 @@ void RenderText()
     g_pTxtHelper->DrawTextLine( DXUTGetDeviceStats() );
 	g_pTxtHelper->DrawTextLine( Scene::GetInstance()->GetProgress() );
 
+	TextureManager::MEMORYSTATS memoryStats = Scene::GetInstance()->GetTextureManager()->GetMemoryStats();
+	g_pTxtHelper->DrawFormattedTextLine( L"Textures: %u MB live, %u MB pooled, %u MB peak", 
+		(unsigned int)(memoryStats.nLiveBytes >> 20), (unsigned int)(memoryStats.nPooledBytes >> 20), (unsigned int)(memoryStats.nHighWaterMark >> 20) );
+
 
 	g_pTxtHelper->End();//important for SAFE_DELETE
 
@@ -353,23 +380,23 @@ void CALLBACK OnMouseEvent( bool bLeftDown, bool bRightDown, bool bMiddleDown, b
 	{
 		if(bLeftDown)
 		{
-			Scene::GetInstance()->RotateSurface1(lookRight, (g_mouseY-iY)*g_fElapsedTime*g_mouseSpeed);
-			Scene::GetInstance()->RotateSurface1(lookUp, (g_mouseX-iX)*g_fElapsedTime*g_mouseSpeed);
+			Scene::GetInstance()->RotateSurface(g_iControlledSurface, lookRight, (g_mouseY-iY)*g_fElapsedTime*g_mouseSpeed);
+			Scene::GetInstance()->RotateSurface(g_iControlledSurface, lookUp, (g_mouseX-iX)*g_fElapsedTime*g_mouseSpeed);
 
 			if(iWheelDelta>0)
-				Scene::GetInstance()->ScaleSurface1(1.02f);
+				Scene::GetInstance()->ScaleSurface(g_iControlledSurface, 1.02f);
 			else if(iWheelDelta<0)
-				Scene::GetInstance()->ScaleSurface1(0.98f);
+				Scene::GetInstance()->ScaleSurface(g_iControlledSurface, 0.98f);
 		}
 		if(bRightDown)
 		{
-			Scene::GetInstance()->RotateSurface2(lookRight, (g_mouseY-iY)*g_fElapsedTime*g_mouseSpeed);
-			Scene::GetInstance()->RotateSurface2(lookUp, (g_mouseX-iX)*g_fElapsedTime*g_mouseSpeed);
+			Scene::GetInstance()->RotateSurface(1, lookRight, (g_mouseY-iY)*g_fElapsedTime*g_mouseSpeed);
+			Scene::GetInstance()->RotateSurface(1, lookUp, (g_mouseX-iX)*g_fElapsedTime*g_mouseSpeed);
 
 			if(iWheelDelta>0)
-				Scene::GetInstance()->ScaleSurface2(1.02f);
+				Scene::GetInstance()->ScaleSurface(1, 1.02f);
 			else if(iWheelDelta<0)
-				Scene::GetInstance()->ScaleSurface2(0.98f);
+				Scene::GetInstance()->ScaleSurface(1, 0.98f);
 		}
 		
 		
@@ -378,24 +405,24 @@ void CALLBACK OnMouseEvent( bool bLeftDown, bool bRightDown, bool bMiddleDown, b
 	{
 		if(bLeftDown)
 		{
-			Scene::GetInstance()->TranslateSurface1(g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.x, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.y, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.z);
-			Scene::GetInstance()->TranslateSurface1(g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.x, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.y, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.z);
+			Scene::GetInstance()->TranslateSurface(g_iControlledSurface, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.x, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.y, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.z);
+			Scene::GetInstance()->TranslateSurface(g_iControlledSurface, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.x, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.y, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.z);
 
 			if(iWheelDelta>0)
-				Scene::GetInstance()->TranslateSurface1(g_fElapsedTime*100*lookAt.x, g_fElapsedTime*100*lookAt.y, g_fElapsedTime*100*lookAt.z);
+				Scene::GetInstance()->TranslateSurface(g_iControlledSurface, g_fElapsedTime*100*lookAt.x, g_fElapsedTime*100*lookAt.y, g_fElapsedTime*100*lookAt.z);
 			else if(iWheelDelta<0)
-				Scene::GetInstance()->TranslateSurface1(-g_fElapsedTime*100*lookAt.x, -g_fElapsedTime*100*lookAt.y, -g_fElapsedTime*100*lookAt.z);
+				Scene::GetInstance()->TranslateSurface(g_iControlledSurface, -g_fElapsedTime*100*lookAt.x, -g_fElapsedTime*100*lookAt.y, -g_fElapsedTime*100*lookAt.z);
 		}
 
 		if(bRightDown)
 		{
-			Scene::GetInstance()->TranslateSurface2(g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.x, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.y, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.z);
-			Scene::GetInstance()->TranslateSurface2(g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.x, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.y, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.z);
+			Scene::GetInstance()->TranslateSurface(1, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.x, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.y, g_mouseSpeed*(iX-g_mouseX)*g_fElapsedTime*lookRight.z);
+			Scene::GetInstance()->TranslateSurface(1, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.x, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.y, g_mouseSpeed*(g_mouseY-iY)*g_fElapsedTime*lookUp.z);
 		
 			if(iWheelDelta>0)
-				Scene::GetInstance()->TranslateSurface1(g_fElapsedTime*100*lookAt.x, g_fElapsedTime*100*lookAt.y, g_fElapsedTime*100*lookAt.z);
+				Scene::GetInstance()->TranslateSurface(1, g_fElapsedTime*100*lookAt.x, g_fElapsedTime*100*lookAt.y, g_fElapsedTime*100*lookAt.z);
 			else if(iWheelDelta<0)
-				Scene::GetInstance()->TranslateSurface1(-g_fElapsedTime*100*lookAt.x, -g_fElapsedTime*100*lookAt.y, -g_fElapsedTime*100*lookAt.z);
+				Scene::GetInstance()->TranslateSurface(1, -g_fElapsedTime*100*lookAt.x, -g_fElapsedTime*100*lookAt.y, -g_fElapsedTime*100*lookAt.z);
 		}
 	}
 
@@ -453,7 +480,7 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
 
 
 				// load the surface mesh into the current surface
-				hr = Scene::GetInstance()->LoadSurface1(strMeshName);
+				hr = Scene::GetInstance()->LoadSurface(0, strMeshName);
 				if(hr == S_OK)
 				{
 					g_SampleUI.GetRadioButton(IDC_ALL_SLICES)->SetVisible(false);
@@ -497,7 +524,7 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
 
 
 				// load the surface mesh into the current surface
-				hr = Scene::GetInstance()->LoadSurface2(strMeshName);
+				hr = Scene::GetInstance()->LoadSurface(1, strMeshName);
 				if(hr == S_OK)
 				{
 					g_SampleUI.GetRadioButton(IDC_ALL_SLICES)->SetVisible(false);
@@ -517,6 +544,60 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
 				}
 				break;
 			}
+		case IDC_ADD_SURFACE:
+			{
+				// open a mesh file name
+				ZeroMemory(&ofnMesh, sizeof(ofnMesh));
+				ofnMesh.lStructSize = sizeof ( ofnMesh );
+				ofnMesh.hwndOwner = NULL  ;
+				ofnMesh.lpstrFile = sz;
+				ofnMesh.lpstrFile[0] = '\0';
+				ofnMesh.nMaxFile = sizeof(sz);
+				ofnMesh.lpstrFilter = L"All\0*.*\0";
+				ofnMesh.nFilterIndex =1;
+				ofnMesh.lpstrFileTitle = NULL ;
+				ofnMesh.nMaxFileTitle = 0 ;
+				ofnMesh.lpstrInitialDir=NULL ;
+				ofnMesh.Flags = OFN_PATHMUSTEXIST|OFN_FILEMUSTEXIST ;
+				GetOpenFileName( &ofnMesh );
+
+				if(wcslen(ofnMesh.lpstrFile) == 0)
+					break;
+
+				strMeshName = ConvertWideCharToChar(ofnMesh.lpstrFile);
+
+				// add the mesh as a new surface and make it controllable with the left mouse button
+				hr = Scene::GetInstance()->AddSurface(strMeshName);
+				if(hr == S_OK)
+				{
+					int iNewSurface = Scene::GetInstance()->GetSurfaceCount() - 1;
+					StringCchPrintf( sz, 100, L"Left Mouse: Surface %d", iNewSurface + 1);
+					g_SampleUI.GetComboBox(IDC_SELECT_SURFACE)->AddItem(sz, NULL);
+					g_SampleUI.GetComboBox(IDC_SELECT_SURFACE)->SetSelectedByIndex(iNewSurface);
+					g_iControlledSurface = iNewSurface;
+
+					g_SampleUI.GetRadioButton(IDC_ALL_SLICES)->SetVisible(false);
+					g_SampleUI.GetRadioButton(IDC_ONE_SLICE)->SetVisible(false);
+					g_SampleUI.GetStatic(IDC_SLICEINDEX_STATIC)->SetVisible(false);
+					g_SampleUI.GetSlider(IDC_SLICEINDEX_SLIDER)->SetVisible(false);
+					g_SampleUI.GetCheckBox(IDC_ISO_CHECK)->SetVisible(false);
+					g_SampleUI.GetStatic(IDC_ISO_SLIDER_STATIC)->SetVisible(false);
+					g_SampleUI.GetSlider(IDC_ISO_SLIDER)->SetVisible(false);
+					g_SampleUI.GetCheckBox(IDC_ISO_COLOR)->SetVisible(false);
+					g_SampleUI.GetButton(IDC_SAVEVOLUME_BUTTON)->SetVisible(false);
+					Scene::GetInstance()->Render3DTexture(false);
+				}
+				else
+				{
+					MessageBox ( NULL , L"Mesh could not be loaded", ofnMesh.lpstrFile , MB_OK);
+				}
+				break;
+			}
+		case IDC_SELECT_SURFACE:
+			{
+				g_iControlledSurface = g_SampleUI.GetComboBox(IDC_SELECT_SURFACE)->GetSelectedIndex();
+				break;
+			}
 		case IDC_ROTATE:
 			{
 				g_bRotatesWithMouse = true;
@@ -620,6 +701,16 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
 				Scene::GetInstance()->ChangeBoundingBoxVisibility(g_bShowBoundingBox);
 				break;
 			}
+		case IDC_COARSE_TO_FINE:
+			{
+				Scene::GetInstance()->SetCoarseToFine(g_SampleUI.GetCheckBox(IDC_COARSE_TO_FINE)->GetChecked());
+				break;
+			}
+		case IDC_ORIENTED_BOUNDINGBOX:
+			{
+				Scene::GetInstance()->SetOrientedBoundingBox(g_SampleUI.GetCheckBox(IDC_ORIENTED_BOUNDINGBOX)->GetChecked());
+				break;
+			}
 		case IDC_DIFFUSION:
 			{
 				g_SampleUI.GetRadioButton(IDC_ALL_SLICES)->SetVisible(true);
@@ -714,6 +805,43 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
 				else
 					MessageBox ( NULL , L"Texture saved!", ofnSave.lpstrFile , MB_OK);
 
+				break;
+			}
+		case IDC_PROFILE_SYNC:
+			{
+				Profiler::GetInstance()->SetSynchronize(g_SampleUI.GetCheckBox(IDC_PROFILE_SYNC)->GetChecked());
+				break;
+			}
+		case IDC_SAVEPROFILE_BUTTON:
+			{
+				// open a save file dialog
+				ZeroMemory(&ofnSave, sizeof(ofnSave));
+				ofnSave.lStructSize = sizeof(ofnSave);
+				ofnSave.hwndOwner = NULL;
+				ofnSave.lpstrFile = sz;
+				ofnSave.lpstrFile[0] = '\0';
+				ofnSave.nMaxFile = sizeof(sz);
+				ofnSave.lpstrFilter = L"Chrome Trace\0*.json\0JSON\0*.json\0CSV\0*.csv\0";
+				ofnSave.nFilterIndex =1;
+				ofnSave.lpstrFileTitle = NULL ;
+				ofnSave.nMaxFileTitle = 0 ;
+				ofnSave.lpstrInitialDir=NULL ;
+				ofnSave.lpstrDefExt = L"json";
+				GetSaveFileName(&ofnSave);
+
+				if(wcslen(ofnSave.lpstrFile) == 0)
+					break;
+
+				if(ofnSave.nFilterIndex == 3)
+					hr = Profiler::GetInstance()->SaveCSV(ofnSave.lpstrFile);
+				else if(ofnSave.nFilterIndex == 2)
+					hr = Profiler::GetInstance()->SaveJSON(ofnSave.lpstrFile);
+				else
+					hr = Profiler::GetInstance()->SaveChromeTrace(ofnSave.lpstrFile);
+
+				if(hr != S_OK)
+					MessageBox ( NULL , L"Profile could not be saved!", ofnSave.lpstrFile , MB_OK);
+
 				break;
 			}
     }
@@ -748,6 +876,7 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
     
 	Scene::GetInstance()->SetDevice(pd3dDevice);
 	Scene::GetInstance()->SetContext(pd3dImmediateContext);
+	Profiler::GetInstance()->SetContext(pd3dImmediateContext);
 
 	V_RETURN(Scene::GetInstance()->Initialize(g_iTextureWidth, g_iTextureHeight, g_iTextureDepth));
 	V_RETURN(Scene::GetInstance()->SetScreenSize(g_Width, g_Height));
@@ -880,7 +1009,8 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 
 	D3DXMATRIX mViewProjection = g_View * g_Proj;
 	
-	Scene::GetInstance()->Render(mViewProjection, g_bShowSurfaces);
+	HRESULT hr;
+	V(Scene::GetInstance()->Render(mViewProjection, g_bShowSurfaces));
 
 	DXUT_BeginPerfEvent( DXUT_PERFEVENTCOLOR, L"HUD / Stats" );
     g_SampleUI.OnRender( fElapsedTime );
@@ -910,7 +1040,9 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
     DXUTGetGlobalResourceCache().OnDestroyDevice();
     SAFE_DELETE(g_pTxtHelper);
 
+	Profiler::DeleteInstance();
 	Scene::DeleteInstance();
-	TextureManager::DeleteInstance();
+	ThreadPool::DeleteInstance();
+	MeshCache::DeleteInstance();
 
 }
\ No newline at end of file
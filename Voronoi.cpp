@@ -2,11 +2,15 @@
 #include "Voronoi.h"
 #include "TextureManager.h"
 #include "Scene.h"
+#include "BrickMap.h"
+#include "Profiler.h"
 
 /****************************************************************************
  ****************************************************************************/
-Voronoi::Voronoi(ID3DX11Effect *pVoronoiEffect)
+Voronoi::Voronoi(Scene* pScene, ID3DX11Effect *pVoronoiEffect)
 {
+	m_pScene = pScene;
+	m_pTextureManager = pScene->GetTextureManager();
 	m_pVoronoiEffect = pVoronoiEffect;
 
 	m_iTextureWidth = 0;
@@ -17,6 +21,13 @@ Voronoi::Voronoi(ID3DX11Effect *pVoronoiEffect)
 	m_pSlicesVB = NULL;
 
 	m_iCurrentSlice = 0;
+	m_iLastRenderedSlice = -1;
+	m_pBrickMap = NULL;
+
+	m_nColorTex3D = 0;
+	m_nDistTex3D = 0;
+	m_nDepthBufferTex2D = 0;
+	m_nSliceTex3D = 0;
 
 	m_bRendering = false;
 }
@@ -25,6 +36,16 @@ Voronoi::Voronoi(ID3DX11Effect *pVoronoiEffect)
  ****************************************************************************/
 Voronoi::~Voronoi()
 {
+	//the textures go back into the pool of the texture manager
+	unsigned int pTextures[] = { m_nColorTex3D, m_nDistTex3D, m_nSliceTex3D };
+	for(int i = 0; i < 3; i++)
+	{
+		if(m_pTextureManager->IsValidTexture(pTextures[i]))
+			m_pTextureManager->ReleaseTexture(pTextures[i]);
+	}
+
+	if(m_pTextureManager->IsValidDepthBuffer(m_nDepthBufferTex2D))
+		m_pTextureManager->ReleaseDepthBuffer(m_nDepthBufferTex2D);
 }
 
 /****************************************************************************
@@ -48,6 +69,7 @@ HRESULT Voronoi::Initialize(const int iWidth,
 
 	//Re-initialize the behaviour variables for incremental voronoi generation
 	m_iCurrentSlice = 0;
+	m_iLastRenderedSlice = -1;
 	m_bRendering = false;
 
 	return S_OK;
@@ -69,6 +91,7 @@ HRESULT Voronoi::Update(const int iWidth,
 
 	//Re-initialize the behaviour variables for incremental voronoi generation
 	m_iCurrentSlice = 0;
+	m_iLastRenderedSlice = -1;
 	m_bRendering = false;
 
 	return S_OK;
@@ -80,13 +103,11 @@ HRESULT	Voronoi::ItlInitTextures()
 {
 	HRESULT hr(S_OK);
 
-	m_nColorTex3D = TextureManager::GetInstance()->Create3DTexture("Voronoi 3D Texture", m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
-	m_nDistTex3D = TextureManager::GetInstance()->Create3DTexture("Distance 3D Texture", m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+	m_nColorTex3D = m_pTextureManager->Create3DTexture("Voronoi 3D Texture", m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+	m_nDistTex3D = m_pTextureManager->Create3DTexture("Distance 3D Texture", m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+	m_nSliceTex3D = m_pTextureManager->Create3DTexture("Voronoi Slice Texture", m_iTextureWidth, m_iTextureHeight, 1);
 
-	m_nColorSliceTex2D = TextureManager::GetInstance()->Create2DTexture("Color 2D Slice", m_iTextureWidth, m_iTextureHeight);
-	m_nDistSliceTex2D = TextureManager::GetInstance()->Create2DTexture("Distance 2D Slice", m_iTextureWidth, m_iTextureHeight);
-
-	m_nDepthBufferTex2D = TextureManager::GetInstance()->Create2DDepthBuffer("Depthbuffer 2D Slice", m_iTextureWidth, m_iTextureHeight);
+	m_nDepthBufferTex2D = m_pTextureManager->Create2DDepthBuffer("Depthbuffer 2D Slice", m_iTextureWidth, m_iTextureHeight);
 
 	return hr;
 }
@@ -97,13 +118,11 @@ HRESULT	Voronoi::ItlUpdateTextures()
 {
 	HRESULT hr(S_OK);
 
-	TextureManager::GetInstance()->Update3DTexture(m_nColorTex3D, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
-	TextureManager::GetInstance()->Update3DTexture(m_nDistTex3D, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
-
-	TextureManager::GetInstance()->Update2DTexture(m_nColorSliceTex2D, m_iTextureWidth, m_iTextureHeight);
-	TextureManager::GetInstance()->Update2DTexture(m_nDistSliceTex2D, m_iTextureWidth, m_iTextureHeight);
+	m_pTextureManager->Update3DTexture(m_nColorTex3D, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+	m_pTextureManager->Update3DTexture(m_nDistTex3D, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth);
+	m_pTextureManager->Update3DTexture(m_nSliceTex3D, m_iTextureWidth, m_iTextureHeight, 1);
 
-	TextureManager::GetInstance()->Update2DDepthBuffer(m_nDepthBufferTex2D, m_iTextureWidth, m_iTextureHeight);
+	m_pTextureManager->Update2DDepthBuffer(m_nDepthBufferTex2D, m_iTextureWidth, m_iTextureHeight);
 
 	return hr;
 }
@@ -130,7 +149,7 @@ HRESULT Voronoi::ItlInitSliceBuffer()
 	passVsDesc.pShaderVariable->GetShaderDesc(passVsDesc.ShaderIndex, &effectVsDesc);
 	const void *vsCodePtr = effectVsDesc.pBytecode;
 	unsigned int vsCodeLen = effectVsDesc.BytecodeLength;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateInputLayout(inputlayout, _countof(inputlayout), vsCodePtr, vsCodeLen, &m_pInputLayout));
+	V_RETURN(m_pScene->GetDevice()->CreateInputLayout(inputlayout, _countof(inputlayout), vsCodePtr, vsCodeLen, &m_pInputLayout));
 
 	SCREENQUAD_VERTEX sliceVertices[6];
 	sliceVertices[0].pos = D3DXVECTOR3(-1.0f, 1.0f, 0.5f);
@@ -157,7 +176,7 @@ HRESULT Voronoi::ItlInitSliceBuffer()
 	initialData.pSysMem = &sliceVertices;
 	initialData.SysMemPitch = 0;
 	initialData.SysMemSlicePitch = 0;
-	V_RETURN(Scene::GetInstance()->GetDevice()->CreateBuffer(&vbDesc, &initialData, &m_pSlicesVB));
+	V_RETURN(m_pScene->GetDevice()->CreateBuffer(&vbDesc, &initialData, &m_pSlicesVB));
 
 	return S_OK;
 }
@@ -198,22 +217,40 @@ HRESULT Voronoi::ItlInitShaders()
 
 /****************************************************************************
  ****************************************************************************/
-bool Voronoi::RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax)
+bool Voronoi::RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax, const D3DXMATRIX& mWorldToVolume)
 {
 	m_bRendering = true;
 
+	//skip the slices without active bricks
+	D3D11_RECT scissorRect = { 0, 0, m_iTextureWidth, m_iTextureHeight};
+	if(m_pBrickMap != NULL)
+	{
+		while(m_iCurrentSlice < m_iTextureDepth && !m_pBrickMap->GetSliceRect(m_iCurrentSlice, m_iTextureWidth, m_iTextureHeight, m_iTextureDepth, &scissorRect))
+			m_iCurrentSlice++;
+
+		if(m_iCurrentSlice == m_iTextureDepth)
+		{
+			m_iCurrentSlice = 0;
+			m_iLastRenderedSlice = -1;
+			m_bRendering = false;
+			return true;
+		}
+	}
+
+	PROFILE_SCOPE("Voronoi slice");
+	Profiler::GetInstance()->AddCounter("Voronoi voxels", double(scissorRect.right - scissorRect.left) * double(scissorRect.bottom - scissorRect.top));
+
 	//store the old render targets and viewports
-    ID3D11RenderTargetView* pOldRTV = DXUTGetD3D11RenderTargetView();
-    ID3D11DepthStencilView* pOldDSV = DXUTGetD3D11DepthStencilView();
-	UINT NumViewports = 1;
-	D3D11_VIEWPORT pViewports[100];
-	Scene::GetInstance()->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
-
-	// generate orth. matrices with bounding parameters
-	D3DXMATRIX mOrth, mModel1Orth, mModel2Orth;
+	ID3D11RenderTargetView* pOldRTV = NULL;
+	ID3D11DepthStencilView* pOldDSV = NULL;
+	m_pScene->GetContext()->OMGetRenderTargets(1, &pOldRTV, &pOldDSV);
+	UINT NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	D3D11_VIEWPORT pViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	m_pScene->GetContext()->RSGetViewports( &NumViewports, &pViewports[0]);
+
+	// generate orth. matrix with bounding parameters
+	D3DXMATRIX mOrth;
 	D3DXMatrixOrthoOffCenterLH(&mOrth, vBBMin.x, vBBMax.x, vBBMin.y, vBBMax.y, vBBMin.z, vBBMax.z);
-	D3DXMatrixMultiply(&mModel1Orth, &Scene::GetInstance()->GetSurface1()->m_mModel, &mOrth);
-	D3DXMatrixMultiply(&mModel2Orth, &Scene::GetInstance()->GetSurface2()->m_mModel, &mOrth);
 
 	//set bounding box parameters
 	D3DXVECTOR4 vBBMinOrth, vBBMaxOrth;
@@ -223,74 +260,72 @@ bool Voronoi::RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax)
 	assert(vBBMinOrth);
 	assert(vBBMaxOrth);
 
-	//Compute NormalMatrix for both surfaces
-	D3DXMATRIX mModel1_3x3 = D3DXMATRIX(Scene::GetInstance()->GetSurface1()->m_mModel._11, Scene::GetInstance()->GetSurface1()->m_mModel._12, Scene::GetInstance()->GetSurface1()->m_mModel._13, 0.0f, 
-									  Scene::GetInstance()->GetSurface1()->m_mModel._21, Scene::GetInstance()->GetSurface1()->m_mModel._22, Scene::GetInstance()->GetSurface1()->m_mModel._23, 0.0f, 
-									  Scene::GetInstance()->GetSurface1()->m_mModel._31, Scene::GetInstance()->GetSurface1()->m_mModel._32, Scene::GetInstance()->GetSurface1()->m_mModel._33, 0.0f, 
-									  0.0f, 0.0f, 0.0f, 1.0f);
-	D3DXMATRIX mModel1_3x3Inv, mNormalMatrix1;
-	D3DXMatrixInverse(&mModel1_3x3Inv, NULL, &mModel1_3x3);
-	D3DXMatrixTranspose(&mNormalMatrix1, &mModel1_3x3Inv);
-
-	D3DXMATRIX mModel2_3x3 = D3DXMATRIX(Scene::GetInstance()->GetSurface2()->m_mModel._11, Scene::GetInstance()->GetSurface2()->m_mModel._12, Scene::GetInstance()->GetSurface2()->m_mModel._13, 0.0f, 
-									  Scene::GetInstance()->GetSurface2()->m_mModel._21, Scene::GetInstance()->GetSurface2()->m_mModel._22, Scene::GetInstance()->GetSurface2()->m_mModel._23, 0.0f, 
-									  Scene::GetInstance()->GetSurface2()->m_mModel._31, Scene::GetInstance()->GetSurface2()->m_mModel._32, Scene::GetInstance()->GetSurface2()->m_mModel._33, 0.0f, 
-									  0.0f, 0.0f, 0.0f, 1.0f);
-	D3DXMATRIX mModel2_3x3Inv, mNormalMatrix2;
-	D3DXMatrixInverse(&mModel2_3x3Inv, NULL, &mModel2_3x3);
-	D3DXMatrixTranspose(&mNormalMatrix2, &mModel2_3x3Inv);
-	
 	// Set Variables needed for Voronoi Diagram Computation
 	m_pBBMinVar->SetFloatVector(vBBMinOrth);
 	m_pBBMaxVar->SetFloatVector(vBBMaxOrth);
 	m_pTextureSizeVar->SetFloatVector(D3DXVECTOR3((float)m_iTextureWidth, (float)m_iTextureHeight, (float)m_iTextureDepth));
 	
+	ItlInitCurrentSlice(scissorRect);
+
 	// clear depthstencilview
-	TextureManager::GetInstance()->Clear2DDepthBuffer(m_nDepthBufferTex2D);
+	m_pTextureManager->Clear2DDepthBuffer(m_nDepthBufferTex2D);
 
-	//Set 2D slice Textures and depthstencil view as RenderTargets
-	TextureManager::GetInstance()->BindTextureAsRTV(m_nColorSliceTex2D, m_nDistSliceTex2D, m_nDepthBufferTex2D);
+	//Set the current slices of the 3D textures and the depthstencil view as RenderTargets
+	m_pTextureManager->BindTextureSliceAsRTV(m_nColorTex3D, m_nDistTex3D, m_iCurrentSlice, m_nDepthBufferTex2D);
 
 	// Set viewport and scissor to match the size of a single slice 
 	D3D11_VIEWPORT viewport = { 0, 0, float(m_iTextureWidth), float(m_iTextureHeight), 0.0f, 1.0f };
-	Scene::GetInstance()->GetContext()->RSSetViewports(1, &viewport);
-	D3D11_RECT scissorRect = { 0, 0, m_iTextureWidth, m_iTextureHeight};
-	Scene::GetInstance()->GetContext()->RSSetScissorRects(1, &scissorRect);
+	m_pScene->GetContext()->RSSetViewports(1, &viewport);
+	m_pScene->GetContext()->RSSetScissorRects(1, &scissorRect);
 
 	// Draw the current slice
 	m_pSliceIndexVar->SetInt(m_iCurrentSlice);
 
-	m_pVoronoiDiagramTechnique->GetPassByIndex(0)->Apply(0, Scene::GetInstance()->GetContext());
-
-	// Render the surfaces
-	m_pModelViewProjectionVar->SetMatrix(mModel1Orth);
-	m_pNormalMatrixVar->SetMatrix(mNormalMatrix1);
-	m_pIsoSurfaceVar->SetFloat(Scene::GetInstance()->GetSurface1()->GetIsoColor());
-	m_pIsTexturedVar->SetBool(Scene::GetInstance()->GetSurface1()->IsTextured());
-	Scene::GetInstance()->GetSurface1()->RenderVoronoi(m_pVoronoiDiagramTechnique, m_pSurfaceTextureVar);
-
-	m_pModelViewProjectionVar->SetMatrix(mModel2Orth);
-	m_pNormalMatrixVar->SetMatrix(mNormalMatrix2);
-	m_pIsoSurfaceVar->SetFloat(Scene::GetInstance()->GetSurface2()->GetIsoColor());
-	m_pIsTexturedVar->SetBool(Scene::GetInstance()->GetSurface2()->IsTextured());
-	Scene::GetInstance()->GetSurface2()->RenderVoronoi(m_pVoronoiDiagramTechnique, m_pSurfaceTextureVar);
+	m_pVoronoiDiagramTechnique->GetPassByIndex(0)->Apply(0, m_pScene->GetContext());
 
-	// render the 2D texture slices into the 3D Textures
-	TextureManager::GetInstance()->Render2DTextureInto3DSlice(m_nColorSliceTex2D, m_nColorTex3D, m_iCurrentSlice);
-	TextureManager::GetInstance()->Render2DTextureInto3DSlice(m_nDistSliceTex2D, m_nDistTex3D, m_iCurrentSlice);
+	// Render the surfaces, every voxel gets the color and iso value of its closest surface
+	for(int i = 0; i < m_pScene->GetSurfaceCount(); i++)
+	{
+		Surface* pSurface = m_pScene->GetSurface(i);
+
+		//transform the surface into the frame of the volume
+		D3DXMATRIX mModelVolume, mModelOrth;
+		D3DXMatrixMultiply(&mModelVolume, &pSurface->GetModelMatrix(), &mWorldToVolume);
+		D3DXMatrixMultiply(&mModelOrth, &mModelVolume, &mOrth);
+
+		//Compute NormalMatrix of the surface
+		D3DXMATRIX mModel_3x3 = D3DXMATRIX(mModelVolume._11, mModelVolume._12, mModelVolume._13, 0.0f, 
+										   mModelVolume._21, mModelVolume._22, mModelVolume._23, 0.0f, 
+										   mModelVolume._31, mModelVolume._32, mModelVolume._33, 0.0f, 
+										   0.0f, 0.0f, 0.0f, 1.0f);
+		D3DXMATRIX mModel_3x3Inv, mNormalMatrix;
+		D3DXMatrixInverse(&mModel_3x3Inv, NULL, &mModel_3x3);
+		D3DXMatrixTranspose(&mNormalMatrix, &mModel_3x3Inv);
+
+		m_pModelViewProjectionVar->SetMatrix(mModelOrth);
+		m_pNormalMatrixVar->SetMatrix(mNormalMatrix);
+		m_pIsoSurfaceVar->SetFloat(pSurface->GetIsoColor());
+		m_pIsTexturedVar->SetBool(pSurface->IsTextured());
+		pSurface->RenderVoronoi(m_pVoronoiDiagramTechnique, m_pSurfaceTextureVar);
+	}
 
+	m_iLastRenderedSlice = m_iCurrentSlice;
+	m_LastSliceRect = scissorRect;
 	m_iCurrentSlice++;
 	
 	//restore old render targets
-	TextureManager::GetInstance()->UnBindRTVs();
+	m_pTextureManager->UnBindRTVs();
 
 	//restore old render targets
-	Scene::GetInstance()->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
-	Scene::GetInstance()->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	m_pScene->GetContext()->OMSetRenderTargets( 1,  &pOldRTV,  pOldDSV );
+	m_pScene->GetContext()->RSSetViewports( NumViewports, &pViewports[0]);
+	SAFE_RELEASE(pOldRTV);
+	SAFE_RELEASE(pOldDSV);
 
 	if(m_iCurrentSlice == m_iTextureDepth)
 	{
 		m_iCurrentSlice = 0;
+		m_iLastRenderedSlice = -1;
 		m_bRendering = false;
 		return true;
 	}
@@ -300,6 +335,40 @@ bool Voronoi::RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax)
 	}
 }
 
+/****************************************************************************
+ ****************************************************************************/
+void Voronoi::ItlInitCurrentSlice(const D3D11_RECT& scissorRect)
+{
+	//with a brick map the previous slice may have been skipped or have a smaller rectangle
+	D3D11_RECT rect = scissorRect;
+	bool bCarryOver = m_iCurrentSlice > 0 && m_iLastRenderedSlice == m_iCurrentSlice - 1;
+	if(bCarryOver)
+	{
+		rect.left = max(rect.left, m_LastSliceRect.left);
+		rect.top = max(rect.top, m_LastSliceRect.top);
+		rect.right = min(rect.right, m_LastSliceRect.right);
+		rect.bottom = min(rect.bottom, m_LastSliceRect.bottom);
+		bCarryOver = rect.left < rect.right && rect.top < rect.bottom;
+	}
+
+	bool bCoversSlice = bCarryOver && rect.left == scissorRect.left && rect.top == scissorRect.top
+						&& rect.right == scissorRect.right && rect.bottom == scissorRect.bottom;
+	if(!bCoversSlice)
+	{
+		m_pTextureManager->ClearTextureSlice(m_nColorTex3D, m_iCurrentSlice);
+		m_pTextureManager->ClearTextureSlice(m_nDistTex3D, m_iCurrentSlice);
+	}
+
+	if(bCarryOver)
+	{
+		//a slice can not be copied within its own texture, it goes through the slice texture
+		m_pTextureManager->CopyTextureSlice(m_nColorTex3D, m_iCurrentSlice - 1, m_nSliceTex3D, 0, rect);
+		m_pTextureManager->CopyTextureSlice(m_nSliceTex3D, 0, m_nColorTex3D, m_iCurrentSlice, rect);
+		m_pTextureManager->CopyTextureSlice(m_nDistTex3D, m_iCurrentSlice - 1, m_nSliceTex3D, 0, rect);
+		m_pTextureManager->CopyTextureSlice(m_nSliceTex3D, 0, m_nDistTex3D, m_iCurrentSlice, rect);
+	}
+}
+
 /****************************************************************************
  ****************************************************************************/
 void Voronoi::ItlDrawCurrentSlice()
@@ -310,11 +379,11 @@ void Voronoi::ItlDrawCurrentSlice()
 	UINT strides = sizeof(SCREENQUAD_VERTEX);
 	UINT offsets = 0;
 
-	Scene::GetInstance()->GetContext()->IASetInputLayout(m_pInputLayout);
-	Scene::GetInstance()->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
-	Scene::GetInstance()->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	m_pScene->GetContext()->IASetInputLayout(m_pInputLayout);
+	m_pScene->GetContext()->IASetVertexBuffers(0, 1, &m_pSlicesVB, &strides, &offsets);
+	m_pScene->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
-	Scene::GetInstance()->GetContext()->Draw(6, 0);
+	m_pScene->GetContext()->Draw(6, 0);
 }
 
 /****************************************************************************
@@ -3,6 +3,10 @@
 
 #include "Surface.h"
 
+class BrickMap;
+class Scene;
+class TextureManager;
+
 
 class Voronoi
 {
@@ -10,7 +14,7 @@ public:
 	/*
 	 *  Constructor
 	 */
-	Voronoi(ID3DX11Effect *pVoronoiEffect);
+	Voronoi(Scene* pScene, ID3DX11Effect *pVoronoiEffect);
 
 	/*
 	 *  Destructor
@@ -30,9 +34,15 @@ public:
 	
 
 	/*
-	 *  Renders the voronoi diagram and the distance diagram into the 3D texture
+	 *  Renders the voronoi diagram and the distance diagram into the 3D texture.
+	 *	The bounding box is given in the frame of mWorldToVolume.
+	 */
+	bool RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax, const D3DXMATRIX& mWorldToVolume);
+
+	/*
+	 *  Restricts the rendering to the active bricks of the brick map, NULL renders the whole volume
 	 */
-	bool RenderVoronoi(D3DXVECTOR3 vBBMin, D3DXVECTOR3 vBBMax);
+	void SetBrickMap(const BrickMap* pBrickMap) { m_pBrickMap = pBrickMap; }
 
 	/*
 	 * Returns the current voronoi rendering progress
@@ -53,14 +63,30 @@ private:
 	 */
 	void ItlDrawCurrentSlice();
 
+	/*
+	 *  Voxels that no surface covers keep the values of the previous slice. The slice starts empty
+	 *	if the previous slice was not rendered in this generation.
+	 */
+	void ItlInitCurrentSlice(const D3D11_RECT& scissorRect);
+
 	//Inputlayout and slice vertex buffer
 	ID3D11InputLayout			*m_pInputLayout;
 	ID3D11Buffer                *m_pSlicesVB;
 
 	int							m_iCurrentSlice;
 
+	//last slice of this generation and its scissor rectangle, -1 before the first one
+	int							m_iLastRenderedSlice;
+	D3D11_RECT					m_LastSliceRect;
+
 	bool						m_bRendering;
 
+	const BrickMap				*m_pBrickMap;
+
+	//scene the voronoi diagram belongs to, the textures are created by its texture manager
+	Scene						*m_pScene;
+	TextureManager				*m_pTextureManager;
+
 	ID3DX11Effect				*m_pVoronoiEffect;
 	ID3DX11EffectTechnique		*m_pVoronoiDiagramTechnique;
 	ID3DX11EffectTechnique		*m_p2Dto3DTechnique;
@@ -84,9 +110,10 @@ private:
 	//Textures
 	unsigned int		m_nColorTex3D;
 	unsigned int		m_nDistTex3D;
-	unsigned int		m_nColorSliceTex2D;
-	unsigned int		m_nDistSliceTex2D;
 	unsigned int		m_nDepthBufferTex2D;
+
+	//one slice, the previous slice is copied through it into the current one
+	unsigned int		m_nSliceTex3D;
 	
 	//3d texture size
 	int							m_iTextureWidth;
@@ -0,0 +1,194 @@
+#include "WindingNumber.h"
+#include <algorithm>
+
+//maximum number of triangles in a leaf of the hierarchy
+#define WINDINGNUMBER_LEAF_SIZE 8
+
+
+/****************************************************************************
+ ****************************************************************************/
+WindingNumber::WindingNumber()
+{
+	m_fBeta = 2.0f;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+WindingNumber::~WindingNumber()
+{
+}
+
+/****************************************************************************
+ ****************************************************************************/
+void WindingNumber::Build(const SURFACE_VERTEX* pVertices, unsigned int nNumVertices, const unsigned int* pIndices, unsigned int nNumIndices)
+{
+	m_vTriangles.clear();
+	m_vNodes.clear();
+
+	unsigned int nNumTriangles = nNumIndices / 3;
+	m_vTriangles.reserve(nNumTriangles);
+
+	for(unsigned int i = 0; i < nNumTriangles; i++)
+	{
+		if(pIndices[3*i] >= nNumVertices || pIndices[3*i+1] >= nNumVertices || pIndices[3*i+2] >= nNumVertices)
+			continue;
+
+		TRIANGLE triangle;
+		triangle.v[0] = pVertices[pIndices[3*i]].pos;
+		triangle.v[1] = pVertices[pIndices[3*i+1]].pos;
+		triangle.v[2] = pVertices[pIndices[3*i+2]].pos;
+		triangle.vCenter = (triangle.v[0] + triangle.v[1] + triangle.v[2]) / 3.0f;
+		m_vTriangles.push_back(triangle);
+	}
+
+	if(m_vTriangles.empty())
+		return;
+
+	//a binary tree with one leaf per WINDINGNUMBER_LEAF_SIZE triangles has less than 2*n/LEAF_SIZE nodes
+	m_vNodes.reserve(2 * (m_vTriangles.size() / WINDINGNUMBER_LEAF_SIZE + 1));
+	ItlBuildNode(0, m_vTriangles.size());
+}
+
+/****************************************************************************
+ ****************************************************************************/
+int WindingNumber::ItlBuildNode(unsigned int nFirst, unsigned int nCount)
+{
+	int iNode = m_vNodes.size();
+	m_vNodes.push_back(NODE());
+
+	NODE node;
+	node.nFirst = nFirst;
+	node.nCount = nCount;
+	node.iLeft = -1;
+	node.iRight = -1;
+
+	//bounding box and dipole of the triangles
+	node.vMin = node.vMax = m_vTriangles[nFirst].v[0];
+	node.vNormal = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	D3DXVECTOR3 vWeightedCenter(0.0f, 0.0f, 0.0f);
+	float fArea = 0.0f;
+
+	for(unsigned int i = nFirst; i < nFirst + nCount; i++)
+	{
+		const TRIANGLE& triangle = m_vTriangles[i];
+		for(int j = 0; j < 3; j++)
+		{
+			D3DXVec3Minimize(&node.vMin, &node.vMin, &triangle.v[j]);
+			D3DXVec3Maximize(&node.vMax, &node.vMax, &triangle.v[j]);
+		}
+
+		//the cross product has the length of twice the triangle area
+		D3DXVECTOR3 vEdge1 = triangle.v[1] - triangle.v[0];
+		D3DXVECTOR3 vEdge2 = triangle.v[2] - triangle.v[0];
+		D3DXVECTOR3 vCross;
+		D3DXVec3Cross(&vCross, &vEdge1, &vEdge2);
+		float fTriangleArea = 0.5f * D3DXVec3Length(&vCross);
+
+		node.vNormal += 0.5f * vCross;
+		vWeightedCenter += fTriangleArea * triangle.vCenter;
+		fArea += fTriangleArea;
+	}
+
+	if(fArea > 0.0f)
+		node.vCenter = vWeightedCenter / fArea;
+	else
+		node.vCenter = 0.5f * (node.vMin + node.vMax);
+
+	node.fRadius = 0.0f;
+	for(unsigned int i = nFirst; i < nFirst + nCount; i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			D3DXVECTOR3 vDiff = m_vTriangles[i].v[j] - node.vCenter;
+			node.fRadius = max(node.fRadius, D3DXVec3Length(&vDiff));
+		}
+	}
+
+	//split at the median of the triangle centers along the longest axis
+	if(nCount > WINDINGNUMBER_LEAF_SIZE)
+	{
+		D3DXVECTOR3 vExtent = node.vMax - node.vMin;
+		int iAxis = 0;
+		if(vExtent.y > vExtent.x && vExtent.y >= vExtent.z)
+			iAxis = 1;
+		else if(vExtent.z > vExtent.x && vExtent.z > vExtent.y)
+			iAxis = 2;
+
+		unsigned int nHalf = nCount / 2;
+		std::nth_element(m_vTriangles.begin() + nFirst, m_vTriangles.begin() + nFirst + nHalf, m_vTriangles.begin() + nFirst + nCount,
+			[iAxis](const TRIANGLE& a, const TRIANGLE& b) -> bool
+		{
+			return ((const float*)a.vCenter)[iAxis] < ((const float*)b.vCenter)[iAxis];
+		});
+
+		node.iLeft = ItlBuildNode(nFirst, nHalf);
+		node.iRight = ItlBuildNode(nFirst + nHalf, nCount - nHalf);
+	}
+
+	m_vNodes[iNode] = node;
+	return iNode;
+}
+
+/****************************************************************************
+ ****************************************************************************/
+float WindingNumber::ItlTriangleWindingNumber(const TRIANGLE& triangle, const D3DXVECTOR3& vPoint)
+{
+	//solid angle formula of van Oosterom and Strackee
+	D3DXVECTOR3 a = triangle.v[0] - vPoint;
+	D3DXVECTOR3 b = triangle.v[1] - vPoint;
+	D3DXVECTOR3 c = triangle.v[2] - vPoint;
+
+	float fLengthA = D3DXVec3Length(&a);
+	float fLengthB = D3DXVec3Length(&b);
+	float fLengthC = D3DXVec3Length(&c);
+
+	D3DXVECTOR3 vCross;
+	D3DXVec3Cross(&vCross, &b, &c);
+	float fDet = D3DXVec3Dot(&a, &vCross);
+	float fDiv = fLengthA * fLengthB * fLengthC
+		+ D3DXVec3Dot(&a, &b) * fLengthC
+		+ D3DXVec3Dot(&b, &c) * fLengthA
+		+ D3DXVec3Dot(&c, &a) * fLengthB;
+
+	return float(2.0 * atan2(fDet, fDiv) / (4.0 * PI));
+}
+
+/****************************************************************************
+ ****************************************************************************/
+float WindingNumber::Compute(const D3DXVECTOR3& vPoint) const
+{
+	if(m_vNodes.empty())
+		return 0.0f;
+
+	float fWindingNumber = 0.0f;
+
+	int pStack[64];
+	int iStackSize = 0;
+	pStack[iStackSize++] = 0;
+
+	while(iStackSize > 0)
+	{
+		const NODE& node = m_vNodes[pStack[--iStackSize]];
+
+		D3DXVECTOR3 vDiff = node.vCenter - vPoint;
+		float fDistance = D3DXVec3Length(&vDiff);
+
+		if(fDistance > m_fBeta * node.fRadius)
+		{
+			//far field: the node acts like a dipole at its center
+			fWindingNumber += float(D3DXVec3Dot(&node.vNormal, &vDiff) / (4.0 * PI * fDistance * fDistance * fDistance));
+		}
+		else if(node.iLeft < 0)
+		{
+			for(unsigned int i = node.nFirst; i < node.nFirst + node.nCount; i++)
+				fWindingNumber += ItlTriangleWindingNumber(m_vTriangles[i], vPoint);
+		}
+		else
+		{
+			pStack[iStackSize++] = node.iLeft;
+			pStack[iStackSize++] = node.iRight;
+		}
+	}
+
+	return fWindingNumber;
+}
@@ -0,0 +1,90 @@
+#ifndef _WINDINGNUMBER_H_
+#define _WINDINGNUMBER_H_
+
+#include "Globals.h"
+#include <vector>
+
+/*
+ *  Generalized winding number of a triangle mesh (Jacobson et al. 2013).
+ *	The value is 1 inside and 0 outside of a closed mesh and degrades gracefully for meshes
+ *	with holes or self intersections. The triangles are stored in a bounding volume hierarchy,
+ *	nodes far away from the query point are approximated by their dipole (sum of the area
+ *	weighted normals at the area weighted center).
+ */
+class WindingNumber
+{
+public:
+	/*
+	 *  Constructor
+	 */
+	WindingNumber();
+
+	/*
+	 *  Destructor
+	 */
+	~WindingNumber();
+
+	/*
+	 *  Builds the hierarchy of the triangle list (object space)
+	 */
+	void Build(const SURFACE_VERTEX* pVertices, unsigned int nNumVertices, const unsigned int* pIndices, unsigned int nNumIndices);
+
+	/*
+	 *  Returns the winding number of the point
+	 */
+	float Compute(const D3DXVECTOR3& vPoint) const;
+
+	/*
+	 *  Returns true if the absolute winding number of the point is greater than 0.5,
+	 *	the absolute value makes the test independent of the triangle orientation
+	 */
+	bool IsInside(const D3DXVECTOR3& vPoint) const { return fabs(Compute(vPoint)) > 0.5f; }
+
+	/*
+	 *  Accuracy of the far field approximation: a node is approximated if the point is
+	 *	more than fBeta times the node radius away from the node center (default 2.0)
+	 */
+	void SetAccuracy(float fBeta) { m_fBeta = fBeta; }
+
+	unsigned int GetNumTriangles() const { return (unsigned int)m_vTriangles.size(); }
+
+protected:
+	struct TRIANGLE
+	{
+		D3DXVECTOR3 v[3];
+		D3DXVECTOR3 vCenter;
+	};
+
+	struct NODE
+	{
+		D3DXVECTOR3 vMin;
+		D3DXVECTOR3 vMax;
+
+		//dipole of the node
+		D3DXVECTOR3 vCenter;
+		D3DXVECTOR3 vNormal;
+		float fRadius;
+
+		//inner nodes reference their children, leaves a range of triangles
+		unsigned int nFirst;
+		unsigned int nCount;
+		int iLeft;
+		int iRight;
+	};
+
+	/*
+	 *  Recursively builds the node of the triangles [nFirst, nFirst+nCount) and returns its index
+	 */
+	int ItlBuildNode(unsigned int nFirst, unsigned int nCount);
+
+	/*
+	 *  Exact solid angle of a triangle seen from the point divided by 4*PI
+	 */
+	static float ItlTriangleWindingNumber(const TRIANGLE& triangle, const D3DXVECTOR3& vPoint);
+
+	std::vector<TRIANGLE> m_vTriangles;
+	std::vector<NODE> m_vNodes;
+	float m_fBeta;
+};
+
+#endif